@@ -6,6 +6,7 @@
 
 #include "main_technique.h"
 #include "main_scene.h"
+#include "ImageStatistics.h"
 #include "ca4g.h"
 
 using namespace CA4G;
@@ -24,6 +25,12 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 #define SAVE_STATS
 
+// Convergence stop: closes the app once the relative standard error of the image
+// (ImageRelativeError of the saved Sum and SqrSum) is below this value, checked at the power of two
+// saves only, 0 renders until the window is closed. This is not adaptive sampling, every pass still
+// traces every pixel (per tile allocation exists only in the CPU path tracer, AdaptiveSampling.h).
+#define STOP_RELATIVE_ERROR 0.0
+
 #define RESOLUTION_COMPARISONS 0
 #define RESOLUTION_PITAGORAS 1
 #define RESOLUTION_SQUARE 2
@@ -110,6 +117,8 @@ int main(int, char**)
 	auto technique = presenter _create TechniqueObj<main_technique>();
 	auto takingScreenshot = presenter _create TechniqueObj<ScreenShotTechnique>();
 	auto savingStats = presenter _create TechniqueObj<ImageSavingTechnique>();
+	auto savingSqrStats = presenter _create TechniqueObj<ImageSavingTechnique>();
+	auto savingRoulettes = presenter _create TechniqueObj<ImageSavingTechnique>();
 
 	gObj<IGatherImageStatistics> asStatistics = technique.Dynamic_Cast<IGatherImageStatistics>();
 
@@ -152,6 +161,7 @@ int main(int, char**)
 
 			RenderGUI<IManageScene>(technique);
 			RenderGUI<IShowComplexity>(technique);
+			RenderGUI<IReportTables>(technique);
 
 			ImGui::End();
 		}
@@ -168,6 +178,8 @@ int main(int, char**)
 		if (frameIndex == 0) {
 			presenter _load TechniqueObj(takingScreenshot);
 			presenter _load TechniqueObj(savingStats);
+			presenter _load TechniqueObj(savingSqrStats);
+			presenter _load TechniqueObj(savingRoulettes);
 			presenter _load TechniqueObj(technique);
 
 			presenter _create FlushAndSignal().WaitFor();
@@ -200,9 +212,23 @@ int main(int, char**)
 				savingStats->TextureToSave = sumTexture;
 				presenter _dispatch TechniqueObj(savingStats); // saving sum
 
-				savingStats->FileName = fileName + CA4G::string("_sqrSum.bin");
-				savingStats->TextureToSave = sqrSumTexture;
-				presenter _dispatch TechniqueObj(savingStats); // saving sqr sum
+				savingSqrStats->FileName = fileName + CA4G::string("_sqrSum.bin");
+				savingSqrStats->TextureToSave = sqrSumTexture;
+				presenter _dispatch TechniqueObj(savingSqrStats); // saving sqr sum
+
+				if (asStatistics->getRoulettes()) {
+					savingRoulettes->FileName = fileName + CA4G::string("_roulettes.bin");
+					savingRoulettes->TextureToSave = asStatistics->getRoulettes();
+					presenter _dispatch TechniqueObj(savingRoulettes); // saving roulettes played and paths ended
+				}
+
+				if (STOP_RELATIVE_ERROR > 0) {
+					double error = ImageRelativeError((float*)savingStats->Data, (float*)savingSqrStats->Data,
+						sumTexture->Width * sumTexture->Height, sumTexture->getElementSize() / sizeof(float),
+						frames, asStatistics->getChannelsPerFrame());
+					if (error <= STOP_RELATIVE_ERROR)
+						::PostQuitMessage(0); // converged, the last saves are the result
+				}
 			}
 		}
 #endif
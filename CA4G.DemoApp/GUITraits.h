@@ -18,8 +18,20 @@ namespace CA4G {
 		float PathtracingRatio = 0.0;
 	};
 
+	struct IReportTables {
+		// Why the offline tables of the technique were not loaded (the technique draws nothing),
+		// empty when they are valid
+		char TableStatus[1024] = "";
+	};
+
 	struct IGatherImageStatistics {
 		virtual void getAccumulators(gObj<Texture2D> &sum, gObj<Texture2D> &sqrSum, int& frames) = 0;
+		// Channels every frame adds a sample to (3 with spectral or shared paths, 1 when a frame
+		// traces only the channel frames % 3)
+		virtual int getChannelsPerFrame() { return 1; }
+		// Russian roulettes played and paths ended per pixel, surface and medium (uint4, see
+		// RussianRoulette in Scattering.h), null when the technique plays none
+		virtual gObj<Texture2D> getRoulettes() { return nullptr; }
 	};
 }
 
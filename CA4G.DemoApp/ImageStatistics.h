@@ -0,0 +1,41 @@
+#ifndef IMAGE_STATISTICS_H
+#define IMAGE_STATISTICS_H
+
+#include <cmath>
+#include <limits>
+
+// Relative error estimates of the accumulated images, for the convergence stop of the DemoApp
+// (STOP_RELATIVE_ERROR) and the adaptive rounds of the CPU path tracer (AdaptiveSampling.h).
+
+// Added to the value of a pixel before dividing its standard error by it. Noise in dark pixels is
+// judged against this floor of the display range instead of against a value close to 0.
+#define RELATIVE_ERROR_EPSILON 0.05
+
+// Relative standard error of the mean sum / passes of a pixel from the sums of its samples and of
+// their squares (three channels). With channelsPerPass 3 every pass samples all the channels, with
+// 1 the pass p samples only the channel p % 3 (scaled by 3, so the mean still divides by passes).
+// Infinite before every channel has two samples.
+inline double PixelRelativeError(const float* sum, const float* sqrSum, int passes, int channelsPerPass, double epsilon = RELATIVE_ERROR_EPSILON) {
+	double variance = 0, mean = 0;
+	for (int c = 0; c < 3; c++) {
+		double samples = channelsPerPass == 3 ? passes : (passes + 2 - c) / 3; // passes of the channel c
+		if (samples < 2)
+			return std::numeric_limits<double>::infinity();
+		double sampleVariance = (sqrSum[c] - sum[c] * (double)sum[c] / samples) / (samples - 1);
+		variance += (sampleVariance > 0 ? sampleVariance : 0) * samples / ((double)passes * passes); // of sum / passes
+		mean += sum[c] / (double)passes;
+	}
+	return sqrt(variance / 3) / (fabs(mean / 3) + epsilon);
+}
+
+// Root mean square of PixelRelativeError over an image of pixels with stride floats per pixel.
+inline double ImageRelativeError(const float* sum, const float* sqrSum, int pixels, int stride, int passes, int channelsPerPass, double epsilon = RELATIVE_ERROR_EPSILON) {
+	double error = 0;
+	for (int i = 0; i < pixels; i++) {
+		double e = PixelRelativeError(sum + (size_t)i * stride, sqrSum + (size_t)i * stride, passes, channelsPerPass, epsilon);
+		error += e * e;
+	}
+	return sqrt(error / (pixels > 0 ? pixels : 1));
+}
+
+#endif
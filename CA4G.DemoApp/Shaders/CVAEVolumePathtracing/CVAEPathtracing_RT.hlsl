@@ -4,6 +4,8 @@
 #include "..\Tools\CommonPT.h" 
 
 // Random using is HybridTaus
+// A Sobol point per pass when every pass traces the three channels
+#define SOBOL_PASSES_PER_SAMPLE (SHARED_PATH_MEDIA ? 1 : 3)
 #include "..\Tools\Randoms.h"
 
 // Includes some functions for surface scattering and texture mapping
@@ -57,6 +59,12 @@ cbuffer Transforming : register(b1) {
 
 #include "../Tools/HGPhaseFunction.h"
 
+// Spheres beyond the range of the model
+#include "../Tools/DiffusionSphere.h"
+
+// Shared-path sampling of the color channels
+#include "../Tools/SharedPath.h"
+
 //#include "CVAEScatteringModel.h"
 #include "CVAEScatteringModelX.h"
 
@@ -200,8 +208,8 @@ void SurfelScattering(inout float3 x, inout float3 w, inout float3 importance, V
 float3 ComputePathOld(float3 O, float3 D, inout int complexity)
 {
 	int cmp = NumberOfPasses % 3;
-	float3 importance = 0;
-	importance[cmp] = 3;
+	bool shared;
+	float3 importance = StartChannelImportance(cmp, shared);
 	float3 x = O;
 	float3 w = D;
 
@@ -217,6 +225,7 @@ float3 ComputePathOld(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		RayPayload payload = (RayPayload)0;
 		if (!Intersect(x, w, payload)) // 
@@ -233,36 +242,51 @@ float3 ComputePathOld(float3 O, float3 D, inout int complexity)
 			payload.TransformIndex,
 			surfel, material, volMaterial, 0, 0);
 
+		if (!isOutside)
+			BeginMediumFlight(importance, shared, volMaterial, cmp);
+
 		float d = length(surfel.P - x); // Distance to the hit position.
 		float t = isOutside || volMaterial.Extinction[cmp] == 0 ? 100000000 : -log(max(0.000000000001, 1 - random())) / volMaterial.Extinction[cmp];
 
 		[branch]
 		if (t >= d)
 		{
+			if (!isOutside)
+				SharedTransmittance(importance, shared, volMaterial.Extinction, cmp, d);
+
 			bounces += isOutside;
 			
 			if (bounces >= MAX_PATHTRACING_BOUNCES)
 				return 0;
 
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return 0;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return 0;
 			x += t * w; // free traverse in a medium
+			SharedCollision(importance, shared, volMaterial.Extinction, cmp, t);
 
 			bool UsePT = DispatchRaysIndex().x < DispatchRaysDimensions().x* PathtracingRatio;
 
 			if (UsePT)
 			{
-				if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+				if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 					return 0;
+				SharedSurvival(importance, shared, volMaterial.ScatteringAlbedo, cmp);
+				float3 win = w;
 				w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+				SharedPhase(importance, shared, volMaterial.G, cmp, win, w);
 			}
 			else
 			{
+				BeginMediumEvent(importance, shared, volMaterial, cmp);
 				//return GetColor(payload.TransformIndex);
 				float r = MaximalRadius(x, payload.TransformIndex);
 				float er = volMaterial.Extinction[cmp] * r;
@@ -288,8 +312,8 @@ float3 ComputePathOld(float3 O, float3 D, inout int complexity)
 float3 ComputePath(float3 O, float3 D, inout int complexity)
 {
 	int cmp = NumberOfPasses % 3;
-	float3 importance = 0;
-	importance[cmp] = 3;
+	bool shared;
+	float3 importance = StartChannelImportance(cmp, shared);
 	float3 x = O;
 	float3 w = D;
 
@@ -305,6 +329,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		RayPayload payload = (RayPayload)0;
 		if (!Intersect(x, w, payload)) // 
@@ -321,34 +346,48 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 			payload.TransformIndex,
 			surfel, material, volMaterial, 0, 0);
 
+		if (!isOutside)
+			BeginMediumFlight(importance, shared, volMaterial, cmp);
+
 		float d = length(surfel.P - x); // Distance to the hit position.
 		float t = isOutside || volMaterial.Extinction[cmp] == 0 ? 100000000 : -log(max(0.000000000001, 1 - random())) / volMaterial.Extinction[cmp];
 
 		[branch]
 		if (t >= d)
 		{
+			if (!isOutside)
+				SharedTransmittance(importance, shared, volMaterial.Extinction, cmp, d);
+
 			bounces += isOutside;
 
 			if (bounces > 5)
 				return 0;
 
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return 0;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return 0;
 			bool UsePT = DispatchRaysIndex().x < DispatchRaysDimensions().x* PathtracingRatio;
 
 			if (UsePT)
 			{
 				x += t * w; // free traverse in a medium
+				SharedCollision(importance, shared, volMaterial.Extinction, cmp, t);
 
-				if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+				if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 					return 0;
+				SharedSurvival(importance, shared, volMaterial.ScatteringAlbedo, cmp);
 
+				float3 win = w;
 				w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+				SharedPhase(importance, shared, volMaterial.G, cmp, win, w);
 			}
 			else
 			{
@@ -358,8 +397,10 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 
 				if (er >= 1)
 				{
+					// Flights and events inside the spheres use the hero coefficients only
+					BeginMediumEvent(importance, shared, volMaterial, cmp);
 					while (er >= 1) {
-						er = min(er, 256);
+						er = min(er, MAX_SPHERE_RADIUS);
 
 						t = -log(1 - random()) / volMaterial.Extinction[cmp];
 						if (t < r)  // Some scattering in sphere
@@ -367,11 +408,16 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 							x += w * t; // move to scatter position
 							// compute sphere radius again
 							r = MaximalRadius(x, payload.TransformIndex);
-							er = volMaterial.Extinction[cmp] * r;
+							er = min(volMaterial.Extinction[cmp] * r, MAX_SPHERE_RADIUS);
 
 							// Check scattering
 							float3 _x, _w;
-							if (!GenerateVariablesWithModel(volMaterial.G[cmp], volMaterial.ScatteringAlbedo[cmp], w, er, _x, _w))
+							bool exits;
+							if (er > CVAE_MAX_RADIUS) // beyond the training range
+								exits = GenerateVariablesInDiffusion(volMaterial.G[cmp], volMaterial.ScatteringAlbedo[cmp], w, er, _x, _w);
+							else
+								exits = GenerateVariablesWithModel(volMaterial.G[cmp], volMaterial.ScatteringAlbedo[cmp], w, er, _x, _w);
+							if (!exits)
 								return 0;
 							w = _w;
 							x += _x * er / volMaterial.Extinction[cmp];
@@ -386,11 +432,15 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				else
 				{
 					x += t * w; // free traverse in a medium
+					SharedCollision(importance, shared, volMaterial.Extinction, cmp, t);
 
-					if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+					if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 						return 0;
+					SharedSurvival(importance, shared, volMaterial.ScatteringAlbedo, cmp);
 
+					float3 win = w;
 					w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+					SharedPhase(importance, shared, volMaterial.G, cmp, win, w);
 				}
 			}
 		}
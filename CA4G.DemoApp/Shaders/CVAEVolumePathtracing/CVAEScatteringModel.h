@@ -1,10 +1,4 @@
-float1 softplusActivation(float1 x) { return log(1 + exp(x)); }
-
-float2 softplusActivation(float2 x) { return log(1 + exp(x)); }
-
-float3 softplusActivation(float3 x) { return log(1 + exp(x)); }
-
-float4 softplusActivation(float4 x) { return log(1 + exp(x)); }
+#include "../Tools/Activations.h"
 
 void lenModel(float _input[4], out float _output[2]) {
 	float4 n_0_0 = float4(_input[0], _input[1], _input[2], _input[3]);
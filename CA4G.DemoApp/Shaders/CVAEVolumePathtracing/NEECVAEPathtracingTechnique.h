@@ -3,6 +3,7 @@
 
 #include "ca4g.h"
 #include "../../GUITraits.h"
+#include "../Tools/Parameters.h"
 
 using namespace CA4G;
 
@@ -124,6 +125,7 @@ public:
 				binder _set UAV(1, Context()->Accumulation);
 				binder _set UAV(2, Context()->SqrAccumulation);
 				binder _set UAV(3, Context()->Complexity);
+				binder _set UAV(4, Context()->Roulettes);
 				binder _set SRV(0, Context()->VertexBuffer);
 				binder _set SRV(1, Context()->IndexBuffer);
 				binder _set SRV(2, Context()->Transforms);
@@ -176,6 +178,7 @@ public:
 		gObj<Texture2D> Accumulation;
 		gObj<Texture2D> SqrAccumulation;
 		gObj<Texture2D> Complexity;
+		gObj<Texture2D> Roulettes;
 		struct PerGeometryInfo {
 			int StartTriangle;
 			int VertexOffset;
@@ -255,6 +258,16 @@ public:
 		frames = pipeline->AccumulativeInfo.Pass;
 	}
 
+	gObj<Texture2D> getRoulettes()
+	{
+		return pipeline->Roulettes;
+	}
+
+	int getChannelsPerFrame()
+	{
+		return SHARED_PATH_MEDIA ? 3 : 1;
+	}
+
 	// Inherited via Technique
 	virtual void OnLoad() override {
 
@@ -301,6 +314,7 @@ public:
 		pipeline->Accumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->SqrAccumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->Complexity = __create Texture2D_UAV<uint>(render_target->Width, render_target->Height);
+		pipeline->Roulettes = __create Texture2D_UAV<uint4>(render_target->Width, render_target->Height);
 
 		pipeline->Lighting = __create Buffer_CB<LightingCB>();
 		pipeline->ProjectionToWorld = __create Buffer_CB<float4x4>();
@@ -648,6 +662,7 @@ public:
 			pipeline->AccumulativeInfo.Pass = 0;
 			manager _clear UAV(pipeline->Accumulation, uint4(0));
 			manager _clear UAV(pipeline->Complexity, uint4(0));
+			manager _clear UAV(pipeline->Roulettes, uint4(0));
 		}
 
 		pipeline->AccumulativeInfo.ShowComplexity = ShowComplexity ? 1 : 0;
@@ -4,6 +4,8 @@
 #include "..\Tools\CommonPT.h" 
 
 // Random using is HybridTaus
+// A Sobol point per pass when every pass traces the three channels
+#define SOBOL_PASSES_PER_SAMPLE (SHARED_PATH_MEDIA ? 1 : 3)
 #include "..\Tools\Randoms.h"
 
 // Includes some functions for surface scattering and texture mapping
@@ -57,6 +59,9 @@ cbuffer Transforming : register(b1) {
 
 #include "../Tools/HGPhaseFunction.h"
 
+// Shared-path sampling of the color channels
+#include "../Tools/SharedPath.h"
+
 //#include "CVAEScatteringModel.h"
 #include "CVAEScatteringModelX.h"
 
@@ -295,8 +300,8 @@ void SurfelScattering(inout float3 x, inout float3 w, inout float3 importance, V
 float3 ComputePathWithNEE(float3 O, float3 D, inout int complexity)
 {
 	int cmp = NumberOfPasses % 3;
-	float3 importance = 0;
-	importance[cmp] = 3;
+	bool shared;
+	float3 importance = StartChannelImportance(cmp, shared);
 	float3 x = O;
 	float3 w = D;
 
@@ -312,6 +317,7 @@ float3 ComputePathWithNEE(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		RayPayload payload = (RayPayload)0;
 		if (!Intersect(x, w, payload)) // 
@@ -328,32 +334,44 @@ float3 ComputePathWithNEE(float3 O, float3 D, inout int complexity)
 			payload.TransformIndex,
 			surfel, material, volMaterial, 0, 0);
 
+		if (!isOutside)
+			BeginMediumFlight(importance, shared, volMaterial, cmp);
+
 		float d = length(surfel.P - x); // Distance to the hit position.
 		float t = isOutside || volMaterial.Extinction[cmp] == 0 ? 100000000 : -log(max(0.000000000001, 1 - random())) / volMaterial.Extinction[cmp];
 
 		[branch]
 		if (t >= d)
 		{
+			if (!isOutside)
+				SharedTransmittance(importance, shared, volMaterial.Extinction, cmp, d);
+
 			bounces += isOutside;
 
 			if (bounces >= MAX_PATHTRACING_BOUNCES)
 				return 0;
 
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return directContribution;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return directContribution;
 			x += t * w; // free traverse in a medium
+			SharedCollision(importance, shared, volMaterial.Extinction, cmp, t);
 
 			bool UsePT = DispatchRaysIndex().x < DispatchRaysDimensions().x* PathtracingRatio;
 
 			if (UsePT)
 			{
-				if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+				if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 					return directContribution;
+				SharedSurvival(importance, shared, volMaterial.ScatteringAlbedo, cmp);
 
 				// Ray cast to light source
 				// NEE using straight line as a naive approximation missing refraction at interface
@@ -373,12 +391,16 @@ float3 ComputePathWithNEE(float3 O, float3 D, inout int complexity)
 				payload = (RayPayload)0;
 				bool clearPathToLight = !Intersect(surfel.P + LightDirection * 0.01, LightDirection, payload); // Shadow ray
 
-				directContribution += clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction[cmp]) * EvalPhase(volMaterial.G[cmp], w, LightDirection) / 2;
+				// per channel terms, only the hero is non zero in importance if the path is not shared
+				directContribution += clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction) * EvalPhaseChannels(volMaterial.G, w, LightDirection) / 2;
 
+				float3 win = w;
 				w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+				SharedPhase(importance, shared, volMaterial.G, cmp, win, w);
 			}
 			else
 			{
+				BeginMediumEvent(importance, shared, volMaterial, cmp);
 				//return GetColor(payload.TransformIndex);
 				float r = MaximalRadius(x, payload.TransformIndex);
 				float er = volMaterial.Extinction[cmp] * r;
@@ -411,7 +433,7 @@ float3 ComputePathWithNEE(float3 O, float3 D, inout int complexity)
 				payload = (RayPayload)0;
 				bool clearPathToLight = !Intersect(surfel.P + LightDirection * 0.01, LightDirection, payload); // Shadow ray
 
-				directContribution += factor * clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction[cmp]) * EvalPhase(volMaterial.G[cmp], _W, LightDirection) / 2;
+				directContribution += factor * clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction) * EvalPhaseChannels(volMaterial.G, _W, LightDirection) / 2;
 
 				w = _w;
 				x += _x * r;
@@ -6,17 +6,14 @@
 
 #include "../Tools/Parameters.h"
 
-// HG factor [-1,1] linear
-#define BINS_G 200
-
-// Scattering albedo [0, 0.999] linear in log(1 / (1 - alpha))
-#define BINS_SA 1000
-
-// Radius [1, 256] linear in log(r)
-#define BINS_R 9
-
-// Theta [0,pi] linear in cos(theta)
-#define BINS_THETA 45
+// Bins of the table, generated from its header (CA4G.Offline tabledefines, a pre-build step)
+#if STF_ADAPTIVE_BINS
+// Adaptive g and phi bins of stf_adaptive.bin (CA4G.Offline stfadaptive g=64 sa=128),
+// located with the edges of the table (see TableBins.h)
+#include "STFAdaptiveTableDefines.h"
+#else
+#include "STFTableDefines.h"
+#endif
 
 #define STRIDE_G (BINS_SA * BINS_R * BINS_THETA)
 #define STRIDE_SA (BINS_R * BINS_THETA)
@@ -34,12 +31,21 @@
 
 #include "../Tools/HGPhaseFunction.h"
 
+// Spheres beyond the tables
+#include "../Tools/DiffusionSphere.h"
+
 // Top level structure with the scene
 RaytracingAccelerationStructure Scene : register(t0, space0);
 
 // Shell Transport Function used as PDF of the outgoing position
+#if TABLE_ALIAS_SAMPLING
+// Alias tables of the empirical cdf(x | g, phi, r)
+#include "../Tools/AliasTable.h"
+StructuredBuffer<uint> STFAlias					: register(t1);
+#else
 // The STF is storing actually the empirical cdf(x | g, phi, r)
 StructuredBuffer<float> STF						: register(t1);
+#endif
 // [r, phi, g] -> s^1
 StructuredBuffer<float> OnceTimeScatteringAlbedo : register(t2);
 //Texture3D<float> OnceTimeScatteringAlbedo		: register(t2);
@@ -47,6 +53,93 @@ StructuredBuffer<float> OnceTimeScatteringAlbedo : register(t2);
 StructuredBuffer<float> MultipleTimeScatteringAlbedo : register(t3);
 //Texture3D<float> MultipleTimeScatteringAlbedo	: register(t3);
 
+#if STF_SCENE_SLICES
+// The tables hold only the (g, phi) slices of the scene media (see TableSlices.h)
+// [g, phi] -> slice, -1 for bins of no medium (dense, BINS_G * BINS_SA ints)
+StructuredBuffer<int> STFSlices : register(t0, space2);
+#endif
+
+#if STF_ADAPTIVE_BINS
+// Edges of g (BINS_G + 1) and of phi up to 0.999 (BINS_SA - 1) in their axis coordinates
+StructuredBuffer<float> STFEdges : register(t1, space2);
+// Bins of u = i / TABLE_BIN_LOOKUP for g and then for phi
+StructuredBuffer<uint> STFBinLookup : register(t2, space2);
+#define TABLE_BIN_LOOKUP 256
+
+// Bin of u in [0, 1) among count bins, the edges start at edges and the lookup at lookup
+int LocateBin(int edges, int lookup, int count, float u) {
+	int bin = STFBinLookup[lookup + clamp((int)(u * TABLE_BIN_LOOKUP), 0, TABLE_BIN_LOOKUP - 1)];
+	while (bin < count - 1 && u >= STFEdges[edges + bin + 1])
+		bin++;
+	return bin;
+}
+#endif
+
+int STFGBin(float g) {
+#if STF_ADAPTIVE_BINS
+	return LocateBin(0, 0, BINS_G, g * 0.5 + 0.5);
+#else
+	return min((g * 0.5 + 0.5) * BINS_G, BINS_G - 1);
+#endif
+}
+
+// phi is binned linearly in log(1 / (1 - phi)) up to 0.999, the last two bins are 0.999 and above
+int STFPhiBin(float phi) {
+	if (phi > 0.999)
+		return BINS_SA - 1;
+#if STF_ADAPTIVE_BINS
+	float u = log(1 / (1 - phi)) / log(1 / 0.001);
+	return u >= 1 ? BINS_SA - 2 : LocateBin(BINS_G + 1, TABLE_BIN_LOOKUP, BINS_SA - 2, u);
+#else
+	return (log(1 / (1 - phi))) * (BINS_SA - 2) / (log(1 / 0.001));
+#endif
+}
+
+#if TABLE_INTERPOLATED_SAMPLING
+// Center of the bin b among count bins of an axis on [0, 1], the bin past the last is the point 1
+float STFBinCenter(int edges, int count, int b) {
+	if (b >= count)
+		return 1;
+#if STF_ADAPTIVE_BINS
+	return 0.5 * (STFEdges[edges + b] + STFEdges[edges + b + 1]);
+#else
+	return (b + 0.5) / count;
+#endif
+}
+
+// The bin of u or its neighbour towards u (up to last) with the linear weights between their
+// centers, the tables mix as if they were interpolated.
+int STFPickBin(int edges, int count, int last, int bin, float u) {
+	int lower = u < STFBinCenter(edges, count, bin) ? bin - 1 : bin;
+	if (lower < 0 || lower >= last)
+		return bin;
+	float c0 = STFBinCenter(edges, count, lower);
+	float c1 = STFBinCenter(edges, count, lower + 1);
+	return lower + (random() < (u - c0) / (c1 - c0));
+}
+
+int STFPickGBin(float g) {
+	return STFPickBin(0, BINS_G, BINS_G - 1, STFGBin(g), g * 0.5 + 0.5);
+}
+
+// phi above 0.999 keeps its bin
+int STFPickPhiBin(float phi) {
+	int bin = STFPhiBin(phi);
+	if (bin >= BINS_SA - 2)
+		return bin;
+	return STFPickBin(BINS_G + 1, BINS_SA - 2, BINS_SA - 2, bin, log(1 / (1 - phi)) / log(1 / 0.001));
+}
+#endif
+
+// Slice of the tables with the rows of (g, phi), negative if it was not loaded.
+int STFSlice(int gBin, int phiBin) {
+#if STF_SCENE_SLICES
+	return STFSlices[gBin * BINS_SA + phiBin];
+#else
+	return gBin * BINS_SA + phiBin;
+#endif
+}
+
 float DistanceToSphereBoundary(float3 x, float3 w)
 {
 	//float a = dot(w,w); <- 1 because w is normalized
@@ -136,15 +229,28 @@ bool SampleCosXAndW2(float g, float phi, float r, out float theta, out float bet
 	rBin += (random() < r / (1 << rBin) - 1); // better than interpolate beteen logR and logR+1
 	//int rBin = (int)logR + (random() < (logR % 1)); // better than interpolate beteen logR and logR+1
 
+#if TABLE_INTERPOLATED_SAMPLING
+	int phiBin = STFPickPhiBin(phi);
+	int gBin = STFPickGBin(g);
+#else
+#if STF_ADAPTIVE_BINS
+	int phiBin = STFPhiBin(phi);
+#else
+	// this variant scales phi by BINS_SA - 1 (STFPhiBin by BINS_SA - 2)
 	int phiBin = phi > 0.999 ? BINS_SA - 1 :
 		(log(1 / (1 - phi))) * (BINS_SA - 1) / (log(1 / 0.001));
-	int gBin = min((g * 0.5 + 0.5) * BINS_G, BINS_G - 1);
-	int offsetInSTFTable = rBin * STRIDE_R + phiBin * STRIDE_SA + gBin * STRIDE_G;
+#endif
+	int gBin = STFGBin(g);
+#endif
+	int slice = STFSlice(gBin, phiBin);
+	if (slice < 0) // medium without tables, absorbed
+		return false;
+	int offsetInSTFTable = rBin * STRIDE_R + slice * STRIDE_SA;
 
 	float selectingCase = random();
-	float prob1Scat = OnceTimeScatteringAlbedo[gBin * (BINS_SA * BINS_R) + phiBin * BINS_R + rBin];
+	float prob1Scat = OnceTimeScatteringAlbedo[slice * BINS_R + rBin];
 	//float prob1Scat = OnceTimeScatteringAlbedo[uint3(rBin, phiBin, gBin)];
-	float probmScat = MultipleTimeScatteringAlbedo[gBin * (BINS_SA * BINS_R) + phiBin * BINS_R + rBin];
+	float probmScat = MultipleTimeScatteringAlbedo[slice * BINS_R + rBin];
 	//float probmScat = MultipleTimeScatteringAlbedo[uint3(rBin, phiBin, gBin)];
 
 	if (selectingCase * (1 - exp(-r) - prob1Scat) < probmScat) {
@@ -162,6 +268,9 @@ bool SampleCosXAndW2(float g, float phi, float r, out float theta, out float bet
 		// theta should be sampled from the table!
 
 		int minTheta = offsetInSTFTable;
+#if TABLE_ALIAS_SAMPLING
+		minTheta += SampleAlias(STFAlias, offsetInSTFTable, BINS_THETA, random(), random());
+#else
 		int maxTheta = offsetInSTFTable + BINS_THETA - 1;
 
 		// Binary search after working
@@ -172,6 +281,7 @@ bool SampleCosXAndW2(float g, float phi, float r, out float theta, out float bet
 			else
 				minTheta = med + 1;
 		}
+#endif
 		theta = 2 * ((minTheta - offsetInSTFTable) + random()) / BINS_THETA - 1;
 		return true;
 	}
@@ -208,6 +318,9 @@ bool SampleCosXAndW2(float g, float phi, float r, out float theta, out float bet
 // Return true if the sample exit, false if ray is absorbed.
 bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta, out float alpha)
 {
+	if (r > (1 << (BINS_R - 1))) // beyond the last radius of the tables
+		return DiffusionSampleCosXAndW(g, phi, r, theta, beta, alpha);
+
 	float logR = max(0, (log2(r)));
 
 	int rBin = (int)logR;
@@ -215,16 +328,23 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 	rBin += (random() < (logR % 1)); // better than interpolate beteen logR and logR+1
 	r = pow(2.0, rBin);
 
-	int phiBin = phi > 0.999 ? BINS_SA - 1 :
-		(log(1 / (1 - phi))) * (BINS_SA - 2) / (log(1 / 0.001));
-	int gBin = min((g * 0.5 + 0.5) * BINS_G, BINS_G - 1);
-	int offsetInSTFTable = rBin * STRIDE_R + phiBin * STRIDE_SA + gBin * STRIDE_G;
+#if TABLE_INTERPOLATED_SAMPLING
+	int phiBin = STFPickPhiBin(phi);
+	int gBin = STFPickGBin(g);
+#else
+	int phiBin = STFPhiBin(phi);
+	int gBin = STFGBin(g);
+#endif
+	int slice = STFSlice(gBin, phiBin);
+	if (slice < 0) // medium without tables, absorbed
+		return false;
+	int offsetInSTFTable = rBin * STRIDE_R + slice * STRIDE_SA;
 
 	float selectingCase = random();
 	float prob0Scat = exp(-r);
-	float prob1Scat = OnceTimeScatteringAlbedo[gBin*(BINS_SA * BINS_R) + phiBin * BINS_R + rBin];
+	float prob1Scat = OnceTimeScatteringAlbedo[slice * BINS_R + rBin];
 	//float prob1Scat = OnceTimeScatteringAlbedo[uint3(rBin, phiBin, gBin)];
-	float probmScat = MultipleTimeScatteringAlbedo[gBin * (BINS_SA * BINS_R) + phiBin * BINS_R + rBin];
+	float probmScat = MultipleTimeScatteringAlbedo[slice * BINS_R + rBin];
 	//float probmScat = MultipleTimeScatteringAlbedo[uint3(rBin, phiBin, gBin)];
 
 	if (selectingCase < prob0Scat) // no scattering
@@ -276,6 +396,9 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 		// theta should be sampled from the table!
 
 		int minTheta = offsetInSTFTable;
+#if TABLE_ALIAS_SAMPLING
+		minTheta += SampleAlias(STFAlias, offsetInSTFTable, BINS_THETA, random(), random());
+#else
 		int maxTheta = offsetInSTFTable + BINS_THETA - 1;
 
 		// Binary search after working
@@ -286,6 +409,7 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 			else
 				minTheta = med + 1;
 		}
+#endif
 		theta = 2 * ((minTheta - offsetInSTFTable) + random()) / BINS_THETA - 1;
 		return true;
 
@@ -449,6 +573,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		RayPayload payload = (RayPayload)0;
 		if (!Intersect(x, w, payload)) // 
@@ -477,18 +602,22 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				return 0;
 
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return 0;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return 0;
 			bool UsePT = DispatchRaysIndex().x < DispatchRaysDimensions().x* PathtracingRatio;
 
 			if (UsePT) {
 				x += t * w; // free traverse in a medium
 
-				if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+				if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 					return 0;
 
 				w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
@@ -502,7 +631,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				if (er >= 1)
 				{
 					while (er >= 1) {
-						er = min(er, 256);
+						er = min(er, MAX_SPHERE_RADIUS);
 						float3 _x, _w;
 						if (!GenerateVariablesWithTable(volMaterial.G[cmp], volMaterial.ScatteringAlbedo[cmp], w, er, _x, _w))
 							return 0;
@@ -517,7 +646,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				{
 					x += t * w; // free traverse in a medium
 
-					if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+					if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 						return 0;
 
 					w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
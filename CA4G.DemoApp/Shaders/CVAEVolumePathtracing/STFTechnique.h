@@ -3,22 +3,23 @@
 
 #include "ca4g.h"
 #include "../../GUITraits.h"
-
-// HG factor [-1,1] linear
-#define BINS_G 200
-
-// Scattering albedo [0, 0.999] linear in log(1 / (1 - alpha))
-#define BINS_SA 1000
-
-// Radius [1, 256] linear in log(r)
-#define BINS_R 9
-
-// Theta [0,pi] linear in cos(theta)
-#define BINS_THETA 45
+#include "../Tools/Parameters.h"
+#include "TableFile.h"
+#include "TableStreaming.h"
+#include "TableSlices.h"
+
+// Bins of the table, generated from its header (CA4G.Offline tabledefines, a pre-build step)
+#if STF_ADAPTIVE_BINS
+// Adaptive g and phi bins of stf_adaptive.bin (CA4G.Offline stfadaptive g=64 sa=128),
+// located with the edges of the table (see TableBins.h)
+#include "STFAdaptiveTableDefines.h"
+#else
+#include "STFTableDefines.h"
+#endif
 
 using namespace CA4G;
 
-class STFTechnique : public Technique,
+class STFTechnique : public TableStreamingTechnique,
 	public IManageScene,
 	public IShowComplexity,
 	public IGatherImageStatistics {
@@ -136,6 +137,7 @@ public:
 				binder _set UAV(1, Context()->Accumulation);
 				binder _set UAV(2, Context()->SqrAccumulation);
 				binder _set UAV(3, Context()->Complexity);
+				binder _set UAV(4, Context()->Roulettes);
 				binder _set SRV(0, Context()->VertexBuffer);
 				binder _set SRV(1, Context()->IndexBuffer);
 				binder _set SRV(2, Context()->Transforms);
@@ -153,6 +155,17 @@ public:
 				binder _set SRV(3, Context()->MultiTimeSA);
 				binder _set SRV(4, Context()->GridInfos);
 				binder _set SRV_Array(5, Context()->DistanceFields, Context()->NumberOfDFs);
+#if STF_SCENE_SLICES
+				binder _set Space(2);
+				binder _set SRV(0, Context()->STFSlices);
+				binder _set Space(0);
+#endif
+#if STF_ADAPTIVE_BINS
+				binder _set Space(2);
+				binder _set SRV(1, Context()->STFEdges);
+				binder _set SRV(2, Context()->STFBinLookup);
+				binder _set Space(0);
+#endif
 
 				binder _set CBV(0, Context()->Lighting);
 				binder _set CBV(1, Context()->ProjectionToWorld);
@@ -191,6 +204,7 @@ public:
 		gObj<Texture2D> Accumulation;
 		gObj<Texture2D> SqrAccumulation;
 		gObj<Texture2D> Complexity;
+		gObj<Texture2D> Roulettes;
 		struct PerGeometryInfo {
 			int StartTriangle;
 			int VertexOffset;
@@ -213,6 +227,11 @@ public:
 		//gObj<Texture3D> OneTimeSA;
 		gObj<Buffer> MultiTimeSA;
 		//gObj<Texture3D> MultiTimeSA;
+		// [g, phi] -> slice of the tables (STF_SCENE_SLICES)
+		gObj<Buffer> STFSlices;
+		// g and phi edges and their bin lookup (STF_ADAPTIVE_BINS)
+		gObj<Buffer> STFEdges;
+		gObj<Buffer> STFBinLookup;
 
 		gObj<Buffer> GridInfos;
 		gObj<Texture3D>* DistanceFields;
@@ -238,6 +257,64 @@ public:
 	// Used to build bottom level ADS
 	gObj<Buffer> GeometryTransforms;
 
+#pragma region Scene Table Slices
+
+	// With STF_SCENE_SLICES the buffers hold only the (g, phi) slices of the scene media (see
+	// TableSlices.h), 1.7 MB for MAX_SCENE_SLICES. The remap STFSlices stays dense, one int per
+	// (g, phi) bin (800 KB at 200 x 1000), so the shaders find a slice with one read. The table
+	// stays mapped to add the slices of media changed later.
+	static const int MAX_SCENE_SLICES = 1024;
+	MappedTableFile sliceFile;
+	STFTableSlices* sceneSlices = nullptr;
+	// slices already in the buffers
+	int uploadedSlices = 0;
+	// Contents of the slice buffers
+	std::vector<float> sliceOneTimeSA;
+	std::vector<float> sliceMultiTimeSA;
+	std::vector<unsigned int> sliceRows;
+
+	// Adds the slices of the current media and uploads the new ones. When the buffers are full
+	// the slices of media no longer in the scene are dropped.
+	void UpdateSceneSlices(gObj<GraphicsManager> manager) {
+		auto media = scene->getScene()->VolumeMaterials();
+		for (int pass = 0; pass < 2; pass++)
+		{
+			// a medium adds at most 9 slices per channel, the ones that do not fit are absorbed
+			for (int i = 0; i < media.Count && sceneSlices->Count() <= MAX_SCENE_SLICES - 27; i++)
+			{
+				// surfaces have no extinction and never sample the tables
+				VolumeMaterial &m = media.Data[i];
+				if (m.Extinction.x > 0)
+					sceneSlices->AddMedium(m.G.x, m.ScatteringAlbedo.x);
+				if (m.Extinction.y > 0)
+					sceneSlices->AddMedium(m.G.y, m.ScatteringAlbedo.y);
+				if (m.Extinction.z > 0)
+					sceneSlices->AddMedium(m.G.z, m.ScatteringAlbedo.z);
+			}
+			if (pass == 1 || sceneSlices->Count() <= MAX_SCENE_SLICES - 27)
+				break;
+			sceneSlices->Clear();
+			uploadedSlices = 0;
+		}
+		if (uploadedSlices == sceneSlices->Count())
+			return;
+		// slices missing in stf_slices.bin are left empty (absorbing)
+		sceneSlices->Gather(sliceFile, TABLE_ALIAS_SAMPLING ? "Alias_STF" : "STF", uploadedSlices,
+			sliceOneTimeSA.data(), sliceMultiTimeSA.data(), sliceRows.data());
+		uploadedSlices = sceneSlices->Count();
+
+		pipeline->OneTimeSA _copy FromPtr(sliceOneTimeSA.data());
+		pipeline->MultiTimeSA _copy FromPtr(sliceMultiTimeSA.data());
+		pipeline->STF _copy FromPtr(sliceRows.data());
+		pipeline->STFSlices _copy FromPtr(sceneSlices->Remap.data());
+		manager _load AllToGPU(pipeline->OneTimeSA);
+		manager _load AllToGPU(pipeline->MultiTimeSA);
+		manager _load AllToGPU(pipeline->STF);
+		manager _load AllToGPU(pipeline->STFSlices);
+	}
+
+#pragma endregion
+
 	#pragma region Grid related fields
 
 	// Transform from geometry space to world space for each
@@ -278,6 +355,11 @@ public:
 		frames = pipeline->AccumulativeInfo.Pass;
 	}
 
+	gObj<Texture2D> getRoulettes()
+	{
+		return pipeline->Roulettes;
+	}
+
 	// Inherited via Technique
 	virtual void OnLoad() override {
 
@@ -324,6 +406,7 @@ public:
 		pipeline->Accumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->SqrAccumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->Complexity = __create Texture2D_UAV<uint>(render_target->Width, render_target->Height);
+		pipeline->Roulettes = __create Texture2D_UAV<uint4>(render_target->Width, render_target->Height);
 
 		pipeline->Lighting = __create Buffer_CB<LightingCB>();
 		pipeline->ProjectionToWorld = __create Buffer_CB<float4x4>();
@@ -345,11 +428,25 @@ public:
 		pipeline->NumberOfDFs = desc->Geometries().Count;
 
 		// Creating TABLES
+#if STF_SCENE_SLICES
+		pipeline->STF = __create Buffer_SRV<float>(MAX_SCENE_SLICES * BINS_R * BINS_THETA);
+		pipeline->OneTimeSA = __create Buffer_SRV<float>(MAX_SCENE_SLICES * BINS_R);
+		pipeline->MultiTimeSA = __create Buffer_SRV<float>(MAX_SCENE_SLICES * BINS_R);
+		pipeline->STFSlices = __create Buffer_SRV<int>(BINS_G * BINS_SA);
+		sliceOneTimeSA.resize(MAX_SCENE_SLICES * BINS_R);
+		sliceMultiTimeSA.resize(MAX_SCENE_SLICES * BINS_R);
+		sliceRows.resize(MAX_SCENE_SLICES * BINS_R * BINS_THETA);
+#else
 		pipeline->STF = __create Buffer_SRV<float>(BINS_G * BINS_SA * BINS_R * BINS_THETA);
 		pipeline->OneTimeSA = __create Buffer_SRV<float>(BINS_R * BINS_SA * BINS_G);
 		//pipeline->OneTimeSA = __create Texture3D_SRV<float>(BINS_R, BINS_SA, BINS_G, 1);
 		pipeline->MultiTimeSA = __create Buffer_SRV<float>(BINS_R * BINS_SA * BINS_G);
 		//pipeline->MultiTimeSA = __create Texture3D_SRV<float>(BINS_R, BINS_SA, BINS_G, 1);
+#endif
+#if STF_ADAPTIVE_BINS
+		pipeline->STFEdges = __create Buffer_SRV<float>(BINS_G + BINS_SA);
+		pipeline->STFBinLookup = __create Buffer_SRV<unsigned int>(2 * TABLE_BIN_LOOKUP);
+#endif
 
 		// The grid for triangle hashing in space and build initial distances.
 		creatingGrid->Head = __create Texture3D_UAV<int>(GridSize, GridSize, GridSize, 1);
@@ -398,23 +495,67 @@ public:
 
 #pragma region Load Table Data from File
 
-		FILE* stfFile;
-		errno_t err;
-		if (err = fopen_s(&stfFile, "stf2.bin", "rb"))
+		const uint32_t bins[] = { BINS_G, BINS_SA, BINS_R, BINS_THETA };
+#if STF_ADAPTIVE_BINS
+		const char* tablePath = "stf_adaptive.bin";
+		const char* tableKind = "stf_adaptive";
+#else
+		const char* tablePath = "stf2.bin";
+		const char* tableKind = "stf";
+#endif
+#if STF_SCENE_SLICES
+		// The table stays mapped, UpdateBuffers copies the slices of the media (see TableSlices.h).
+		// Checking a gather without slices validates the kind and the sections.
+		sceneSlices = new STFTableSlices(bins);
+		const char* rows = TABLE_ALIAS_SAMPLING ? "Alias_STF" : "STF";
+#if STF_ADAPTIVE_BINS
+		// slices of the scene media are located with the adaptive edges
+		bool validTables =
+			OpenTableVersion(sliceFile, tablePath, tableKind, bins, 4, TableStatus, sizeof(TableStatus)) &&
+			sceneSlices->Binning.Use(sliceFile) &&
+			sceneSlices->Gather(sliceFile, rows, 0, nullptr, nullptr, nullptr) &&
+			StreamTableSection(sliceFile, "Edges", &pipeline->STFEdges, 1) &&
+			StreamTableSection(sliceFile, "Lookup", &pipeline->STFBinLookup, 1);
+		EndTableStreaming();
+#else
+		bool validTables =
+			(OpenTableVersion(sliceFile, tablePath, tableKind, bins, 4, TableStatus, sizeof(TableStatus)) &&
+				sceneSlices->Gather(sliceFile, rows, 0, nullptr, nullptr, nullptr)) ||
+			(OpenTableVersion(sliceFile, "stf_slices.bin", "stf_slices", bins, 4, TableStatus, sizeof(TableStatus)) &&
+				sceneSlices->Gather(sliceFile, rows, 0, nullptr, nullptr, nullptr));
+#endif
+		if (!validTables)
 		{
+			if (!TableStatus[0])
+				snprintf(TableStatus, sizeof(TableStatus), "The table misses sections or slices of the scene media");
 			return;
 		}
-
-		float* tempSTable = new float[BINS_G * BINS_SA * BINS_R];
-		fread((void*)tempSTable, 4, BINS_G * BINS_SA * BINS_R, stfFile);
-		pipeline->OneTimeSA _copy FromPtr(tempSTable);
-		fread((void*)tempSTable, 4, BINS_G * BINS_SA * BINS_R, stfFile);
-		pipeline->MultiTimeSA _copy FromPtr(tempSTable);
-		delete[] tempSTable;
-		tempSTable = new float[BINS_G * BINS_SA * BINS_R * BINS_THETA];
-		fread((void*)tempSTable, 4, BINS_G * BINS_SA * BINS_R * BINS_THETA, stfFile);
-		pipeline->STF _copy FromPtr(tempSTable);
-		delete[] tempSTable;
+#else
+		// the table is mapped and its sections streamed to the buffers (see TableFile.h)
+		MappedTableFile stfFile;
+		if (!OpenTableVersion(stfFile, tablePath, tableKind, bins, 4, TableStatus, sizeof(TableStatus)))
+		{
+			return;
+		}
+		bool validTables =
+			StreamTableSection(stfFile, "OneTimeSA", &pipeline->OneTimeSA, 1) &&
+			StreamTableSection(stfFile, "MultiTimeSA", &pipeline->MultiTimeSA, 1) &&
+#if STF_ADAPTIVE_BINS
+			StreamTableSection(stfFile, "Edges", &pipeline->STFEdges, 1) &&
+			StreamTableSection(stfFile, "Lookup", &pipeline->STFBinLookup, 1) &&
+#endif
+#if TABLE_ALIAS_SAMPLING
+			// same size as the cdfs, bound at t1 as STFAlias
+			StreamTableSection(stfFile, "Alias_STF", &pipeline->STF, 1);
+#else
+			StreamTableSection(stfFile, "STF", &pipeline->STF, 1);
+#endif
+		EndTableStreaming();
+		if (!validTables)
+		{
+			return;
+		}
+#endif
 
 #pragma endregion
 
@@ -429,10 +570,6 @@ public:
 
 		manager _load AllToGPU(screenVertices);
 
-		manager _load AllToGPU(pipeline->STF);
-		manager _load AllToGPU(pipeline->OneTimeSA);
-		manager _load AllToGPU(pipeline->MultiTimeSA);
-
 		SceneElement elements = scene->Updated(sceneVersion);
 		UpdateBuffers(manager, elements);
 	}
@@ -486,6 +623,10 @@ public:
 	}
 
 	virtual void OnDispatch() override {
+		// nothing was loaded, the GUI shows TableStatus
+		if (TableStatus[0])
+			return;
+
 		// Update dirty elements
 		__dispatch member_collector(UpdateAssets);
 
@@ -542,6 +683,9 @@ public:
 			pipeline->VolMaterials _copy FromPtr(desc->VolumeMaterials().Data);
 			manager _load AllToGPU(pipeline->Materials);
 			manager _load AllToGPU(pipeline->VolMaterials);
+#if STF_SCENE_SLICES
+			UpdateSceneSlices(manager);
+#endif
 		}
 
 		if (+(elements & SceneElement::Textures)) {
@@ -705,6 +849,7 @@ public:
 			manager _clear UAV(pipeline->Accumulation, uint4(0));
 			manager _clear UAV(pipeline->SqrAccumulation, uint4(0));
 			manager _clear UAV(pipeline->Complexity, uint4(0));
+			manager _clear UAV(pipeline->Roulettes, uint4(0));
 		}
 
 		pipeline->AccumulativeInfo.ShowComplexity = ShowComplexity ? 1 : 0;
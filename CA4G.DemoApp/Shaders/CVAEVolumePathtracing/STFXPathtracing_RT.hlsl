@@ -6,20 +6,10 @@
 
 #include "../Tools/Parameters.h"
 
-// HG factor [-1,1] linear
-#define BINS_G 100
+// Bins of the table, generated from its header into the intermediate directory (CA4G.Offline
+// tabledefines, a pre-build step), TableDefaults has the ones of the default layout
+#include "STFXTableDefines.h"
 
-// Log of the number of Scatters between 0..8
-#define BINS_LOGN 100
-
-// Radius [0, 127] linear in log(r)
-#define BINS_R 8
-
-// Theta [0,pi] linear in cos(theta) beta[-1,1] alpha[-1,1]
-//40x20x10
-#define BINS_THETA 40
-#define BINS_BETA 20
-#define BINS_ALPHA 10
 #define BINS_X (BINS_THETA * BINS_BETA * BINS_ALPHA)
 
 #define LOGN_G_STRIDE (BINS_R * BINS_LOGN)
@@ -45,12 +35,35 @@ RaytracingAccelerationStructure Scene : register(t0, space0);
 
 // PDF of the number of scatters
 // The table is storing actually the empirical cdf(logN | g, r)
+#if TABLE_ALIAS_SAMPLING
+// Alias tables of the cdfs (see AliasTable.h), the compressed cdfs are searched
+#include "../Tools/AliasTable.h"
+StructuredBuffer<uint> Alias_LogN					: register(t1);
+#else
 StructuredBuffer<float> CDF_LogN					: register(t1);
+#endif
 // PDF of the outgoing position
 // The table is storing actually the empirical cdf(x, w | g, logN, r)
+#if STFX_COMPRESSED_TABLES
+// 16-bit cdfs without the zero probability bins (see CompressedCDF.h)
+#include "../Tools/CompressedCDF.h"
+StructuredBuffer<uint2> CDF_XW_Cells				: register(t2);
+StructuredBuffer<uint> CDF_XW_Data					: register(t3);
+#elif TABLE_GUIDE_SAMPLING
+// The cdfs split in two tables and the guide tables of all the cdfs (see GuideTable.h)
+#include "../Tools/GuideTable.h"
+StructuredBuffer<float> CDF_XW_L					: register(t2);
+StructuredBuffer<float> CDF_XW_H					: register(t3);
+StructuredBuffer<uint> Guide_XW						: register(t0, space2);
+#elif TABLE_ALIAS_SAMPLING
+// Alias tables split in two tables as the cdfs
+StructuredBuffer<uint> Alias_XW_L					: register(t2);
+StructuredBuffer<uint> Alias_XW_H					: register(t3);
+#else
 // The table is split in two tables to allow more than 2G memory table
 StructuredBuffer<float> CDF_XW_L					: register(t2);
 StructuredBuffer<float> CDF_XW_H					: register(t3);
+#endif
 
 int SearchBin(StructuredBuffer<float> cdf, int beg, int end, float value) {
 	while (beg < end) {
@@ -63,6 +76,21 @@ int SearchBin(StructuredBuffer<float> cdf, int beg, int end, float value) {
 	return beg;
 }
 
+// Bin of g, with TABLE_INTERPOLATED_SAMPLING the bin of g or its neighbour towards g with the
+// linear weights between their centers (STFPickGBin of STFPathtracing_RT on uniform bins).
+int STFXPickGBin(float g) {
+	float u = g * 0.5 + 0.5;
+	int bin = min(u * BINS_G, BINS_G - 1);
+#if TABLE_INTERPOLATED_SAMPLING
+	int lower = u < (bin + 0.5) / BINS_G ? bin - 1 : bin;
+	if (lower < 0 || lower >= BINS_G - 1)
+		return bin;
+	return lower + (random() < u * BINS_G - 0.5 - lower);
+#else
+	return bin;
+#endif
+}
+
 // Samples an outgoing position and direction using the tables
 // Return true if the sample exit, false if ray is absorbed.
 bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta, out float alpha)
@@ -77,11 +105,15 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 		rBin = logR;
 		rBin += random() < (logR % 1);
 	}
-	int gBin = min((g * 0.5 + 0.5) * BINS_G, BINS_G - 1);
+	int gBin = STFXPickGBin(g);
 
 	// Get the logN from the table
 	int startPoslogNPos = gBin * LOGN_G_STRIDE + rBin * LOGN_R_STRIDE;
+#if TABLE_ALIAS_SAMPLING
+	int selectedLogNBin = SampleAlias(Alias_LogN, startPoslogNPos, BINS_LOGN, random(), random());
+#else
 	int selectedLogNBin = SearchBin(CDF_LogN, startPoslogNPos, startPoslogNPos + BINS_LOGN - 1, random()) - startPoslogNPos;
+#endif
 	float logN = 8.0 * (selectedLogNBin + random()) / BINS_LOGN;
 
 	int N = (exp(logN));
@@ -98,6 +130,10 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 
 	return true;*/
 
+#if STFX_COMPRESSED_TABLES
+	int xwBin = SearchCompressedCDF(CDF_XW_Data, CDF_XW_Cells[startPoslogNPos + selectedLogNBin], random());
+#else
+	int cdfIndex = startPoslogNPos + selectedLogNBin;
 	bool sampleLow = true;
 	if (startPoslogNPos >= BINS_G * BINS_R * BINS_LOGN / 2) // Sampling from high density pdfs
 	{
@@ -108,10 +144,23 @@ bool SampleCosXAndW(float g, float phi, float r, out float theta, out float beta
 	int startxwPos = (startPoslogNPos + selectedLogNBin) * BINS_X;
 
 	int xwBin;
+#if TABLE_GUIDE_SAMPLING
+	if (sampleLow)
+		xwBin = SearchGuided(CDF_XW_L, Guide_XW, cdfIndex * GUIDE_ENTRIES, startxwPos, BINS_X, random());
+	else
+		xwBin = SearchGuided(CDF_XW_H, Guide_XW, cdfIndex * GUIDE_ENTRIES, startxwPos, BINS_X, random());
+#elif TABLE_ALIAS_SAMPLING
+	if (sampleLow)
+		xwBin = SampleAlias(Alias_XW_L, startxwPos, BINS_X, random(), random());
+	else
+		xwBin = SampleAlias(Alias_XW_H, startxwPos, BINS_X, random(), random());
+#else
 	if (sampleLow)
 		xwBin = SearchBin(CDF_XW_L, startxwPos, startxwPos + BINS_X - 1, random()) - startxwPos;
 	else
 		xwBin = SearchBin(CDF_XW_H, startxwPos, startxwPos + BINS_X - 1, random()) - startxwPos;
+#endif
+#endif
 
 	// Convert xwBin into theta, beta, alpha bins...
 	int thetaBin = xwBin / (BINS_BETA * BINS_ALPHA);
@@ -270,6 +319,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		RayPayload payload = (RayPayload)0;
 		if (!Intersect(x, w, payload)) // 
@@ -298,18 +348,22 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				return 0;
 
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return 0;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return 0;
 			bool UsePT = DispatchRaysIndex().x < DispatchRaysDimensions().x* PathtracingRatio;
 
 			if (UsePT) {
 				x += t * w; // free traverse in a medium
 
-				if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+				if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 					return 0;
 
 				w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
@@ -334,7 +388,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 				else {
 					x += t * w; // free traverse in a medium
 
-					if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+					if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 						return 0;
 
 					w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
@@ -3,26 +3,22 @@
 
 #include "ca4g.h"
 #include "../../GUITraits.h"
+#include "../Tools/Parameters.h"
+#include "TableFile.h"
+#include "TableStreaming.h"
 
-// HG factor [-1,1] linear
-#define BINS_G 100
+// Bins of the table, generated from its header into the intermediate directory (CA4G.Offline
+// tabledefines, a pre-build step), TableDefaults has the ones of the default layout
+#include "STFXTableDefines.h"
 
-// Log of the number of Scatters between 0..8
-#define BINS_LOGN 100
-
-// Radius [0, 127] linear in log(r)
-#define BINS_R 8
-
-// Theta [0,pi] linear in cos(theta) beta[-1,1] alpha[-1,1]
-//40x20x10
-#define BINS_THETA 40
-#define BINS_BETA 20
-#define BINS_ALPHA 10
 #define BINS_X (BINS_THETA * BINS_BETA * BINS_ALPHA)
 
+// Entries of the guide table of every position-direction cdf (Tools/GuideTable.h)
+#define GUIDE_ENTRIES 64
+
 using namespace CA4G;
 
-class STFXTechnique : public Technique,
+class STFXTechnique : public TableStreamingTechnique,
 	public IManageScene,
 	public IShowComplexity,
 	public IGatherImageStatistics {
@@ -140,6 +136,7 @@ public:
 				binder _set UAV(1, Context()->Accumulation);
 				binder _set UAV(2, Context()->SqrAccumulation);
 				binder _set UAV(3, Context()->Complexity);
+				binder _set UAV(4, Context()->Roulettes);
 				binder _set SRV(0, Context()->VertexBuffer);
 				binder _set SRV(1, Context()->IndexBuffer);
 				binder _set SRV(2, Context()->Transforms);
@@ -153,8 +150,18 @@ public:
 
 				binder _set ADS(0, Context()->Scene);
 				binder _set SRV(1, Context()->CDF_LogN);
+#if STFX_COMPRESSED_TABLES
+				binder _set SRV(2, Context()->CDF_XW_Cells);
+				binder _set SRV(3, Context()->CDF_XW_Data);
+#else
 				binder _set SRV(2, Context()->CDF_XW_L);
 				binder _set SRV(3, Context()->CDF_XW_H);
+#if TABLE_GUIDE_SAMPLING
+				binder _set Space(2);
+				binder _set SRV(0, Context()->Guide_XW);
+				binder _set Space(0);
+#endif
+#endif
 				binder _set SRV(4, Context()->GridInfos);
 				binder _set SRV_Array(5, Context()->DistanceFields, Context()->NumberOfDFs);
 
@@ -195,6 +202,7 @@ public:
 		gObj<Texture2D> Accumulation;
 		gObj<Texture2D> SqrAccumulation;
 		gObj<Texture2D> Complexity;
+		gObj<Texture2D> Roulettes;
 		struct PerGeometryInfo {
 			int StartTriangle;
 			int VertexOffset;
@@ -213,8 +221,15 @@ public:
 
 		// Tabular method buffers...
 		gObj<Buffer> CDF_LogN;
+#if STFX_COMPRESSED_TABLES
+		gObj<Buffer> CDF_XW_Cells;
+		gObj<Buffer> CDF_XW_Data;
+#else
 		gObj<Buffer> CDF_XW_L;
 		gObj<Buffer> CDF_XW_H;
+		// 16-bit guide tables of the cdfs (TABLE_GUIDE_SAMPLING)
+		gObj<Buffer> Guide_XW;
+#endif
 
 		gObj<Buffer> GridInfos;
 		gObj<Texture3D>* DistanceFields;
@@ -276,6 +291,11 @@ public:
 		frames = pipeline->AccumulativeInfo.Pass;
 	}
 
+	gObj<Texture2D> getRoulettes()
+	{
+		return pipeline->Roulettes;
+	}
+
 	// Inherited via Technique
 	virtual void OnLoad() override {
 
@@ -322,6 +342,7 @@ public:
 		pipeline->Accumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->SqrAccumulation = __create Texture2D_UAV<float4>(render_target->Width, render_target->Height, 1, 1);
 		pipeline->Complexity = __create Texture2D_UAV<uint>(render_target->Width, render_target->Height);
+		pipeline->Roulettes = __create Texture2D_UAV<uint4>(render_target->Width, render_target->Height);
 
 		pipeline->Lighting = __create Buffer_CB<LightingCB>();
 		pipeline->ProjectionToWorld = __create Buffer_CB<float4x4>();
@@ -344,8 +365,14 @@ public:
 
 		// Creating TABLES
 		pipeline->CDF_LogN = __create Buffer_SRV<float>(BINS_G * BINS_R * BINS_LOGN);
+#if !STFX_COMPRESSED_TABLES
 		pipeline->CDF_XW_L = __create Buffer_SRV<float>(BINS_G * BINS_R * BINS_LOGN * BINS_X / 2); // Spliting 2.7 GB in two tables
 		pipeline->CDF_XW_H = __create Buffer_SRV<float>(BINS_G * BINS_R * BINS_LOGN * BINS_X / 2);
+#if TABLE_GUIDE_SAMPLING
+		// two 16-bit entries per element
+		pipeline->Guide_XW = __create Buffer_SRV<unsigned int>(BINS_G * BINS_R * BINS_LOGN * GUIDE_ENTRIES / 2);
+#endif
+#endif
 
 		// The grid for triangle hashing in space and build initial distances.
 		creatingGrid->Head = __create Texture3D_UAV<int>(GridSize, GridSize, GridSize, 1);
@@ -394,24 +421,57 @@ public:
 
 #pragma region Load Table Data from File
 
-		FILE* stfFile;
-		errno_t err;
-		if (err = fopen_s(&stfFile, "stfx.bin", "rb"))
+		// The table file is mapped and its sections streamed to the buffers (see TableFile.h)
+		MappedTableFile stfFile;
+		const uint32_t bins[] = { BINS_G, BINS_R, BINS_LOGN, BINS_THETA, BINS_BETA, BINS_ALPHA };
+#if STFX_COMPRESSED_TABLES
+		// CDF_LogN, cells and 16-bit data (see Tools/CompressedCDF.h)
+		if (!OpenTableVersion(stfFile, "stfx_compressed.bin", "stfx_compressed", bins, 6, TableStatus, sizeof(TableStatus)))
+		{
+			return;
+		}
+		const TableSection* cdfData = stfFile.Header().Find("Data");
+		if (!cdfData)
 		{
+			snprintf(TableStatus, sizeof(TableStatus), "The table has no section Data");
 			return;
 		}
 
-		float* tempSTable = new float[BINS_G * BINS_R * BINS_LOGN];
-		fread((void*)tempSTable, 4, BINS_G * BINS_R * BINS_LOGN, stfFile);
-		pipeline->CDF_LogN _copy FromPtr(tempSTable);
-		delete tempSTable;
+		// uint2 in the shader
+		struct CompressedCDFCell { unsigned int Offset, Info; };
+		pipeline->CDF_XW_Cells = __create Buffer_SRV<CompressedCDFCell>(BINS_G * BINS_R * BINS_LOGN);
+		// two 16-bit values per element (the count is even)
+		pipeline->CDF_XW_Data = __create Buffer_SRV<unsigned int>((int)(cdfData->Count / 2));
+
+		bool validTables =
+			StreamTableSection(stfFile, TABLE_ALIAS_SAMPLING ? "Alias_LogN" : "CDF_LogN", &pipeline->CDF_LogN, 1) &&
+			StreamTableSection(stfFile, "Cells", &pipeline->CDF_XW_Cells, 1) &&
+			StreamTableSection(stfFile, "Data", &pipeline->CDF_XW_Data, 1);
+#else
+		if (!OpenTableVersion(stfFile, "stfx.bin", "stfx", bins, 6, TableStatus, sizeof(TableStatus)))
+		{
+			return;
+		}
 
-		tempSTable = new float[BINS_G * BINS_R * BINS_LOGN * BINS_X / 2];
-		fread((void*)tempSTable, 4, BINS_G * BINS_R * BINS_LOGN * BINS_X / 2, stfFile);
-		pipeline->CDF_XW_L _copy FromPtr(tempSTable);
-		fread((void*)tempSTable, 4, BINS_G * BINS_R * BINS_LOGN * BINS_X / 2, stfFile);
-		pipeline->CDF_XW_H _copy FromPtr(tempSTable);
-		delete[] tempSTable;
+		gObj<Buffer> halves[] = { pipeline->CDF_XW_L, pipeline->CDF_XW_H };
+#if TABLE_GUIDE_SAMPLING
+		// the guides take the place of the alias tables of the position-direction cdfs
+		bool validTables =
+			StreamTableSection(stfFile, TABLE_ALIAS_SAMPLING ? "Alias_LogN" : "CDF_LogN", &pipeline->CDF_LogN, 1) &&
+			StreamTableSection(stfFile, "CDF_XW", halves, 2) &&
+			StreamTableSection(stfFile, "Guide_XW", &pipeline->Guide_XW, 1);
+#else
+		// alias tables have the size of the cdfs and go to the same buffers
+		bool validTables =
+			StreamTableSection(stfFile, TABLE_ALIAS_SAMPLING ? "Alias_LogN" : "CDF_LogN", &pipeline->CDF_LogN, 1) &&
+			StreamTableSection(stfFile, TABLE_ALIAS_SAMPLING ? "Alias_XW" : "CDF_XW", halves, 2);
+#endif
+#endif
+		EndTableStreaming();
+		if (!validTables)
+		{
+			return;
+		}
 
 #pragma endregion
 
@@ -426,10 +486,6 @@ public:
 
 		manager _load AllToGPU(screenVertices);
 
-		manager _load AllToGPU(pipeline->CDF_LogN);
-		manager _load AllToGPU(pipeline->CDF_XW_L);
-		manager _load AllToGPU(pipeline->CDF_XW_H);
-
 		SceneElement elements = scene->Updated(sceneVersion);
 		UpdateBuffers(manager, elements);
 	}
@@ -483,6 +539,10 @@ public:
 	}
 
 	virtual void OnDispatch() override {
+		// nothing was loaded, the GUI shows TableStatus
+		if (TableStatus[0])
+			return;
+
 		// Update dirty elements
 		__dispatch member_collector(UpdateAssets);
 
@@ -702,6 +762,7 @@ public:
 			manager _clear UAV(pipeline->Accumulation, uint4(0));
 			manager _clear UAV(pipeline->SqrAccumulation, uint4(0));
 			manager _clear UAV(pipeline->Complexity, uint4(0));
+			manager _clear UAV(pipeline->Roulettes, uint4(0));
 		}
 
 		pipeline->AccumulativeInfo.ShowComplexity = ShowComplexity ? 1 : 0;
@@ -0,0 +1,107 @@
+#pragma once
+
+// Bins of the g and phi axes of the STF tables. Uniform tables (kinds stf, stf_slices) bin
+// u = g * 0.5 + 0.5 linearly and u = log(1 / (1 - phi)) / log(1000) linearly up to phi = 0.999,
+// the last two phi bins take phi = 0.999 and (0.999, 1].
+// Adaptive tables (kind stf_adaptive, CA4G.Offline stfadaptive) keep those coordinates but place
+// the edges where the tables change most, with the same sections as stf plus:
+//	Edges: the BINS_G + 1 edges of g and the BINS_SA - 1 edges of phi up to 0.999
+//	Lookup: TABLE_BIN_LOOKUP bins per axis, the bin of u = i / TABLE_BIN_LOOKUP
+// A bin is located with one read of Lookup and a short walk over the edges.
+// Interpolated sampling (TABLE_INTERPOLATED_SAMPLING) takes the values of a table at the bin
+// centers and picks the bin of u or its neighbour with the linear weights between both centers.
+// Shared with CA4G.Offline, LocateBin in STFPathtracing_RT.hlsl is the shader version.
+
+#include <cmath>
+#include <cstdint>
+#include "TableFile.h"
+
+static const int TABLE_BIN_LOOKUP = 256;
+
+// Bin of u among count bins with edges[0..count] starting at the bin lookup gives for u.
+static int LocateTableBin(const float* edges, const uint32_t* lookup, int count, float u) {
+	int i = (int)(u * TABLE_BIN_LOOKUP);
+	int bin = (int)lookup[i < 0 ? 0 : i >= TABLE_BIN_LOOKUP ? TABLE_BIN_LOOKUP - 1 : i];
+	while (bin < count - 1 && u >= edges[bin + 1])
+		bin++;
+	return bin;
+}
+
+// Center of the bin b among count bins on [0, 1], the bin past the last one is the point 1 (the
+// bin of phi = 0.999 on the phi axis).
+static float TableBinCenter(const float* edges, int count, int b) {
+	if (b >= count)
+		return 1;
+	return edges ? 0.5f * (edges[b] + edges[b + 1]) : (b + 0.5f) / count;
+}
+
+// Moves bin (the bin of u) to the lower of it and the neighbour towards u, w gets the weight of
+// the upper one. Bins go up to last, false (bin kept, w 0) before the first center and after the
+// last one, where the shader's STFPickBin does not draw a random.
+static bool InterpolateTableBin(const float* edges, int count, int last, int &bin, float u, float &w) {
+	int lower = u < TableBinCenter(edges, count, bin) ? bin - 1 : bin;
+	w = 0;
+	if (lower < 0 || lower >= last)
+		return false;
+	float c0 = TableBinCenter(edges, count, lower), c1 = TableBinCenter(edges, count, lower + 1);
+	w = (u - c0) / (c1 - c0);
+	w = w < 0 ? 0 : w > 1 ? 1 : w;
+	bin = lower;
+	return true;
+}
+
+struct STFBinning {
+	int BinsG, BinsSA;
+	// Views of the sections of an adaptive table, null for uniform bins
+	const float* Edges = nullptr;
+	const uint32_t* Lookup = nullptr;
+
+	STFBinning(int binsG, int binsSA) : BinsG(binsG), BinsSA(binsSA) {}
+
+	// Uses the edges of an stf_adaptive table, false if the file has none.
+	bool Use(const MappedTableFile &file) {
+		Edges = (const float*)file.Section("Edges", sizeof(float), (uint64_t)BinsG + BinsSA);
+		Lookup = (const uint32_t*)file.Section("Lookup", sizeof(uint32_t), 2 * TABLE_BIN_LOOKUP);
+		if (!Edges || !Lookup)
+			Edges = nullptr, Lookup = nullptr;
+		return Edges != nullptr;
+	}
+
+	int GBin(float g) const {
+		float u = g * 0.5f + 0.5f;
+		if (Edges)
+			return LocateTableBin(Edges, Lookup, BinsG, u);
+		float b = u * BinsG;
+		return b < 0 ? 0 : b > BinsG - 1 ? BinsG - 1 : (int)b;
+	}
+
+	int PhiBin(float phi) const {
+		if (phi > 0.999f)
+			return BinsSA - 1;
+		float L = logf(1 / (1 - phi));
+		if (Edges) {
+			float u = L / logf(1 / 0.001f);
+			return u >= 1 ? BinsSA - 2 : LocateTableBin(Edges + BinsG + 1, Lookup + TABLE_BIN_LOOKUP, BinsSA - 2, u);
+		}
+		int b = (int)(L * (BinsSA - 2) / logf(1 / 0.001f));
+		return b < 0 ? 0 : b;
+	}
+
+	// Lower bin and weight w of the next one interpolating g between the bin centers, false if g
+	// has a single bin (see InterpolateTableBin).
+	bool GBins(float g, int &bin, float &w) const {
+		bin = GBin(g);
+		return InterpolateTableBin(Edges, BinsG, BinsG - 1, bin, g * 0.5f + 0.5f, w);
+	}
+
+	// Lower bin and weight w of the next one interpolating phi between the bin centers up to the
+	// bin of 0.999, phi above 0.999 keeps its bin (false).
+	bool PhiBins(float phi, int &bin, float &w) const {
+		bin = PhiBin(phi);
+		w = 0;
+		if (bin >= BinsSA - 2)
+			return false;
+		float u = logf(1 / (1 - phi)) / logf(1 / 0.001f);
+		return InterpolateTableBin(Edges ? Edges + BinsG + 1 : nullptr, BinsSA - 2, BinsSA - 2, bin, u, w);
+	}
+};
@@ -0,0 +1,17 @@
+// Generated by CA4G.Offline tabledefines from the stf_adaptive layout of CA4G.Offline, do not edit.
+#ifndef STF_ADAPTIVE_TABLE_DEFINES_H
+#define STF_ADAPTIVE_TABLE_DEFINES_H
+
+// g adaptive in [-1, 1], edges in the section Edges
+#define BINS_G 64
+
+// sa adaptive in [0, 0.999], edges in the section Edges
+#define BINS_SA 128
+
+// r powers of two from 1 to 256
+#define BINS_R 9
+
+// theta linear in [-1, 1]
+#define BINS_THETA 45
+
+#endif
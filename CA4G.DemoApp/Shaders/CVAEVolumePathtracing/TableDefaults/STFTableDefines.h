@@ -0,0 +1,17 @@
+// Generated by CA4G.Offline tabledefines from the stf layout of CA4G.Offline, do not edit.
+#ifndef STF_TABLE_DEFINES_H
+#define STF_TABLE_DEFINES_H
+
+// g linear in [-1, 1]
+#define BINS_G 200
+
+// sa linear in log(1 / (1 - v)) in [0, 0.999], two more bins for 0.999 and above
+#define BINS_SA 1000
+
+// r powers of two from 1 to 256
+#define BINS_R 9
+
+// theta linear in [-1, 1]
+#define BINS_THETA 45
+
+#endif
@@ -0,0 +1,23 @@
+// Generated by CA4G.Offline tabledefines from the stfx layout of CA4G.Offline, do not edit.
+#ifndef STFX_TABLE_DEFINES_H
+#define STFX_TABLE_DEFINES_H
+
+// g linear in [-1, 1]
+#define BINS_G 100
+
+// r powers of two from 0.707107 to 90.5097
+#define BINS_R 8
+
+// logn linear in [0, 8]
+#define BINS_LOGN 100
+
+// theta linear in [-1, 1]
+#define BINS_THETA 40
+
+// beta linear in [-1, 1]
+#define BINS_BETA 20
+
+// alpha linear in [-1, 1]
+#define BINS_ALPHA 10
+
+#endif
@@ -0,0 +1,419 @@
+#pragma once
+
+// Table files of the STF techniques (stf2.bin, stfx.bin and stfx_compressed.bin), shared with
+// CA4G.Offline which generates them. A header describing the bins and the sections is followed
+// by the sections, each one at an offset multiple of TableFileHeader::ALIGNMENT so the file can
+// be mapped and any section viewed in place.
+//	kind stf: bins g, sa, r, theta; sections OneTimeSA, MultiTimeSA, STF
+//	kind stf_slices: as stf for some (g, phi) bins only (see TableSlices.h)
+//	kind stfx: bins g, r, logn, theta, beta, alpha; sections CDF_LogN, CDF_XW
+//	kind stfx_compressed: as stfx; sections CDF_LogN, Cells, Data (see Tools/CompressedCDF.h)
+// Strides are the element strides of the last section for each bin dimension. Since version 3
+// the header also names the axes and how their values map to bins, the element type of every
+// section and the seed and walks of the generator, so a table describes itself. The bin defines
+// of the shaders are generated from the tables (CA4G.Offline tabledefines, *TableDefines.h in
+// the intermediate directory of the DemoApp, TableDefaults has the ones of the default layouts).
+// Files of kind stf and stfx written before the header (raw f32 sections one after the other)
+// are still opened, see MappedTableFile::OpenHeaderless.
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Element types of the sections, untyped in version 1 and 2 files
+enum TableElementType : uint32_t {
+	TABLE_UNTYPED = 0,
+	TABLE_F32 = 1,
+	TABLE_U32 = 2,
+	TABLE_I32 = 3,
+	TABLE_U16 = 4,
+	TABLE_U32X2 = 5,
+};
+
+static uint32_t TableElementSize(uint32_t type) {
+	switch (type) {
+	case TABLE_F32: case TABLE_U32: case TABLE_I32: return 4;
+	case TABLE_U16: return 2;
+	case TABLE_U32X2: return 8;
+	}
+	return 0;
+}
+
+static const char* TableElementName(uint32_t type) {
+	const char* names[] = { "untyped", "f32", "u32", "i32", "u16", "u32x2" };
+	return type < sizeof(names) / sizeof(names[0]) ? names[type] : "unknown";
+}
+
+// How the values of an axis map to its bins, unknown in version 1 and 2 files
+enum TableAxisMapping : uint32_t {
+	TABLE_AXIS_UNKNOWN = 0,
+	// uniform over [Min, Max]
+	TABLE_AXIS_LINEAR = 1,
+	// bin k is Min * 2^k, Max is the last one
+	TABLE_AXIS_LOG2 = 2,
+	// uniform in log(1 / (1 - v)) over [Min, Max], the last two bins are Max and above
+	TABLE_AXIS_ALBEDO = 3,
+	// as TABLE_AXIS_LINEAR or TABLE_AXIS_ALBEDO with the edges of the section Edges (TableBins.h)
+	TABLE_AXIS_EDGES = 4,
+};
+
+struct TableAxis {
+	// lower case, BINS_<NAME> in the generated defines
+	char Name[8];
+	uint32_t Mapping;
+	uint32_t Reserved;
+	float Min, Max;
+};
+
+struct TableSection {
+	char Name[16];
+	uint32_t ElementSize;
+	// TableElementType
+	uint32_t Type;
+	// bytes from the start of the file
+	uint64_t Offset;
+	uint64_t Count;
+	// TableChecksum of the Count * ElementSize bytes
+	uint64_t Checksum;
+
+	uint64_t Bytes() const { return Count * ElementSize; }
+};
+
+struct TableFileHeader {
+	static const uint32_t MAGIC = 0x4C424154; // "TABL"
+	// Version 1 had 4 sections and version 2 no axes, types or generator. Their headers read as
+	// version 3 ones with the rest zero (the first section starts at ALIGNMENT).
+	static const uint32_t VERSION = 3;
+	static const int MAX_BINS = 8;
+	static const int MAX_SECTIONS = 8;
+	static const uint64_t ALIGNMENT = 1 << 16; // allocation granularity of the windows mappings
+
+	uint32_t Magic;
+	uint32_t Version;
+	char Kind[16];
+	uint32_t Bins[MAX_BINS];
+	uint64_t Strides[MAX_BINS];
+	uint32_t SectionCount;
+	uint32_t Reserved;
+	TableSection Sections[MAX_SECTIONS];
+	// version 3
+	TableAxis Axes[MAX_BINS];
+	// seed and walks per cell of the generator, 0 if unknown
+	uint64_t Seed;
+	uint32_t Walks;
+	uint32_t Reserved2;
+
+	const TableSection* Find(const char* name) const {
+		for (uint32_t i = 0; i < SectionCount && i < MAX_SECTIONS; i++)
+			if (strncmp(Sections[i].Name, name, sizeof(Sections[i].Name)) == 0)
+				return &Sections[i];
+		return nullptr;
+	}
+
+	// True for a table of this kind and bin counts (the unused bins must be 0).
+	bool Matches(const char* kind, const uint32_t* bins, int count) const {
+		return Mismatch(kind, bins, count, nullptr, 0) == false;
+	}
+
+	// As !Matches, describing the difference in error.
+	bool Mismatch(const char* kind, const uint32_t* bins, int count, char* error, size_t size) const {
+		if (strncmp(Kind, kind, sizeof(Kind)) != 0) {
+			if (error)
+				snprintf(error, size, "kind %.16s instead of %s", Kind, kind);
+			return true;
+		}
+		for (int i = 0; i < MAX_BINS; i++)
+			if (Bins[i] != (i < count ? bins[i] : 0)) {
+				if (error)
+					snprintf(error, size, "%u bins of %.8s (axis %d) instead of %u, regenerate the *TableDefines.h",
+						Bins[i], Axes[i].Name[0] ? Axes[i].Name : "?", i, i < count ? bins[i] : 0);
+				return true;
+			}
+		return false;
+	}
+
+	// Identifies a version of a table: kind, bins and the contents of the sections.
+	uint64_t Id() const {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		const unsigned char* kind = (const unsigned char*)Kind;
+		for (size_t i = 0; i < sizeof(Kind); i++)
+			hash = (hash ^ kind[i]) * 0x100000001b3ull;
+		for (int i = 0; i < MAX_BINS; i++)
+			hash = (hash ^ Bins[i]) * 0x100000001b3ull;
+		for (uint32_t i = 0; i < SectionCount && i < MAX_SECTIONS; i++)
+			hash = (hash ^ Sections[i].Checksum) * 0x100000001b3ull;
+		return hash;
+	}
+};
+
+// FNV-1a over 32-bit words (sections are multiples of 4 bytes). Can be continued
+// passing the previous result, chunks must be multiples of 4 bytes.
+static uint64_t TableChecksum(const void* data, uint64_t bytes, uint64_t hash = 0xcbf29ce484222325ull) {
+	const uint32_t* words = (const uint32_t*)data;
+	for (uint64_t i = 0; i < bytes / 4; i++)
+		hash = (hash ^ words[i]) * 0x100000001b3ull;
+	return hash;
+}
+
+// Read only mapping of a table file. Nothing is read until a page is touched, so samplers
+// reading a view only page in the bins they use and the file cache is shared between processes.
+class MappedTableFile {
+	const unsigned char* data = nullptr;
+	uint64_t size = 0;
+	char error[256] = "";
+	// header made up for a headerless file, Version 0
+	TableFileHeader legacy = {};
+	bool headerless = false;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	bool Map(const char* path) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+		size = (uint64_t)fileSize.QuadPart;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			return false;
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			size = (uint64_t)st.st_size;
+			void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (view != MAP_FAILED) {
+				madvise(view, size, MADV_RANDOM); // no read ahead, lookups are scattered
+				data = (const unsigned char*)view;
+			}
+		}
+		close(fd);
+#endif
+		return data != nullptr;
+	}
+
+public:
+	MappedTableFile() {}
+	MappedTableFile(const MappedTableFile&) = delete;
+	MappedTableFile& operator = (const MappedTableFile&) = delete;
+	~MappedTableFile() { Close(); }
+
+	// Maps the file and checks the header and that every section is inside the file and of the
+	// size of its type. Error() tells why it failed.
+	bool Open(const char* path) {
+		Close();
+		if (!Map(path))
+			snprintf(error, sizeof(error), "%s can not be read", path);
+		else if (size < sizeof(TableFileHeader) || Header().Magic != TableFileHeader::MAGIC)
+			snprintf(error, sizeof(error), "%s is not a table file", path);
+		else {
+			const TableFileHeader &h = Header();
+			if ((h.Version < 1 || h.Version > TableFileHeader::VERSION) || h.SectionCount > TableFileHeader::MAX_SECTIONS ||
+				(h.Version == 1 && h.SectionCount > 4))
+				snprintf(error, sizeof(error), "%s has version %u, this build reads 1 to %u", path, h.Version, TableFileHeader::VERSION);
+			for (uint32_t i = 0; !error[0] && i < h.SectionCount; i++) {
+				const TableSection &s = h.Sections[i];
+				if (s.Offset % TableFileHeader::ALIGNMENT != 0 || s.Offset > size || s.Bytes() > size - s.Offset)
+					snprintf(error, sizeof(error), "%s is cut, section %.16s is outside the file", path, s.Name);
+				else if (s.Type != TABLE_UNTYPED && TableElementSize(s.Type) != s.ElementSize)
+					snprintf(error, sizeof(error), "%s: section %.16s has %u byte elements of type %s", path, s.Name,
+						s.ElementSize, TableElementName(s.Type));
+			}
+		}
+		if (error[0]) {
+			char reason[sizeof(error)];
+			memcpy(reason, error, sizeof(error));
+			Close();
+			memcpy(error, reason, sizeof(error));
+			return false;
+		}
+		return true;
+	}
+
+	// Opens the file if it is a table of the kind and bins, Error() tells why not.
+	bool Open(const char* path, const char* kind, const uint32_t* bins, int count) {
+		if (!Open(path))
+			return false;
+		char reason[160];
+		if (Header().Mismatch(kind, bins, count, reason, sizeof(reason))) {
+			Close();
+			snprintf(error, sizeof(error), "%.80s: %s", path, reason);
+			return false;
+		}
+		return true;
+	}
+
+	// Opens a file of kind stf or stfx without header, the only format before version 1: the
+	// f32 sections follow each other from the start of the file (stf OneTimeSA, MultiTimeSA and
+	// STF, stfx CDF_LogN and CDF_XW). The file is recognized by its size, so it must have the
+	// bins given. The header made up has version 0 and no checksums (see Headerless).
+	bool OpenHeaderless(const char* path, const char* kind, const uint32_t* bins, int count) {
+		Close();
+		const char* names[2][3] = { { "OneTimeSA", "MultiTimeSA", "STF" }, { "CDF_LogN", "CDF_XW", nullptr } };
+		uint64_t counts[3] = {};
+		int table;
+		if (strcmp(kind, "stf") == 0 && count == 4) {
+			table = 0;
+			counts[0] = counts[1] = (uint64_t)bins[0] * bins[1] * bins[2];
+			counts[2] = counts[0] * bins[3];
+		}
+		else if (strcmp(kind, "stfx") == 0 && count == 6) {
+			table = 1;
+			counts[0] = (uint64_t)bins[0] * bins[1] * bins[2];
+			counts[1] = counts[0] * bins[3] * bins[4] * bins[5];
+		}
+		else {
+			snprintf(error, sizeof(error), "%s: tables of kind %s always had a header", path, kind);
+			return false;
+		}
+		if (!Map(path)) {
+			Close();
+			snprintf(error, sizeof(error), "%s can not be read", path);
+			return false;
+		}
+		TableFileHeader &h = legacy;
+		h = TableFileHeader{};
+		h.Magic = TableFileHeader::MAGIC;
+		snprintf(h.Kind, sizeof(h.Kind), "%s", kind);
+		for (int i = count - 1; i >= 0; i--) {
+			h.Bins[i] = bins[i];
+			h.Strides[i] = i == count - 1 ? 1 : h.Strides[i + 1] * bins[i + 1];
+		}
+		uint64_t offset = 0;
+		for (int i = 0; i < 3 && names[table][i]; i++) {
+			TableSection &s = h.Sections[h.SectionCount++];
+			snprintf(s.Name, sizeof(s.Name), "%s", names[table][i]);
+			s.ElementSize = 4;
+			s.Type = TABLE_F32;
+			s.Offset = offset;
+			s.Count = counts[i];
+			offset += s.Bytes();
+		}
+		if (offset != size) {
+			snprintf(error, sizeof(error), "%s has no header and %llu bytes instead of the %llu of a headerless %s table",
+				path, (unsigned long long)size, (unsigned long long)offset, kind);
+			char reason[sizeof(error)];
+			memcpy(reason, error, sizeof(error));
+			Close();
+			memcpy(error, reason, sizeof(error));
+			return false;
+		}
+		headerless = true;
+		return true;
+	}
+
+	const char* Error() const { return error; }
+
+	void Close() {
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data)
+			munmap((void*)data, size);
+#endif
+		data = nullptr;
+		size = 0;
+		error[0] = 0;
+		headerless = false;
+	}
+
+	bool IsOpen() const { return data != nullptr; }
+	uint64_t Size() const { return size; }
+	const TableFileHeader& Header() const { return headerless ? legacy : *(const TableFileHeader*)data; }
+	// Opened by OpenHeaderless, the sections have no checksums.
+	bool Headerless() const { return headerless; }
+
+	// View of a section, null if it is missing or has other element size or count.
+	const void* Section(const char* name, uint32_t elementSize, uint64_t count) const {
+		const TableSection* s = data ? Header().Find(name) : nullptr;
+		if (!s || s->ElementSize != elementSize || s->Count != count)
+			return nullptr;
+		return data + s->Offset;
+	}
+
+	// As above checking the type too (untyped sections of older files match any type of the size).
+	const void* Section(const char* name, TableElementType type, uint64_t count) const {
+		const TableSection* s = data ? Header().Find(name) : nullptr;
+		if (!s || (s->Type != TABLE_UNTYPED && s->Type != (uint32_t)type))
+			return nullptr;
+		return Section(name, TableElementSize(type), count);
+	}
+
+	const void* Section(const TableSection &s) const { return data + s.Offset; }
+
+	// Reads the whole section, only tools and uploads that read it anyway should verify.
+	// Headerless files have nothing to verify against.
+	bool Verify(const TableSection &s) const {
+		return headerless || TableChecksum(data + s.Offset, s.Bytes()) == s.Checksum;
+	}
+};
+
+// Versions of a table kept side by side: the paths listed in tables.txt (one per line, if it is
+// in the working directory) are tried before the default one, the first table of the kind and
+// bins is opened. Only headers are read, so switching versions (as benchmarks do) costs nothing.
+// A headerless default file of the kind and bins is opened as the last resort (OpenHeaderless).
+// error gets the reasons of every candidate if none is valid.
+inline bool OpenTableVersion(MappedTableFile &file, const char* defaultPath, const char* kind, const uint32_t* bins, int count,
+	char* error, size_t size) {
+	error[0] = 0;
+	size_t used = 0;
+	FILE* list = nullptr;
+#ifdef _WIN32
+	if (fopen_s(&list, "tables.txt", "r") != 0)
+		list = nullptr;
+#else
+	list = fopen("tables.txt", "r");
+#endif
+	char line[260];
+	bool found = false;
+	while (!found && list && fgets(line, sizeof(line), list)) {
+		size_t length = strcspn(line, "\r\n");
+		line[length] = 0;
+		if (length == 0 || line[0] == '#')
+			continue;
+		found = file.Open(line, kind, bins, count);
+		if (!found && used < size)
+			used += snprintf(error + used, size - used, "%s\n", file.Error());
+	}
+	if (list)
+		fclose(list);
+	if (!found) {
+		found = file.Open(defaultPath, kind, bins, count);
+		if (!found && used < size)
+			used += snprintf(error + used, size - used, "%s\n", file.Error());
+	}
+	if (!found && strstr(file.Error(), "is not a table file")) {
+		found = file.OpenHeaderless(defaultPath, kind, bins, count);
+		if (!found && used < size)
+			snprintf(error + used, size - used, "%s\n", file.Error());
+	}
+	if (found)
+		error[0] = 0;
+	return found;
+}
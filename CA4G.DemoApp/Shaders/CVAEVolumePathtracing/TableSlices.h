@@ -0,0 +1,111 @@
+#pragma once
+
+// (g, phi) slices of the STF tables a scene uses, so only the rows of its media are kept on the
+// device instead of the whole tables. A slice holds the BINS_R albedos of OneTimeSA and
+// MultiTimeSA and the BINS_R * BINS_THETA values of STF (or Alias_STF) of one (g, phi) bin, the
+// shaders find it through Remap[g * BINS_SA + phi]. Shared with CA4G.Offline.
+// Slices are copied from stf2.bin, stf_adaptive.bin (after Binning.Use, see TableBins.h) or from a
+// table of some slices generated for a scene:
+//	kind stf_slices: bins as stf; sections Slices (g * BINS_SA + phi of every slice), SA (s^1 of
+//	all the slices followed by s^m), STF and Alias_STF (optional) in the order of Slices.
+
+#include <vector>
+#include <cstring>
+#include "TableFile.h"
+#include "TableBins.h"
+
+struct STFTableSlices {
+	// g, sa, r and theta bins of the tables
+	uint32_t Bins[4];
+	// Bins of the media
+	STFBinning Binning;
+	// g * BINS_SA + phi of every slice in the order they were added
+	std::vector<uint32_t> Keys;
+	// [g, phi] -> slice, -1 if not added
+	std::vector<int> Remap;
+
+	STFTableSlices(const uint32_t* bins) : Binning((int)bins[0], (int)bins[1]), Remap((size_t)bins[0] * bins[1], -1) {
+		memcpy(Bins, bins, sizeof(Bins));
+	}
+
+	int Count() const { return (int)Keys.size(); }
+	// values of a slice in STF
+	int SliceSize() const { return (int)(Bins[2] * Bins[3]); }
+
+	int Slice(int g, int phi) const { return Remap[(size_t)g * Bins[1] + phi]; }
+
+	// Adds the slice of a bin, false if it is out of range or already added.
+	bool Add(int g, int phi) {
+		if (g < 0 || g >= (int)Bins[0] || phi < 0 || phi >= (int)Bins[1])
+			return false;
+		uint32_t key = (uint32_t)g * Bins[1] + phi;
+		if (Remap[key] >= 0)
+			return false;
+		Remap[key] = Count();
+		Keys.push_back(key);
+		return true;
+	}
+
+	// Adds the slices of a medium and of the bins around it (the shader variants scale phi
+	// differently and the gpu logarithms may round to the next bin). Returns the new slices.
+	int AddMedium(float g, float phi, int neighbours = 1) {
+		int gBin = Binning.GBin(g), phiBin = Binning.PhiBin(phi), added = 0;
+		for (int dg = -neighbours; dg <= neighbours; dg++)
+			for (int dp = -neighbours; dp <= neighbours; dp++)
+				added += Add(gBin + dg, phiBin + dp);
+		return added;
+	}
+
+	void Clear() {
+		for (uint32_t key : Keys)
+			Remap[key] = -1;
+		Keys.clear();
+	}
+
+	// Copies the slices [first, Count()) of a stf, stf_adaptive or stf_slices table: BINS_R albedos per slice to
+	// oneTime and multi, and SliceSize() values of the section rows (STF or Alias_STF) to values,
+	// all indexed by slice. False if the table misses the sections or some slices, missing slices
+	// are zeros (no scattering, the samplers absorb).
+	bool Gather(const MappedTableFile &file, const char* rows, int first, float* oneTime, float* multi, uint32_t* values) const {
+		const TableFileHeader &h = file.Header();
+		bool sliced = h.Matches("stf_slices", Bins, 4);
+		if (!sliced && !h.Matches("stf", Bins, 4) && !h.Matches("stf_adaptive", Bins, 4))
+			return false;
+		const TableSection* keySection = h.Find("Slices");
+		uint64_t fileSlices = sliced ? (keySection ? keySection->Count : 0) : (uint64_t)Bins[0] * Bins[1];
+		const uint32_t* fileKeys = sliced ? (const uint32_t*)file.Section("Slices", sizeof(uint32_t), fileSlices) : nullptr;
+		const float* oneTimeSA;
+		const float* multiTimeSA;
+		if (sliced) {
+			oneTimeSA = (const float*)file.Section("SA", sizeof(float), 2 * fileSlices * Bins[2]);
+			multiTimeSA = oneTimeSA ? oneTimeSA + fileSlices * Bins[2] : nullptr;
+		}
+		else {
+			oneTimeSA = (const float*)file.Section("OneTimeSA", sizeof(float), fileSlices * Bins[2]);
+			multiTimeSA = (const float*)file.Section("MultiTimeSA", sizeof(float), fileSlices * Bins[2]);
+		}
+		const uint32_t* rowValues = (const uint32_t*)file.Section(rows, sizeof(uint32_t), fileSlices * SliceSize());
+		if (!oneTimeSA || !multiTimeSA || !rowValues || (sliced && !fileKeys))
+			return false;
+		bool complete = true;
+		for (int s = first; s < Count(); s++) {
+			uint64_t source = Keys[s];
+			if (sliced) {
+				source = 0;
+				while (source < fileSlices && fileKeys[source] != Keys[s])
+					source++;
+				if (source == fileSlices) {
+					memset(oneTime + (size_t)s * Bins[2], 0, Bins[2] * sizeof(float));
+					memset(multi + (size_t)s * Bins[2], 0, Bins[2] * sizeof(float));
+					memset(values + (size_t)s * SliceSize(), 0, SliceSize() * sizeof(uint32_t));
+					complete = false;
+					continue;
+				}
+			}
+			memcpy(oneTime + (size_t)s * Bins[2], oneTimeSA + source * Bins[2], Bins[2] * sizeof(float));
+			memcpy(multi + (size_t)s * Bins[2], multiTimeSA + source * Bins[2], Bins[2] * sizeof(float));
+			memcpy(values + (size_t)s * SliceSize(), rowValues + source * SliceSize(), SliceSize() * sizeof(uint32_t));
+		}
+		return complete;
+	}
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ca4g.h"
+#include "../../GUITraits.h"
+#include "TableFile.h"
+
+using namespace CA4G;
+
+// Base of the techniques that upload offline tables (STF, STFX). Table sections go from the
+// mapped file to the buffers through two staging buffers used alternately, the tables are never
+// read into memory nor mapped for upload entirely.
+class TableStreamingTechnique : public Technique,
+	public IReportTables {
+
+protected:
+	static const int TABLE_CHUNK_BYTES = 1 << 26;
+	gObj<Buffer> tableStaging[2];
+	Signal tableStagingFree[2];
+	int streamedChunks = 0;
+	// Chunk recorded by StreamTableChunk
+	gObj<Buffer> chunkTarget;
+	long long chunkOffset = 0;
+	int chunkBytes = 0;
+	int chunkStaging = 0;
+
+	// Streams a section split in equal parts to the targets. False if it is missing or damaged,
+	// TableStatus tells which.
+	bool StreamTableSection(const MappedTableFile &file, const char* name, gObj<Buffer>* targets, int count) {
+		const TableSection* section = file.Header().Find(name);
+		if (!section)
+		{
+			snprintf(TableStatus, sizeof(TableStatus), "The table has no section %s", name);
+			return false;
+		}
+		if (!tableStaging[0])
+			for (int i = 0; i < 2; i++)
+				tableStaging[i] = __create Buffer_SRV<unsigned int>(TABLE_CHUNK_BYTES / 4);
+		const unsigned char* data = (const unsigned char*)file.Section(*section);
+		unsigned long long partBytes = section->Bytes() / count;
+		unsigned long long hash = TableChecksum(nullptr, 0);
+		for (int t = 0; t < count; t++)
+			for (unsigned long long offset = 0; offset < partBytes; offset += TABLE_CHUNK_BYTES)
+			{
+				int s = streamedChunks++ % 2;
+				if (streamedChunks > 2) // wait the copy that read this staging buffer
+					tableStagingFree[s].WaitFor();
+				chunkBytes = (int)(partBytes - offset < TABLE_CHUNK_BYTES ? partBytes - offset : TABLE_CHUNK_BYTES);
+				const unsigned char* chunk = data + t * partBytes + offset;
+				hash = TableChecksum(chunk, chunkBytes, hash);
+				tableStaging[s] _copy RegionFromPtr((byte*)chunk, D3D12_BOX{ 0, 0, 0, (UINT)(chunkBytes / 4), 1, 1 });
+				chunkTarget = targets[t];
+				chunkOffset = (long long)offset;
+				chunkStaging = s;
+				__dispatch member_collector(StreamTableChunk);
+				tableStagingFree[s] = __create FlushAndSignal();
+			}
+		// headerless tables have no checksums (MappedTableFile::OpenHeaderless)
+		bool damaged = !file.Headerless() && hash != section->Checksum;
+		if (damaged)
+			snprintf(TableStatus, sizeof(TableStatus), "Section %s of the table is damaged (checksum)", name);
+		return !damaged;
+	}
+
+	void StreamTableChunk(gObj<GraphicsManager> manager) {
+		manager _load BufferRegionToGPU(chunkTarget, chunkOffset, tableStaging[chunkStaging], chunkBytes);
+	}
+
+	// Waits for the last copies and releases the staging buffers.
+	void EndTableStreaming() {
+		for (int i = 0; i < 2 && i < streamedChunks; i++)
+			tableStagingFree[i].WaitFor();
+		tableStaging[0] = nullptr;
+		tableStaging[1] = nullptr;
+	}
+};
@@ -4,6 +4,8 @@
 #include "..\Tools\CommonPT.h" 
 
 // Random using is HybridTaus
+// A Sobol point per pass when every pass traces the three channels
+#define SOBOL_PASSES_PER_SAMPLE (SPECTRAL_PATHTRACING ? 1 : 3)
 #include "..\Tools\Randoms.h"
 
 // Includes some functions for surface scattering and texture mapping
@@ -27,6 +29,9 @@ cbuffer Transforming : register(b1) {
 
 #include "../Tools/HGPhaseFunction.h"
 
+// Spectral MIS of the three channels (SPECTRAL_PATHTRACING)
+#include "../Tools/SpectralPath.h"
+
 struct RayPayload // Only used for raycasting
 {
 	int TriangleIndex;
@@ -83,8 +88,8 @@ void SurfelScattering(inout float3 x, inout float3 w, inout float3 importance, V
 float3 ComputePath(float3 O, float3 D, inout int complexity)
 {
 	int cmp = NumberOfPasses % 3;
-	float3 importance = 0;
-	importance[cmp] = 3;
+	float3 pdfs;
+	float3 importance = StartSpectralImportance(cmp, pdfs);
 	float3 x = O;
 	float3 w = D;
 
@@ -100,6 +105,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		int tIndex;
 		int transformIndex;
@@ -127,19 +133,28 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 		[branch]
 		if (t >= d)
 		{
+			if (!isOutside)
+				SpectralTransmittance(importance, pdfs, volMaterial.Extinction, cmp, d);
+
 			bounces += isOutside;
 			if (bounces >= MAX_PATHTRACING_BOUNCES)
 				return 0;
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return directContribution;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return directContribution;
 			x += t * w; // free traverse in a medium
-			if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+			SpectralCollision(importance, pdfs, volMaterial.Extinction, cmp, t);
+			if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 				return directContribution;
+			SpectralSurvival(importance, pdfs, volMaterial.ScatteringAlbedo, cmp);
 
 			// Ray cast to light source
 			// NEE using straight line as a naive approximation missing refraction at interface
@@ -159,9 +174,12 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 			payload = (RayPayload)0;
 			bool clearPathToLight = !Intersect(surfel.P + LightDirection * 0.01, LightDirection, payload); // Shadow ray
 
-			directContribution += clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction[cmp]) * EvalPhase(volMaterial.G[cmp], w, LightDirection) / 2;
+			directContribution += clearPathToLight * importance * LightIntensity * exp(-d * volMaterial.Extinction) *
+				float3(EvalPhase(volMaterial.G.x, w, LightDirection), EvalPhase(volMaterial.G.y, w, LightDirection), EvalPhase(volMaterial.G.z, w, LightDirection)) / 2;
 
+			float3 win = w;
 			w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+			SpectralPhase(importance, pdfs, volMaterial.G, cmp, win, w);
 		}
 	}
 	return 0;
@@ -4,6 +4,8 @@
 #include "..\Tools\CommonPT.h" 
 
 // Random using is HybridTaus
+// A Sobol point per pass when every pass traces the three channels
+#define SOBOL_PASSES_PER_SAMPLE (SPECTRAL_PATHTRACING ? 1 : 3)
 #include "..\Tools\Randoms.h"
 
 // Includes some functions for surface scattering and texture mapping
@@ -27,6 +29,9 @@ cbuffer Transforming : register(b1) {
 
 #include "../Tools/HGPhaseFunction.h"
 
+// Spectral MIS of the three channels (SPECTRAL_PATHTRACING)
+#include "../Tools/SpectralPath.h"
+
 struct RayPayload // Only used for raycasting
 {
 	int TriangleIndex;
@@ -83,8 +88,8 @@ void SurfelScattering(inout float3 x, inout float3 w, inout float3 importance, V
 float3 ComputePath(float3 O, float3 D, inout int complexity)
 {
 	int cmp = NumberOfPasses % 3;
-	float3 importance = 0;
-	importance[cmp] = 3;
+	float3 pdfs;
+	float3 importance = StartSpectralImportance(cmp, pdfs);
 	float3 x = O;
 	float3 w = D;
 
@@ -100,6 +105,7 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 	while (true)
 	{
 		complexity++;
+		StartPathVertex(complexity);
 
 		int tIndex;
 		int transformIndex;
@@ -127,20 +133,31 @@ float3 ComputePath(float3 O, float3 D, inout int complexity)
 		[branch]
 		if (t >= d)
 		{
+			if (!isOutside)
+				SpectralTransmittance(importance, pdfs, volMaterial.Extinction, cmp, d);
+
 			bounces += isOutside;
 			if (bounces >= MAX_PATHTRACING_BOUNCES)
 				return 0;
 			SurfelScattering(x, w, importance, surfel, material);
+			if (!RussianRoulette(importance, ROULETTE_SURFACE_THRESHOLD, roulettes.xy))
+				return 0;
 
 			if (any(material.Specular) && material.Roulette.w > 0)
 				isOutside = dot(surfel.N, w) >= 0;
 		}
 		else
 		{ // Volume scattering or absorption
+			if (!RussianRoulette(importance, ROULETTE_MEDIUM_THRESHOLD, roulettes.zw))
+				return 0;
 			x += t * w; // free traverse in a medium
-			if (random() < 1 - volMaterial.ScatteringAlbedo[cmp]) // absorption instead
+			SpectralCollision(importance, pdfs, volMaterial.Extinction, cmp, t);
+			if (!MediumAbsorption(importance, volMaterial.ScatteringAlbedo, cmp)) // absorption instead
 				return 0;
+			SpectralSurvival(importance, pdfs, volMaterial.ScatteringAlbedo, cmp);
+			float3 win = w;
 			w = ImportanceSamplePhase(volMaterial.G[cmp], w); // scattering event...
+			SpectralPhase(importance, pdfs, volMaterial.G, cmp, win, w);
 		}
 	}
 	return 0;
@@ -0,0 +1,40 @@
+#ifndef ACTIVATIONS_H
+#define ACTIVATIONS_H
+
+// Activations used by the generated CVAE networks.
+// softplus(x) = log(1 + exp(x)) is evaluated as max(x, 0) + log(1 + exp(-|x|)) in every tier,
+// so large |x| can not overflow to inf.
+// Define ACTIVATION_TIER before including the networks (see Parameters.h) to select the accuracy.
+
+// Full precision exp and log.
+#define ACTIVATION_TIER_EXACT 0
+// exp2 and polynomial log1p, max abs error 2e-6 and max relative error 1.2e-4.
+#define ACTIVATION_TIER_POLYNOMIAL 1
+// The piecewise linear tier of CA4G.Offline is evaluated here as the polynomial one. Its table
+// would be indexed per lane (registers or local memory on most drivers) and, with the error
+// bounded, it is slower than the polynomial tier already on the CPU (CA4G.Offline activations).
+#define ACTIVATION_TIER_LINEAR 2
+
+#ifndef ACTIVATION_TIER
+#define ACTIVATION_TIER ACTIVATION_TIER_EXACT
+#endif
+
+#define DECLARE_SOFTPLUS(T) \
+T softplusExact(T x) { return max(x, 0) + log(1 + exp(-abs(x))); } \
+T softplusPolynomial(T x) { \
+	T u = exp2(-abs(x) * 1.44269504); \
+	return max(x, 0) + u * (0.999888916 + u * (-0.497702963 + u * (0.316877881 + u * (-0.192238615 + u * (0.0841986622 + u * -0.0178779012))))); \
+} \
+T softplusActivation(T x) { \
+	if (ACTIVATION_TIER != ACTIVATION_TIER_EXACT) return softplusPolynomial(x); \
+	return softplusExact(x); \
+}
+
+DECLARE_SOFTPLUS(float1)
+DECLARE_SOFTPLUS(float2)
+DECLARE_SOFTPLUS(float3)
+DECLARE_SOFTPLUS(float4)
+
+#undef DECLARE_SOFTPLUS
+
+#endif
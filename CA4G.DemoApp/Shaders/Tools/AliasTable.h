@@ -0,0 +1,15 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+// Walker/Vose alias tables written by CA4G.Offline (Common/AliasTable.h documents the format).
+// One uint per bin: probability of keeping the bin in 16 bits (65535 is 1) | alias bin << 16.
+
+// Replaces SearchBin over a cdf of count bins starting at start: one read instead of log2(count).
+// u0 picks the slot and u1 the bin or its alias. Returns the bin relative to start.
+int SampleAlias(StructuredBuffer<uint> table, int start, int count, float u0, float u1) {
+	int bin = min((int)(u0 * count), count - 1);
+	uint entry = table[start + bin];
+	return u1 * 65535 < (entry & 0xFFFF) ? bin : (int)(entry >> 16);
+}
+
+#endif
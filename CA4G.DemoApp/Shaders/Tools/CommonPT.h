@@ -12,6 +12,10 @@ cbuffer AccumulativeInfo : register(b1, space1) {
 RWTexture2D<float3> Accumulation : register(u1, space1); // Auxiliar Accumulation Buffer
 RWTexture2D<float3> SqrAccumulation : register(u2, space1); // Square accumulator (for variance estimation)
 RWTexture2D<uint> Complexity	 : register(u3, space1); // Complexity buffer for debuging
+RWTexture2D<uint4> Roulettes	 : register(u4, space1); // Russian roulettes played and paths ended, surface (xy) and medium (zw)
+
+// Roulettes of the path being traced (see RussianRoulette), added to Roulettes with its output
+static uint4 roulettes = 0;
 
 #include "CommonComplexity.h"
 
@@ -19,6 +23,7 @@ void AccumulateOutput(uint2 coord, float3 value, int complexity) {
 	Accumulation[coord] += value;
 	SqrAccumulation[coord] += value * value;
 	Complexity[coord] += complexity;
+	Roulettes[coord] += roulettes;
 
 	if (ShowComplexity)
 		Output[coord] = float4(GetColor((int)round(Complexity[coord] / (NumberOfPasses + 1))), 1);
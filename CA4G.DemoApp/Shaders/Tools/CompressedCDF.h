@@ -0,0 +1,44 @@
+#ifndef COMPRESSED_CDF_H
+#define COMPRESSED_CDF_H
+
+// Cdfs quantized to 16 bits (65535 is 1) packed two per uint, written by the offline tool
+// stfxcompress (CA4G.Offline/Samplers/STFXCompressedSampler.h documents the format).
+// A cell is uint2(offset in 16-bit units, first bin | count << 13 | sparse << 31).
+//	sparse: count pairs (cdf, bin), one uint each, of the bins where the cdf grows
+//	dense: count cdf values of the bins first..first + count - 1
+// Zero probability bins are not stored, count is 0 for cdfs that are never sampled.
+
+uint ReadCDF16(StructuredBuffer<uint> data, uint index) {
+	return (data[index >> 1] >> ((index & 1) * 16)) & 0xFFFF;
+}
+
+// Replaces SearchBin over a dense float cdf. Returns the bin where value (in [0,1)) falls.
+int SearchCompressedCDF(StructuredBuffer<uint> data, uint2 cell, float value) {
+	float v = value * 65535;
+	int first = cell.y & 0x1FFF;
+	int beg = 0;
+	int end = (int)((cell.y >> 13) & 0x3FFF) - 1;
+	if (end < 0)
+		return 0;
+	if (cell.y >> 31) {
+		uint pairs = cell.x >> 1; // sparse blocks start at even positions
+		while (beg < end) {
+			int med = (beg + end) / 2;
+			if (v < (data[pairs + med] & 0xFFFF))
+				end = med;
+			else
+				beg = med + 1;
+		}
+		return data[pairs + beg] >> 16;
+	}
+	while (beg < end) {
+		int med = (beg + end) / 2;
+		if (v < ReadCDF16(data, cell.x + med))
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return first + beg;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef DIFFUSION_SPHERE_H
+#define DIFFUSION_SPHERE_H
+
+#include "Randoms.h"
+#include "Definitions.h"
+
+// Exit of a sphere of r mean free paths in the diffusion limit, for spheres beyond the STF tables
+// and the CVAE training range (up to MAX_SPHERE_RADIUS). CA4G.Offline Samplers/DiffusionSampler.h
+// derives it and bounds its error against the exact walk (diffusionerror).
+// The walk is an isotropic source at a transport mean free path from the center, the exit
+// position follows its harmonic measure, the direction is cosine weighted around the normal and
+// the walk survives with the first passage probability of the diffusion with absorption.
+
+// (1 - exp(-x)) / x without the cancellation near 0
+float DiffusionShrink(float x)
+{
+	return x < 1e-3 ? 1 - 0.5 * x : (1 - exp(-x)) / x;
+}
+
+// Same outputs as SampleCosXAndW of the table and model path tracers.
+bool DiffusionSampleCosXAndW(float g, float phi, float r, out float theta, out float beta, out float alpha)
+{
+	theta = 1;
+	beta = 0;
+	alpha = 0;
+
+	float sigmaTr = 1 - g * phi;
+	float a = min(1 / sigmaTr, 0.5 * r);
+	float R = r + 1.42 / sigmaTr; // extrapolated boundary
+	float k = sqrt(3 * (1 - phi) * sigmaTr);
+	float survival = exp(k * (a - R)) * DiffusionShrink(2 * k * a) / DiffusionShrink(2 * k * R);
+	if (random() >= survival)
+		return false;
+
+	float rho = a / R;
+	float u = random();
+	if (rho < 1e-4)
+		theta = 2 * u - 1;
+	else {
+		float q = u * (1 / (1 - rho) - 1 / (1 + rho)) + 1 / (1 + rho);
+		theta = clamp((1 + rho * rho - 1 / (q * q)) / (2 * rho), -1, 1);
+	}
+	float angle = random() * 2 * pi;
+	float rad = sqrt(random());
+	alpha = rad * sin(angle);
+	beta = rad * cos(angle);
+	return true;
+}
+
+// As GenerateVariablesWithTable and GenerateVariablesWithModel, exit position (in radii) and
+// direction around win.
+bool GenerateVariablesInDiffusion(float G, float Phi, float3 win, float density, out float3 x, out float3 w)
+{
+	x = float3(0, 0, 0);
+	w = win;
+
+	float3 temp = abs(win.x) >= 0.9999 ? float3(0, 0, 1) : float3(1, 0, 0);
+	float3 winY = normalize(cross(temp, win));
+	float3 winX = cross(win, winY);
+	float rAlpha = random() * 2 * pi;
+	float3x3 R = (mul(float3x3(
+		cos(rAlpha), -sin(rAlpha), 0,
+		sin(rAlpha), cos(rAlpha), 0,
+		0, 0, 1), float3x3(winX, winY, win)));
+
+	float theta, beta, alpha;
+	if (!DiffusionSampleCosXAndW(G, Phi, density, theta, beta, alpha))
+		return false;
+
+	x = float3(0, sqrt(1 - theta * theta), theta);
+	float3 N = x;
+	float3 B = float3(1, 0, 0);
+	float3 T = cross(x, B);
+	w = normalize(N * sqrt(max(0, 1 - beta * beta - alpha * alpha)) + T * beta + B * alpha);
+
+	x = mul(x, R);
+	w = mul(w, R); // move to radial space
+
+	return true;
+}
+
+#endif
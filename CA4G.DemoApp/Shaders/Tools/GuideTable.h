@@ -0,0 +1,28 @@
+#ifndef GUIDE_TABLE_H
+#define GUIDE_TABLE_H
+
+// Guide tables of normalized cdfs written by CA4G.Offline (Common/GuideTable.h documents the
+// format). GUIDE_ENTRIES 16-bit starting bins per cdf packed two per uint.
+#define GUIDE_ENTRIES 64
+
+uint ReadGuide16(StructuredBuffer<uint> guide, uint index) {
+	return (guide[index >> 1] >> ((index & 1) * 16)) & 0xFFFF;
+}
+
+// Replaces SearchBin over a cdf of count bins starting at start, the search covers only the bins
+// between two entries of the guide of the cdf (at guideStart). Returns the bin relative to start.
+int SearchGuided(StructuredBuffer<float> cdf, StructuredBuffer<uint> guide, int guideStart, int start, int count, float value) {
+	int i = min((int)(value * GUIDE_ENTRIES), GUIDE_ENTRIES - 1);
+	int beg = ReadGuide16(guide, guideStart + i);
+	int end = i < GUIDE_ENTRIES - 1 ? ReadGuide16(guide, guideStart + i + 1) : count - 1;
+	while (beg < end) {
+		int med = (beg + end) / 2;
+		if (value < cdf[start + med])
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return beg;
+}
+
+#endif
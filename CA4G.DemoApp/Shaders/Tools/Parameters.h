@@ -7,7 +7,92 @@
 // Use skybox to show fancy scenes
 #define USE_SKYBOX
 
+// Random numbers of the path tracers (see Randoms.h), CA4G.Offline draws the same ones (randoms).
+// HybridTaus seeded with the linear index of the ray and 23 to 35 warm-up draws
+#define RANDOM_SEQUENCE_HYBRIDTAUS 0
+// Philox4x32-10 stream keyed by (pixel, frame) with the bounce in the counter, no warm-up
+#define RANDOM_SEQUENCE_PHILOX 1
+// Owen-scrambled Sobol points, four dimensions per path vertex (StartPathVertex) and the Philox
+// stream past them, normals by the inverse cdf. Fewer passes for the same noise (CA4G.Offline converge).
+#define RANDOM_SEQUENCE_SOBOL 2
+#define RANDOM_SEQUENCE RANDOM_SEQUENCE_SOBOL
+
 // Max number of outside bounces allowed in a Pathtracer
 #define MAX_PATHTRACING_BOUNCES 5
 
+// Russian roulette on the path importance (relative to the camera ray, see RussianRoulette in
+// Scattering.h) after surface scattering and before the steps of a medium walk. Paths below the
+// threshold survive with probability importance / threshold, 0 turns off the event type. Both are
+// off by default, opt in with thresholds measured by CA4G.Offline roulette (e.g. 0.25 and 1).
+#define ROULETTE_SURFACE_THRESHOLD 0
+#define ROULETTE_MEDIUM_THRESHOLD 0
+
+// Medium collisions absorb non-analogly (see MediumAbsorption): paths always scatter and their
+// importance carries the albedo of every channel, so only the medium roulette ends the walks. With
+// ROULETTE_MEDIUM_THRESHOLD at 1 it replaces the absorption test of the hero channel by one on the
+// mean albedo of the channels, lower thresholds let the walks go on longer. Without the medium
+// roulette only leaving the medium ends a walk. 0 keeps the analog absorption test, with or
+// without the roulette.
+#define NON_ANALOG_ABSORPTION 0
+
+// With 1 Pathtracing_RT and NEEPathtracing_RT trace the three color channels in every pass: the
+// hero channel (NumberOfPasses % 3) samples the media and spectral MIS weights the others (see
+// SpectralPath.h), less noise per pass but more work per path, colored media can lose per unit
+// time (CA4G.Offline sharedpath). 0 (the default) traces one channel per pass with weight 3.
+#define SPECTRAL_PATHTRACING 0
+
+// Accuracy of the CVAE network activations (see Activations.h)
+// ACTIVATION_TIER_EXACT, ACTIVATION_TIER_POLYNOMIAL or ACTIVATION_TIER_LINEAR
+#define ACTIVATION_TIER ACTIVATION_TIER_EXACT
+
+// Trace one path for the three color channels in the CVAE path tracers (see SharedPath.h)
+// instead of one channel per pass. Unbiased, pays off in gray or near gray media.
+#define SHARED_PATH_MEDIA 0
+
+// Max relative difference between channels of a medium to share CVAE events (0 = only gray media)
+#define GRAY_MEDIA_TOLERANCE 0
+
+// Max relative difference between channels of a medium to keep sharing analytic flights (below 1)
+#define SHARED_PATH_MAX_SPREAD 0.25
+
+// STFX loads stfx_compressed.bin (16-bit sparse cdfs, see CompressedCDF.h) instead of the dense
+// stfx.bin. Convert the dense tables with CA4G.Offline stfxcompress before turning it on.
+#define STFX_COMPRESSED_TABLES 0
+
+// STF and STFX draw the table bins from alias tables (see AliasTable.h) with one read instead of
+// binary searches over the cdfs. Tables need the alias sections (CA4G.Offline stftable or tablealias).
+#define TABLE_ALIAS_SAMPLING 0
+
+// STFX searches the dense position-direction cdfs from their guide tables (see GuideTable.h)
+// instead of a full binary search (or the alias tables), bins keep the order of the random
+// numbers. Tables need the section Guide_XW (CA4G.Offline stftable or tableguide).
+#define TABLE_GUIDE_SAMPLING 0
+
+// STF keeps on the device only the (g, phi) table slices of the scene media (see TableSlices.h),
+// copied from stf2.bin or, without it, from stf_slices.bin (CA4G.Offline stftable gs= phis=).
+// 1.7 MB of slices plus the dense [g, phi] -> slice remap, 4 * BINS_G * BINS_SA bytes (800 KB at
+// 200 x 1000), instead of the 338 MB of the whole tables.
+#define STF_SCENE_SLICES 0
+
+// STF loads stf_adaptive.bin, with g and phi bins placed where the tables change most (see
+// TableBins.h), instead of the uniform 200 x 1000 bins of stf2.bin. Build it from stf2.bin with
+// CA4G.Offline stfadaptive.
+#define STF_ADAPTIVE_BINS 0
+
+// STF picks the g and phi bins (STFX the g bin) around a medium with their linear interpolation
+// weights between bin centers (as r already is) instead of the bins the medium falls in (see
+// TableBins.h).
+#define TABLE_INTERPOLATED_SAMPLING 0
+
+// Largest sphere (in mean free paths) of a medium step in the STF and CVAE path tracers. The STF
+// tables reach 2^(BINS_R - 1) = 256 and the CVAE model was trained up to CVAE_MAX_RADIUS, larger
+// spheres are sampled in the diffusion limit (see DiffusionSphere.h) so optically thick objects
+// are crossed in far fewer steps (CA4G.Offline spheresteps). 256 keeps every step in the tables,
+// larger radii opt in to the diffusion limit (error against the exact walk: CA4G.Offline
+// diffusionerror).
+#define MAX_SPHERE_RADIUS 256
+
+// Largest density of the CVAE training data (CA4G.Offline cvaedata density=1,256)
+#define CVAE_MAX_RADIUS 256
+
 #endif
\ No newline at end of file
@@ -1,7 +1,27 @@
 #ifndef RANDOMS_H
 #define RANDOMS_H
 
+#include "Parameters.h"
+
+#ifndef RANDOM_SEQUENCE
+#define RANDOM_SEQUENCE RANDOM_SEQUENCE_HYBRIDTAUS
+#endif
+
+// Passes that share a Sobol point: 3 when every pass traces one channel, each channel walks its own
+// sequence, 1 when every pass traces the three channels. Defined by the path tracers before this include.
+#ifndef SOBOL_PASSES_PER_SAMPLE
+#define SOBOL_PASSES_PER_SAMPLE 3
+#endif
+
+// HybridTaus lanes or, with Philox and Sobol, the key (pixel, frame), the next dimension and the bounce
 static uint4 rng_state;
+// Philox block of the dimensions rng_state.z & ~3 to rng_state.z | 3
+static uint4 rng_block;
+// Sobol point index and scrambling seed of the pixel and channel, dimensions of the path vertex
+static uint sobol_index;
+static uint sobol_seed;
+static uint4 sobol_point;
+static int sobol_dimension;
 
 uint TausStep(uint z, int S1, int S2, int S3, uint M)
 {
@@ -23,11 +43,148 @@ float HybridTaus()
 	return 2.3283064365387e-10 * (rng_state.x ^ rng_state.y ^ rng_state.z ^ rng_state.w);
 }
 
+// 32 x 32 bit product without 64 bit integers, same result as MulHiLo of CA4G.Offline Randoms.h
+void MulHiLo(uint a, uint b, out uint hi, out uint lo)
+{
+	uint a0 = a & 0xFFFF, a1 = a >> 16;
+	uint b0 = b & 0xFFFF, b1 = b >> 16;
+	uint p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+	uint mid = (p00 >> 16) + (p01 & 0xFFFF) + (p10 & 0xFFFF);
+	hi = p11 + (p01 >> 16) + (p10 >> 16) + (mid >> 16);
+	lo = a * b;
+}
+
+// Philox4x32-10 (Salmon et al., Random123), 10 rounds over the counter ctr with the key
+uint4 Philox4x32(uint4 ctr, uint2 key)
+{
+	[unroll]
+	for (int r = 0; r < 10; r++)
+	{
+		uint hi0, lo0, hi1, lo1;
+		MulHiLo(0xD2511F53, ctr.x, hi0, lo0);
+		MulHiLo(0xCD9E8D57, ctr.z, hi1, lo1);
+		ctr = uint4(hi1 ^ ctr.y ^ key.x, lo1, hi0 ^ ctr.w ^ key.y, lo0);
+		key += uint2(0x9E3779B9, 0xBB67AE85);
+	}
+	return ctr;
+}
+
+// Dimension rng_state.z of the stream, a Philox block gives four of them.
+float PhiloxRandom()
+{
+	uint lane = rng_state.z & 3;
+	if (lane == 0)
+		rng_block = Philox4x32(uint4(rng_state.z >> 2, 0, rng_state.w, 0), rng_state.xy);
+	rng_state.z++;
+	uint bits = lane == 0 ? rng_block.x : lane == 1 ? rng_block.y : lane == 2 ? rng_block.z : rng_block.w;
+	return (bits >> 8) * (1.0 / 16777216.0);
+}
+
+// Integer hash (lowbias32) for the scrambling seeds
+uint HashUInt(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352D;
+	x ^= x >> 15;
+	x *= 0x846CA68B;
+	x ^= x >> 16;
+	return x;
+}
+
+uint HashCombine(uint seed, uint v)
+{
+	return HashUInt(seed ^ (v + 0x9E3779B9 + (seed << 6) + (seed >> 2)));
+}
+
+// Owen scrambling of the bits of x (most significant first) by a hash (Laine-Karras, Vegdahl)
+uint NestedUniformScramble(uint x, uint seed)
+{
+	x = reversebits(x);
+	x += seed;
+	x ^= x * 0x6C50B47C;
+	x ^= x * 0xB82F1E52;
+	x ^= x * 0xC7AFE638;
+	x ^= x * 0x8D22F6E6;
+	return reversebits(x);
+}
+
+// Generator matrices of the first four Sobol dimensions (Joe and Kuo), one column per index bit.
+static const uint SOBOL_DIRECTIONS[4][32] = {
+	{ 0x80000000, 0x40000000, 0x20000000, 0x10000000, 0x08000000, 0x04000000, 0x02000000, 0x01000000,
+	  0x00800000, 0x00400000, 0x00200000, 0x00100000, 0x00080000, 0x00040000, 0x00020000, 0x00010000,
+	  0x00008000, 0x00004000, 0x00002000, 0x00001000, 0x00000800, 0x00000400, 0x00000200, 0x00000100,
+	  0x00000080, 0x00000040, 0x00000020, 0x00000010, 0x00000008, 0x00000004, 0x00000002, 0x00000001 },
+	{ 0x80000000, 0xc0000000, 0xa0000000, 0xf0000000, 0x88000000, 0xcc000000, 0xaa000000, 0xff000000,
+	  0x80800000, 0xc0c00000, 0xa0a00000, 0xf0f00000, 0x88880000, 0xcccc0000, 0xaaaa0000, 0xffff0000,
+	  0x80008000, 0xc000c000, 0xa000a000, 0xf000f000, 0x88008800, 0xcc00cc00, 0xaa00aa00, 0xff00ff00,
+	  0x80808080, 0xc0c0c0c0, 0xa0a0a0a0, 0xf0f0f0f0, 0x88888888, 0xcccccccc, 0xaaaaaaaa, 0xffffffff },
+	{ 0x80000000, 0xc0000000, 0x60000000, 0x90000000, 0xe8000000, 0x5c000000, 0x8e000000, 0xc5000000,
+	  0x68800000, 0x9cc00000, 0xee600000, 0x55900000, 0x80680000, 0xc09c0000, 0x60ee0000, 0x90550000,
+	  0xe8808000, 0x5cc0c000, 0x8e606000, 0xc5909000, 0x6868e800, 0x9c9c5c00, 0xeeee8e00, 0x5555c500,
+	  0x8000e880, 0xc0005cc0, 0x60008e60, 0x9000c590, 0xe8006868, 0x5c009c9c, 0x8e00eeee, 0xc5005555 },
+	{ 0x80000000, 0xc0000000, 0x20000000, 0x50000000, 0xf8000000, 0x74000000, 0xa2000000, 0x93000000,
+	  0xd8800000, 0x25400000, 0x59e00000, 0xe6d00000, 0x78080000, 0xb40c0000, 0x82020000, 0xc3050000,
+	  0x208f8000, 0x51474000, 0xfbea2000, 0x75d93000, 0xa0858800, 0x914e5400, 0xdbe79e00, 0x25db6d00,
+	  0x58800080, 0xe54000c0, 0x79e00020, 0xb6d00050, 0x800800f8, 0xc00c0074, 0x200200a2, 0x50050093 }
+};
+
+// Point index of the Owen-scrambled Sobol sequence in four dimensions (Burley 2020), the index is
+// shuffled with the seed so groups of dimensions with different seeds are not correlated.
+uint4 OwenSobol4(uint index, uint seed)
+{
+	index = NestedUniformScramble(index, seed);
+	uint4 bits = 0;
+	for (int i = 0; index != 0; i++, index >>= 1)
+		if (index & 1)
+			bits ^= uint4(SOBOL_DIRECTIONS[0][i], SOBOL_DIRECTIONS[1][i], SOBOL_DIRECTIONS[2][i], SOBOL_DIRECTIONS[3][i]);
+	return uint4(
+		NestedUniformScramble(bits.x, HashCombine(seed, 0)),
+		NestedUniformScramble(bits.y, HashCombine(seed, 1)),
+		NestedUniformScramble(bits.z, HashCombine(seed, 2)),
+		NestedUniformScramble(bits.w, HashCombine(seed, 3)));
+}
+
+// The next four draws are the Sobol dimensions of the path vertex (0 is the pixel jitter, the
+// closest hit queries of a path count the next ones), further draws come from the Philox stream.
+void StartPathVertex(int vertex)
+{
+#if RANDOM_SEQUENCE == RANDOM_SEQUENCE_SOBOL
+	sobol_point = OwenSobol4(sobol_index, HashCombine(sobol_seed, vertex));
+	sobol_dimension = 0;
+#endif
+}
+
+float SobolRandom()
+{
+	if (sobol_dimension >= 4)
+		return PhiloxRandom();
+	uint bits = sobol_dimension == 0 ? sobol_point.x : sobol_dimension == 1 ? sobol_point.y : sobol_dimension == 2 ? sobol_point.z : sobol_point.w;
+	sobol_dimension++;
+	return (bits >> 8) * (1.0 / 16777216.0);
+}
+
 float random() {
+#if RANDOM_SEQUENCE == RANDOM_SEQUENCE_SOBOL
+	return SobolRandom();
+#elif RANDOM_SEQUENCE == RANDOM_SEQUENCE_PHILOX
+	return PhiloxRandom();
+#else
 	return HybridTaus();
+#endif
 }
 
 void StartRandomSeedForRay(uint2 gridDimensions, int maxBounces, uint2 raysIndex, int bounce, int frame) {
+#if RANDOM_SEQUENCE != RANDOM_SEQUENCE_HYBRIDTAUS
+	// Counter-based, the stream is ready without warm-up draws
+	uint pixel = raysIndex.x + raysIndex.y * gridDimensions.x;
+	rng_state = uint4(pixel, frame, 0, bounce);
+#if RANDOM_SEQUENCE == RANDOM_SEQUENCE_SOBOL
+	// the samples of a channel are the points frame / SOBOL_PASSES_PER_SAMPLE
+	sobol_index = frame / SOBOL_PASSES_PER_SAMPLE;
+	sobol_seed = HashCombine(HashUInt(pixel), frame % SOBOL_PASSES_PER_SAMPLE);
+	StartPathVertex(0);
+#endif
+#else
 	uint index = 0;
 	uint dim = 1;
 	index += raysIndex.x * dim;
@@ -42,14 +199,21 @@ void StartRandomSeedForRay(uint2 gridDimensions, int maxBounces, uint2 raysIndex
 
 	for (int i = 0; i < 23 + index % 13; i++)
 		random();
+#endif
 }
 
+// Sobol draws resume from the Philox stream until the next StartPathVertex.
 uint4 getRNG() {
 	return rng_state;
 }
 
 void setRNG(uint4 state) {
 	rng_state = state;
+#if RANDOM_SEQUENCE != RANDOM_SEQUENCE_HYBRIDTAUS
+	if ((state.z & 3) != 0) // resumes inside a block
+		rng_block = Philox4x32(uint4(state.z >> 2, 0, state.w, 0), state.xy);
+	sobol_dimension = 4;
+#endif
 }
 
 float3 randomHSDirection(float3 N, out float NdotD)
@@ -131,6 +295,66 @@ float4 BM_4() {
 	return float4(r.x * float2(cos(t.x), sin(t.x)), r.y * float2(cos(t.y), sin(t.y)));
 }
 
+// Standard normal of u in [0, 1) with 24 bits (moved to the center of its cell), sqrt(2) erfinv(2u - 1)
+// with the single precision erfinv of Giles, max abs error 5e-7.
+float InverseNormalCDF(float u)
+{
+	float x = 2 * u - 1 + 1.0 / 16777216.0;
+	float w = -log((1 - x) * (1 + x));
+	float p;
+	if (w < 5)
+	{
+		w -= 2.5;
+		p = 2.81022636e-08;
+		p = 3.43273939e-07 + p * w;
+		p = -3.5233877e-06 + p * w;
+		p = -4.39150654e-06 + p * w;
+		p = 0.00021858087 + p * w;
+		p = -0.00125372503 + p * w;
+		p = -0.00417768164 + p * w;
+		p = 0.246640727 + p * w;
+		p = 1.50140941 + p * w;
+	}
+	else
+	{
+		w = sqrt(w) - 3;
+		p = -0.000200214257;
+		p = 0.000100950558 + p * w;
+		p = 0.00134934322 + p * w;
+		p = -0.00367342844 + p * w;
+		p = 0.00573950773 + p * w;
+		p = -0.0076224613 + p * w;
+		p = 0.00943887047 + p * w;
+		p = 1.00167406 + p * w;
+		p = 2.83297682 + p * w;
+	}
+	return 1.41421356 * p * x;
+}
+
+// Sobol draws the normals by the inverse cdf, one dimension each, so they keep the stratification.
+#if RANDOM_SEQUENCE == RANDOM_SEQUENCE_SOBOL
+float randomStdNormal() {
+	return InverseNormalCDF(random());
+}
+
+float2 randomStdNormal2() {
+	float a = randomStdNormal();
+	return float2(a, randomStdNormal());
+}
+
+float3 randomStdNormal3() {
+	float a = randomStdNormal();
+	float b = randomStdNormal();
+	return float3(a, b, randomStdNormal());
+}
+
+float4 randomStdNormal4() {
+	float a = randomStdNormal();
+	float b = randomStdNormal();
+	float c = randomStdNormal();
+	return float4(a, b, c, randomStdNormal());
+}
+#else
 float randomStdNormal() {
 	return BM_2().x;
 }
@@ -146,6 +370,7 @@ float2 randomStdNormal2() {
 float4 randomStdNormal4() {
 	return BM_4();
 }
+#endif
 
 float gauss(float mu = 0, float sigma = 1) {
 	return mu + sigma * randomStdNormal(); //random normal(mean,stdDev^2)
@@ -151,5 +151,40 @@ void ComputeImpulses(float3 V, Vertex surfel, Material material,
 	R.w = material.Roulette.z + R.w * material.Roulette.w;
 	T.w *= material.Roulette.w;
 }
+
+// Russian roulette on the importance of a path relative to the one of its camera ray (3 in the
+// channel of the pass or 1 in the three when shared). Below threshold the path survives with
+// probability throughput / threshold and carries its inverse, 0 never terminates. games counts
+// the roulettes played (x) and the paths they ended (y).
+bool RussianRoulette(inout float3 importance, float threshold, inout uint2 games)
+{
+	float throughput = (importance.x + importance.y + importance.z) / 3;
+	if (throughput >= threshold)
+		return true;
+	games.x++;
+	float survival = throughput / threshold;
+	if (random() >= survival)
+	{
+		games.y++;
+		return false;
+	}
+	importance /= survival;
+	return true;
+}
+
+// Absorption at a medium collision, false if the path is absorbed. With NON_ANALOG_ABSORPTION
+// the path scatters and its importance carries the albedo of every channel, so the medium
+// roulette ends the walks instead. Otherwise the hero survives with probability albedo[hero] and
+// SpectralSurvival or SharedSurvival update the other channels.
+bool MediumAbsorption(inout float3 importance, float3 albedo, int hero)
+{
+#if NON_ANALOG_ABSORPTION
+	importance *= albedo;
+	return true;
+#else
+	return random() < albedo[hero];
+#endif
+}
+
 #endif // !SCATTERING_TOOLS_H
 
@@ -0,0 +1,111 @@
+#ifndef SHARED_PATH_H
+#define SHARED_PATH_H
+
+// Shared-path sampling of the three color channels (SHARED_PATH_MEDIA in Parameters.h).
+// The hero channel (NumberOfPasses % 3) takes every sampling decision exactly as the single
+// channel tracer does, the other channels follow the same path carrying in importance the ratio
+// between their pdf and the hero pdf (free flights, absorption and phase function).
+// In gray media all ratios are 1 and one path converges the three channels at once.
+// CVAE events have no pdf to build a ratio with, so a path reaching a non gray medium collapses
+// to the hero channel with weight 3, which is the single channel estimator again.
+// Needs HGPhaseFunction.h.
+
+#ifndef SHARED_PATH_MEDIA
+#define SHARED_PATH_MEDIA 0
+#endif
+
+#ifndef GRAY_MEDIA_TOLERANCE
+#define GRAY_MEDIA_TOLERANCE 0
+#endif
+
+#ifndef SHARED_PATH_MAX_SPREAD
+#define SHARED_PATH_MAX_SPREAD 0.25
+#endif
+
+float3 StartChannelImportance(int hero, out bool shared) {
+	float3 importance = 0;
+#if SHARED_PATH_MEDIA
+	shared = true;
+	importance = 1;
+#else
+	shared = false;
+	importance[hero] = 3;
+#endif
+	return importance;
+}
+
+// Continues only with the hero channel.
+void CollapseToHero(inout float3 importance, inout bool shared, int hero) {
+	if (!shared)
+		return;
+	float h = importance[hero] * 3;
+	importance = 0;
+	importance[hero] = h;
+	shared = false;
+}
+
+float HighestChannel(float3 v) {
+	return max(v.x, max(v.y, v.z));
+}
+
+float LowestChannel(float3 v) {
+	return min(v.x, min(v.y, v.z));
+}
+
+// Channels differ less than tolerance (relative to the largest one for extinction and albedo).
+// The test is the same for every hero, a path collapsing only for some heroes would weight the
+// channels differently from pass to pass and bias them.
+bool IsGrayMedium(VolumeMaterial m, float tolerance) {
+	return
+		HighestChannel(m.Extinction) - LowestChannel(m.Extinction) <= tolerance * HighestChannel(m.Extinction) &&
+		HighestChannel(m.ScatteringAlbedo) - LowestChannel(m.ScatteringAlbedo) <= tolerance * HighestChannel(m.ScatteringAlbedo) &&
+		HighestChannel(m.G) - LowestChannel(m.G) <= tolerance;
+}
+
+// Before sampling a flight in medium m. Ratio weights of channels far from the hero have a
+// huge variance (and can not exist if the hero has no extinction or albedo where another
+// channel has), beyond SHARED_PATH_MAX_SPREAD (below 1) the path collapses.
+void BeginMediumFlight(inout float3 importance, inout bool shared, VolumeMaterial m, int hero) {
+	if (shared && !IsGrayMedium(m, SHARED_PATH_MAX_SPREAD))
+		CollapseToHero(importance, shared, hero);
+}
+
+// Before a CVAE event in medium m.
+// A GRAY_MEDIA_TOLERANCE above 0 lets CVAE events be shared in near gray media at the cost of a small bias.
+void BeginMediumEvent(inout float3 importance, inout bool shared, VolumeMaterial m, int hero) {
+	if (shared && !IsGrayMedium(m, GRAY_MEDIA_TOLERANCE))
+		CollapseToHero(importance, shared, hero);
+}
+
+// The flight sampled with the hero extinction passed a distance d without collision.
+void SharedTransmittance(inout float3 importance, bool shared, float3 sigma, int hero, float d) {
+	if (shared)
+		importance *= exp(-(sigma - sigma[hero]) * d);
+}
+
+// The flight sampled with the hero extinction collided at distance t.
+void SharedCollision(inout float3 importance, bool shared, float3 sigma, int hero, float t) {
+	if (shared)
+		importance *= sigma / sigma[hero] * exp(-(sigma - sigma[hero]) * t);
+}
+
+// The hero survived the absorption test (probability albedo[hero]), nothing was sampled when
+// MediumAbsorption is non-analog (NON_ANALOG_ABSORPTION).
+void SharedSurvival(inout float3 importance, bool shared, float3 albedo, int hero) {
+#if !NON_ANALOG_ABSORPTION
+	if (shared)
+		importance *= albedo / albedo[hero];
+#endif
+}
+
+float3 EvalPhaseChannels(float3 G, float3 D, float3 L) {
+	return float3(EvalPhase(G.x, D, L), EvalPhase(G.y, D, L), EvalPhase(G.z, D, L));
+}
+
+// The direction L was sampled from D with the hero phase function.
+void SharedPhase(inout float3 importance, bool shared, float3 G, int hero, float3 D, float3 L) {
+	if (shared)
+		importance *= EvalPhaseChannels(G, D, L) / EvalPhase(G[hero], D, L);
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SPECTRAL_PATH_H
+#define SPECTRAL_PATH_H
+
+// Spectral MIS of the three color channels in Pathtracing_RT and NEEPathtracing_RT
+// (SPECTRAL_PATHTRACING in Parameters.h). The hero channel (NumberOfPasses % 3) takes every
+// sampling decision, every channel gets a share of the path. Over three passes each channel
+// is the hero once, so a path is weighted with the balance heuristic over the three hero pdfs:
+// f_c / (sum_k p_k / 3). importance carries f_c / p_hero and pdfs p_k / p_hero, both divided by
+// the mean of pdfs at every event, so importance is always the weighted estimate (at most 3)
+// and no long walk overflows. Surfaces sample the same direction for all channels, their
+// ratios (SurfelScattering) leave pdfs as they are.
+// Unlike SharedPath.h no path collapses to the hero, chromatic media only lower the weights of
+// the channels the hero samples poorly. Needs HGPhaseFunction.h.
+
+#ifndef SPECTRAL_PATHTRACING
+#define SPECTRAL_PATHTRACING 0
+#endif
+
+float3 StartSpectralImportance(int hero, out float3 pdfs) {
+	pdfs = 1;
+	float3 importance = 0;
+#if SPECTRAL_PATHTRACING
+	importance = 1;
+#else
+	importance[hero] = 3;
+#endif
+	return importance;
+}
+
+// A medium event whose pdf ratios p_k / p_hero (equal to f_k / p_hero, media are sampled
+// analogly) are ratio.
+void SpectralEvent(inout float3 importance, inout float3 pdfs, float3 ratio) {
+#if SPECTRAL_PATHTRACING
+	float3 next = pdfs * ratio;
+	float mean = (next.x + next.y + next.z) / 3;
+	importance *= ratio / mean;
+	pdfs = next / mean;
+#endif
+}
+
+// The flight sampled with the hero extinction passed a distance d without collision.
+void SpectralTransmittance(inout float3 importance, inout float3 pdfs, float3 sigma, int hero, float d) {
+	SpectralEvent(importance, pdfs, exp(-(sigma - sigma[hero]) * d));
+}
+
+// The flight sampled with the hero extinction collided at distance t.
+void SpectralCollision(inout float3 importance, inout float3 pdfs, float3 sigma, int hero, float t) {
+	SpectralEvent(importance, pdfs, sigma / sigma[hero] * exp(-(sigma - sigma[hero]) * t));
+}
+
+// The hero survived the absorption test (probability albedo[hero]), nothing was sampled when
+// MediumAbsorption is non-analog (NON_ANALOG_ABSORPTION).
+void SpectralSurvival(inout float3 importance, inout float3 pdfs, float3 albedo, int hero) {
+#if !NON_ANALOG_ABSORPTION
+	SpectralEvent(importance, pdfs, albedo / albedo[hero]);
+#endif
+}
+
+// The direction L was sampled from D with the hero phase function.
+void SpectralPhase(inout float3 importance, inout float3 pdfs, float3 G, int hero, float3 D, float3 L) {
+#if SPECTRAL_PATHTRACING
+	float3 phases = float3(EvalPhase(G.x, D, L), EvalPhase(G.y, D, L), EvalPhase(G.z, D, L));
+	SpectralEvent(importance, pdfs, phases / phases[hero]);
+#endif
+}
+
+#endif
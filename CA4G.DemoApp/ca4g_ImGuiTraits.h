@@ -5,6 +5,11 @@ void GuiFor(gObj<CA4G::IShowComplexity> t) {
 	ImGui::SliderFloat("Pathtracing", &t->PathtracingRatio, 0, 1);
 }
 
+void GuiFor(gObj<CA4G::IReportTables> t) {
+	if (t->TableStatus[0])
+		ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "Tables not loaded:\n%s", t->TableStatus);
+}
+
 int selectedMaterial = 0;
 
 void GuiFor(gObj<CA4G::IManageScene> t) {
@@ -585,6 +585,14 @@ public:
 
 	CA4G::string FileName;
 
+	// Texels of the last saved texture (getElementSize bytes each)
+	byte* Data = nullptr;
+	int DataSize = 0;
+
+	~ImageSavingTechnique() {
+		delete[] Data;
+	}
+
 	void OnLoad() {
 	}
 
@@ -596,14 +604,18 @@ public:
 		__dispatch member_collector(CopyImageFromGPU);
 		__create FlushAndSignal().WaitFor();
 
+		int dataSize = TextureToSave->Width * TextureToSave->Height * TextureToSave->getElementSize();
+		if (dataSize != DataSize) {
+			delete[] Data;
+			Data = new byte[dataSize];
+			DataSize = dataSize;
+		}
+		TextureToSave _copy ToPtr(Data);
+
 		FILE* writting;
 		if (fopen_s(&writting, FileName.c_str(), "wb") != 0)
 			return;
-
-		int dataSize = TextureToSave->Width * TextureToSave->Height * TextureToSave->getElementSize();
-		byte* data = new byte[dataSize];
-		TextureToSave _copy ToPtr((byte*)data);
-		fwrite((void*)data, 1, dataSize, writting);
+		fwrite((void*)Data, 1, dataSize, writting);
 		fclose(writting);
 	}
 };
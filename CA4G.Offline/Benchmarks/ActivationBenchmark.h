@@ -0,0 +1,143 @@
+#ifndef OFFLINE_ACTIVATIONBENCHMARK_H
+#define OFFLINE_ACTIVATIONBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Activations.h"
+#include "../Common/Parallel.h"
+#include "../Common/Randoms.h"
+#include "../CVAE/CVAEBatchInference.h"
+
+// The formula used by the networks before the activation tiers, kept as a reference.
+static void SoftplusLegacy(const float* x, float* y, int count) {
+	for (int i = 0; i < count; i++)
+		y[i] = logf(1 + expf(x[i]));
+}
+
+// Error report and throughput of every activation tier, alone and inside the CVAE networks.
+// Fails (exit code 1) when a tier exceeds the error bound documented in Activations.h.
+//	samples=1048576 repeat=64
+static int ActivationBenchmark(const CommandLine &args) {
+	const ActivationTier tiers[] = { ActivationTier::Exact, ActivationTier::Polynomial, ActivationTier::PiecewiseLinear };
+	// Max abs and relative errors of the tiers
+	const double bounds[3][2] = { { 1e-6, 1e-6 }, { 2e-6, 1.2e-4 }, { 3.4e-4, 1e-3 } };
+	bool withinBounds = true;
+
+	printf("Error against double precision softplus for x in [-40, 40]\n");
+	printf("  %-12s %12s %12s %12s %8s\n", "tier", "max abs", "mean abs", "max rel", "bound");
+	const int sweep = 800001;
+	std::vector<float> x(sweep), y(sweep);
+	for (int i = 0; i < sweep; i++)
+		x[i] = -40 + 80 * (i / (float)(sweep - 1));
+	for (int t = -1; t < 3; t++)
+	{
+		if (t < 0)
+			SoftplusLegacy(x.data(), y.data(), sweep);
+		else
+			Activations::Softplus(tiers[t], x.data(), y.data(), sweep);
+		double maxAbs = 0, sumAbs = 0, maxRel = 0;
+		for (int i = 0; i < sweep; i++)
+		{
+			double xd = x[i];
+			double reference = (xd > 0 ? xd : 0) + log1p(exp(-fabs(xd)));
+			double e = fabs(y[i] - reference);
+			maxAbs = e > maxAbs ? e : maxAbs;
+			sumAbs += e;
+			double rel = e / reference;
+			maxRel = rel > maxRel ? rel : maxRel;
+		}
+		bool ok = t < 0 || (maxAbs <= bounds[t][0] && maxRel <= bounds[t][1]);
+		withinBounds = withinBounds && ok;
+		printf("  %-12s %12.3e %12.3e %12.3e %8s\n", t < 0 ? "legacy" : ActivationTierName(tiers[t]), maxAbs, sumAbs / sweep, maxRel,
+			t < 0 ? "" : ok ? "ok" : "FAILED");
+	}
+
+	printf("Large |x|\n");
+	const float extremes[] = { -1e30f, -1000, -90, 90, 1000, 1e30f };
+	for (int t = -1; t < 3; t++)
+	{
+		float out[6];
+		if (t < 0)
+			SoftplusLegacy(extremes, out, 6);
+		else
+			Activations::Softplus(tiers[t], extremes, out, 6);
+		printf("  %-12s", t < 0 ? "legacy" : ActivationTierName(tiers[t]));
+		for (int i = 0; i < 6; i++)
+			printf(" sp(%g)=%g", extremes[i], out[i]);
+		printf("\n");
+	}
+
+	int count = (int)args.Int("samples", 1 << 20);
+	int repeat = (int)args.Int("repeat", 64);
+	RandomGenerator rng(1);
+	x.resize(count);
+	y.resize(count);
+	for (int i = 0; i < count; i++)
+		x[i] = rng.random() * 40 - 20;
+
+	printf("Throughput, single thread, %d samples x %d\n", count, repeat);
+	for (int t = -1; t < 3; t++)
+	{
+		Stopwatch watch;
+		for (int r = 0; r < repeat; r++)
+			if (t < 0)
+				SoftplusLegacy(x.data(), y.data(), count);
+			else
+				Activations::Softplus(tiers[t], x.data(), y.data(), count);
+		double seconds = watch.Seconds();
+		printf("  %-12s %10.1f Msamples/s\n", t < 0 ? "legacy" : ActivationTierName(tiers[t]), count * (double)repeat / seconds * 1e-6);
+	}
+
+	// Networks fed with plausible inputs: density in [1, 256], G in [-0.9, 0.9], logN in [0, 8], normal latents
+	int networkSamples = count / 8;
+	std::vector<float> lenIn[4], pathIn[8], lenOut[3][2], pathOut[3][6];
+	for (auto &c : lenIn) c.resize(networkSamples);
+	for (auto &c : pathIn) c.resize(networkSamples);
+	for (int t = 0; t < 3; t++) {
+		for (auto &c : lenOut[t]) c.resize(networkSamples);
+		for (auto &c : pathOut[t]) c.resize(networkSamples);
+	}
+	for (int i = 0; i < networkSamples; i++)
+	{
+		float density = 1 + rng.random() * 255;
+		float g = rng.random() * 1.8f - 0.9f;
+		lenIn[0][i] = pathIn[0][i] = density;
+		lenIn[1][i] = pathIn[1][i] = g;
+		lenIn[2][i] = rng.randomStdNormal();
+		lenIn[3][i] = rng.randomStdNormal();
+		pathIn[2][i] = rng.random() * 8;
+		for (int k = 3; k < 8; k++)
+			pathIn[k][i] = rng.randomStdNormal();
+	}
+
+	printf("CVAE networks (lenModel + pathModel), single thread, %d samples\n", networkSamples);
+	printf("  %-12s %12s %14s %14s\n", "tier", "Msamples/s", "max |dLen|", "max |dPath|");
+	for (int t = 0; t < 3; t++)
+	{
+		const float* lin[4]; float* lout[2];
+		const float* pin[8]; float* pout[6];
+		for (int k = 0; k < 4; k++) lin[k] = lenIn[k].data();
+		for (int k = 0; k < 2; k++) lout[k] = lenOut[t][k].data();
+		for (int k = 0; k < 8; k++) pin[k] = pathIn[k].data();
+		for (int k = 0; k < 6; k++) pout[k] = pathOut[t][k].data();
+
+		Stopwatch watch;
+		CVAEBatch::LenModelColumns(tiers[t], lin, lout, 0, networkSamples);
+		CVAEBatch::PathModelColumns(tiers[t], pin, pout, 0, networkSamples);
+		double seconds = watch.Seconds();
+
+		double dLen = 0, dPath = 0;
+		for (int i = 0; i < networkSamples; i++)
+		{
+			for (int k = 0; k < 2; k++)
+				dLen = fmax(dLen, fabs(lenOut[t][k][i] - lenOut[0][k][i]));
+			for (int k = 0; k < 6; k++)
+				dPath = fmax(dPath, fabs(pathOut[t][k][i] - pathOut[0][k][i]));
+		}
+		printf("  %-12s %12.3f %14.3e %14.3e\n", ActivationTierName(tiers[t]), networkSamples / seconds * 1e-6, dLen, dPath);
+	}
+	return withinBounds ? 0 : 1;
+}
+
+#endif
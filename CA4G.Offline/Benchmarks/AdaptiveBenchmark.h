@@ -0,0 +1,95 @@
+#ifndef OFFLINE_ADAPTIVEBENCHMARK_H
+#define OFFLINE_ADAPTIVEBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "../Render/RenderCommand.h"
+#include "ConvergenceBenchmark.h"
+
+// Adaptive sampling against uniform passes to the same relative error estimate: rounds, time,
+// pixel passes, the estimated error and the relative RMSE against a reference of HybridTaus
+// passes for each threshold. Both stop once the estimate of the image is below the threshold. The
+// efficiency of adaptive is 1 / (RMSE^2 time) over the one of uniform, above 1 when it pays off.
+//	technique=pt width=64 height=36 thresholds=0.2,0.1,0.05 minpasses=12 maxpasses=1536 reference=768 tile=8 threads=0
+//	epsilon=0.05 neighbourhood=1 retire=2
+//	tier=exact|polynomial|linear randoms= scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int AdaptiveBenchmark(const CommandLine &args) {
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "pt");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	settings.TileSize = (int)args.Int("tile", 8);
+	settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+	RandomSequence randoms = settings.Randoms;
+	if (!ParseRandomSequence(args.String("randoms", RandomSequenceName(randoms)), randoms)) {
+		printf("Unknown random sequence (hybridtaus, philox or sobol)\n");
+		return 1;
+	}
+	int width = (int)args.Int("width", 64), height = (int)args.Int("height", 36);
+	int referencePasses = std::max(3, (int)args.Int("reference", 768) / 3 * 3);
+	AdaptiveSettings adaptive;
+	adaptive.MinimumPasses = (int)args.Int("minpasses", adaptive.MinimumPasses);
+	adaptive.MaximumPasses = (int)args.Int("maxpasses", adaptive.MaximumPasses);
+	adaptive.Epsilon = args.Float("epsilon", adaptive.Epsilon);
+	adaptive.Neighbourhood = (int)args.Int("neighbourhood", adaptive.Neighbourhood);
+	adaptive.RetireRounds = (int)args.Int("retire", adaptive.RetireRounds);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+
+	settings.Randoms = RandomSequence::HybridTaus;
+	RenderTarget reference(width, height);
+	{
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		for (int p = 0; p < referencePasses; p++)
+			tracer.RenderPass(pool, reference);
+	}
+	settings.Randoms = randoms;
+
+	printf("Adaptive benchmark: %s %dx%d, %s randoms, tiles of %d pixels, reference of %d hybridtaus passes\n",
+		RenderTechniqueName(settings.Technique), width, height, RandomSequenceName(randoms), settings.TileSize, referencePasses);
+	printf("  %-9s %-8s %6s %10s %12s %10s %10s %10s\n", "threshold", "", "rounds", "ms", "pixel passes", "estimate", "worst tile", "RMSE");
+	for (const std::string &value : args.Strings("thresholds", "0.2,0.1,0.05")) {
+		adaptive.Threshold = (float)atof(value.c_str());
+		if (adaptive.Threshold <= 0)
+			continue;
+		double uniformPixelPasses = 0, uniformCost = 0;
+		for (int a = 0; a < 2; a++) {
+			adaptive.Adaptive = a == 1;
+			CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+			RenderTarget target(width, height);
+			AdaptiveResult result = RenderAdaptive(tracer, pool, target, adaptive);
+			double pixelPasses = 0;
+			for (uint32_t p : target.PixelPasses)
+				pixelPasses += p;
+			double rmse = sqrt(std::max(0.0, RelativeMeanSquaredError(target, reference)));
+			double cost = rmse * rmse * result.Statistics.Seconds;
+			if (a == 0) {
+				uniformPixelPasses = pixelPasses;
+				uniformCost = cost;
+			}
+			printf("  %-9.3f %-8s %6d %10.1f %12.0f %10.4f %10.4f %10.5f", adaptive.Threshold, a ? "adaptive" : "uniform",
+				result.Rounds, result.Statistics.Seconds * 1000, pixelPasses, result.Error, result.WorstTile, rmse);
+			if (a == 1)
+				printf(" (%.2fx fewer pixel passes, efficiency x%.2f)", uniformPixelPasses / std::max(1.0, pixelPasses), uniformCost / std::max(1e-12, cost));
+			printf(result.Converged ? "\n" : " not converged\n");
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef OFFLINE_ALIASSAMPLINGBENCHMARK_H
+#define OFFLINE_ALIASSAMPLINGBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include <functional>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/STFXCompressedSampler.h"
+#include "SamplerBenchmark.h"
+
+// Bin lookups per second of fn(rng) over count lookups in chunks with their own streams.
+template<typename TLookup>
+static double LookupsPerSecond(ThreadPool &pool, int count, uint32_t seed, const TLookup &fn, long long &checksum) {
+	const int chunk = 1 << 16;
+	int chunks = (count + chunk - 1) / chunk;
+	std::vector<long long> sums(chunks, 0);
+	Stopwatch watch;
+	pool.ParallelFor(chunks, 1, [&](int b, int e, int) {
+		for (int c = b; c < e; c++) {
+			RandomGenerator rng(seed + (uint32_t)c * 7919u);
+			int n = count - c * chunk < chunk ? count - c * chunk : chunk;
+			long long sum = 0;
+			for (int i = 0; i < n; i++)
+				sum += fn(rng);
+			sums[c] = sum;
+		}
+	});
+	double seconds = watch.Seconds();
+	checksum = 0;
+	for (long long s : sums)
+		checksum += s;
+	return count / seconds / pool.ThreadCount();
+}
+
+// Binary searches over the cdfs against alias tables (AliasTable.h) for the STF theta rows and
+// the STFX logN and position-direction cdfs. Tables without alias sections are skipped (add them
+// with tablealias). Rows are drawn uniformly, reads are the dependent table reads per lookup.
+// Samplers run in both modes with the same random streams, distances are of alias to cdf.
+//	stf=stf2.bin stfx=stfx.bin compressed=stfx_compressed.bin lookups=16777216 samples=262144
+//	ers=1,16 gs=0,0.875 phis=0.95,0.999 threads=0 seed=1
+static int AliasSamplingBenchmark(const CommandLine &args) {
+	int lookups = (int)args.Int("lookups", 1 << 24);
+	int count = (int)args.Int("samples", 1 << 18);
+	std::vector<float> ers = args.Floats("ers", "1,16");
+	std::vector<float> gs = args.Floats("gs", "0,0.875");
+	std::vector<float> phis = args.Floats("phis", "0.95,0.999");
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	STFTables stf;
+	bool hasSTF = stf.Load(args.String("stf", "stf2.bin").c_str()) && stf.AliasSTF;
+	STFXTables stfx;
+	bool hasSTFX = stfx.Load(args.String("stfx", "stfx.bin").c_str()) && stfx.AliasLogN && stfx.AliasXW;
+	STFXCompressedTables compressed;
+	bool hasCompressed = compressed.Load(args.String("compressed", "stfx_compressed.bin").c_str());
+	printf("Alias sampling benchmark: %d threads\n", pool.ThreadCount());
+	if (!hasSTF)
+		printf("  STF tables with alias not found, skipping STF\n");
+	if (!hasSTFX)
+		printf("  STFX tables with alias not found, skipping STFX\n");
+	if (!hasCompressed)
+		printf("  compressed STFX tables not found, skipping them\n");
+
+	struct Lookup {
+		const char* Name;
+		int Rows, Bins;
+		const float* CDF;
+		const uint32_t* Alias;
+	};
+	std::vector<Lookup> tables;
+	if (hasSTF)
+		tables.push_back({ "stf theta", (int)(stf.File.Header().Find("STF")->Count / STFTables::BINS_THETA), STFTables::BINS_THETA, stf.STF, stf.AliasSTF });
+	if (hasSTFX) {
+		tables.push_back({ "stfx logN", STFXTables::BINS_G * STFXTables::BINS_R, STFXTables::BINS_LOGN, stfx.CDF_LogN, stfx.AliasLogN });
+		tables.push_back({ "stfx xw", STFXTables::LOGN_COUNT, STFXTables::BINS_X, stfx.CDF_XW, stfx.AliasXW });
+	}
+	printf("  %-10s %6s %20s %20s %8s %8s\n", "lookups", "bins", "cdf M/s/core", "alias M/s/core", "reads", "speedup");
+	for (auto &t : tables) {
+		long long cdfSum, aliasSum;
+		// STF rows are not normalized, the search value is scaled by the row mass as the sampler does
+		double cdfRate = LookupsPerSecond(pool, lookups, seed, [&](RandomGenerator &rng) {
+			size_t start = (size_t)(rng.random() * t.Rows) * t.Bins;
+			float u = rng.random() * t.CDF[start + t.Bins - 1];
+			return (long long)(STFXSearchBin(t.CDF, start, start + t.Bins - 1, u) - start);
+		}, cdfSum);
+		double aliasRate = LookupsPerSecond(pool, lookups, seed, [&](RandomGenerator &rng) {
+			size_t start = (size_t)(rng.random() * t.Rows) * t.Bins;
+			float u0 = rng.random();
+			return (long long)SampleAlias(t.Alias + start, t.Bins, u0, rng.random());
+		}, aliasSum);
+		int reads = 0;
+		while ((1 << reads) < t.Bins)
+			reads++;
+		printf("  %-10s %6d %20.2f %20.2f %4d -> 1 %7.2fx\n", t.Name, t.Bins, cdfRate * 1e-6, aliasRate * 1e-6,
+			reads, aliasRate / cdfRate);
+	}
+
+	typedef std::function<ScatteringSample(RandomGenerator &, float, float, float, bool)> Sampler;
+	struct Mode { const char* Name; Sampler Sample; };
+	std::vector<Mode> modes;
+	if (hasSTF)
+		modes.push_back({ "stf", [&](RandomGenerator &rng, float g, float phi, float r, bool alias) { return STFSampleCosXAndW(stf, rng, g, phi, r, alias); } });
+	if (hasSTFX)
+		modes.push_back({ "stfx", [&](RandomGenerator &rng, float g, float phi, float r, bool alias) { return STFXSampleCosXAndW(stfx, rng, g, phi, r, alias); } });
+	if (hasCompressed)
+		modes.push_back({ "stfx compr.", [&](RandomGenerator &rng, float g, float phi, float r, bool alias) { return STFXCompressedSampleCosXAndW(compressed, rng, g, phi, r, alias); } });
+
+	printf("  %-12s %-22s %16s %16s %9s %9s %9s %9s\n", "samplers", "", "cdf Ms/s/core", "alias Ms/s/core", "absorbed",
+		"KS theta", "KS beta", "KS alpha");
+	for (auto &m : modes)
+		for (float er : ers)
+			for (float g : gs)
+				for (float phi : phis)
+				{
+					double seconds[2];
+					SamplerHistogram h[2];
+					for (int alias = 0; alias < 2; alias++)
+						h[alias] = RunSampler(pool, count, seed, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+							for (int i = 0; i < n; i++)
+								o[i] = m.Sample(rng, g, phi, er, alias == 1);
+						}, seconds[alias]);
+					double ks[3], emd[3];
+					for (int v = 0; v < 3; v++)
+						h[1].Distances(h[0], v, ks[v], emd[v]);
+					char name[64];
+					snprintf(name, sizeof(name), "er=%g g=%g phi=%g", er, g, phi);
+					printf("  %-12s %-22s %16.3f %16.3f %9.4f %9.4f %9.4f %9.4f\n", m.Name, name,
+						count / seconds[0] / pool.ThreadCount() * 1e-6, count / seconds[1] / pool.ThreadCount() * 1e-6,
+						h[1].AbsorptionRate(), ks[0], ks[1], ks[2]);
+				}
+	return 0;
+}
+
+#endif
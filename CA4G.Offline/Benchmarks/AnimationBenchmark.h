@@ -0,0 +1,93 @@
+#ifndef OFFLINE_ANIMATIONBENCHMARK_H
+#define OFFLINE_ANIMATIONBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include "../Render/RenderCommand.h"
+
+// Closest hits of camera rays through the centers of width x height pixels.
+static void TraceCameraRays(const RenderScene &scene, const RenderAccelerator &accelerator, int width, int height, std::vector<RenderHit> &hits) {
+	const float4x4 projectionToWorld = scene.Camera.ProjectionToWorld(width, height);
+	hits.resize(width * height);
+	for (int py = 0; py < height; py++)
+		for (int px = 0; px < width; px++) {
+			float3 O, D;
+			RenderCamera::PrimaryRay(projectionToWorld, (px + 0.5f) / width, (py + 0.5f) / height, O, D);
+			accelerator.Intersect(O, D, 100.0f, hits[py * width + px]);
+		}
+}
+
+// Time per frame of following an animated scene with RenderAccelerator::Update against building
+// the accelerator again. Instances turn around the origin as in LucyAndDrago::SetTransforms (TLAS
+// only) or the vertices of the first geometry move along their normals in a wave (BLAS refit,
+// built again when its SAH cost passes rebuild times the built one). The camera hits of the updated
+// structure are compared with the ones of a structure built for the last frame.
+//	frames=30 amplitude=0.05 rebuild=1.5 width=160 height=90 threads=0 scene=lucydrago|demo models= slices=96
+static int AnimationBenchmark(const CommandLine &args) {
+	int frames = (int)args.Int("frames", 30);
+	float amplitude = args.Float("amplitude", 0.05f), rebuild = args.Float("rebuild", 1.5f);
+	int width = (int)args.Int("width", 160), height = (int)args.Int("height", 90);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	RenderScene scene;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	if (scene.Geometries.empty()) {
+		printf("The scene has no geometries\n");
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+	printf("Animation benchmark: %d frames, %d threads\n", frames, pool.ThreadCount());
+	printf("  %-11s %12s %12s %8s %8s %10s %10s\n", "", "build ms", "update ms", "refits", "rebuilds", "SAH cost", "mismatches");
+
+	std::vector<float4x4> transforms;
+	for (const RenderInstance &instance : scene.Instances)
+		transforms.push_back(instance.Transform);
+	const RenderGeometry &wave = scene.Geometries[0];
+	std::vector<RenderVertex> vertices(scene.Vertices.begin() + wave.StartVertex, scene.Vertices.begin() + wave.StartVertex + wave.VertexCount);
+
+	const char* names[2] = { "transforms", "vertices" };
+	for (int mode = 0; mode < 2; mode++) {
+		double buildSeconds = 0, updateSeconds = 0;
+		int refits = 0, rebuilds = 0;
+		RenderAccelerator built;
+		for (int frame = 1; frame <= frames; frame++) {
+			float time = frame * 0.1f;
+			if (mode == 0) {
+				for (size_t i = 0; i + 1 < scene.Instances.size(); i++) // the last instance is the plate
+					scene.Instances[i].Transform = mul(transforms[i], Transforms::RotateY(time));
+				scene.OnUpdated(RenderSceneElement::InstanceTransforms);
+			}
+			else {
+				for (int v = 0; v < wave.VertexCount; v++)
+					scene.Vertices[wave.StartVertex + v].P = vertices[v].P + vertices[v].N * (amplitude * sinf(20 * vertices[v].P.y + 4 * time));
+				scene.OnUpdated(RenderSceneElement::Vertices, 0);
+			}
+			accelerator.Update(scene, &pool, rebuild);
+			updateSeconds += accelerator.UpdateStatistics().Seconds;
+			refits += accelerator.UpdateStatistics().Refitted;
+			rebuilds += accelerator.UpdateStatistics().Rebuilt;
+			Stopwatch watch;
+			built.Build(scene, &pool);
+			buildSeconds += watch.Seconds();
+		}
+		std::vector<RenderHit> updatedHits, builtHits;
+		TraceCameraRays(scene, accelerator, width, height, updatedHits);
+		TraceCameraRays(scene, built, width, height, builtHits);
+		int mismatches = 0;
+		for (size_t i = 0; i < updatedHits.size(); i++)
+			mismatches += updatedHits[i].Instance != builtHits[i].Instance || updatedHits[i].Triangle != builtHits[i].Triangle;
+		printf("  %-11s %12.3f %12.4f %8d %8d %10.2f %10d\n", names[mode], buildSeconds * 1000 / frames, updateSeconds * 1000 / frames,
+			refits, rebuilds, accelerator.BLASStatistics().SAHCost, mismatches);
+		printf("  %-11s %12s %12s %8s %8s %10.2f\n", "", "", "", "", "built", built.BLASStatistics().SAHCost);
+	}
+	return 0;
+}
+
+#endif
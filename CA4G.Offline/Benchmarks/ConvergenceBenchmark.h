@@ -0,0 +1,137 @@
+#ifndef OFFLINE_CONVERGENCEBENCHMARK_H
+#define OFFLINE_CONVERGENCEBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include "../Render/RenderCommand.h"
+
+// Mean over pixels and channels of the squared error of target against reference, minus the
+// variance of the mean of the reference (from its SqrAccumulation), relative to the squared mean
+// of the reference. Every pass traces one channel (a channel has passes / 3 samples) or, Spectral,
+// the three.
+static double RelativeMeanSquaredError(const RenderTarget &target, const RenderTarget &reference) {
+	double error = 0, variance = 0, mean = 0;
+	const int pixels = target.Width * target.Height;
+	const double passes = reference.Passes, samples = reference.Spectral ? passes : passes / 3.0;
+	for (int i = 0; i < pixels; i++) {
+		float3 t = target.Output(i, false), r = reference.Output(i, false);
+		for (int c = 0; c < 3; c++) {
+			double d = Channel(t, c) - Channel(r, c);
+			double sum = Channel(reference.Accumulation[i], c), squares = Channel(reference.SqrAccumulation[i], c);
+			double sampleVariance = samples > 1 ? (squares - sum * sum / samples) / (samples - 1) : 0;
+			error += d * d;
+			variance += sampleVariance * samples / (passes * passes);
+			mean += Channel(r, c);
+		}
+	}
+	mean /= pixels * 3.0;
+	return (error - variance) / (pixels * 3.0) / (mean * mean);
+}
+
+// Passes a curve of (passes, error) needs to reach target, log-log interpolated between its points
+// and extrapolated from its last two.
+static double PassesForError(const std::vector<int> &passes, const std::vector<double> &errors, double target) {
+	int n = (int)passes.size();
+	if (n < 2 || target <= 0)
+		return 0;
+	int i = 0;
+	while (i < n - 2 && errors[i + 1] > target)
+		i++;
+	if (errors[i] <= 0 || errors[i + 1] <= 0)
+		return passes[i + 1];
+	double slope = (log(errors[i + 1]) - log(errors[i])) / (log((double)passes[i + 1]) - log((double)passes[i]));
+	if (slope >= 0)
+		return passes[i + 1];
+	return passes[i] * exp((log(target) - log(errors[i])) / slope);
+}
+
+// Noise of the CPU path tracer against the passes for each random sequence: relative RMSE against
+// a reference of HybridTaus passes (independent from the sequences, its own variance removed) at
+// 3 x 2^k passes, and the passes each sequence needs to reach the noise philox (the first one)
+// has after all the passes.
+//	technique=pt width=64 height=36 passes=96 reference=384 randoms=philox,sobol spectral=0 threads=0
+//	tier=exact|polynomial|linear scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int ConvergenceBenchmark(const CommandLine &args) {
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "pt");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+	bool spectral = args.Int("spectral", settings.Spectral) != 0;
+	int width = (int)args.Int("width", 64), height = (int)args.Int("height", 36);
+	int passes = std::max(3, (int)args.Int("passes", 96) / 3 * 3);
+	int referencePasses = std::max(3, (int)args.Int("reference", 384) / 3 * 3);
+	ThreadPool pool((int)args.Int("threads", 0));
+	std::vector<RandomSequence> sequences;
+	for (const std::string &name : args.Strings("randoms", "philox,sobol")) {
+		RandomSequence sequence;
+		if (ParseRandomSequence(name, sequence))
+			sequences.push_back(sequence);
+		else
+			printf("Unknown random sequence %s, skipping it\n", name.c_str());
+	}
+	if (sequences.empty())
+		return 1;
+
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+
+	settings.Randoms = RandomSequence::HybridTaus;
+	settings.Spectral = false;
+	RenderTarget reference(width, height);
+	{
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		for (int p = 0; p < referencePasses; p++)
+			tracer.RenderPass(pool, reference);
+	}
+	settings.Spectral = spectral;
+	std::vector<int> checkpoints;
+	for (int p = 3; p <= passes; p *= 2)
+		checkpoints.push_back(p);
+
+	printf("Convergence benchmark: %s%s %dx%d, reference of %d hybridtaus passes, relative RMSE\n",
+		RenderTechniqueName(settings.Technique), spectral ? " spectral" : "", width, height, referencePasses);
+	printf("  %-8s", "passes");
+	for (RandomSequence sequence : sequences)
+		printf(" %12s", RandomSequenceName(sequence));
+	printf("\n");
+	std::vector<std::vector<double>> errors(sequences.size());
+	for (size_t s = 0; s < sequences.size(); s++) {
+		settings.Randoms = sequences[s];
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		RenderTarget target(width, height);
+		for (int checkpoint : checkpoints) {
+			while (target.Passes < checkpoint)
+				tracer.RenderPass(pool, target);
+			errors[s].push_back(sqrt(std::max(0.0, RelativeMeanSquaredError(target, reference))));
+		}
+	}
+	for (size_t k = 0; k < checkpoints.size(); k++) {
+		printf("  %-8d", checkpoints[k]);
+		for (size_t s = 0; s < sequences.size(); s++)
+			printf(" %12.5f", errors[s][k]);
+		printf("\n");
+	}
+	double target = errors[0].back();
+	printf("  passes for the RMSE %.5f of %d %s passes:", target, checkpoints.back(), RandomSequenceName(sequences[0]));
+	for (size_t s = 0; s < sequences.size(); s++) {
+		double needed = PassesForError(checkpoints, errors[s], target);
+		printf(" %s %.0f (%.2fx)", RandomSequenceName(sequences[s]), needed, needed > 0 ? checkpoints.back() / needed : 0.0);
+	}
+	printf("\n");
+	return 0;
+}
+
+#endif
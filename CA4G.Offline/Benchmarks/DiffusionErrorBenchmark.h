@@ -0,0 +1,71 @@
+#ifndef OFFLINE_DIFFUSIONERRORBENCHMARK_H
+#define OFFLINE_DIFFUSIONERRORBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/ExactSampler.h"
+#include "../Samplers/DiffusionSampler.h"
+#include "SamplerBenchmark.h"
+
+// Error of the diffusion limit (DiffusionSampler.h), the sampler of the steps beyond the STF tables
+// when MAX_SPHERE_RADIUS is above 256, against the exact random walk (delta tracking of the sphere)
+// for spheres past the tables. For every medium it reports the absorption rate of both, their
+// difference and the KS distances of the exit marginals, and checks them against the bounds
+// documented in DiffusionSampler.h. KS distances are only checked when both samplers leave with
+// minexits samples at least, thick spheres of albedo below 1 absorb almost every walk.
+// Fails (exit code 1) when a medium exceeds a bound.
+//	samples=4096 ers=256,512,1024 gs=0,0.5 phis=0.999,0.9999,0.99999 minexits=1024 threads=0
+//	seed=1
+static int DiffusionErrorBenchmark(const CommandLine &args) {
+	int count = (int)args.Int("samples", 1 << 12);
+	std::vector<float> ers = args.Floats("ers", "256,512,1024");
+	std::vector<float> gs = args.Floats("gs", "0,0.5");
+	std::vector<float> phis = args.Floats("phis", "0.999,0.9999,0.99999");
+	long long minExits = args.Int("minexits", 1024);
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ThreadPool pool((int)args.Int("threads", 0));
+	bool withinBounds = true;
+
+	printf("Diffusion limit against the exact walk: %d samples per medium, %d threads\n", count, pool.ThreadCount());
+	printf("Bounds: absorption %.3f, KS theta %.3f, KS beta and alpha %.3f\n", DIFFUSION_ABSORPTION_BOUND,
+		DIFFUSION_KS_THETA_BOUND, DIFFUSION_KS_DIRECTION_BOUND);
+	printf("  %-8s %6s %8s %10s %10s %10s %9s %9s %9s %9s %8s\n", "er", "g", "phi", "exact abs", "diff abs", "error",
+		"exits", "KS theta", "KS beta", "KS alpha", "bound");
+	for (float er : ers)
+		for (float g : gs)
+			for (float phi : phis)
+			{
+				double seconds;
+				SamplerHistogram exact = RunSampler(pool, count, seed, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+					for (int i = 0; i < n; i++)
+						o[i] = ExactSampleCosXAndW(rng, g, phi, er);
+				}, seconds);
+				SamplerHistogram diffusion = RunSampler(pool, count, seed, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+					for (int i = 0; i < n; i++)
+						o[i] = DiffusionSampleCosXAndW(rng, g, phi, er);
+				}, seconds);
+				double error = fabs(diffusion.AbsorptionRate() - exact.AbsorptionRate());
+				bool ok = error <= DIFFUSION_ABSORPTION_BOUND;
+				long long exits = exact.Samples - exact.Absorbed;
+				long long diffusionExits = diffusion.Samples - diffusion.Absorbed;
+				printf("  %-8.0f %6.3f %8.5f %10.4f %10.4f %10.4f %9lld", er, g, phi, exact.AbsorptionRate(),
+					diffusion.AbsorptionRate(), error, exits);
+				if (exits >= minExits && diffusionExits >= minExits) {
+					double ks[3], emd;
+					for (int v = 0; v < 3; v++)
+						diffusion.Distances(exact, v, ks[v], emd);
+					ok = ok && ks[0] <= DIFFUSION_KS_THETA_BOUND &&
+						ks[1] <= DIFFUSION_KS_DIRECTION_BOUND && ks[2] <= DIFFUSION_KS_DIRECTION_BOUND;
+					printf(" %9.4f %9.4f %9.4f", ks[0], ks[1], ks[2]);
+				}
+				else
+					printf(" %9s %9s %9s", "-", "-", "-");
+				printf(" %8s\n", ok ? "ok" : "FAILED");
+				withinBounds = withinBounds && ok;
+			}
+	return withinBounds ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef OFFLINE_GUIDESAMPLINGBENCHMARK_H
+#define OFFLINE_GUIDESAMPLINGBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/GuideTable.h"
+#include "../Samplers/STFXSampler.h"
+#include "AliasSamplingBenchmark.h"
+
+// Cache lines (64 bytes) of the reads of a search, added to lines.
+static int TraceSearch(const float* cdf, size_t start, int n, const uint16_t* guide, float value, std::vector<uintptr_t> &lines) {
+	int beg = 0, end = n - 1;
+	if (guide) {
+		int i = (int)(value * GUIDE_ENTRIES);
+		i = i < GUIDE_ENTRIES - 1 ? i : GUIDE_ENTRIES - 1;
+		lines.push_back((uintptr_t)(guide + i) / 64);
+		beg = guide[i];
+		if (i < GUIDE_ENTRIES - 1) {
+			lines.push_back((uintptr_t)(guide + i + 1) / 64);
+			end = guide[i + 1];
+		}
+	}
+	while (beg < end) {
+		int med = (beg + end) / 2;
+		lines.push_back((uintptr_t)(cdf + start + med) / 64);
+		if (value < cdf[start + med])
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return beg;
+}
+
+// Binary search over the 8000-bin STFX position-direction cdfs against the guided search
+// (GuideTable.h) and the alias tables (if the file has them). Tables without Guide_XW get the
+// guides built in memory. Both searches must return the same bins.
+//	lookups: bins per second per core over uniformly drawn cdfs and the reads per lookup
+//	warps: groups of 32 lanes with stratified u over one cdf, as neighbour pixels of a medium
+//	draw them. Cache lines the group reads and the groups whose bins keep the order of u.
+//	stfx=stfx.bin lookups=16777216 warps=65536 threads=0 seed=1
+static int GuideSamplingBenchmark(const CommandLine &args) {
+	int lookups = (int)args.Int("lookups", 1 << 24);
+	int warps = (int)args.Int("warps", 1 << 16);
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	std::string path = args.String("stfx", "stfx.bin");
+	STFXTables stfx;
+	if (!stfx.Load(path.c_str())) {
+		printf("Can not read %s\n", path.c_str());
+		return 1;
+	}
+	const int rows = STFXTables::LOGN_COUNT, n = STFXTables::BINS_X;
+	std::vector<uint16_t> built;
+	const uint16_t* guides = stfx.GuideXW;
+	if (!guides) {
+		printf("%s has no Guide_XW, building the guides\n", path.c_str());
+		built.resize(STFXTables::GUIDE_COUNT);
+		pool.ParallelFor(rows, 256, [&](int b, int e, int) {
+			for (int row = b; row < e; row++)
+				BuildGuideTable(stfx.CDF_XW + (size_t)row * n, n, built.data() + (size_t)row * GUIDE_ENTRIES);
+		});
+		guides = built.data();
+	}
+	printf("Guide sampling benchmark: %d threads, %d bins, %d guide entries (%.1f MB)\n", pool.ThreadCount(), n,
+		GUIDE_ENTRIES, STFXTables::GUIDE_COUNT * sizeof(uint16_t) / (double)(1 << 20));
+
+	long long searchSum, guidedSum, aliasSum = 0;
+	double searchRate = LookupsPerSecond(pool, lookups, seed, [&](RandomGenerator &rng) {
+		size_t start = (size_t)(rng.random() * rows) * n;
+		return (long long)(STFXSearchBin(stfx.CDF_XW, start, start + n - 1, rng.random()) - start);
+	}, searchSum);
+	double guidedRate = LookupsPerSecond(pool, lookups, seed, [&](RandomGenerator &rng) {
+		size_t row = (size_t)(rng.random() * rows);
+		return (long long)SearchGuided(stfx.CDF_XW, row * n, n, guides + row * GUIDE_ENTRIES, rng.random());
+	}, guidedSum);
+	double aliasRate = 0;
+	if (stfx.AliasXW)
+		aliasRate = LookupsPerSecond(pool, lookups, seed, [&](RandomGenerator &rng) {
+			size_t start = (size_t)(rng.random() * rows) * n;
+			float u0 = rng.random();
+			return (long long)SampleAlias(stfx.AliasXW + start, n, u0, rng.random());
+		}, aliasSum);
+
+	// reads per lookup and warp coherence on one thread, they do not depend on the timing
+	const int lanes = 32;
+	double reads[2] = { 0, 0 }, lines[3] = { 0, 0, 0 };
+	int ordered[3] = { 0, 0, 0 };
+	RandomGenerator rng(seed);
+	std::vector<uintptr_t> touched;
+	for (int w = 0; w < warps; w++) {
+		size_t row = (size_t)(rng.random() * rows);
+		size_t start = row * n;
+		float u[lanes], u1[lanes];
+		for (int l = 0; l < lanes; l++) {
+			u[l] = (l + rng.random()) / lanes;
+			u1[l] = rng.random();
+		}
+		for (int m = 0; m < 3; m++) {
+			if (m == 2 && !stfx.AliasXW)
+				break;
+			touched.clear();
+			int last = -1;
+			bool inOrder = true;
+			for (int l = 0; l < lanes; l++) {
+				int bin;
+				if (m == 2) {
+					int slot = std::min((int)(u[l] * n), n - 1);
+					touched.push_back((uintptr_t)(stfx.AliasXW + start + slot) / 64);
+					bin = SampleAlias(stfx.AliasXW + start, n, u[l], u1[l]);
+				}
+				else {
+					size_t before = touched.size();
+					bin = TraceSearch(stfx.CDF_XW, start, n, m == 1 ? guides + row * GUIDE_ENTRIES : nullptr, u[l], touched);
+					reads[m] += touched.size() - before;
+				}
+				inOrder &= bin >= last;
+				last = bin;
+			}
+			std::sort(touched.begin(), touched.end());
+			lines[m] += std::unique(touched.begin(), touched.end()) - touched.begin();
+			ordered[m] += inOrder;
+		}
+	}
+
+	printf("  %-8s %14s %14s %18s %14s\n", "", "M/s/core", "reads/lookup", "lines/warp (32)", "ordered warps");
+	const char* names[] = { "search", "guided", "alias" };
+	double rates[] = { searchRate, guidedRate, aliasRate };
+	for (int m = 0; m < 3; m++) {
+		if (m == 2 && !stfx.AliasXW) {
+			printf("  alias    not in %s\n", path.c_str());
+			break;
+		}
+		char readText[32] = "1";
+		if (m < 2)
+			snprintf(readText, sizeof(readText), "%.2f", reads[m] / ((double)warps * lanes));
+		printf("  %-8s %14.2f %14s %18.2f %13.1f%%\n", names[m], rates[m] * 1e-6, readText, lines[m] / warps,
+			100.0 * ordered[m] / warps);
+	}
+	printf("  guided / search: %.2fx, same bins: %s\n", guidedRate / searchRate, guidedSum == searchSum ? "yes" : "NO");
+	return guidedSum == searchSum ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef OFFLINE_RANDOMBENCHMARK_H
+#define OFFLINE_RANDOMBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include "../Common/Philox.h"
+#include "../Render/RenderCommand.h"
+
+// MulHiLo of Shaders/Tools/Randoms.h, from 16 bit halves as the shaders have no 64 bit products.
+static void ShaderMulHiLo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+	uint32_t a0 = a & 0xFFFF, a1 = a >> 16;
+	uint32_t b0 = b & 0xFFFF, b1 = b >> 16;
+	uint32_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+	uint32_t mid = (p00 >> 16) + (p01 & 0xFFFF) + (p10 & 0xFFFF);
+	hi = p11 + (p01 >> 16) + (p10 >> 16) + (mid >> 16);
+	lo = a * b;
+}
+
+// Numbers of the rays of two frames of a width x height image, dimensions per ray, as the path
+// tracers draw them with a sequence (the dimensions of the pixel jitter vertex for Sobol).
+struct RandomStreams {
+	int Width, Height, Dimensions;
+	std::vector<float> U; // [frame][pixel][dimension]
+
+	RandomStreams(int width, int height, int dimensions, RandomSequence sequence) : Width(width), Height(height), Dimensions(dimensions),
+		U((size_t)2 * width * height * dimensions) {
+		float* u = U.data();
+		for (int frame = 0; frame < 2; frame++)
+			for (int py = 0; py < height; py++)
+				for (int px = 0; px < width; px++) {
+					RandomGenerator rng = RandomGenerator::ForRay(width, height, 1, px, py, 0, frame, sequence);
+					for (int d = 0; d < dimensions; d++)
+						*u++ = rng.random();
+				}
+	}
+
+	float At(int frame, int pixel, int d) const { return U[((size_t)frame * Width * Height + pixel) * Dimensions + d]; }
+};
+
+// Deviation of a chi-square statistic from its degrees of freedom in standard deviations.
+static double ChiSquareZ(const std::vector<long long> &counts, double expected) {
+	double chi = 0;
+	for (long long c : counts)
+		chi += (c - expected) * (c - expected) / expected;
+	double dof = counts.size() - 1.0;
+	return (chi - dof) / sqrt(2 * dof);
+}
+
+// Correlation of n pairs in standard deviations from 0 (sqrt(n) times the coefficient).
+static double CorrelationZ(const std::vector<float> &a, const std::vector<float> &b) {
+	double n = (double)a.size(), ma = 0, mb = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		ma += a[i];
+		mb += b[i];
+	}
+	ma /= n;
+	mb /= n;
+	double sab = 0, saa = 0, sbb = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		sab += (a[i] - ma) * (b[i] - mb);
+		saa += (a[i] - ma) * (a[i] - ma);
+		sbb += (b[i] - mb) * (b[i] - mb);
+	}
+	return sab / sqrt(saa * sbb) * sqrt(n);
+}
+
+// Largest |z| over the dimensions of the pairs (first(p, d), second(p, d)).
+template<typename First, typename Second>
+static double WorstCorrelationZ(const RandomStreams &s, int pairs, First first, Second second) {
+	double worst = 0;
+	std::vector<float> a(pairs), b(pairs);
+	for (int d = 0; d < s.Dimensions; d++) {
+		for (int p = 0; p < pairs; p++) {
+			a[p] = first(p, d);
+			b[p] = second(p, d);
+		}
+		worst = std::max(worst, fabs(CorrelationZ(a, b)));
+	}
+	return worst;
+}
+
+// Chi-square z of the 16 x 16 cells of the points (first(p), second(p)).
+template<typename First, typename Second>
+static double PairChiSquareZ(int pairs, First first, Second second) {
+	std::vector<long long> cells(256, 0);
+	for (int p = 0; p < pairs; p++)
+		cells[std::min(15, (int)(first(p) * 16)) * 16 + std::min(15, (int)(second(p) * 16))]++;
+	return ChiSquareZ(cells, pairs / 256.0);
+}
+
+// Random sequences of StartRandomSeedForRay: HybridTaus seeded with the linear index of the ray
+// and 23 + index % 13 warm-up draws, the Philox streams and Owen-scrambled Sobol. It checks the
+// Philox rounds with the Random123 known answers, the shader MulHiLo (16 bit halves) against the
+// 64 bit one and RandomGenerator::Philox against PhiloxGenerator, then runs statistical tests over the numbers of two frames (|z| above 4 is
+// suspicious): uniformity, the 24 bits, pairs of consecutive dimensions, neighbor pixels and
+// frames with the same dimension. The throughput includes the seeding of every ray (HybridTaus
+// draws 29 numbers on average to warm up) and the CPU path tracer renders passes with each.
+//	width=256 height=256 dimensions=16 rays=4194304 draws=16 threads=0 passes=3 technique=pt
+//	scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int RandomBenchmark(const CommandLine &args) {
+	int width = (int)args.Int("width", 256), height = (int)args.Int("height", 256);
+	int dimensions = std::max(2, (int)args.Int("dimensions", 16));
+	int rays = (int)args.Int("rays", 1 << 22), draws = std::max(1, (int)args.Int("draws", 16));
+	int passes = (int)args.Int("passes", 3);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	// Known answers of philox4x32_10 in Random123 (kat_vectors)
+	const uint32_t kat[3][10] = {
+		{ 0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+		{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+		{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0, 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } };
+	int katPassed = 0;
+	for (int k = 0; k < 3; k++) {
+		uint32_t out[4];
+		Philox4x32(&kat[k][0], &kat[k][4], out);
+		katPassed += out[0] == kat[k][6] && out[1] == kat[k][7] && out[2] == kat[k][8] && out[3] == kat[k][9];
+	}
+	PhiloxGenerator words(1, 0);
+	int mulMismatches = 0;
+	for (int i = 0; i < 1 << 20; i++) {
+		uint32_t a = words.next(), b = i < 16 ? 0xFFFFFFFFu - i : words.next();
+		uint32_t hi, lo, shaderHi, shaderLo;
+		MulHiLo(a, b, hi, lo);
+		ShaderMulHiLo(a, b, shaderHi, shaderLo);
+		mulMismatches += hi != shaderHi || lo != shaderLo;
+	}
+	int streamMismatches = 0;
+	for (uint32_t key = 0; key < 1024; key++) {
+		uint32_t pixel = key * 7919u, frame = key % 5, bounce = key % 3;
+		RandomGenerator rng = RandomGenerator::Philox(pixel, frame, bounce);
+		PhiloxGenerator reference(pixel | (uint64_t)frame << 32, bounce);
+		for (int d = 0; d < 64; d++)
+			streamMismatches += rng.random() != reference.random();
+	}
+	printf("Philox4x32-10: %d/3 known answers, %d shader MulHiLo mismatches, %d stream mismatches\n", katPassed, mulMismatches, streamMismatches);
+
+	printf("Random benchmark: %dx%d rays of 2 frames, %d dimensions, |z| of the tests\n", width, height, dimensions);
+	printf("  %-10s %10s %10s %10s %10s %10s %10s\n", "", "uniform", "bits", "dims d,d+1", "pixels", "frames", "pixel pairs");
+	const int pixels = width * height;
+	const RandomSequence sequences[3] = { RandomSequence::HybridTaus, RandomSequence::Philox, RandomSequence::Sobol };
+	for (RandomSequence sequence : sequences) {
+		RandomStreams s(width, height, dimensions, sequence);
+		std::vector<long long> bins(256, 0);
+		std::vector<long long> ones(24, 0);
+		for (float u : s.U) {
+			bins[std::min(255, (int)(u * 256))]++;
+			uint32_t bits = (uint32_t)(u * 16777216.0f);
+			for (int b = 0; b < 24; b++)
+				ones[b] += (bits >> b) & 1;
+		}
+		double bitZ = 0, n = (double)s.U.size();
+		for (int b = 0; b < 24; b++)
+			bitZ = std::max(bitZ, fabs((ones[b] - n / 2) / sqrt(n / 4)));
+		double dimsZ = 0;
+		for (int d = 0; d + 1 < dimensions; d++)
+			dimsZ = std::max(dimsZ, fabs(PairChiSquareZ(pixels * 2,
+				[&](int p) { return s.At(p / pixels, p % pixels, d); }, [&](int p) { return s.At(p / pixels, p % pixels, d + 1); })));
+		double pixelZ = WorstCorrelationZ(s, pixels - 1, [&](int p, int d) { return s.At(0, p, d); }, [&](int p, int d) { return s.At(0, p + 1, d); });
+		double frameZ = WorstCorrelationZ(s, pixels, [&](int p, int d) { return s.At(0, p, d); }, [&](int p, int d) { return s.At(1, p, d); });
+		double pairZ = 0;
+		for (int d = 0; d < dimensions; d++)
+			pairZ = std::max(pairZ, fabs(PairChiSquareZ(pixels - 1, [&](int p) { return s.At(0, p, d); }, [&](int p) { return s.At(0, p + 1, d); })));
+		printf("  %-10s %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", RandomSequenceName(sequence),
+			fabs(ChiSquareZ(bins, n / 256)), bitZ, dimsZ, pixelZ, frameZ, pairZ);
+	}
+
+	printf("Throughput: %d rays seeded and %d numbers drawn per ray, %d threads\n", rays, draws, pool.ThreadCount());
+	printf("  %-10s %14s %14s %10s\n", "", "Mrandoms/s", "warm-up/ray", "mean");
+	for (RandomSequence sequence : sequences) {
+		std::vector<double> sums(pool.ThreadCount(), 0);
+		Stopwatch watch;
+		pool.ParallelFor(rays, 4096, [&](int b, int e, int thread) {
+			float sum = 0;
+			for (int i = b; i < e; i++) {
+				RandomGenerator rng = RandomGenerator::ForRay(1920, 1080, 1, i % 1920, (i / 1920) % 1080, 0, i / (1920 * 1080), sequence);
+				for (int d = 0; d < draws; d++)
+					sum += rng.random();
+			}
+			sums[thread] += sum;
+		});
+		double seconds = watch.Seconds(), total = 0;
+		for (double v : sums)
+			total += v;
+		printf("  %-10s %14.1f %14.1f %10.4f\n", RandomSequenceName(sequence), (double)rays * draws / seconds * 1e-6,
+			sequence == RandomSequence::HybridTaus ? 23 + 6.0 : 0.0, total / ((double)rays * draws));
+	}
+
+	if (passes <= 0)
+		return 0;
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "pt");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	printf("CPU path tracer: %s 160x90, %d passes\n", RenderTechniqueName(settings.Technique), passes);
+	printf("  %-10s %10s %10s %12s\n", "", "ms/pass", "Mpaths/s", "mean");
+	for (RandomSequence sequence : sequences) {
+		settings.Randoms = sequence;
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		RenderTarget target(160, 90);
+		RenderStatistics total;
+		for (int p = 0; p < passes; p++)
+			total.Add(tracer.RenderPass(pool, target));
+		float3 mean(0, 0, 0);
+		for (int i = 0; i < 160 * 90; i++)
+			mean = mean + target.Output(i, false) * (1.0f / (160 * 90));
+		printf("  %-10s %10.1f %10.3f   %.4f %.4f %.4f\n", RandomSequenceName(sequence), total.Seconds * 1000 / passes,
+			total.Paths / total.Seconds * 1e-6, mean.x, mean.y, mean.z);
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef OFFLINE_RAYBENCHMARK_H
+#define OFFLINE_RAYBENCHMARK_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include "../Common/Randoms.h"
+#include "../Render/RenderCommand.h"
+
+struct RayBenchmarkRays {
+	std::vector<float3> O, D;
+};
+
+static double TraceSingleRays(ThreadPool &pool, const RenderAccelerator &accelerator, const RayBenchmarkRays &rays, std::vector<RenderHit> &hits) {
+	hits.resize(rays.O.size());
+	Stopwatch watch;
+	pool.ParallelFor((int)rays.O.size(), 1024, [&](int b, int e, int) {
+		for (int i = b; i < e; i++)
+			accelerator.Intersect(rays.O[i], rays.D[i], 100.0f, hits[i]);
+	});
+	return watch.Seconds();
+}
+
+static double TraceRayPackets(ThreadPool &pool, const RenderAccelerator &accelerator, const RayBenchmarkRays &rays, std::vector<RenderHit> &hits) {
+	const int SIZE = RenderRayPacket::SIZE;
+	hits.resize(rays.O.size());
+	Stopwatch watch;
+	pool.ParallelFor((int)rays.O.size() / SIZE, 128, [&](int b, int e, int) {
+		RenderRayPacket packet;
+		for (int p = b; p < e; p++) {
+			for (int r = 0; r < SIZE; r++) {
+				packet.O[r] = rays.O[p * SIZE + r];
+				packet.D[r] = rays.D[p * SIZE + r];
+				packet.TMax[r] = 100.0f;
+			}
+			accelerator.Intersect(packet, &hits[p * SIZE]);
+		}
+	});
+	return watch.Seconds();
+}
+
+// Closest hit throughput of the accelerator of the render commands traced one ray at a time and in
+// packets of 8, for coherent rays (camera rays of 4x2 pixel blocks) and incoherent ones (uniform
+// directions leaving the surfaces the camera sees, shuffled, as diffuse bounces). Both entry points
+// must find the same closest hits.
+//	width=640 height=360 repeat=4 threads=0 scene=lucydrago|demo models= slices=96
+static int RayBenchmark(const CommandLine &args) {
+	const int SIZE = RenderRayPacket::SIZE;
+	int width = (int)args.Int("width", 640) / 4 * 4, height = (int)args.Int("height", 360) / 2 * 2;
+	int repeat = std::max(1, (int)args.Int("repeat", 4));
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	RenderScene scene;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+
+	RayBenchmarkRays coherent, incoherent;
+	const float4x4 projectionToWorld = scene.Camera.ProjectionToWorld(width, height);
+	for (int by = 0; by < height; by += 2)
+		for (int bx = 0; bx < width; bx += 4)
+			for (int p = 0; p < SIZE; p++) {
+				float3 O, D;
+				RenderCamera::PrimaryRay(projectionToWorld, (bx + p % 4 + 0.5f) / width, (by + p / 4 + 0.5f) / height, O, D);
+				coherent.O.push_back(O);
+				coherent.D.push_back(D);
+			}
+	std::vector<RenderHit> hits, packetHits;
+	TraceSingleRays(pool, accelerator, coherent, hits);
+	RandomGenerator rng(1);
+	for (size_t i = 0; i < hits.size(); i++)
+		if (hits[i].Triangle >= 0) {
+			incoherent.O.push_back(coherent.O[i] + coherent.D[i] * (hits[i].T * 0.9999f));
+			incoherent.D.push_back(rng.randomDirection());
+		}
+	for (int i = (int)incoherent.O.size() - 1; i > 0; i--) {
+		int j = std::min(i, (int)(rng.random() * (i + 1)));
+		std::swap(incoherent.O[i], incoherent.O[j]);
+		std::swap(incoherent.D[i], incoherent.D[j]);
+	}
+	incoherent.O.resize(incoherent.O.size() / SIZE * SIZE);
+	incoherent.D.resize(incoherent.O.size());
+
+	printf("Ray benchmark: BVH%d, %d coherent and %d incoherent rays traced %d times, %d threads\n", RenderWideBVH::WIDTH,
+		(int)coherent.O.size(), (int)incoherent.O.size(), repeat, pool.ThreadCount());
+	printf("  %-10s %14s %14s %10s %10s\n", "", "single Mrays/s", "packet Mrays/s", "hits", "mismatches");
+	const RayBenchmarkRays* sets[2] = { &coherent, &incoherent };
+	const char* names[2] = { "coherent", "incoherent" };
+	for (int s = 0; s < 2; s++) {
+		double single = 0, packet = 0;
+		for (int r = 0; r < repeat; r++) {
+			single += TraceSingleRays(pool, accelerator, *sets[s], hits);
+			packet += TraceRayPackets(pool, accelerator, *sets[s], packetHits);
+		}
+		int hitCount = 0, mismatches = 0;
+		for (size_t i = 0; i < hits.size(); i++) {
+			hitCount += hits[i].Triangle >= 0;
+			mismatches += hits[i].Instance != packetHits[i].Instance || hits[i].Geometry != packetHits[i].Geometry ||
+				hits[i].Triangle != packetHits[i].Triangle;
+		}
+		double rays = (double)hits.size() * repeat;
+		printf("  %-10s %14.3f %14.3f %9.1f%% %10d\n", names[s], rays / single * 1e-6, rays / packet * 1e-6,
+			100.0 * hitCount / std::max<size_t>(1, hits.size()), mismatches);
+	}
+	return 0;
+}
+
+#endif
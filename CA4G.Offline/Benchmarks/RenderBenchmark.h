@@ -0,0 +1,60 @@
+#ifndef OFFLINE_RENDERBENCHMARK_H
+#define OFFLINE_RENDERBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include "../Render/RenderCommand.h"
+
+// Throughput of the CPU path tracer for every technique on the same scene and camera: time per
+// pass, paths and closest hit rays per second, and the work of a path (rays, MaximalRadius
+// queries and medium events). Techniques whose tables are not found are skipped.
+//	techniques=pt,stf,stfx,cvae width=160 height=90 passes=3 ptratio=0 tile=16 schedule=cost threads=0
+//	tier=exact|polynomial|linear scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int RenderBenchmark(const CommandLine &args) {
+	int width = (int)args.Int("width", 160), height = (int)args.Int("height", 90);
+	int passes = (int)args.Int("passes", 3);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	RenderScene scene;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+	printf("Render benchmark: %dx%d, %d passes, %d threads\n", width, height, passes, pool.ThreadCount());
+	printf("  %-6s %10s %10s %10s %10s %10s %10s\n", "", "ms/pass", "Mpaths/s", "Mrays/s", "rays", "radius", "events");
+
+	RenderTables tables;
+	for (const std::string &name : args.Strings("techniques", "pt,stf,stfx,cvae")) {
+		RenderSettings settings;
+		if (!ParseRenderTechnique(name, settings.Technique)) {
+			printf("  %-6s unknown technique, skipping it\n", name.c_str());
+			continue;
+		}
+		if (!tables.Load(args, settings.Technique, error)) {
+			printf("  %-6s %s, skipping it\n", name.c_str(), error.c_str());
+			continue;
+		}
+		settings.PathtracingRatio = args.Float("ptratio", 0);
+		settings.TileSize = (int)args.Int("tile", 16);
+		ParseTileSchedule(args.String("schedule", "cost"), settings.Schedule);
+		settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		RenderTarget target(width, height);
+		RenderStatistics total;
+		for (int p = 0; p < passes; p++)
+			total.Add(tracer.RenderPass(pool, target));
+		double paths = (double)(total.Paths > 0 ? total.Paths : 1);
+		printf("  %-6s %10.1f %10.3f %10.3f %10.2f %10.2f %10.2f\n", name.c_str(),
+			total.Seconds * 1000 / (passes > 0 ? passes : 1), total.Paths / total.Seconds * 1e-6, total.Rays / total.Seconds * 1e-6,
+			total.Rays / paths, total.RadiusQueries / paths, total.MediumEvents / paths);
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef OFFLINE_ROULETTEBENCHMARK_H
+#define OFFLINE_ROULETTEBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "../Render/RenderCommand.h"
+#include "ConvergenceBenchmark.h"
+
+// Russian roulette thresholds (surface:medium, 0 is off, a third field 1 absorbs non-analogly as
+// NON_ANALOG_ABSORPTION) of the CPU path tracer: time, rays and medium events per path, the
+// roulettes played and the paths they ended per event type, the relative RMSE against a reference
+// without roulette and the efficiency (1 / (RMSE^2 time)) against the first thresholds.
+//	technique=pt width=64 height=36 passes=48 reference=384 thresholds=0:0,0.25:0,0.25:1,0.25:1:1,0.25:0.5:1 threads=0
+//	tier=exact|polynomial|linear randoms= scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int RouletteBenchmark(const CommandLine &args) {
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "pt");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+	RandomSequence randoms = settings.Randoms;
+	if (!ParseRandomSequence(args.String("randoms", RandomSequenceName(randoms)), randoms)) {
+		printf("Unknown random sequence (hybridtaus, philox or sobol)\n");
+		return 1;
+	}
+	int width = (int)args.Int("width", 64), height = (int)args.Int("height", 36);
+	int passes = std::max(3, (int)args.Int("passes", 48) / 3 * 3);
+	int referencePasses = std::max(3, (int)args.Int("reference", 384) / 3 * 3);
+	ThreadPool pool((int)args.Int("threads", 0));
+	std::vector<float3> thresholds;
+	for (const std::string &triple : args.Strings("thresholds", "0:0,0.25:0,0.25:1,0.25:1:1,0.25:0.5:1")) {
+		size_t colon = triple.find(':');
+		size_t second = colon == std::string::npos ? colon : triple.find(':', colon + 1);
+		float surface = (float)atof(triple.substr(0, colon).c_str());
+		float medium = colon == std::string::npos ? surface : (float)atof(triple.substr(colon + 1).c_str());
+		float nonAnalog = second == std::string::npos ? 0 : (float)atof(triple.substr(second + 1).c_str());
+		thresholds.push_back(float3(surface, medium, nonAnalog));
+	}
+	if (thresholds.empty())
+		return 1;
+
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+
+	settings.Randoms = RandomSequence::HybridTaus;
+	settings.SurfaceRoulette = settings.MediumRoulette = 0;
+	settings.NonAnalogAbsorption = false;
+	RenderTarget reference(width, height);
+	{
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		for (int p = 0; p < referencePasses; p++)
+			tracer.RenderPass(pool, reference);
+	}
+	settings.Randoms = randoms;
+
+	printf("Roulette benchmark: %s %dx%d, %d %s passes, reference of %d hybridtaus passes without roulette\n",
+		RenderTechniqueName(settings.Technique), width, height, passes, RandomSequenceName(randoms), referencePasses);
+	printf("  %-11s %9s %8s %9s %20s %20s %9s %10s\n", "thresholds", "ms/pass", "rays", "events", "surface played/ended",
+		"medium played/ended", "RMSE", "efficiency");
+	double firstEfficiency = 0;
+	for (const float3 &t : thresholds) {
+		settings.SurfaceRoulette = t.x;
+		settings.MediumRoulette = t.y;
+		settings.NonAnalogAbsorption = t.z != 0;
+		CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+		RenderTarget target(width, height);
+		RenderStatistics total;
+		for (int p = 0; p < passes; p++)
+			total.Add(tracer.RenderPass(pool, target));
+		double paths = (double)std::max(1LL, total.Paths);
+		double rmse = sqrt(std::max(0.0, RelativeMeanSquaredError(target, reference)));
+		double efficiency = rmse > 0 && total.Seconds > 0 ? 1 / (rmse * rmse * total.Seconds) : 0;
+		if (firstEfficiency == 0)
+			firstEfficiency = efficiency;
+		char name[32], surface[32], medium[32];
+		snprintf(name, sizeof(name), t.z != 0 ? "%.3g:%.3g:1" : "%.3g:%.3g", t.x, t.y);
+		snprintf(surface, sizeof(surface), "%.4f/%.4f", total.SurfaceRoulettes / paths, total.SurfaceTerminations / paths);
+		snprintf(medium, sizeof(medium), "%.4f/%.4f", total.MediumRoulettes / paths, total.MediumTerminations / paths);
+		printf("  %-11s %9.1f %8.2f %9.2f %20s %20s %9.5f %9.2fx\n", name, total.Seconds * 1000 / passes, total.Rays / paths,
+			total.MediumEvents / paths, surface, medium, rmse, firstEfficiency > 0 ? efficiency / firstEfficiency : 0.0);
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef OFFLINE_STFXCOMPRESSIONBENCHMARK_H
+#define OFFLINE_STFXCOMPRESSIONBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/STFXCompressedSampler.h"
+#include "SamplerBenchmark.h"
+
+// Size, speed and error of the compressed STFX tables against the dense stfx.bin.
+//	error: max and mean absolute difference of the decoded cdfs (only cdfs CDF_LogN can select)
+//	lookups: position and direction bin searches per second over random (g, r, logN) cells
+//	samplers: whole STFXSampleCosXAndW with both formats and the same random streams,
+//	distances are of the compressed sampler to the dense one
+//	dense=stfx.bin compressed=stfx_compressed.bin (compressed from dense if missing)
+//	lookups=16777216 samples=262144 ers=1,4,16,64 gs=0,0.875 phis=0.95,1 threads=0 seed=1
+static int STFXCompressionBenchmark(const CommandLine &args) {
+	std::string densePath = args.String("dense", "stfx.bin"), compressedPath = args.String("compressed", "stfx_compressed.bin");
+	int lookups = (int)args.Int("lookups", 1 << 24);
+	int count = (int)args.Int("samples", 1 << 18);
+	std::vector<float> ers = args.Floats("ers", "1,4,16,64");
+	std::vector<float> gs = args.Floats("gs", "0,0.875");
+	std::vector<float> phis = args.Floats("phis", "0.95,1");
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	STFXTables dense;
+	if (!dense.Load(densePath.c_str())) {
+		printf("Can not read %s\n", densePath.c_str());
+		return 1;
+	}
+	STFXCompressedTables compressed;
+	if (!compressed.Load(compressedPath.c_str())) {
+		printf("%s not found, compressing %s\n", compressedPath.c_str(), densePath.c_str());
+		if (!compressed.Compress(densePath.c_str()))
+			return 1;
+	}
+
+	const int cdfs = STFXTables::BINS_G * STFXTables::BINS_R * STFXTables::BINS_LOGN;
+	const int X = STFXTables::BINS_X;
+	double denseBytes = (double)dense.File.Size();
+	int sparse = 0, empty = 0;
+	for (auto &c : compressed.Cells) {
+		sparse += c.Sparse();
+		empty += c.Count() == 0;
+	}
+	printf("STFX compression benchmark: %d threads\n", pool.ThreadCount());
+	printf("  size: dense %.1f MB, compressed %.1f MB (x%.1f)\n", denseBytes / (1 << 20),
+		compressed.Bytes() / (double)(1 << 20), denseBytes / compressed.Bytes());
+	printf("  cdfs: %d sparse, %d dense, %d never sampled\n", sparse, cdfs - sparse - empty, empty);
+
+	// decoded cdf at bin x is the last stored value at or before x
+	std::vector<double> maxError(pool.ThreadCount(), 0), sumError(pool.ThreadCount(), 0);
+	std::vector<long long> compared(pool.ThreadCount(), 0);
+	pool.ParallelFor(cdfs, 64, [&](int b, int e, int thread) {
+		std::vector<float> decoded(X);
+		for (int i = b; i < e; i++) {
+			const STFXCompressedCell &cell = compressed.Cells[i];
+			if (cell.Count() == 0)
+				continue;
+			const uint16_t* block = compressed.Data.data() + cell.Offset;
+			float value = 0;
+			int next = 0;
+			for (int x = 0; x < X; x++) {
+				if (cell.Sparse()) {
+					if (next < cell.Count() && block[2 * next + 1] == x)
+						value = block[2 * next++] / 65535.0f;
+				}
+				else if (x >= cell.First() && x - cell.First() < cell.Count())
+					value = block[x - cell.First()] / 65535.0f;
+				decoded[x] = value;
+			}
+			const float* cdf = dense.CDF_XW + (size_t)i * X;
+			for (int x = 0; x < X; x++) {
+				double d = fabs(decoded[x] - cdf[x]);
+				maxError[thread] = d > maxError[thread] ? d : maxError[thread];
+				sumError[thread] += d;
+			}
+			compared[thread] += X;
+		}
+	});
+	double maxE = 0, sumE = 0;
+	long long total = 0;
+	for (int t = 0; t < pool.ThreadCount(); t++) {
+		maxE = maxError[t] > maxE ? maxError[t] : maxE;
+		sumE += sumError[t];
+		total += compared[t];
+	}
+	printf("  cdf error: max %.3g, mean %.3g\n", maxE, total ? sumE / total : 0.0);
+
+	// lookups of the bin only, cells are drawn as the sampler draws them
+	for (int format = 0; format < 2; format++) {
+		const int chunk = 1 << 16;
+		int chunks = (lookups + chunk - 1) / chunk;
+		std::vector<long long> checksums(chunks, 0);
+		Stopwatch watch;
+		pool.ParallelFor(chunks, 1, [&](int b, int e, int) {
+			for (int c = b; c < e; c++) {
+				RandomGenerator rng(seed + (uint32_t)c * 7919u);
+				int n = lookups - c * chunk < chunk ? lookups - c * chunk : chunk;
+				long long sum = 0;
+				for (int i = 0; i < n; i++) {
+					size_t start = (size_t)(rng.random() * (STFXTables::BINS_G * STFXTables::BINS_R)) * STFXTables::BINS_LOGN;
+					size_t cell = STFXSearchBin(dense.CDF_LogN, start, start + STFXTables::BINS_LOGN - 1, rng.random());
+					float u = rng.random();
+					sum += format == 0 ?
+						(long long)(STFXSearchBin(dense.CDF_XW, cell * X, cell * X + X - 1, u) - cell * X) :
+						SearchCompressedCDF(compressed.Data.data(), compressed.Cells[cell], u);
+				}
+				checksums[c] = sum;
+			}
+		});
+		double seconds = watch.Seconds();
+		long long checksum = 0;
+		for (long long s : checksums)
+			checksum += s;
+		printf("  %-10s lookups %8.2f M/s/core (checksum %lld)\n", format == 0 ? "dense" : "compressed",
+			lookups / seconds / pool.ThreadCount() * 1e-6, checksum);
+	}
+
+	printf("  %-22s %16s %16s %9s %9s %9s %9s\n", "", "dense Ms/s/core", "compr. Ms/s/core", "absorbed",
+		"KS theta", "KS beta", "KS alpha");
+	for (float er : ers)
+		for (float g : gs)
+			for (float phi : phis)
+			{
+				double denseSeconds, compressedSeconds;
+				SamplerHistogram reference = RunSampler(pool, count, seed, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+					for (int i = 0; i < n; i++)
+						o[i] = STFXSampleCosXAndW(dense, rng, g, phi, er);
+				}, denseSeconds);
+				SamplerHistogram h = RunSampler(pool, count, seed, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+					for (int i = 0; i < n; i++)
+						o[i] = STFXCompressedSampleCosXAndW(compressed, rng, g, phi, er);
+				}, compressedSeconds);
+				double ks[3], emd[3];
+				for (int v = 0; v < 3; v++)
+					h.Distances(reference, v, ks[v], emd[v]);
+				char name[64];
+				snprintf(name, sizeof(name), "er=%g g=%g phi=%g", er, g, phi);
+				printf("  %-22s %16.3f %16.3f %9.4f %9.4f %9.4f %9.4f\n", name,
+					count / denseSeconds / pool.ThreadCount() * 1e-6, count / compressedSeconds / pool.ThreadCount() * 1e-6,
+					h.AbsorptionRate(), ks[0], ks[1], ks[2]);
+			}
+	return 0;
+}
+
+#endif
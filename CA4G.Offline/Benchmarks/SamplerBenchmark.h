@@ -0,0 +1,219 @@
+#ifndef OFFLINE_SAMPLERBENCHMARK_H
+#define OFFLINE_SAMPLERBENCHMARK_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/ExactSampler.h"
+#include "../Samplers/STFSampler.h"
+#include "../Samplers/STFXSampler.h"
+#include "../Samplers/CVAESampler.h"
+#include "../Samplers/DiffusionSampler.h"
+
+// Marginal distributions of the exit variables of a sampler for one medium configuration.
+struct SamplerHistogram {
+	static const int BINS = 256;
+
+	long long Samples = 0;
+	long long Absorbed = 0;
+	long long KnownN = 0; // samples whose sampler reported the number of scatterings
+	double SumN = 0;
+	// theta, beta, alpha in [-1, 1]
+	long long Bins[3][BINS] = { };
+
+	void Add(const ScatteringSample &s) {
+		Samples++;
+		if (s.N >= 0) {
+			KnownN++;
+			SumN += s.N;
+		}
+		if (s.Absorbed) {
+			Absorbed++;
+			return;
+		}
+		const float v[3] = { s.Theta, s.Beta, s.Alpha };
+		for (int i = 0; i < 3; i++)
+		{
+			int b = (int)((v[i] * 0.5f + 0.5f) * BINS);
+			Bins[i][b < 0 ? 0 : b >= BINS ? BINS - 1 : b]++;
+		}
+	}
+
+	void Add(const SamplerHistogram &h) {
+		Samples += h.Samples;
+		Absorbed += h.Absorbed;
+		KnownN += h.KnownN;
+		SumN += h.SumN;
+		for (int i = 0; i < 3; i++)
+			for (int b = 0; b < BINS; b++)
+				Bins[i][b] += h.Bins[i][b];
+	}
+
+	double AbsorptionRate() const { return Samples == 0 ? 0 : Absorbed / (double)Samples; }
+
+	// Kolmogorov-Smirnov (max cdf difference) and earth mover's distance (area between the cdfs)
+	// of variable v conditioned to exit.
+	void Distances(const SamplerHistogram &reference, int v, double &ks, double &emd) const {
+		double exited = (double)(Samples - Absorbed), referenceExited = (double)(reference.Samples - reference.Absorbed);
+		ks = emd = 0;
+		if (exited == 0 || referenceExited == 0)
+			return;
+		double cdf = 0, referenceCdf = 0;
+		for (int b = 0; b < BINS; b++)
+		{
+			cdf += Bins[v][b] / exited;
+			referenceCdf += reference.Bins[v][b] / referenceExited;
+			double d = fabs(cdf - referenceCdf);
+			ks = d > ks ? d : ks;
+			emd += d * (2.0 / BINS);
+		}
+	}
+};
+
+// Samples count outcomes of one sampler in parallel. Every chunk of samples owns a random stream
+// seeded by its index, so results do not depend on the number of threads.
+// sample(rng, output, count) fills count outcomes.
+template<typename TSample>
+static SamplerHistogram RunSampler(ThreadPool &pool, int count, uint32_t seed, const TSample &sample, double &seconds) {
+	const int chunk = 4096;
+	int chunks = (count + chunk - 1) / chunk;
+	std::vector<SamplerHistogram> perThread(pool.ThreadCount());
+	Stopwatch watch;
+	pool.ParallelFor(chunks, 1, [&](int b, int e, int threadIndex) {
+		std::vector<ScatteringSample> outcomes(chunk);
+		for (int c = b; c < e; c++)
+		{
+			RandomGenerator rng(seed + (uint32_t)c * 7919u);
+			int n = count - c * chunk < chunk ? count - c * chunk : chunk;
+			sample(rng, outcomes.data(), n);
+			for (int i = 0; i < n; i++)
+				perThread[threadIndex].Add(outcomes[i]);
+		}
+	});
+	seconds = watch.Seconds();
+	SamplerHistogram total;
+	for (auto &h : perThread)
+		total.Add(h);
+	return total;
+}
+
+// Compares the tabulated (STF, STFX) and learned (CVAE) samplers against the exact random walk
+// over a sweep of media. For every sampler it reports throughput per core, the absorption rate,
+// the mean number of scatterings (when known) and KS/EMD distances of the theta, beta and alpha
+// marginals to the exact walk. STF and STFX are skipped if their tables are not found, stf-in is
+// STF with interpolated g and phi bins and stfx-in STFX with interpolated g bins
+// (TABLE_INTERPOLATED_SAMPLING). Several versions of the
+// tables (e.g. uniform and adaptive bins, other walks) are compared side by side listing them,
+// the rows of the second one are stf#1, stf-in#1... From er 64 the diffusion limit that takes
+// over beyond the tables (DiffusionSampler.h) is compared too.
+//	samples=65536 ers=1,4,16,64 gs=0,0.5,0.875 phis=0.95,0.999 threads=0 seed=1
+//	stf=stf2.bin stfx=stfx.bin tier=exact|polynomial|linear
+static int SamplerBenchmark(const CommandLine &args) {
+	int count = (int)args.Int("samples", 1 << 16);
+	std::vector<float> ers = args.Floats("ers", "1,4,16,64");
+	std::vector<float> gs = args.Floats("gs", "0,0.5,0.875");
+	std::vector<float> phis = args.Floats("phis", "0.95,0.999");
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ActivationTier tier = ParseActivationTier(args.String("tier", "exact"));
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	// the medium of the row being measured
+	float er = 0, g = 0, phi = 0;
+	typedef std::function<void(RandomGenerator &, ScatteringSample*, int)> Sampler;
+	std::vector<std::pair<std::string, Sampler>> samplers;
+	samplers.push_back({ "exact", [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+		for (int i = 0; i < n; i++)
+			o[i] = ExactSampleCosXAndW(rng, g, phi, er);
+	} });
+	// tables stay mapped while the samplers run
+	std::vector<std::unique_ptr<STFTables>> stfs;
+	std::vector<std::unique_ptr<STFXTables>> stfxs;
+	for (const std::string &path : args.Strings("stf", "stf2.bin")) {
+		stfs.emplace_back(new STFTables());
+		const STFTables &stf = *stfs.back();
+		if (!stfs.back()->Load(path.c_str())) {
+			printf("%s is not an STF table (%s), skipping it\n", path.c_str(), stf.File.Error()[0] ? stf.File.Error() : "other kind or bins");
+			continue;
+		}
+		std::string suffix = stfs.size() > 1 ? "#" + std::to_string(stfs.size() - 1) : "";
+		printf("%-8s %s, %s, id %016llx\n", ("stf" + suffix).c_str(), path.c_str(), stf.File.Header().Kind,
+			(unsigned long long)stf.File.Header().Id());
+		samplers.push_back({ "stf" + suffix, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+			for (int i = 0; i < n; i++)
+				o[i] = STFSampleCosXAndW(stf, rng, g, phi, er);
+		} });
+		samplers.push_back({ "stf-in" + suffix, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+			for (int i = 0; i < n; i++)
+				o[i] = STFSampleCosXAndW(stf, rng, g, phi, er, false, true);
+		} });
+	}
+	for (const std::string &path : args.Strings("stfx", "stfx.bin")) {
+		stfxs.emplace_back(new STFXTables());
+		const STFXTables &stfx = *stfxs.back();
+		if (!stfxs.back()->Load(path.c_str())) {
+			printf("%s is not an STFX table (%s), skipping it\n", path.c_str(), stfx.File.Error()[0] ? stfx.File.Error() : "other kind or bins");
+			continue;
+		}
+		std::string suffix = stfxs.size() > 1 ? "#" + std::to_string(stfxs.size() - 1) : "";
+		printf("%-8s %s, %s, id %016llx\n", ("stfx" + suffix).c_str(), path.c_str(), stfx.File.Header().Kind,
+			(unsigned long long)stfx.File.Header().Id());
+		samplers.push_back({ "stfx" + suffix, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+			for (int i = 0; i < n; i++)
+				o[i] = STFXSampleCosXAndW(stfx, rng, g, phi, er);
+		} });
+		samplers.push_back({ "stfx-in" + suffix, [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+			for (int i = 0; i < n; i++)
+				o[i] = STFXSampleCosXAndW(stfx, rng, g, phi, er, false, false, true);
+		} });
+	}
+	samplers.push_back({ "cvae", [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+		CVAESampler sampler(tier);
+		sampler.Sample(rng, g, phi, er, o, n);
+	} });
+	samplers.push_back({ "diffusion", [&](RandomGenerator &rng, ScatteringSample* o, int n) {
+		for (int i = 0; i < n; i++)
+			o[i] = DiffusionSampleCosXAndW(rng, g, phi, er);
+	} });
+
+	printf("Sampler benchmark: %d samples per configuration, %d threads, CVAE with %s activations\n",
+		count, pool.ThreadCount(), ActivationTierName(tier));
+
+	for (float mediumER : ers)
+		for (float mediumG : gs)
+			for (float mediumPhi : phis)
+			{
+				er = mediumER;
+				g = mediumG;
+				phi = mediumPhi;
+				printf("er=%.2f g=%.3f phi=%.4f\n", er, g, phi);
+				printf("  %-9s %14s %10s %8s %9s %9s %9s %9s %9s %9s\n", "", "Msamples/s/core", "absorbed", "mean N",
+					"KS theta", "KS beta", "KS alpha", "EMD theta", "EMD beta", "EMD alpha");
+
+				SamplerHistogram reference;
+				for (size_t s = 0; s < samplers.size(); s++)
+				{
+					if (samplers[s].first == "diffusion" && er < 64)
+						continue;
+					double seconds = 0;
+					SamplerHistogram h = RunSampler(pool, count, seed, samplers[s].second, seconds);
+					if (s == 0) // exact
+						reference = h;
+					double ks[3], emd[3];
+					for (int v = 0; v < 3; v++)
+						h.Distances(reference, v, ks[v], emd[v]);
+					char meanN[32] = "-";
+					if (h.KnownN == h.Samples && h.Samples > 0)
+						snprintf(meanN, sizeof(meanN), "%.1f", h.SumN / h.Samples);
+					printf("  %-9s %14.3f %10.4f %8s %9.4f %9.4f %9.4f %9.4f %9.4f %9.4f\n", samplers[s].first.c_str(),
+						count / seconds / pool.ThreadCount() * 1e-6, h.AbsorptionRate(), meanN,
+						ks[0], ks[1], ks[2], emd[0], emd[1], emd[2]);
+				}
+			}
+	return 0;
+}
+
+#endif
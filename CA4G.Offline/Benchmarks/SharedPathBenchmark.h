@@ -0,0 +1,174 @@
+#ifndef OFFLINE_SHAREDPATHBENCHMARK_H
+#define OFFLINE_SHAREDPATHBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/SharedPath.h"
+#include "../Render/SpectralPath.h"
+#include "../Samplers/ExactSampler.h"
+
+// CPU reference of the UsePT branch of ComputePath for a unit sphere of an RGB medium lit by
+// the environment. Paths enter at the bottom along +z, the hero channel is i % 3 as the passes
+// of the shaders do. Returns the radiance estimate, steps gets the scattering events.
+static float3 TraceSharedPathSphere(RandomGenerator &rng, const MediumChannels &m, int hero, bool shared, float maxSpread, int &steps)
+{
+	ChannelImportance channels(hero, shared);
+	float3 x = float3(0, 0, -1);
+	float3 w = float3(0, 0, 1);
+	channels.BeginMediumFlight(m, maxSpread);
+	float sigma = m.Extinction[hero];
+	while (true)
+	{
+		float d = DistanceToSphereBoundary(x, w);
+		float t = sigma == 0 ? 100000000 : -logf(maxf(0.000000000001f, 1 - rng.random())) / sigma;
+		if (t >= d)
+		{
+			channels.Transmittance(m.Extinction, d);
+			// environment, brighter and warmer upwards
+			float up = 0.5f + 0.5f * w.z;
+			return channels.Weights() * float3(0.2f + up, 0.2f + 0.8f * up, 0.2f + 0.6f * up);
+		}
+		x = x + w * t;
+		channels.Collision(m.Extinction, t);
+		steps++;
+		if (rng.random() < 1 - m.ScatteringAlbedo[hero]) // absorption instead
+			return float3(0, 0, 0);
+		channels.Survival(m.ScatteringAlbedo);
+		float3 win = w;
+		w = ImportanceSamplePhase(rng, m.G[hero], w); // scattering event...
+		channels.Phase(m.G, win, w);
+	}
+}
+
+// TraceSharedPathSphere with the spectral MIS weights of Pathtracing_RT (SpectralPath.h) instead
+// of the hero ratios, no collapse in colored media.
+static float3 TraceSpectralPathSphere(RandomGenerator &rng, const MediumChannels &m, int hero, int &steps)
+{
+	const float3 sigma(m.Extinction[0], m.Extinction[1], m.Extinction[2]);
+	const float3 albedo(m.ScatteringAlbedo[0], m.ScatteringAlbedo[1], m.ScatteringAlbedo[2]);
+	const float3 G(m.G[0], m.G[1], m.G[2]);
+	float3 pdfs;
+	float3 importance = StartSpectralImportance(hero, true, pdfs);
+	float3 x = float3(0, 0, -1);
+	float3 w = float3(0, 0, 1);
+	while (true)
+	{
+		float d = DistanceToSphereBoundary(x, w);
+		float t = m.Extinction[hero] == 0 ? 100000000 : -logf(maxf(0.000000000001f, 1 - rng.random())) / m.Extinction[hero];
+		if (t >= d)
+		{
+			SpectralTransmittance(importance, pdfs, sigma, hero, d);
+			float up = 0.5f + 0.5f * w.z;
+			return importance * float3(0.2f + up, 0.2f + 0.8f * up, 0.2f + 0.6f * up);
+		}
+		x = x + w * t;
+		SpectralCollision(importance, pdfs, sigma, hero, t);
+		steps++;
+		if (rng.random() < 1 - m.ScatteringAlbedo[hero]) // absorption instead
+			return float3(0, 0, 0);
+		SpectralSurvival(importance, pdfs, albedo, hero);
+		float3 win = w;
+		w = ImportanceSamplePhase(rng, m.G[hero], w); // scattering event...
+		SpectralPhase(importance, pdfs, G, hero, win, w);
+	}
+}
+
+// Per channel tracing (one channel per pass, weight 3) against shared paths (one path for the
+// three channels with ratio weights) through media from gray to strongly colored.
+// Means must agree within the error. Efficiency is 1 / (variance * seconds per path).
+// Media with channels beyond spread (SHARED_PATH_MAX_SPREAD) fall back to the per channel estimator,
+// spectral MIS paths (SPECTRAL_PATHTRACING) share every medium.
+//	paths=1048576 threads=0 spread=0.25
+//	ext=8,8,8 albedo=0.99,0.99,0.99 g=0.7,0.7,0.7 (an extra medium to the presets)
+static int SharedPathBenchmark(const CommandLine &args) {
+	int count = (int)args.Int("paths", 1 << 20);
+	ThreadPool pool((int)args.Int("threads", 0));
+	float maxSpread = args.Float("spread", 0.25f);
+
+	struct Preset { const char* Name; MediumChannels Medium; };
+	std::vector<Preset> presets = {
+		{ "gray", { { 8, 8, 8 }, { 0.99f, 0.99f, 0.99f }, { 0.7f, 0.7f, 0.7f } } },
+		{ "near-gray", { { 8, 8.4f, 7.6f }, { 0.99f, 0.985f, 0.995f }, { 0.7f, 0.68f, 0.72f } } },
+		{ "colored", { { 4, 8, 16 }, { 0.99f, 0.9f, 0.7f }, { 0.8f, 0.5f, 0.2f } } },
+	};
+	std::vector<float> ext = args.Floats("ext", ""), albedo = args.Floats("albedo", ""), g = args.Floats("g", "");
+	if (ext.size() == 3 && albedo.size() == 3 && g.size() == 3)
+		presets.push_back({ "custom", { { ext[0], ext[1], ext[2] }, { albedo[0], albedo[1], albedo[2] }, { g[0], g[1], g[2] } } });
+
+	printf("Shared path benchmark: %d paths per run, %d threads, max spread %g\n", count, pool.ThreadCount(), maxSpread);
+	for (auto &preset : presets)
+	{
+		printf("%s: ext=(%g,%g,%g) albedo=(%g,%g,%g) g=(%g,%g,%g)\n", preset.Name,
+			preset.Medium.Extinction[0], preset.Medium.Extinction[1], preset.Medium.Extinction[2],
+			preset.Medium.ScatteringAlbedo[0], preset.Medium.ScatteringAlbedo[1], preset.Medium.ScatteringAlbedo[2],
+			preset.Medium.G[0], preset.Medium.G[1], preset.Medium.G[2]);
+		printf("  %-12s %26s %26s %10s %12s\n", "", "mean (r,g,b)", "std error (r,g,b)", "steps", "efficiency");
+		double reference[3] = { 0, 0, 0 }, referenceError[3] = { 0, 0, 0 }, referenceEfficiency = 0;
+		for (int mode = 0; mode < 3; mode++)
+		{
+			const int chunk = 4096;
+			int chunks = (count + chunk - 1) / chunk;
+			std::vector<double> sums(chunks * 6, 0.0);
+			std::vector<long long> steps(chunks, 0);
+			Stopwatch watch;
+			pool.ParallelFor(chunks, 1, [&](int b, int e, int) {
+				for (int c = b; c < e; c++) {
+					RandomGenerator rng((uint32_t)c * 7919u + 1);
+					int n = count - c * chunk < chunk ? count - c * chunk : chunk;
+					for (int i = 0; i < n; i++) {
+						int s = 0;
+						int hero = (c * chunk + i) % 3;
+						float3 L = mode == 2 ? TraceSpectralPathSphere(rng, preset.Medium, hero, s) :
+							TraceSharedPathSphere(rng, preset.Medium, hero, mode == 1, maxSpread, s);
+						steps[c] += s;
+						const double l[3] = { L.x, L.y, L.z };
+						for (int k = 0; k < 3; k++) {
+							sums[c * 6 + k] += l[k];
+							sums[c * 6 + 3 + k] += l[k] * l[k];
+						}
+					}
+				}
+			});
+			double seconds = watch.Seconds();
+			double mean[3], error[3], variance = 0;
+			long long totalSteps = 0;
+			for (int c = 0; c < chunks; c++)
+				totalSteps += steps[c];
+			for (int k = 0; k < 3; k++) {
+				double s = 0, s2 = 0;
+				for (int c = 0; c < chunks; c++) {
+					s += sums[c * 6 + k];
+					s2 += sums[c * 6 + 3 + k];
+				}
+				mean[k] = s / count;
+				double v = maxf(0.0f, (float)(s2 / count - mean[k] * mean[k]));
+				error[k] = sqrt(v / count);
+				variance += v / 3;
+			}
+			double efficiency = 1 / (variance * seconds * pool.ThreadCount() / count);
+			printf("  %-12s  (%7.4f, %7.4f, %7.4f)  (%7.5f, %7.5f, %7.5f) %10.2f %12.4g", mode == 0 ? "per channel" : mode == 1 ? "shared" : "spectral MIS",
+				mean[0], mean[1], mean[2], error[0], error[1], error[2], totalSteps / (double)count, efficiency);
+			if (mode == 0) {
+				for (int k = 0; k < 3; k++) {
+					reference[k] = mean[k];
+					referenceError[k] = error[k];
+				}
+				referenceEfficiency = efficiency;
+				printf("\n");
+			}
+			else {
+				double z = 0;
+				for (int k = 0; k < 3; k++) {
+					double dz = fabs(mean[k] - reference[k]) / sqrt(error[k] * error[k] + referenceError[k] * referenceError[k] + 1e-20);
+					z = dz > z ? dz : z;
+				}
+				printf("  x%.2f, max |z| %.2f\n", efficiency / referenceEfficiency, z);
+			}
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef OFFLINE_SPHERESTEPSBENCHMARK_H
+#define OFFLINE_SPHERESTEPSBENCHMARK_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/SphereMedium.h"
+#include "../Samplers/STFSampler.h"
+
+struct SphereStepsResult {
+	long long Steps = 0, MaxSteps = 0;
+	long long Reflected = 0, Transmitted = 0, Absorbed = 0;
+
+	void Add(const SphereStepsResult &o) {
+		Steps += o.Steps;
+		MaxSteps = MaxSteps > o.MaxSteps ? MaxSteps : o.MaxSteps;
+		Reflected += o.Reflected;
+		Transmitted += o.Transmitted;
+		Absorbed += o.Absorbed;
+	}
+};
+
+// Paths entering an optically thick homogeneous sphere, tracked with the medium steps of
+// ComputePath in STFPathtracing_RT.hlsl: spheres of the largest empty radius around the path,
+// capped at the radius of the row (MAX_SPHERE_RADIUS), from the STF tables up to their last
+// radius and in the diffusion limit beyond. For every cap it reports the steps per path, where
+// the paths leave (a larger cap must keep them) and the time of a frame of width x height paths.
+// Paths entering through the boundary rarely leave the outer 256 mean free paths, depth (fraction
+// of the radius below the entry point) starts them inside, as lights and deep bounces do.
+//	stf=stf2.bin er=4096 g=0.5 phi=1 depth=0 caps=256,1024,4096,16384 paths=16384 width=1280
+//	height=720 threads=0 seed=1
+static int SphereStepsBenchmark(const CommandLine &args) {
+	SphereMedium medium;
+	medium.Radius = 1;
+	medium.Extinction = args.Float("er", 4096);
+	medium.G = args.Float("g", 0.5f);
+	medium.Phi = args.Float("phi", 1);
+	float depth = clamp(args.Float("depth", 0), 0.0001f, 1.0f);
+	std::vector<float> caps = args.Floats("caps", "256,1024,4096,16384");
+	int count = (int)args.Int("paths", 1 << 14);
+	double framePaths = (double)args.Int("width", 1280) * args.Int("height", 720);
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	std::string path = args.String("stf", "stf2.bin");
+	STFTables stf;
+	if (!stf.Load(path.c_str())) {
+		printf("%s is not an STF table (%s)\n", path.c_str(), stf.File.Error()[0] ? stf.File.Error() : "other kind or bins");
+		return 1;
+	}
+	printf("Sphere steps benchmark: sphere of %.0f mean free paths, g=%.3f phi=%.4f, depth %.4f, %d paths, %d threads\n",
+		medium.Extinction, medium.G, medium.Phi, depth, count, pool.ThreadCount());
+	printf("  %-8s %12s %10s %10s %12s %12s %10s %14s\n", "cap", "steps/path", "max steps", "Mpaths/s", "reflected",
+		"transmitted", "absorbed", "ms/frame");
+
+	const float sigma = medium.Extinction;
+	for (float cap : caps) {
+		std::vector<SphereStepsResult> perThread(pool.ThreadCount());
+		Stopwatch watch;
+		pool.ParallelFor(count, 64, [&](int b, int e, int thread) {
+			SphereStepsResult &result = perThread[thread];
+			for (int i = b; i < e; i++) {
+				RandomGenerator rng(seed + (uint32_t)i);
+				float3 x = float3(0, 0, -medium.Radius * (1 - depth)), w = float3(0, 0, 1);
+				long long steps = 0;
+				while (true) {
+					steps++;
+					float er = sigma * medium.MaximalRadius(x);
+					if (er >= 1) {
+						er = minf(er, cap);
+						ScatteringSample s = STFSampleCosXAndW(stf, rng, medium.G, medium.Phi, er);
+						if (s.Absorbed) {
+							result.Absorbed++;
+							break;
+						}
+						float3 sx, sw;
+						SphereExitToWorld(rng, w, s, sx, sw);
+						x = x + sx * (er / sigma);
+						w = sw;
+						continue;
+					}
+					float d = medium.DistanceToBoundary(x, w);
+					float t = -logf(maxf(0.000000000001f, 1 - rng.random())) / sigma;
+					if (t >= d) {
+						x = x + w * d;
+						if (x.z < 0)
+							result.Reflected++;
+						else
+							result.Transmitted++;
+						break;
+					}
+					x = x + w * t; // free traverse in a medium
+					if (rng.random() < 1 - medium.Phi) { // absorption instead
+						result.Absorbed++;
+						break;
+					}
+					w = ImportanceSamplePhase(rng, medium.G, w);
+				}
+				result.Steps += steps;
+				result.MaxSteps = result.MaxSteps > steps ? result.MaxSteps : steps;
+			}
+		});
+		double seconds = watch.Seconds();
+		SphereStepsResult total;
+		for (auto &r : perThread)
+			total.Add(r);
+		printf("  %-8.0f %12.1f %10lld %10.4f %12.4f %12.4f %10.4f %14.1f\n", cap, total.Steps / (double)count, total.MaxSteps,
+			count / seconds * 1e-6, total.Reflected / (double)count, total.Transmitted / (double)count,
+			total.Absorbed / (double)count, framePaths / (count / seconds) * 1000);
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef OFFLINE_TABLELOADBENCHMARK_H
+#define OFFLINE_TABLELOADBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/STFSampler.h"
+#include "../Samplers/STFXSampler.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static double PeakResidentMB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize / (double)(1 << 20);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0; // KB on linux
+#endif
+}
+
+// Copies the sections of a mapped table to memory as the techniques did before mapping them.
+static std::vector<float> ReadTableSection(const MappedTableFile &file, const char* path, const char* name) {
+	const TableSection* s = file.Header().Find(name);
+	std::vector<float> values(s ? (size_t)s->Count : 0);
+	FILE* f = s ? OpenFile(path, "rb") : nullptr;
+	if (f) {
+		if (!SeekFile(f, s->Offset) || !ReadFloats(f, values.data(), values.size()))
+			values.clear();
+		fclose(f);
+	}
+	return values;
+}
+
+// Startup time and peak resident memory of a sampler that reads the tables from their mapping
+// (mode=map) against one that reads them into memory first (mode=read). Only one mode per run,
+// the peak is of the whole process. Samples of the configurations a scene would use follow, with
+// the mapping only their bins are paged in.
+//	table=stf|stfx file=stf2.bin|stfx.bin mode=map samples=65536 ers=1,16 gs=0.875 phis=0.95 seed=1
+static int TableLoadBenchmark(const CommandLine &args) {
+	std::string type = args.String("table", "stfx");
+	std::string path = args.String("file", type == "stf" ? "stf2.bin" : "stfx.bin");
+	bool map = args.String("mode", "map") == "map";
+	int count = (int)args.Int("samples", 1 << 16);
+	std::vector<float> ers = args.Floats("ers", "1,16");
+	std::vector<float> gs = args.Floats("gs", "0.875");
+	std::vector<float> phis = args.Floats("phis", "0.95");
+	uint32_t seed = (uint32_t)args.Int("seed", 1);
+
+	STFTables stf;
+	STFXTables stfx;
+	std::vector<float> copies[3];
+	Stopwatch watch;
+	bool ok = type == "stf" ? stf.Load(path.c_str()) : type == "stfx" ? stfx.Load(path.c_str()) : false;
+	if (ok && !map) {
+		if (type == "stf") {
+			const char* names[] = { "OneTimeSA", "MultiTimeSA", "STF" };
+			for (int i = 0; i < 3; i++)
+				copies[i] = ReadTableSection(stf.File, path.c_str(), names[i]);
+			stf.OneTimeSA = copies[0].data();
+			stf.MultiTimeSA = copies[1].data();
+			stf.STF = copies[2].data();
+		}
+		else {
+			copies[0] = ReadTableSection(stfx.File, path.c_str(), "CDF_LogN");
+			copies[1] = ReadTableSection(stfx.File, path.c_str(), "CDF_XW");
+			stfx.CDF_LogN = copies[0].data();
+			stfx.CDF_XW = copies[1].data();
+		}
+		ok = !copies[0].empty() && !copies[1].empty();
+	}
+	if (!ok) {
+		printf("Can not load %s as %s tables\n", path.c_str(), type.c_str());
+		return 1;
+	}
+	double loadSeconds = watch.Seconds();
+
+	printf("Table load benchmark: %s (%s), mode %s\n", path.c_str(), type.c_str(), map ? "map" : "read");
+	printf("  load %.3fs, peak resident %.1f MB\n", loadSeconds, PeakResidentMB());
+	for (float er : ers)
+		for (float g : gs)
+			for (float phi : phis)
+			{
+				RandomGenerator rng(seed);
+				int absorbed = 0;
+				Stopwatch sampling;
+				for (int i = 0; i < count; i++)
+					absorbed += (type == "stf" ? STFSampleCosXAndW(stf, rng, g, phi, er) : STFXSampleCosXAndW(stfx, rng, g, phi, er)).Absorbed;
+				printf("  er=%g g=%g phi=%g: %.3f Ms/s, absorbed %.4f, peak resident %.1f MB\n", er, g, phi,
+					count / sampling.Seconds() * 1e-6, absorbed / (double)count, PeakResidentMB());
+			}
+	printf("  total %.3fs\n", watch.Seconds());
+	return 0;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef OFFLINE_TILESCALINGBENCHMARK_H
+#define OFFLINE_TILESCALINGBENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include "../Render/RenderCommand.h"
+
+// Scaling of the CPU path tracer passes from 1 to maxthreads workers (doubling) for each tile
+// schedule: time per pass, speedup and efficiency against one worker, and the mean and lowest
+// utilization of the workers with the tiles they stole. The first pass has no Complexity yet, so
+// the cost schedule deals it as the stealing one.
+//	technique=stf width=320 height=180 passes=4 tile=16 maxthreads=0 schedules=shared,stealing,cost
+//	tier=exact|polynomial|linear scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int TileScalingBenchmark(const CommandLine &args) {
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "stf");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	settings.TileSize = (int)args.Int("tile", 16);
+	settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+	int width = (int)args.Int("width", 320), height = (int)args.Int("height", 180);
+	int passes = std::max(1, (int)args.Int("passes", 4));
+	int maxThreads = (int)args.Int("maxthreads", 0);
+	if (maxThreads <= 0)
+		maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	{
+		ThreadPool pool(maxThreads);
+		accelerator.Build(scene, &pool);
+	}
+	PrintBuildStatistics(scene, accelerator);
+
+	std::vector<int> threadCounts;
+	for (int t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+	std::vector<TileSchedule> schedules;
+	for (const std::string &name : args.Strings("schedules", "shared,stealing,cost")) {
+		TileSchedule schedule;
+		if (ParseTileSchedule(name, schedule))
+			schedules.push_back(schedule);
+		else
+			printf("Unknown schedule %s, skipping it\n", name.c_str());
+	}
+
+	printf("Tile scaling benchmark: %s %dx%d, %d passes, tiles of %d pixels\n", RenderTechniqueName(settings.Technique),
+		width, height, passes, settings.TileSize);
+	printf("  %-8s %7s %10s %8s %10s %10s %10s %10s\n", "", "threads", "ms/pass", "speedup", "efficiency", "mean use", "lowest use", "stolen");
+	for (TileSchedule schedule : schedules) {
+		settings.Schedule = schedule;
+		double single = 0;
+		for (int threads : threadCounts) {
+			ThreadPool pool(threads);
+			CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+			RenderTarget target(width, height);
+			double seconds = 0, mean = 0, lowest = 1;
+			int stolen = 0;
+			for (int p = 0; p < passes; p++) {
+				seconds += tracer.RenderPass(pool, target).Seconds;
+				mean += tracer.Scheduler().MeanUtilization();
+				lowest = std::min(lowest, tracer.Scheduler().MinimumUtilization());
+				stolen += tracer.Scheduler().StolenTiles();
+			}
+			if (threads == 1)
+				single = seconds;
+			double speedup = single / seconds;
+			printf("  %-8s %7d %10.1f %8.2f %9.1f%% %9.1f%% %9.1f%% %10.1f\n", TileScheduleName(schedule), threads,
+				seconds * 1000 / passes, speedup, 100 * speedup / threads, 100 * mean / passes, 100 * lowest, stolen / (double)passes);
+		}
+	}
+	return 0;
+}
+
+#endif
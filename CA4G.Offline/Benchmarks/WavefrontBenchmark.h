@@ -0,0 +1,69 @@
+#ifndef OFFLINE_WAVEFRONTBENCHMARK_H
+#define OFFLINE_WAVEFRONTBENCHMARK_H
+
+#include "../Common/CommandLine.h"
+#include "../Common/SphereMedium.h"
+#include "../CVAE/CVAEWavefront.h"
+
+// Traces the same set of paths through a sphere medium evaluating the CVAE events one by one
+// and in wavefronts of increasing width. All runs consume the same random streams so escape
+// counts have to match exactly, only throughput and the queue statistics change.
+//	paths=262144 er=64 g=0.875 phi=0.999 threads=0 widths=1,64,1024,0 (0 means whole wavefront)
+//	tier=exact|polynomial|linear (activations of the networks)
+static int WavefrontBenchmark(const CommandLine &args) {
+	SphereMedium medium;
+	medium.Radius = 1;
+	medium.Extinction = args.Float("er", 64);
+	medium.G = args.Float("g", 0.875f);
+	medium.Phi = args.Float("phi", 0.999f);
+	int count = (int)args.Int("paths", 1 << 18);
+	std::string widths = args.String("widths", "1,64,1024,0");
+	ActivationTier tier = ParseActivationTier(args.String("tier", "exact"));
+
+	ThreadPool pool((int)args.Int("threads", 0));
+	printf("CVAE wavefront benchmark: %d paths, er=%.1f g=%.3f phi=%.4f, %s activations, %d threads\n",
+		count, medium.Extinction, medium.G, medium.Phi, ActivationTierName(tier), pool.ThreadCount());
+
+	std::vector<CVAEPathState> paths(count);
+	long long referenceEscaped = -1;
+
+	size_t pos = 0;
+	while (pos <= widths.size())
+	{
+		size_t comma = widths.find(',', pos);
+		if (comma == std::string::npos)
+			comma = widths.size();
+		int width = atoi(widths.substr(pos, comma - pos).c_str());
+		pos = comma + 1;
+		if (width <= 0)
+			width = count;
+
+		for (int i = 0; i < count; i++) {
+			paths[i].X = float3(0, 0, -medium.Radius * 0.9999f);
+			paths[i].W = float3(0, 0, 1);
+			paths[i].Rng = RandomGenerator((uint32_t)i);
+			paths[i].Events = 0;
+		}
+
+		CVAEWavefrontTracer<SphereMedium> tracer(medium, &pool, tier);
+		Stopwatch watch;
+		tracer.Trace(paths, width);
+		double seconds = watch.Seconds();
+
+		long long escaped = 0, events = 0;
+		for (auto &p : paths) {
+			escaped += p.Status == CVAEPathState::Escaped;
+			events += p.Events;
+		}
+		if (referenceEscaped < 0)
+			referenceEscaped = escaped;
+
+		printf("width %d: %.3fs, %.3f Mpaths/s, %.3f Mevents/s, %.2f events/path, escaped %.4f%s\n",
+			width, seconds, count / seconds * 1e-6, events / seconds * 1e-6, events / (double)count,
+			escaped / (double)count, escaped == referenceEscaped ? "" : " (MISMATCH)");
+		tracer.Statistics().Print(stdout);
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef OFFLINE_CVAEBATCHINFERENCE_H
+#define OFFLINE_CVAEBATCHINFERENCE_H
+
+#include <cmath>
+#include "../Common/Activations.h"
+
+// Number of samples evaluated together by one call of the generated networks.
+// Every operation below is a fixed-length loop over the lanes, so the compiler keeps them in
+// SIMD registers (8 floats fill an AVX register).
+#define CVAE_BATCH_LANES 8
+
+// Batched evaluation of the generated CVAE networks on the CPU.
+// The HLSL model headers are included as they are, with every scalar replaced by a lane pack,
+// so the very same weights and topology used by the shaders run here over CVAE_BATCH_LANES samples.
+// The networks are included once per activation tier (nested namespaces Exact, Polynomial and Linear).
+namespace CVAEBatch {
+
+	struct lane {
+		float v[CVAE_BATCH_LANES];
+	};
+
+	static inline lane operator +(const lane &a, const lane &b) { lane r; for (int i = 0; i < CVAE_BATCH_LANES; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+	// a * s + acc
+	static inline lane madd(const lane &a, float s, const lane &acc) { lane r; for (int i = 0; i < CVAE_BATCH_LANES; i++) r.v[i] = a.v[i] * s + acc.v[i]; return r; }
+	static inline lane scale(const lane &a, float s) { lane r; for (int i = 0; i < CVAE_BATCH_LANES; i++) r.v[i] = a.v[i] * s; return r; }
+
+	// Only the vector shapes the generated networks use.
+	struct float1 {
+		lane x;
+	};
+	struct float2 {
+		lane x, y;
+		float2() {}
+		float2(const lane &x, const lane &y) :x(x), y(y) {}
+		float2(float x, float y) { for (int i = 0; i < CVAE_BATCH_LANES; i++) { this->x.v[i] = x; this->y.v[i] = y; } }
+		lane& operator[](int c) { return (&x)[c]; }
+	};
+	struct float3 {
+		lane x, y, z;
+	};
+	struct float4 {
+		lane x, y, z, w;
+		float4() {}
+		float4(const lane &x, const lane &y, const lane &z, const lane &w) :x(x), y(y), z(z), w(w) {}
+		float4(float x, float y, float z, float w) { for (int i = 0; i < CVAE_BATCH_LANES; i++) { this->x.v[i] = x; this->y.v[i] = y; this->z.v[i] = z; this->w.v[i] = w; } }
+		lane& operator[](int c) { return (&x)[c]; }
+		const lane& operator[](int c) const { return (&x)[c]; }
+	};
+
+	// Weights are shared by all lanes, so matrices stay scalar.
+	struct float4x4 {
+		float m[4][4];
+		float4x4(
+			float m00, float m01, float m02, float m03,
+			float m10, float m11, float m12, float m13,
+			float m20, float m21, float m22, float m23,
+			float m30, float m31, float m32, float m33) {
+			m[0][0] = m00; m[0][1] = m01; m[0][2] = m02; m[0][3] = m03;
+			m[1][0] = m10; m[1][1] = m11; m[1][2] = m12; m[1][3] = m13;
+			m[2][0] = m20; m[2][1] = m21; m[2][2] = m22; m[2][3] = m23;
+			m[3][0] = m30; m[3][1] = m31; m[3][2] = m32; m[3][3] = m33;
+		}
+	};
+	struct float4x2 {
+		float m[4][2];
+		float4x2(
+			float m00, float m01,
+			float m10, float m11,
+			float m20, float m21,
+			float m30, float m31) {
+			m[0][0] = m00; m[0][1] = m01;
+			m[1][0] = m10; m[1][1] = m11;
+			m[2][0] = m20; m[2][1] = m21;
+			m[3][0] = m30; m[3][1] = m31;
+		}
+	};
+
+	// Row vector times matrix, as HLSL mul(v, M)
+	static inline float4 mul(const float4 &a, const float4x4 &m) {
+		float4 r;
+		for (int c = 0; c < 4; c++)
+			r[c] = madd(a.w, m.m[3][c], madd(a.z, m.m[2][c], madd(a.y, m.m[1][c], scale(a.x, m.m[0][c]))));
+		return r;
+	}
+	static inline float2 mul(const float4 &a, const float4x2 &m) {
+		float2 r;
+		for (int c = 0; c < 2; c++)
+			r[c] = madd(a.w, m.m[3][c], madd(a.z, m.m[2][c], madd(a.y, m.m[1][c], scale(a.x, m.m[0][c]))));
+		return r;
+	}
+
+	static inline float4 operator +(const float4 &a, const float4 &b) { return float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+	static inline float2 operator +(const float2 &a, const float2 &b) { return float2(a.x + b.x, a.y + b.y); }
+
+	template<ActivationTier TIER>
+	static inline lane softplus(const lane &a) { lane r; for (int i = 0; i < CVAE_BATCH_LANES; i++) r.v[i] = Activations::Softplus<TIER>(a.v[i]); return r; }
+
+	// Overloads the networks expect, instead of the ones in Shaders/Tools/Activations.h
+#define CVAE_BATCH_SOFTPLUS(TIER) \
+	static inline float1 softplusActivation(const float1 &x) { return float1{ softplus<TIER>(x.x) }; } \
+	static inline float2 softplusActivation(const float2 &x) { return float2(softplus<TIER>(x.x), softplus<TIER>(x.y)); } \
+	static inline float3 softplusActivation(const float3 &x) { return float3{ softplus<TIER>(x.x), softplus<TIER>(x.y), softplus<TIER>(x.z) }; } \
+	static inline float4 softplusActivation(const float4 &x) { return float4(softplus<TIER>(x.x), softplus<TIER>(x.y), softplus<TIER>(x.z), softplus<TIER>(x.w)); }
+
+#define ACTIVATIONS_H // skips the HLSL activations included by the networks
+#define float lane
+#define out
+
+	namespace Exact {
+		CVAE_BATCH_SOFTPLUS(ActivationTier::Exact)
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/CVAEScatteringModelX.h"
+	}
+
+	namespace Polynomial {
+		CVAE_BATCH_SOFTPLUS(ActivationTier::Polynomial)
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/CVAEScatteringModelX.h"
+	}
+
+	namespace Linear {
+		CVAE_BATCH_SOFTPLUS(ActivationTier::PiecewiseLinear)
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/CVAEScatteringModelX.h"
+	}
+
+#undef out
+#undef float
+#undef ACTIVATIONS_H
+#undef CVAE_BATCH_SOFTPLUS
+
+	// Runs a network over count samples stored by columns (input[k][s] is the k-th input of sample s).
+	// The last pack is padded with the first sample of the pack.
+	template<int INPUTS, int OUTPUTS, void(*MODEL)(lane[INPUTS], lane[OUTPUTS])>
+	static void EvaluateColumns(const float* const input[INPUTS], float* const output[OUTPUTS], int start, int count) {
+		lane in[INPUTS];
+		lane o[OUTPUTS];
+		for (int s = start; s < start + count; s += CVAE_BATCH_LANES)
+		{
+			int active = start + count - s < CVAE_BATCH_LANES ? start + count - s : CVAE_BATCH_LANES;
+			for (int k = 0; k < INPUTS; k++)
+				for (int i = 0; i < CVAE_BATCH_LANES; i++)
+					in[k].v[i] = input[k][s + (i < active ? i : 0)];
+			MODEL(in, o);
+			for (int k = 0; k < OUTPUTS; k++)
+				for (int i = 0; i < active; i++)
+					output[k][s + i] = o[k].v[i];
+		}
+	}
+
+	// lenModel: (density, G, latent0, latent1) -> (mu, logVar) of logN
+	static void LenModelColumns(ActivationTier tier, const float* const input[4], float* const output[2], int start, int count) {
+		switch (tier) {
+		case ActivationTier::Polynomial: EvaluateColumns<4, 2, Polynomial::lenModel>(input, output, start, count); break;
+		case ActivationTier::PiecewiseLinear: EvaluateColumns<4, 2, Linear::lenModel>(input, output, start, count); break;
+		default: EvaluateColumns<4, 2, Exact::lenModel>(input, output, start, count); break;
+		}
+	}
+
+	// pathModel: (density, G, logN, latent0..4) -> (mu, logVar) of (costheta, wt, wb)
+	static void PathModelColumns(ActivationTier tier, const float* const input[8], float* const output[6], int start, int count) {
+		switch (tier) {
+		case ActivationTier::Polynomial: EvaluateColumns<8, 6, Polynomial::pathModel>(input, output, start, count); break;
+		case ActivationTier::PiecewiseLinear: EvaluateColumns<8, 6, Linear::pathModel>(input, output, start, count); break;
+		default: EvaluateColumns<8, 6, Exact::pathModel>(input, output, start, count); break;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,421 @@
+#ifndef OFFLINE_CVAEWAVEFRONT_H
+#define OFFLINE_CVAEWAVEFRONT_H
+
+#include <vector>
+#include <cstdio>
+#include "../Common/Randoms.h"
+#include "../Common/HGPhaseFunction.h"
+#include "../Common/Parallel.h"
+#include "CVAEBatchInference.h"
+
+// Wavefront evaluation of the CVAE medium events.
+// Paths are advanced until they reach a medium event (the point where the shader calls
+// GenerateVariablesWithModel), there they are suspended and their event is queued.
+// When the queue is flushed all pending events go through lenModel and pathModel as
+// SIMD batches, and the paths are resumed with the sampled exit position and direction.
+
+// A suspended path waiting for the network to decide its next position and direction.
+struct CVAEMediumEvent {
+	RandomGenerator* rng; // stream of the suspended path, consumed exactly like the shader does
+	float G;
+	float Phi;
+	float Density; // er (extinction times sphere radius)
+	float3 Win;
+};
+
+struct CVAEMediumResult {
+	float3 X; // exit position in the unit sphere
+	float3 W; // exit direction
+	float Scatterings; // number of scatterings sampled by lenModel
+	bool Absorbed;
+};
+
+// Counters of the queue behaviour. Depth is the number of events at flush time,
+// lane utilization is how much of the SIMD packs carried real events.
+struct CVAEWavefrontStatistics {
+	static const int DEPTH_BUCKETS = 24;
+
+	long long Flushes = 0;
+	long long Events = 0;
+	long long Absorbed = 0;
+	long long LenPacks = 0; // packs of CVAE_BATCH_LANES evaluated by lenModel
+	long long PathPacks = 0; // packs of CVAE_BATCH_LANES evaluated by pathModel
+	int MaxDepth = 0;
+	int MinDepth = 0;
+	long long DepthHistogram[DEPTH_BUCKETS] = { }; // bucket i counts flushes with depth in [2^i, 2^(i+1))
+	double InferenceSeconds = 0;
+
+	void Add(int depth, int survivors, double seconds) {
+		if (depth <= 0)
+			return;
+		MaxDepth = Flushes == 0 || depth > MaxDepth ? depth : MaxDepth;
+		MinDepth = Flushes == 0 || depth < MinDepth ? depth : MinDepth;
+		Flushes++;
+		Events += depth;
+		Absorbed += depth - survivors;
+		LenPacks += (depth + CVAE_BATCH_LANES - 1) / CVAE_BATCH_LANES;
+		PathPacks += (survivors + CVAE_BATCH_LANES - 1) / CVAE_BATCH_LANES;
+		int bucket = 0;
+		while ((2 << bucket) <= depth && bucket < DEPTH_BUCKETS - 1)
+			bucket++;
+		DepthHistogram[bucket]++;
+		InferenceSeconds += seconds;
+	}
+
+	double AverageDepth() const { return Flushes == 0 ? 0 : Events / (double)Flushes; }
+
+	double LaneUtilization() const {
+		long long lanes = (LenPacks + PathPacks) * CVAE_BATCH_LANES;
+		return lanes == 0 ? 0 : (Events + Events - Absorbed) / (double)lanes;
+	}
+
+	void Print(FILE* f) const {
+		fprintf(f, "  flushes: %lld events: %lld absorbed: %lld\n", Flushes, Events, Absorbed);
+		fprintf(f, "  queue depth avg: %.1f min: %d max: %d\n", AverageDepth(), MinDepth, MaxDepth);
+		fprintf(f, "  lane utilization: %.1f%% (%d lanes)\n", LaneUtilization() * 100, CVAE_BATCH_LANES);
+		fprintf(f, "  inference: %.3fs (%.2f Mevents/s)\n", InferenceSeconds, InferenceSeconds > 0 ? Events / InferenceSeconds * 1e-6 : 0);
+		fprintf(f, "  depth histogram:");
+		for (int i = 0; i < DEPTH_BUCKETS; i++)
+			if (DepthHistogram[i] > 0)
+				fprintf(f, " [%d+]:%lld", 1 << i, DepthHistogram[i]);
+		fprintf(f, "\n");
+	}
+};
+
+// Queue of pending medium events. Push is not thread-safe, producers in parallel phases
+// should write their events in their own slots and Push them afterwards in a fixed order
+// to keep runs reproducible.
+class CVAEMediumQueue {
+	std::vector<CVAEMediumEvent> events;
+	std::vector<CVAEMediumResult> results;
+
+	// Per event intermediate state
+	std::vector<float3> frames; // rows of the rotation to radial space, 3 per event
+	std::vector<float> scatterings;
+	std::vector<unsigned char> alive;
+	std::vector<int> survivors;
+
+	// Network inputs and outputs by columns.
+	// lenModel runs over all events, pathModel only over the survivors (compacted).
+	std::vector<float> lenIn[4], lenOut[2];
+	std::vector<float> pathIn[8], pathOut[6];
+
+	void Resize(int count) {
+		results.resize(count);
+		frames.resize(count * 3);
+		scatterings.resize(count);
+		alive.resize(count);
+		survivors.resize(count);
+		for (auto &c : lenIn) c.resize(count);
+		for (auto &c : lenOut) c.resize(count);
+	}
+
+	static float sampleNormal(RandomGenerator& rng, float mu, float logVar) {
+		return mu + rng.gauss() * expf(clamp(logVar, -16.0f, 16.0f) * 0.5f);
+	}
+
+	// Random rotation around win and length latents (first part of GenerateVariablesWithModel)
+	void PrepareLength(int i) {
+		CVAEMediumEvent &e = events[i];
+		float3 win = e.Win;
+		float3 temp = fabsf(win.x) >= 0.9999f ? float3(0, 0, 1) : float3(1, 0, 0);
+		float3 winY = normalize(cross(temp, win));
+		float3 winX = cross(win, winY);
+		float rAlpha = e.rng->random() * 2 * PI;
+		float3x3 R = mul(float3x3(
+			cosf(rAlpha), -sinf(rAlpha), 0,
+			sinf(rAlpha), cosf(rAlpha), 0,
+			0, 0, 1), float3x3(winX, winY, win));
+		frames[i * 3 + 0] = R[0];
+		frames[i * 3 + 1] = R[1];
+		frames[i * 3 + 2] = R[2];
+
+		float2 lenLatent = e.rng->randomStdNormal2();
+		lenIn[0][i] = e.Density;
+		lenIn[1][i] = e.G;
+		lenIn[2][i] = lenLatent.x;
+		lenIn[3][i] = lenLatent.y;
+	}
+
+	// Number of scatterings and absorption. Returns false if absorbed.
+	bool SampleScatterings(int i) {
+		CVAEMediumEvent &e = events[i];
+		float logN = maxf(0.0f, sampleNormal(*e.rng, lenOut[0][i], lenOut[1][i]));
+		float n = roundf(expf(logN) + 0.49f);
+		scatterings[i] = n;
+		return e.rng->random() < powf(e.Phi, n);
+	}
+
+	// Path latents of event i written in the survivor slot s.
+	void PreparePath(int i, int s) {
+		CVAEMediumEvent &e = events[i];
+		float4 pathLatent14 = e.rng->randomStdNormal4();
+		float pathLatent5 = e.rng->randomStdNormal();
+		pathIn[0][s] = e.Density;
+		pathIn[1][s] = e.G;
+		pathIn[2][s] = logf(scatterings[i]);
+		pathIn[3][s] = pathLatent14.x;
+		pathIn[4][s] = pathLatent14.y;
+		pathIn[5][s] = pathLatent14.z;
+		pathIn[6][s] = pathLatent14.w;
+		pathIn[7][s] = pathLatent5;
+	}
+
+	// Builds the exit position and direction of event i from the path model output in slot s.
+	void Finish(int i, int s) {
+		CVAEMediumEvent &e = events[i];
+		float3 sampling3 = e.rng->randomStdNormal3();
+		float n = scatterings[i];
+		// float3::operator[] is avoided, its out of range fallback is not defined in the library
+		const float sampling[3] = { sampling3.x, sampling3.y, sampling3.z };
+		float pathOutput[3];
+		for (int c = 0; c < 3; c++)
+			pathOutput[c] = clamp(pathOut[c][s] + expf(clamp(pathOut[c + 3][s], -16.0f, 16.0f) * 0.5f) * sampling[c], -0.9999f, 0.9999f);
+		float costheta = pathOutput[0];
+		float wt = n > 1 ? pathOutput[1] : 0.0f; // only if n > 1
+		float wb = n > 2 ? pathOutput[2] : 0.0f; // only if n > 2
+
+		float3 x = float3(0, sqrtf(1 - costheta * costheta), costheta);
+		float3 N = x;
+		float3 B = float3(1, 0, 0);
+		float3 T = cross(x, B);
+
+		float3 w = normalize(N * sqrtf(maxf(0.0f, 1 - wt * wt - wb * wb)) + T * wt + B * wb);
+		float3x3 R = float3x3(frames[i * 3 + 0], frames[i * 3 + 1], frames[i * 3 + 2]);
+		results[i].X = mul(x, R);
+		results[i].W = mul(w, R);
+		results[i].Absorbed = false;
+	}
+
+public:
+	CVAEWavefrontStatistics Statistics;
+
+	// Accuracy of the network activations used on the next flushes.
+	ActivationTier Tier = ActivationTier::Exact;
+
+	int Count() const { return (int)events.size(); }
+
+	int Push(const CVAEMediumEvent &e) {
+		events.push_back(e);
+		return (int)events.size() - 1;
+	}
+
+	const CVAEMediumResult& Result(int ticket) const { return results[ticket]; }
+
+	// Evaluates all pending events. Results are valid until the next Flush.
+	// pool can be null for a single threaded evaluation.
+	void Flush(ThreadPool* pool) {
+		int count = (int)events.size();
+		if (count == 0)
+			return;
+		Resize(count);
+
+		Stopwatch watch;
+		auto parallel = [&](int n, int grain, const std::function<void(int, int, int)> &body) {
+			if (pool)
+				pool->ParallelFor(n, grain, body);
+			else
+				body(0, n, 0);
+		};
+		// grain is kept multiple of the lanes so packs are never split between workers
+		const int grain = CVAE_BATCH_LANES * 32;
+
+		parallel(count, grain, [&](int b, int e, int) {
+			for (int i = b; i < e; i++)
+				PrepareLength(i);
+			const float* in[4] = { lenIn[0].data(), lenIn[1].data(), lenIn[2].data(), lenIn[3].data() };
+			float* out[2] = { lenOut[0].data(), lenOut[1].data() };
+			CVAEBatch::LenModelColumns(Tier, in, out, b, e - b);
+		});
+
+		parallel(count, grain, [&](int b, int e, int) {
+			for (int i = b; i < e; i++)
+				alive[i] = SampleScatterings(i);
+		});
+
+		// Absorbed events are compacted away so pathModel packs stay full.
+		int survivorCount = 0;
+		for (int i = 0; i < count; i++) {
+			results[i].Scatterings = scatterings[i];
+			if (alive[i])
+				survivors[survivorCount++] = i;
+			else
+				results[i].Absorbed = true;
+		}
+
+		for (auto &c : pathIn) c.resize(survivorCount);
+		for (auto &c : pathOut) c.resize(survivorCount);
+		parallel(survivorCount, grain, [&](int b, int e, int) {
+			for (int s = b; s < e; s++)
+				PreparePath(survivors[s], s);
+			const float* in[8];
+			float* out[6];
+			for (int c = 0; c < 8; c++) in[c] = pathIn[c].data();
+			for (int c = 0; c < 6; c++) out[c] = pathOut[c].data();
+			CVAEBatch::PathModelColumns(Tier, in, out, b, e - b);
+			for (int s = b; s < e; s++)
+				Finish(survivors[s], s);
+		});
+
+		Statistics.Add(count, survivorCount, watch.Seconds());
+	}
+
+	// Drops the evaluated events, results are no longer accessible.
+	void Clear() {
+		events.clear();
+	}
+};
+
+// State of a path walking inside a medium.
+struct CVAEPathState {
+	float3 X, W;
+	RandomGenerator Rng;
+	int Ticket; // pending event in the queue, -1 if the path is not suspended
+	int Events; // number of medium events (CVAE and single scattering) so far
+	enum State { Active, Suspended, Escaped, Absorbed } Status;
+};
+
+// Tracks paths inside a medium with the same logic of ComputePath (CVAE branch) but evaluating
+// the medium events of many paths at once.
+// TMedium must provide:
+//	float MaximalRadius(const float3 &x)  radius of the largest empty sphere around x inside the medium.
+//	float DistanceToBoundary(const float3 &x, const float3 &w)
+//	float Extinction, G, Phi
+template<typename TMedium>
+class CVAEWavefrontTracer {
+	const TMedium &medium;
+	ThreadPool* pool;
+	CVAEMediumQueue queue;
+
+	// Advances a path until it escapes, gets absorbed or needs the network.
+	// pending gets the event to be queued when the path is suspended.
+	void Advance(CVAEPathState &p, CVAEMediumEvent &pending) const {
+		const float sigma = medium.Extinction;
+		while (true)
+		{
+			float r = medium.MaximalRadius(p.X);
+			float er = sigma * r;
+			if (er >= 1)
+			{
+				float t = -logf(1 - p.Rng.random()) / sigma;
+				if (t < r) // Some scattering in sphere
+				{
+					p.X = p.X + p.W * t; // move to scatter position
+					// compute sphere radius again
+					r = medium.MaximalRadius(p.X);
+					er = sigma * r;
+					pending.rng = &p.Rng;
+					pending.G = medium.G;
+					pending.Phi = medium.Phi;
+					pending.Density = er;
+					pending.Win = p.W;
+					p.Status = CVAEPathState::Suspended;
+					return;
+				}
+				p.X = p.X + p.W * r; // free flight
+			}
+			else
+			{
+				float d = medium.DistanceToBoundary(p.X, p.W);
+				float t = -logf(maxf(0.000000000001f, 1 - p.Rng.random())) / sigma;
+				if (t >= d)
+				{
+					p.X = p.X + p.W * d;
+					p.Status = CVAEPathState::Escaped;
+					return;
+				}
+				p.X = p.X + p.W * t; // free traverse in a medium
+				p.Events++;
+				if (p.Rng.random() < 1 - medium.Phi) // absorption instead
+				{
+					p.Status = CVAEPathState::Absorbed;
+					return;
+				}
+				p.W = ImportanceSamplePhase(p.Rng, medium.G, p.W); // scattering event...
+			}
+		}
+	}
+
+	void Resume(CVAEPathState &p) const {
+		const CVAEMediumResult &res = queue.Result(p.Ticket);
+		p.Ticket = -1;
+		p.Events++;
+		if (res.Absorbed)
+		{
+			p.Status = CVAEPathState::Absorbed;
+			return;
+		}
+		float r = medium.MaximalRadius(p.X);
+		p.W = res.W;
+		p.X = p.X + res.X * r;
+		p.Status = CVAEPathState::Active;
+	}
+
+public:
+	CVAEWavefrontTracer(const TMedium &medium, ThreadPool* pool, ActivationTier tier = ActivationTier::Exact) :medium(medium), pool(pool) {
+		queue.Tier = tier;
+	}
+
+	const CVAEWavefrontStatistics& Statistics() const { return queue.Statistics; }
+
+	// Traces all paths to completion. Active paths are advanced in parallel until they suspend,
+	// then suspended paths are queued in path order (keeping runs reproducible), flushed and resumed
+	// in groups of at most maxQueue events (the wavefront width). maxQueue 1 evaluates every event alone.
+	void Trace(std::vector<CVAEPathState> &paths, int maxQueue) {
+		int count = (int)paths.size();
+		std::vector<CVAEMediumEvent> pending(count);
+		std::vector<int> waiting, next;
+		waiting.reserve(count);
+		next.reserve(count);
+
+		auto parallel = [&](int n, int grain, const std::function<void(int, int, int)> &body) {
+			if (pool)
+				pool->ParallelFor(n, grain, body);
+			else
+				body(0, n, 0);
+		};
+
+		for (auto &p : paths) {
+			p.Ticket = -1;
+			p.Status = CVAEPathState::Active;
+		}
+
+		parallel(count, 256, [&](int b, int e, int) {
+			for (int i = b; i < e; i++)
+				Advance(paths[i], pending[i]);
+		});
+		for (int i = 0; i < count; i++)
+			if (paths[i].Status == CVAEPathState::Suspended)
+				waiting.push_back(i);
+
+		while (!waiting.empty())
+		{
+			next.clear();
+			for (size_t start = 0; start < waiting.size(); start += maxQueue)
+			{
+				size_t end = start + maxQueue < waiting.size() ? start + maxQueue : waiting.size();
+				for (size_t k = start; k < end; k++)
+					paths[waiting[k]].Ticket = queue.Push(pending[waiting[k]]);
+				queue.Flush(pool);
+
+				parallel((int)(end - start), 256, [&](int b, int e, int) {
+					for (int k = b; k < e; k++)
+					{
+						int i = waiting[start + k];
+						Resume(paths[i]);
+						if (paths[i].Status == CVAEPathState::Active)
+							Advance(paths[i], pending[i]);
+					}
+				});
+				queue.Clear();
+
+				for (size_t k = start; k < end; k++)
+					if (paths[waiting[k]].Status == CVAEPathState::Suspended)
+						next.push_back(waiting[k]);
+			}
+			waiting.swap(next);
+		}
+	}
+};
+
+#endif
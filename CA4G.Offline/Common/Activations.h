@@ -0,0 +1,135 @@
+#ifndef OFFLINE_ACTIVATIONS_H
+#define OFFLINE_ACTIVATIONS_H
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <string>
+
+// CPU counterpart of Shaders/Tools/Activations.h, the shaders evaluate the piecewise linear tier
+// as the polynomial one.
+// All tiers compute softplus(x) = log(1 + exp(x)) as max(x, 0) + log(1 + exp(-|x|)) so large |x| never overflows.
+// Functions are branch free, loops over arrays of them are vectorized by the compiler.
+
+enum class ActivationTier {
+	// Full precision transcendentals.
+	Exact = 0,
+	// exp2 and log1p by polynomials, max abs error 2e-6 and max relative error 1.2e-4.
+	Polynomial = 1,
+	// Piecewise linear, a slope and offset table over 64 segments and the exact formula below
+	// x = -3, max abs error 3.4e-4 and max relative error 1e-3.
+	PiecewiseLinear = 2
+};
+
+static const char* ActivationTierName(ActivationTier tier) {
+	switch (tier) {
+	case ActivationTier::Polynomial: return "polynomial";
+	case ActivationTier::PiecewiseLinear: return "linear";
+	default: return "exact";
+	}
+}
+
+static ActivationTier ParseActivationTier(const std::string &name) {
+	if (name == "polynomial" || name == "1")
+		return ActivationTier::Polynomial;
+	if (name == "linear" || name == "2")
+		return ActivationTier::PiecewiseLinear;
+	return ActivationTier::Exact;
+}
+
+namespace Activations {
+
+	// 2^t for t <= 0, flushed to zero below 2^-126
+	static inline float FastExp2(float t) {
+		float c = t < -126.0f ? -126.0f : t;
+		float i = floorf(c);
+		float f = c - i;
+		float p = 0.999999927f + f * (0.693152968f + f * (0.240154531f + f * (0.0558236014f + f * (0.00899258757f + f * 0.0018762315f))));
+		int32_t bits = ((int32_t)i + 127) << 23;
+		float scale;
+		memcpy(&scale, &bits, sizeof(float));
+		return t < -126.0f ? 0.0f : p * scale;
+	}
+
+	// log(1 + u) for u in [0, 1]
+	static inline float Log1pUnit(float u) {
+		return u * (0.999888916f + u * (-0.497702963f + u * (0.316877881f + u * (-0.192238615f + u * (0.0841986622f + u * -0.0178779012f)))));
+	}
+
+	static inline float SoftplusExact(float x) {
+		return fmaxf(x, 0.0f) + log1pf(expf(-fabsf(x)));
+	}
+
+	static inline float SoftplusPolynomial(float x) {
+		return fmaxf(x, 0.0f) + Log1pUnit(FastExp2(-fabsf(x) * 1.44269504f));
+	}
+
+	// Chords of log(1 + exp(-t)) on SOFTPLUS_SEGMENTS segments of 1 / SOFTPLUS_SCALE over [0, 8],
+	// lowered by half their largest gap so the error is below 2.5e-4 on both sides. The entry past
+	// the last segment is 0 for t >= 8 (where the function is below 3.4e-4). Below
+	// -SOFTPLUS_LINEAR_CUTOFF softplus is the exact formula, where an absolute error would be a
+	// large relative one: max abs error 3.4e-4 and max relative error 1e-3 over every x.
+	static const int SOFTPLUS_SEGMENTS = 64;
+	static const float SOFTPLUS_SCALE = 8.0f;
+	static const float SOFTPLUS_LINEAR_CUTOFF = 3.0f;
+	static const float SOFTPLUS_SLOPES[SOFTPLUS_SEGMENTS + 1] = {
+		-0.484385162f, -0.453276924f, -0.422529246f, -0.39237024f, -0.363010447f, -0.334637377f,
+		-0.307411401f, -0.281463148f, -0.25689241f, -0.233768439f, -0.212131438f, -0.191994989f,
+		-0.173349141f, -0.15616388f, -0.140392743f, -0.125976373f, -0.112845858f, -0.100925759f,
+		-0.0901367475f, -0.0803978495f, -0.0716282772f, -0.0637488851f, -0.0566832788f, -0.0503586207f,
+		-0.0447061788f, -0.0396616603f, -0.0351653736f, -0.0311622537f, -0.0276017847f, -0.0244378465f,
+		-0.0216285078f, -0.0191357839f, -0.0169253747f, -0.0149663932f, -0.0132310932f, -0.0116946034f,
+		-0.0103346708f, -0.0091314179f, -0.00806711486f, -0.00712596732f, -0.0062939209f, -0.00555848179f,
+		-0.00490855306f, -0.00433428599f, -0.00382694551f, -0.00337878889f, -0.00298295655f, -0.00263337412f,
+		-0.00232466476f, -0.00205207071f, -0.00181138338f, -0.00159888098f, -0.00141127299f, -0.00124565088f,
+		-0.00109944417f, -0.000970381603f, -0.000856456541f, -0.000755896414f, -0.000667135576f, -0.000588791295f,
+		-0.000519642493f, -0.000458610929f, -0.000404744564f, -0.000357202834f, 0.0f
+	};
+	static const float SOFTPLUS_OFFSETS[SOFTPLUS_SEGMENTS + 1] = {
+		0.692903318f, 0.689016682f, 0.681333491f, 0.670029315f, 0.655356431f, 0.637631639f,
+		0.617221673f, 0.594527368f, 0.569967706f, 0.543964739f, 0.516930194f, 0.489254292f,
+		0.461297075f, 0.433382276f, 0.405793618f, 0.378773251f, 0.352521981f, 0.327200921f,
+		0.302934167f, 0.279812171f, 0.257895501f, 0.237218749f, 0.217794399f, 0.199616521f,
+		0.18266419f, 0.16690458f, 0.152295709f, 0.138788829f, 0.126330459f, 0.114864112f,
+		0.104331708f, 0.0946747376f, 0.0858351813f, 0.0777562342f, 0.0703828559f, 0.0636621757f,
+		0.0575437774f, 0.0519798847f, 0.0469254666f, 0.0423382772f, 0.0381788466f, 0.0344104307f,
+		0.0309989328f, 0.0279128027f, 0.0251229214f, 0.0226024748f, 0.0203268229f, 0.0182733655f,
+		0.0164214093f, 0.0147520357f, 0.013247974f, 0.0118934779f, 0.0106742087f, 0.00957712343f,
+		0.00859037059f, 0.00770319116f, 0.00690582676f, 0.00618943388f, 0.00554600434f, 0.00496829166f,
+		0.00444974308f, 0.00398443694f, 0.00356702515f, 0.00319268042f, 0.0f
+	};
+
+	// Line of the segment of |x| from a clamped index: two loads and no loop (a max over the lines
+	// is a chain of dependent fmaxf that compilers only vectorize with fast math).
+	static inline float SoftplusLinear(float x) {
+		float t = fabsf(x);
+		int i = (int)fminf(t * SOFTPLUS_SCALE, (float)SOFTPLUS_SEGMENTS);
+		float line = fmaxf(x, 0.0f) + SOFTPLUS_SLOPES[i] * t + SOFTPLUS_OFFSETS[i];
+		return x < -SOFTPLUS_LINEAR_CUTOFF ? log1pf(expf(x)) : line;
+	}
+
+	template<ActivationTier TIER>
+	static inline float Softplus(float x) {
+		switch (TIER) {
+		case ActivationTier::Polynomial: return SoftplusPolynomial(x);
+		case ActivationTier::PiecewiseLinear: return SoftplusLinear(x);
+		default: return SoftplusExact(x);
+		}
+	}
+
+	template<ActivationTier TIER>
+	static void Softplus(const float* x, float* y, int count) {
+		for (int i = 0; i < count; i++)
+			y[i] = Softplus<TIER>(x[i]);
+	}
+
+	static void Softplus(ActivationTier tier, const float* x, float* y, int count) {
+		switch (tier) {
+		case ActivationTier::Polynomial: Softplus<ActivationTier::Polynomial>(x, y, count); break;
+		case ActivationTier::PiecewiseLinear: Softplus<ActivationTier::PiecewiseLinear>(x, y, count); break;
+		default: Softplus<ActivationTier::Exact>(x, y, count); break;
+		}
+	}
+}
+
+#endif
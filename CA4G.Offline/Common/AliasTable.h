@@ -0,0 +1,56 @@
+#ifndef OFFLINE_ALIASTABLE_H
+#define OFFLINE_ALIASTABLE_H
+
+#include <vector>
+#include <cstdint>
+
+// Walker/Vose alias tables, CPU counterpart of Shaders/Tools/AliasTable.h.
+// One uint per bin: probability of keeping the bin in 16 bits (65535 is 1) | alias bin << 16.
+// Bins are drawn in constant time with one read instead of a binary search over the cdf.
+
+// Builds the table of a cdf of n bins (cumulative, not necessarily normalized, n <= 65536).
+// Empty cdfs get a uniform table.
+static void BuildAliasTable(const float* cdf, int n, uint32_t* table) {
+	std::vector<double> scaled(n);
+	std::vector<int> small, large;
+	double total = cdf[n - 1] > 0 ? cdf[n - 1] : 0;
+	double below = 0;
+	for (int i = 0; i < n; i++) {
+		double p = total > 0 ? (cdf[i] > below ? cdf[i] - below : 0) / total : 1.0 / n;
+		below = cdf[i] > below ? cdf[i] : below;
+		scaled[i] = p * n;
+		(scaled[i] < 1 ? small : large).push_back(i);
+	}
+	std::vector<uint32_t> alias(n);
+	for (int i = 0; i < n; i++)
+		alias[i] = i;
+	while (!small.empty() && !large.empty()) {
+		int s = small.back(), l = large.back();
+		small.pop_back();
+		alias[s] = l;
+		scaled[l] -= 1 - scaled[s];
+		if (scaled[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// leftovers are 1 up to rounding
+	for (int i : large)
+		scaled[i] = 1;
+	for (int i : small)
+		scaled[i] = 1;
+	for (int i = 0; i < n; i++) {
+		double keep = scaled[i] < 0 ? 0 : scaled[i] > 1 ? 1 : scaled[i];
+		table[i] = (uint32_t)(keep * 65535 + 0.5) | alias[i] << 16;
+	}
+}
+
+// Bin of the table of count bins, u0 picks the slot and u1 the bin or its alias.
+static int SampleAlias(const uint32_t* table, int count, float u0, float u1) {
+	int bin = (int)(u0 * count);
+	bin = bin < count - 1 ? bin : count - 1;
+	uint32_t entry = table[bin];
+	return u1 * 65535 < (entry & 0xFFFF) ? bin : (int)(entry >> 16);
+}
+
+#endif
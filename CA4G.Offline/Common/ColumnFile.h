@@ -0,0 +1,273 @@
+#ifndef OFFLINE_COLUMNFILE_H
+#define OFFLINE_COLUMNFILE_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include "Files.h"
+
+// Chunked columnar binary files written by the offline generators.
+//
+// Layout (little endian):
+//	ColumnFileHeader
+//	ColumnFileColumn[ColumnCount]
+//	MetadataBytes of text (key=value lines describing how the data was generated)
+//	chunks:
+//		uint32 ChunkTag, uint32 Rows
+//		for each column: uint32 StoredBytes, uint32 RawBytes, StoredBytes of data
+//
+// Columns of a chunk are stored one after the other so readers can load only what they need.
+// With ColumnCodec::ShuffleRLE every column is split in byte planes (all first bytes, then all
+// second bytes...) and run-length encoded, which packs well the slowly varying exponent bytes.
+// A column is kept raw when encoding does not make it smaller (StoredBytes == RawBytes).
+
+enum class ColumnType : uint32_t {
+	Float32 = 0,
+	Int32 = 1,
+	UInt8 = 2
+};
+
+enum class ColumnCodec : uint32_t {
+	None = 0,
+	ShuffleRLE = 1
+};
+
+static int ColumnTypeSize(ColumnType type) {
+	return type == ColumnType::UInt8 ? 1 : 4;
+}
+
+struct ColumnFileHeader {
+	static const uint32_t MAGIC = 0x4C4F4341; // "ACOL"
+	static const uint32_t VERSION = 1;
+	static const uint32_t CHUNK_TAG = 0x4B4E4843; // "CHNK"
+
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t ColumnCount;
+	ColumnCodec Codec;
+	uint64_t Rows;
+	uint64_t Chunks;
+	uint32_t MetadataBytes;
+	uint32_t Reserved;
+};
+
+struct ColumnFileColumn {
+	char Name[28];
+	ColumnType Type;
+};
+
+namespace ColumnCodecs {
+
+	// PackBits: control c < 128 copies c + 1 literals, c >= 128 repeats the next byte c - 125 times.
+	static void EncodeRLE(const uint8_t* data, size_t count, std::vector<uint8_t> &out) {
+		size_t i = 0;
+		while (i < count) {
+			size_t run = 1;
+			while (i + run < count && run < 130 && data[i + run] == data[i])
+				run++;
+			if (run >= 3) {
+				out.push_back((uint8_t)(run + 125));
+				out.push_back(data[i]);
+				i += run;
+				continue;
+			}
+			size_t start = i;
+			size_t literals = 0;
+			while (i < count && literals < 128) {
+				if (i + 2 < count && data[i] == data[i + 1] && data[i] == data[i + 2])
+					break;
+				i++;
+				literals++;
+			}
+			out.push_back((uint8_t)(literals - 1));
+			out.insert(out.end(), data + start, data + start + literals);
+		}
+	}
+
+	static bool DecodeRLE(const uint8_t* data, size_t count, uint8_t* out, size_t outCount) {
+		size_t o = 0;
+		size_t i = 0;
+		while (i < count) {
+			uint8_t c = data[i++];
+			if (c < 128) {
+				size_t n = c + 1;
+				if (i + n > count || o + n > outCount)
+					return false;
+				memcpy(out + o, data + i, n);
+				i += n;
+				o += n;
+			}
+			else {
+				size_t n = c - 125;
+				if (i >= count || o + n > outCount)
+					return false;
+				memset(out + o, data[i++], n);
+				o += n;
+			}
+		}
+		return o == outCount;
+	}
+
+	// Encodes count elements of elementSize bytes. Returns the raw bytes when encoding does not help.
+	static void Encode(ColumnCodec codec, const void* data, int elementSize, size_t count, std::vector<uint8_t> &out) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		size_t raw = (size_t)elementSize * count;
+		out.clear();
+		if (codec == ColumnCodec::ShuffleRLE) {
+			std::vector<uint8_t> plane(count);
+			for (int b = 0; b < elementSize; b++) {
+				for (size_t i = 0; i < count; i++)
+					plane[i] = bytes[i * elementSize + b];
+				EncodeRLE(plane.data(), count, out);
+			}
+			if (out.size() < raw)
+				return;
+			out.clear();
+		}
+		out.insert(out.end(), bytes, bytes + raw);
+	}
+
+	static bool Decode(const uint8_t* data, size_t stored, int elementSize, size_t count, void* output) {
+		size_t raw = (size_t)elementSize * count;
+		if (stored == raw) {
+			memcpy(output, data, raw);
+			return true;
+		}
+		// byte planes were encoded one after the other in a single stream
+		std::vector<uint8_t> planes(raw);
+		if (!DecodeRLE(data, stored, planes.data(), raw))
+			return false;
+		uint8_t* bytes = (uint8_t*)output;
+		for (int b = 0; b < elementSize; b++)
+			for (size_t i = 0; i < count; i++)
+				bytes[i * elementSize + b] = planes[b * count + i];
+		return true;
+	}
+}
+
+// A chunk whose columns are already encoded, so encoding can run in the worker threads.
+struct EncodedChunk {
+	uint32_t Rows = 0;
+	std::vector<std::vector<uint8_t>> Columns;
+};
+
+class ColumnFileWriter {
+	FILE* file = nullptr;
+	ColumnFileHeader header;
+	std::vector<ColumnFileColumn> columns;
+public:
+	~ColumnFileWriter() { Close(); }
+
+	// Writes the header, the column descriptions and the metadata. Rows and chunks are updated on Close.
+	bool Open(const char* path, const std::vector<ColumnFileColumn> &columns, ColumnCodec codec, const std::string &metadata) {
+		file = OpenFile(path, "wb");
+		if (!file)
+			return false;
+		this->columns = columns;
+		header.Magic = ColumnFileHeader::MAGIC;
+		header.Version = ColumnFileHeader::VERSION;
+		header.ColumnCount = (uint32_t)columns.size();
+		header.Codec = codec;
+		header.Rows = 0;
+		header.Chunks = 0;
+		header.MetadataBytes = (uint32_t)metadata.size();
+		header.Reserved = 0;
+		return
+			fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(columns.data(), sizeof(ColumnFileColumn), columns.size(), file) == columns.size() &&
+			fwrite(metadata.data(), 1, metadata.size(), file) == metadata.size();
+	}
+
+	ColumnCodec Codec() const { return header.Codec; }
+
+	// Encodes rows elements of every column (pointers in the order of the columns).
+	void Encode(const void* const* data, uint32_t rows, EncodedChunk &chunk) const {
+		chunk.Rows = rows;
+		chunk.Columns.resize(columns.size());
+		for (size_t c = 0; c < columns.size(); c++)
+			ColumnCodecs::Encode(header.Codec, data[c], ColumnTypeSize(columns[c].Type), rows, chunk.Columns[c]);
+	}
+
+	bool Write(const EncodedChunk &chunk) {
+		uint32_t tag[2] = { ColumnFileHeader::CHUNK_TAG, chunk.Rows };
+		if (fwrite(tag, sizeof(tag), 1, file) != 1)
+			return false;
+		for (size_t c = 0; c < columns.size(); c++)
+		{
+			uint32_t sizes[2] = { (uint32_t)chunk.Columns[c].size(), chunk.Rows * (uint32_t)ColumnTypeSize(columns[c].Type) };
+			if (fwrite(sizes, sizeof(sizes), 1, file) != 1 ||
+				fwrite(chunk.Columns[c].data(), 1, sizes[0], file) != sizes[0])
+				return false;
+		}
+		header.Rows += chunk.Rows;
+		header.Chunks++;
+		return true;
+	}
+
+	bool Close() {
+		if (!file)
+			return true;
+		// rows and chunks are known at the end
+		bool ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+		ok &= fclose(file) == 0;
+		file = nullptr;
+		return ok;
+	}
+};
+
+class ColumnFileReader {
+	FILE* file = nullptr;
+	std::vector<uint8_t> stored;
+public:
+	ColumnFileHeader Header;
+	std::vector<ColumnFileColumn> Columns;
+	std::string Metadata;
+
+	~ColumnFileReader() { if (file) fclose(file); }
+
+	bool Open(const char* path) {
+		file = OpenFile(path, "rb");
+		if (!file || fread(&Header, sizeof(Header), 1, file) != 1 ||
+			Header.Magic != ColumnFileHeader::MAGIC || Header.Version != ColumnFileHeader::VERSION)
+			return false;
+		Columns.resize(Header.ColumnCount);
+		Metadata.resize(Header.MetadataBytes);
+		return
+			fread(Columns.data(), sizeof(ColumnFileColumn), Columns.size(), file) == Columns.size() &&
+			fread(&Metadata[0], 1, Metadata.size(), file) == Metadata.size();
+	}
+
+	int FindColumn(const char* name) const {
+		for (size_t c = 0; c < Columns.size(); c++)
+			if (strncmp(Columns[c].Name, name, sizeof(Columns[c].Name)) == 0)
+				return (int)c;
+		return -1;
+	}
+
+	// Reads the next chunk decoding every column in data[c] (resized as needed).
+	// Returns false at the end of the file or if the chunk is corrupted.
+	bool ReadChunk(std::vector<std::vector<uint8_t>> &data, uint32_t &rows) {
+		uint32_t tag[2];
+		if (fread(tag, sizeof(tag), 1, file) != 1 || tag[0] != ColumnFileHeader::CHUNK_TAG)
+			return false;
+		rows = tag[1];
+		data.resize(Columns.size());
+		for (size_t c = 0; c < Columns.size(); c++)
+		{
+			uint32_t sizes[2];
+			if (fread(sizes, sizeof(sizes), 1, file) != 1)
+				return false;
+			int elementSize = ColumnTypeSize(Columns[c].Type);
+			if (sizes[1] != rows * (uint32_t)elementSize)
+				return false;
+			stored.resize(sizes[0]);
+			data[c].resize(sizes[1]);
+			if (fread(stored.data(), 1, sizes[0], file) != sizes[0] ||
+				!ColumnCodecs::Decode(stored.data(), sizes[0], elementSize, rows, data[c].data()))
+				return false;
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef OFFLINE_COMMANDLINE_H
+#define OFFLINE_COMMANDLINE_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+// Arguments of the offline tools in the form key=value.
+class CommandLine {
+	std::map<std::string, std::string> values;
+public:
+	CommandLine(int argc, char** argv) {
+		for (int i = 0; i < argc; i++)
+		{
+			std::string a = argv[i];
+			size_t eq = a.find('=');
+			if (eq == std::string::npos)
+				values[a] = "1";
+			else
+				values[a.substr(0, eq)] = a.substr(eq + 1);
+		}
+	}
+
+	bool Has(const char* key) const { return values.find(key) != values.end(); }
+
+	std::string String(const char* key, const char* def) const {
+		auto it = values.find(key);
+		return it == values.end() ? def : it->second;
+	}
+
+	long long Int(const char* key, long long def) const {
+		auto it = values.find(key);
+		return it == values.end() ? def : atoll(it->second.c_str());
+	}
+
+	float Float(const char* key, float def) const {
+		auto it = values.find(key);
+		return it == values.end() ? def : (float)atof(it->second.c_str());
+	}
+
+	// Comma separated list, e.g. stf=stf2.bin,stf_adaptive.bin
+	std::vector<std::string> Strings(const char* key, const char* def) const {
+		std::string list = String(key, def);
+		std::vector<std::string> result;
+		size_t pos = 0;
+		while (pos < list.size())
+		{
+			size_t comma = list.find(',', pos);
+			if (comma == std::string::npos)
+				comma = list.size();
+			if (comma > pos)
+				result.push_back(list.substr(pos, comma - pos));
+			pos = comma + 1;
+		}
+		return result;
+	}
+
+	// Comma separated list of numbers, e.g. ers=1,4,16
+	std::vector<float> Floats(const char* key, const char* def) const {
+		std::vector<float> result;
+		for (const std::string &value : Strings(key, def))
+			result.push_back((float)atof(value.c_str()));
+		return result;
+	}
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef OFFLINE_FILES_H
+#define OFFLINE_FILES_H
+
+#include <cstdio>
+#include <cstdint>
+
+// fopen_s where available (as the techniques do), fopen elsewhere.
+static FILE* OpenFile(const char* path, const char* mode) {
+	FILE* f = nullptr;
+#ifdef _MSC_VER
+	if (fopen_s(&f, path, mode))
+		return nullptr;
+#else
+	f = fopen(path, mode);
+#endif
+	return f;
+}
+
+// Seeks to an absolute byte offset, tables are beyond the 2GB a long can address on Windows.
+static bool SeekFile(FILE* f, uint64_t offset) {
+#ifdef _MSC_VER
+	return _fseeki64(f, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Reads count floats, returns false if the file ended before.
+static bool ReadFloats(FILE* f, float* data, size_t count) {
+	// fread of more than 2GB at once fails on some runtimes
+	const size_t chunk = 1 << 26;
+	while (count > 0)
+	{
+		size_t n = count < chunk ? count : chunk;
+		if (fread(data, sizeof(float), n, f) != n)
+			return false;
+		data += n;
+		count -= n;
+	}
+	return true;
+}
+
+static bool WriteFloats(FILE* f, const float* data, size_t count) {
+	const size_t chunk = 1 << 26;
+	while (count > 0)
+	{
+		size_t n = count < chunk ? count : chunk;
+		if (fwrite(data, sizeof(float), n, f) != n)
+			return false;
+		data += n;
+		count -= n;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef OFFLINE_GUIDETABLE_H
+#define OFFLINE_GUIDETABLE_H
+
+#include <cstdint>
+
+// Guide tables of normalized cdfs, CPU counterpart of Shaders/Tools/GuideTable.h.
+// Entry i of a cdf of n bins (n <= 65536) is the bin of u = i / GUIDE_ENTRIES, 16 bits each. A
+// value u in [i, i + 1) / GUIDE_ENTRIES falls between the entries i and i + 1, the binary search
+// starts there instead of over the whole cdf. Unlike alias tables the bins keep the order of u,
+// stratified or nearby values of u read nearby bins.
+static const int GUIDE_ENTRIES = 64; // a power of two, u * GUIDE_ENTRIES is exact
+
+static void BuildGuideTable(const float* cdf, int n, uint16_t* guide) {
+	int bin = 0;
+	for (int i = 0; i < GUIDE_ENTRIES; i++) {
+		float u = i / (float)GUIDE_ENTRIES;
+		while (bin < n - 1 && !(u < cdf[bin]))
+			bin++;
+		guide[i] = (uint16_t)bin;
+	}
+}
+
+// Bin of value in [0, 1) in the cdf of n bins starting at start (relative to start), as
+// STFXSearchBin over the whole cdf returns.
+static int SearchGuided(const float* cdf, size_t start, int n, const uint16_t* guide, float value) {
+	int i = (int)(value * GUIDE_ENTRIES);
+	i = i < GUIDE_ENTRIES - 1 ? i : GUIDE_ENTRIES - 1;
+	int beg = guide[i];
+	int end = i < GUIDE_ENTRIES - 1 ? guide[i + 1] : n - 1;
+	while (beg < end) {
+		int med = (beg + end) / 2;
+		if (value < cdf[start + med])
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return beg;
+}
+
+#endif
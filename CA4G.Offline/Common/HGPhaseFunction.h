@@ -0,0 +1,42 @@
+#ifndef OFFLINE_HGPHASEFUNCTION_H
+#define OFFLINE_HGPHASEFUNCTION_H
+
+#include "Randoms.h"
+
+// CPU counterpart of Shaders/Tools/HGPhaseFunction.h
+
+static float EvalPhase(float GFactor, const float3 &D, const float3 &L) {
+	if (fabsf(GFactor) < 0.001f)
+		return 0.25f / PI;
+	float cosTheta = dot(D, L);
+	return 0.25f / PI * (1.0f - GFactor * GFactor) / powf(1.0f + GFactor * GFactor - 2 * GFactor * cosTheta, 1.5f);
+}
+
+static float invertcdf(float GFactor, float xi) {
+	float t = (1.0f - GFactor * GFactor) / (1.0f - GFactor + 2.0f * GFactor * xi);
+	return 0.5f / GFactor * (1.0f + GFactor * GFactor - t * t);
+}
+
+static void CreateOrthonormalBasis(const float3 &D, float3 &B, float3 &T) {
+	float3 other = fabsf(D.z) >= 0.999f ? float3(1, 0, 0) : float3(0, 0, 1);
+	B = normalize(cross(other, D));
+	T = normalize(cross(D, B));
+}
+
+// TRandom is RandomGenerator or any generator with random() and randomDirection().
+template<typename TRandom>
+static float3 ImportanceSamplePhase(TRandom &rng, float GFactor, const float3 &D) {
+	if (fabsf(GFactor) < 0.001f)
+		return rng.randomDirection();
+
+	float phi = rng.random() * 2 * PI;
+	float cosTheta = invertcdf(GFactor, rng.random());
+	float sinTheta = sqrtf(maxf(0.0f, 1.0f - cosTheta * cosTheta));
+
+	float3 t0, t1;
+	CreateOrthonormalBasis(D, t0, t1);
+
+	return t0 * (sinTheta * sinf(phi)) + t1 * (sinTheta * cosf(phi)) + D * cosTheta;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef OFFLINE_PARALLEL_H
+#define OFFLINE_PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <chrono>
+
+// Persistent pool of worker threads.
+// ParallelFor splits [0, count) in chunks of grain elements that workers (and the caller) grab
+// with an atomic counter. The call returns when all chunks were processed.
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::condition_variable done;
+
+	std::function<void(int, int, int)> job;
+	int jobCount = 0;
+	int jobGrain = 1;
+	std::atomic<int> nextChunk;
+	int pendingWorkers = 0;
+	unsigned long long generation = 0;
+	bool exiting = false;
+
+	void RunChunks(int threadIndex) {
+		while (true) {
+			int begin = nextChunk.fetch_add(jobGrain);
+			if (begin >= jobCount)
+				return;
+			int end = begin + jobGrain < jobCount ? begin + jobGrain : jobCount;
+			job(begin, end, threadIndex);
+		}
+	}
+
+	void WorkerLoop(int threadIndex) {
+		unsigned long long seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [&] { return exiting || generation != seen; });
+				if (exiting)
+					return;
+				seen = generation;
+			}
+			RunChunks(threadIndex);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--pendingWorkers == 0)
+					done.notify_one();
+			}
+		}
+	}
+
+public:
+	// threads = 0 uses all hardware threads. The calling thread always takes part as thread 0.
+	ThreadPool(int threads = 0) {
+		if (threads <= 0)
+			threads = (int)std::thread::hardware_concurrency();
+		if (threads <= 0)
+			threads = 1;
+		nextChunk = 0;
+		for (int i = 1; i < threads; i++)
+			workers.push_back(std::thread([this, i] { WorkerLoop(i); }));
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			exiting = true;
+		}
+		wakeUp.notify_all();
+		for (auto &t : workers)
+			t.join();
+	}
+
+	int ThreadCount() const { return (int)workers.size() + 1; }
+
+	// body(begin, end, threadIndex)
+	void ParallelFor(int count, int grain, const std::function<void(int, int, int)> &body) {
+		if (count <= 0)
+			return;
+		if (grain < 1)
+			grain = 1;
+		if (workers.empty() || count <= grain) {
+			body(0, count, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = body;
+			jobCount = count;
+			jobGrain = grain;
+			nextChunk = 0;
+			pendingWorkers = (int)workers.size();
+			generation++;
+		}
+		wakeUp.notify_all();
+		RunChunks(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return pendingWorkers == 0; });
+	}
+};
+
+// Wall-clock helper used by the benchmarks.
+class Stopwatch {
+	std::chrono::high_resolution_clock::time_point start;
+public:
+	Stopwatch() { Reset(); }
+	void Reset() { start = std::chrono::high_resolution_clock::now(); }
+	double Seconds() const {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef OFFLINE_PHILOX_H
+#define OFFLINE_PHILOX_H
+
+#include <cstdint>
+#include "Randoms.h"
+
+// Counter-based generator Philox4x32-10 (Salmon et al., Random123).
+// Every (key, stream) pair is an independent sequence that needs no warm-up, so work items can
+// open their stream directly from their index and results do not depend on scheduling.
+// It exposes the same sampling methods than RandomGenerator used by the samplers.
+// RandomGenerator::Philox(pixel, frame, bounce) draws the stream (pixel | frame << 32, bounce).
+struct PhiloxGenerator {
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4];
+	int used;
+
+	PhiloxGenerator(uint64_t seed, uint64_t stream) {
+		key[0] = (uint32_t)seed;
+		key[1] = (uint32_t)(seed >> 32);
+		counter[0] = 0;
+		counter[1] = 0;
+		counter[2] = (uint32_t)stream;
+		counter[3] = (uint32_t)(stream >> 32);
+		used = 4;
+	}
+
+	uint32_t next() {
+		if (used == 4) {
+			Philox4x32(counter, key, block);
+			if (++counter[0] == 0)
+				counter[1]++;
+			used = 0;
+		}
+		return block[used++];
+	}
+
+	// Uniform in [0, 1) with 24 bits
+	float random() {
+		return (next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float3 randomDirection() {
+		float r1 = random();
+		float r2 = random() * 2 - 1;
+		float sqrt_of_one_minus_sqrR2 = sqrtf(maxf(0.0f, 1.0f - r2 * r2));
+		return float3(cosf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, sinf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, r2);
+	}
+};
+
+#endif
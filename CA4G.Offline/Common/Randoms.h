@@ -0,0 +1,339 @@
+#ifndef OFFLINE_RANDOMS_H
+#define OFFLINE_RANDOMS_H
+
+#include <limits>
+#include <cstdint>
+#include <string>
+#include "ca4g_gmath.h"
+#include "../../CA4G.DemoApp/Shaders/Tools/Parameters.h"
+
+using namespace CA4G;
+
+static void MulHiLo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+	uint64_t p = (uint64_t)a * b;
+	hi = (uint32_t)(p >> 32);
+	lo = (uint32_t)p;
+}
+
+// Philox4x32-10 (Salmon et al., Random123), 10 rounds over the counter ctr with the key k.
+static void Philox4x32(const uint32_t ctr[4], const uint32_t k[2], uint32_t out[4]) {
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t k0 = k[0], k1 = k[1];
+	for (int r = 0; r < 10; r++) {
+		uint32_t hi0, lo0, hi1, lo1;
+		MulHiLo(0xD2511F53u, c0, hi0, lo0);
+		MulHiLo(0xCD9E8D57u, c2, hi1, lo1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+static uint32_t ReverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00FF00FFu) << 8) | ((x >> 8) & 0x00FF00FFu);
+	x = ((x & 0x0F0F0F0Fu) << 4) | ((x >> 4) & 0x0F0F0F0Fu);
+	x = ((x & 0x33333333u) << 2) | ((x >> 2) & 0x33333333u);
+	x = ((x & 0x55555555u) << 1) | ((x >> 1) & 0x55555555u);
+	return x;
+}
+
+// Integer hash (lowbias32) for the scrambling seeds
+static uint32_t HashUInt(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint32_t HashCombine(uint32_t seed, uint32_t v) {
+	return HashUInt(seed ^ (v + 0x9E3779B9u + (seed << 6) + (seed >> 2)));
+}
+
+// Owen scrambling of the bits of x (most significant first) by a hash, every bit flips depending
+// on the bits above it (Laine and Karras permutation as improved by Vegdahl).
+static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+	x = ReverseBits(x);
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return ReverseBits(x);
+}
+
+// Generator matrices of the first four Sobol dimensions (Joe and Kuo), one column per index bit.
+static const uint32_t SOBOL_DIRECTIONS[4][32] = {
+	{ 0x80000000, 0x40000000, 0x20000000, 0x10000000, 0x08000000, 0x04000000, 0x02000000, 0x01000000,
+	  0x00800000, 0x00400000, 0x00200000, 0x00100000, 0x00080000, 0x00040000, 0x00020000, 0x00010000,
+	  0x00008000, 0x00004000, 0x00002000, 0x00001000, 0x00000800, 0x00000400, 0x00000200, 0x00000100,
+	  0x00000080, 0x00000040, 0x00000020, 0x00000010, 0x00000008, 0x00000004, 0x00000002, 0x00000001 },
+	{ 0x80000000, 0xc0000000, 0xa0000000, 0xf0000000, 0x88000000, 0xcc000000, 0xaa000000, 0xff000000,
+	  0x80800000, 0xc0c00000, 0xa0a00000, 0xf0f00000, 0x88880000, 0xcccc0000, 0xaaaa0000, 0xffff0000,
+	  0x80008000, 0xc000c000, 0xa000a000, 0xf000f000, 0x88008800, 0xcc00cc00, 0xaa00aa00, 0xff00ff00,
+	  0x80808080, 0xc0c0c0c0, 0xa0a0a0a0, 0xf0f0f0f0, 0x88888888, 0xcccccccc, 0xaaaaaaaa, 0xffffffff },
+	{ 0x80000000, 0xc0000000, 0x60000000, 0x90000000, 0xe8000000, 0x5c000000, 0x8e000000, 0xc5000000,
+	  0x68800000, 0x9cc00000, 0xee600000, 0x55900000, 0x80680000, 0xc09c0000, 0x60ee0000, 0x90550000,
+	  0xe8808000, 0x5cc0c000, 0x8e606000, 0xc5909000, 0x6868e800, 0x9c9c5c00, 0xeeee8e00, 0x5555c500,
+	  0x8000e880, 0xc0005cc0, 0x60008e60, 0x9000c590, 0xe8006868, 0x5c009c9c, 0x8e00eeee, 0xc5005555 },
+	{ 0x80000000, 0xc0000000, 0x20000000, 0x50000000, 0xf8000000, 0x74000000, 0xa2000000, 0x93000000,
+	  0xd8800000, 0x25400000, 0x59e00000, 0xe6d00000, 0x78080000, 0xb40c0000, 0x82020000, 0xc3050000,
+	  0x208f8000, 0x51474000, 0xfbea2000, 0x75d93000, 0xa0858800, 0x914e5400, 0xdbe79e00, 0x25db6d00,
+	  0x58800080, 0xe54000c0, 0x79e00020, 0xb6d00050, 0x800800f8, 0xc00c0074, 0x200200a2, 0x50050093 }
+};
+
+// Point index of the Owen-scrambled Sobol sequence in four dimensions (Burley 2020). The index is
+// shuffled with the seed too, so groups of dimensions with different seeds are not correlated and
+// the first 2^m points of every group are still a Sobol net.
+static void OwenSobol4(uint32_t index, uint32_t seed, uint32_t out[4]) {
+	index = NestedUniformScramble(index, seed);
+	uint32_t bits[4] = { 0, 0, 0, 0 };
+	for (int i = 0; index != 0; i++, index >>= 1)
+		if (index & 1)
+			for (int d = 0; d < 4; d++)
+				bits[d] ^= SOBOL_DIRECTIONS[d][i];
+	for (int d = 0; d < 4; d++)
+		out[d] = NestedUniformScramble(bits[d], HashCombine(seed, d));
+}
+
+// Standard normal of u in [0, 1) with 24 bits (u is moved to the center of its cell), sqrt(2)
+// erfinv(2u - 1) with the single precision erfinv of Giles, max abs error 5e-7.
+static float InverseNormalCDF(float u) {
+	float x = 2 * u - 1 + 1.0f / 16777216;
+	float w = -logf((1 - x) * (1 + x));
+	float p;
+	if (w < 5) {
+		w -= 2.5f;
+		p = 2.81022636e-08f;
+		p = 3.43273939e-07f + p * w;
+		p = -3.5233877e-06f + p * w;
+		p = -4.39150654e-06f + p * w;
+		p = 0.00021858087f + p * w;
+		p = -0.00125372503f + p * w;
+		p = -0.00417768164f + p * w;
+		p = 0.246640727f + p * w;
+		p = 1.50140941f + p * w;
+	}
+	else {
+		w = sqrtf(w) - 3;
+		p = -0.000200214257f;
+		p = 0.000100950558f + p * w;
+		p = 0.00134934322f + p * w;
+		p = -0.00367342844f + p * w;
+		p = 0.00573950773f + p * w;
+		p = -0.0076224613f + p * w;
+		p = 0.00943887047f + p * w;
+		p = 1.00167406f + p * w;
+		p = 2.83297682f + p * w;
+	}
+	return 1.41421356f * p * x;
+}
+
+// RANDOM_SEQUENCE of Shaders/Tools/Parameters.h
+enum class RandomSequence {
+	// HybridTaus seeded with the linear index of the ray and 23 + index % 13 warm-up draws
+	HybridTaus = 0,
+	// Philox4x32-10 stream keyed by (pixel, frame) with the bounce in the counter
+	Philox = 1,
+	// Owen-scrambled Sobol, four dimensions per path vertex padded with the Philox stream
+	Sobol = 2
+};
+
+static const char* RandomSequenceName(RandomSequence sequence) {
+	switch (sequence) {
+	case RandomSequence::Philox: return "philox";
+	case RandomSequence::Sobol: return "sobol";
+	default: return "hybridtaus";
+	}
+}
+
+static bool ParseRandomSequence(const std::string &name, RandomSequence &sequence) {
+	const RandomSequence all[] = { RandomSequence::HybridTaus, RandomSequence::Philox, RandomSequence::Sobol };
+	for (RandomSequence q : all)
+		if (name == RandomSequenceName(q)) {
+			sequence = q;
+			return true;
+		}
+	return false;
+}
+
+// CPU counterpart of Shaders/Tools/Randoms.h.
+// The shader keeps the generator in a static per-thread variable, here every path (or worker)
+// owns an instance so suspended paths can be resumed later with their own stream.
+// With HybridTaus x, y, z, w are its lanes. With Philox and Sobol they are the Philox stream of
+// the ray as rng_state in the shader: x, y the key (pixel, frame), z the next dimension and w the
+// bounce. Sobol draws the dimensions of a path vertex (StartPathVertex) from the point
+// frame / passesPerSample of the sequence scrambled for the pixel and frame % passesPerSample, and
+// the draws past the four of the vertex from the Philox stream. passesPerSample is 3 when every
+// pass traces one channel (each channel walks its own sequence) and 1 when every pass traces the
+// three (SOBOL_PASSES_PER_SAMPLE in the shaders).
+struct RandomGenerator {
+	uint32_t x, y, z, w;
+	uint32_t block[4];
+	RandomSequence sequence;
+	uint32_t sobolIndex, sobolSeed;
+	uint32_t sobol[4];
+	int sobolDimension;
+
+	RandomGenerator() : x(0), y(0), z(0), w(0), sequence(RandomSequence::HybridTaus) {}
+
+	// Same seeding as StartRandomSeedForRay for an already linearized index with HybridTaus.
+	RandomGenerator(uint32_t index) : sequence(RandomSequence::HybridTaus) {
+		x = y = z = w = index;
+		for (uint32_t i = 0; i < 23 + index % 13; i++)
+			random();
+	}
+
+	// Philox stream keyed by (pixel, frame) with the bounce in the counter, no warm-up.
+	static RandomGenerator Philox(uint32_t pixel, uint32_t frame, uint32_t bounce) {
+		RandomGenerator rng;
+		rng.x = pixel;
+		rng.y = frame;
+		rng.z = 0;
+		rng.w = bounce;
+		rng.sequence = RandomSequence::Philox;
+		return rng;
+	}
+
+	// Sobol samples of a pixel, vertex 0 (the pixel jitter) is started.
+	static RandomGenerator Sobol(uint32_t pixel, uint32_t frame, uint32_t bounce, uint32_t passesPerSample = 3) {
+		RandomGenerator rng = Philox(pixel, frame, bounce);
+		rng.sequence = RandomSequence::Sobol;
+		rng.sobolIndex = frame / passesPerSample;
+		rng.sobolSeed = HashCombine(HashUInt(pixel), frame % passesPerSample);
+		rng.StartPathVertex(0);
+		return rng;
+	}
+
+	// StartRandomSeedForRay(gridDimensions, maxBounces, raysIndex, bounce, frame)
+	static RandomGenerator ForRay(uint32_t width, uint32_t height, uint32_t maxBounces, uint32_t px, uint32_t py, uint32_t bounce, uint32_t frame,
+		RandomSequence sequence = (RandomSequence)RANDOM_SEQUENCE, uint32_t passesPerSample = 3) {
+		switch (sequence) {
+		case RandomSequence::Philox: return Philox(px + py * width, frame, bounce);
+		case RandomSequence::Sobol: return Sobol(px + py * width, frame, bounce, passesPerSample);
+		default: return RandomGenerator(px + py * width + bounce * width * height + frame * width * height * maxBounces);
+		}
+	}
+
+	// StartPathVertex of the shaders, the next four draws are the Sobol dimensions of the vertex.
+	void StartPathVertex(int vertex) {
+		if (sequence != RandomSequence::Sobol)
+			return;
+		OwenSobol4(sobolIndex, HashCombine(sobolSeed, (uint32_t)vertex), sobol);
+		sobolDimension = 0;
+	}
+
+	// Dimension z of the stream, a Philox block gives four of them.
+	float PhiloxRandom() {
+		uint32_t lane = z & 3;
+		if (lane == 0) {
+			const uint32_t ctr[4] = { z >> 2, 0, w, 0 };
+			const uint32_t key[2] = { x, y };
+			Philox4x32(ctr, key, block);
+		}
+		z++;
+		return (block[lane] >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float SobolRandom() {
+		if (sobolDimension < 4)
+			return (sobol[sobolDimension++] >> 8) * (1.0f / 16777216.0f);
+		return PhiloxRandom();
+	}
+
+	static uint32_t TausStep(uint32_t z, int S1, int S2, int S3, uint32_t M)
+	{
+		uint32_t b = (((z << S1) ^ z) >> S2);
+		return ((z & M) << S3) ^ b;
+	}
+
+	static uint32_t LCGStep(uint32_t z, uint32_t A, uint32_t C)
+	{
+		return A * z + C;
+	}
+
+	float HybridTaus() {
+		x = TausStep(x, 13, 19, 12, 4294967294u);
+		y = TausStep(y, 2, 25, 4, 4294967288u);
+		z = TausStep(z, 3, 11, 17, 4294967280u);
+		w = LCGStep(w, 1664525, 1013904223);
+
+		return 2.3283064365387e-10f * (x ^ y ^ z ^ w);
+	}
+
+	float random() {
+		switch (sequence) {
+		case RandomSequence::Philox: return PhiloxRandom();
+		case RandomSequence::Sobol: return SobolRandom();
+		default: return HybridTaus();
+		}
+	}
+
+	float2 BM_2() {
+		float u1 = 1.0f - random(); //uniform(0,1] random doubles
+		float u2 = 1.0f - random();
+		float r = sqrtf(-2.0f * logf(maxf(0.0000000001f, u1)));
+		float t = 2.0f * PI * u2;
+		return float2(r * cosf(t), r * sinf(t));
+	}
+
+	float4 BM_4() {
+		float u1x = 1.0f - random(); // same consumption order as the shader version
+		float u1y = 1.0f - random();
+		float u2x = 1.0f - random();
+		float u2y = 1.0f - random();
+		float rx = sqrtf(-2.0f * logf(maxf(0.0000000001f, u1x)));
+		float ry = sqrtf(-2.0f * logf(maxf(0.0000000001f, u1y)));
+		float tx = 2.0f * PI * u2x;
+		float ty = 2.0f * PI * u2y;
+		return float4(rx * cosf(tx), rx * sinf(tx), ry * cosf(ty), ry * sinf(ty));
+	}
+
+	// Sobol draws the normals by the inverse cdf, one dimension each, so they keep the stratification.
+	float randomStdNormal() {
+		if (sequence == RandomSequence::Sobol)
+			return InverseNormalCDF(random());
+		return BM_2().x;
+	}
+	float2 randomStdNormal2() {
+		if (sequence == RandomSequence::Sobol) {
+			float a = randomStdNormal();
+			return float2(a, randomStdNormal());
+		}
+		return BM_2();
+	}
+	float3 randomStdNormal3() {
+		if (sequence == RandomSequence::Sobol) {
+			float a = randomStdNormal(), b = randomStdNormal();
+			return float3(a, b, randomStdNormal());
+		}
+		float4 r = BM_4();
+		return float3(r.x, r.y, r.z);
+	}
+	float4 randomStdNormal4() {
+		if (sequence == RandomSequence::Sobol) {
+			float a = randomStdNormal(), b = randomStdNormal(), c = randomStdNormal();
+			return float4(a, b, c, randomStdNormal());
+		}
+		return BM_4();
+	}
+
+	float gauss(float mu = 0, float sigma = 1) {
+		return mu + sigma * randomStdNormal();
+	}
+
+	float3 randomDirection() {
+		float r1 = random();
+		float r2 = random() * 2 - 1;
+		float sqrt_of_one_minus_sqrR2 = sqrtf(maxf(0.0f, 1.0f - r2 * r2));
+		return float3(cosf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, sinf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, r2);
+	}
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef OFFLINE_SHAREDPATH_H
+#define OFFLINE_SHAREDPATH_H
+
+#include "HGPhaseFunction.h"
+
+// CPU counterpart of Shaders/Tools/SharedPath.h
+// The hero channel takes every sampling decision, the other channels carry in importance the
+// ratio between their pdf and the hero pdf. Paths that can not be shared collapse to the hero
+// channel with weight 3 (the single channel estimator).
+// Channels are kept in plain arrays, float3::operator[] falls back to a static that the
+// library does not define.
+
+// Per channel coefficients of a medium (VolumeMaterial in the shaders).
+struct MediumChannels {
+	float Extinction[3];
+	float ScatteringAlbedo[3];
+	float G[3];
+};
+
+struct ChannelImportance {
+	float Importance[3];
+	int Hero;
+	bool Shared;
+
+	ChannelImportance(int hero, bool shared) : Hero(hero), Shared(shared) {
+		for (int c = 0; c < 3; c++)
+			Importance[c] = shared ? 1.0f : (c == hero ? 3.0f : 0.0f);
+	}
+
+	float3 Weights() const { return float3(Importance[0], Importance[1], Importance[2]); }
+
+	void CollapseToHero() {
+		if (!Shared)
+			return;
+		for (int c = 0; c < 3; c++)
+			Importance[c] = c == Hero ? Importance[c] * 3 : 0.0f;
+		Shared = false;
+	}
+
+	// Same test for every hero (see IsGrayMedium in the shaders).
+	static bool IsGrayMedium(const MediumChannels &m, float tolerance = 0) {
+		return Spread(m.Extinction) <= tolerance * Highest(m.Extinction) &&
+			Spread(m.ScatteringAlbedo) <= tolerance * Highest(m.ScatteringAlbedo) &&
+			Spread(m.G) <= tolerance;
+	}
+
+	static float Highest(const float* v) {
+		return fmaxf(v[0], fmaxf(v[1], v[2]));
+	}
+
+	static float Spread(const float* v) {
+		return Highest(v) - fminf(v[0], fminf(v[1], v[2]));
+	}
+
+	// maxSpread as SHARED_PATH_MAX_SPREAD
+	void BeginMediumFlight(const MediumChannels &m, float maxSpread = 0.25f) {
+		if (Shared && !IsGrayMedium(m, maxSpread))
+			CollapseToHero();
+	}
+
+	void BeginMediumEvent(const MediumChannels &m, float tolerance = 0) {
+		if (Shared && !IsGrayMedium(m, tolerance))
+			CollapseToHero();
+	}
+
+	void Transmittance(const float* sigma, float d) {
+		if (Shared)
+			for (int c = 0; c < 3; c++)
+				Importance[c] *= expf(-(sigma[c] - sigma[Hero]) * d);
+	}
+
+	void Collision(const float* sigma, float t) {
+		if (Shared)
+			for (int c = 0; c < 3; c++)
+				Importance[c] *= sigma[c] / sigma[Hero] * expf(-(sigma[c] - sigma[Hero]) * t);
+	}
+
+	void Survival(const float* albedo) {
+		if (Shared)
+			for (int c = 0; c < 3; c++)
+				Importance[c] *= albedo[c] / albedo[Hero];
+	}
+
+	void Phase(const float* G, const float3 &D, const float3 &L) {
+		if (!Shared)
+			return;
+		float hero = EvalPhase(G[Hero], D, L);
+		for (int c = 0; c < 3; c++)
+			Importance[c] *= EvalPhase(G[c], D, L) / hero;
+	}
+};
+
+#endif
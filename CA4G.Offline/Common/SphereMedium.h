@@ -0,0 +1,27 @@
+#ifndef OFFLINE_SPHEREMEDIUM_H
+#define OFFLINE_SPHEREMEDIUM_H
+
+#include "ca4g_gmath.h"
+
+using namespace CA4G;
+
+// Homogeneous sphere centered at the origin.
+struct SphereMedium {
+	float Radius;
+	float Extinction;
+	float G;
+	float Phi;
+
+	float MaximalRadius(const float3 &x) const {
+		return maxf(0.0f, Radius - length(x));
+	}
+
+	float DistanceToBoundary(const float3 &x, const float3 &w) const {
+		// |x + w t| = Radius, positive root
+		float b = dot(x, w);
+		float c = dot(x, x) - Radius * Radius;
+		return maxf(0.0f, -b + sqrtf(maxf(0.0f, b * b - c)));
+	}
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef OFFLINE_TABLEFILES_H
+#define OFFLINE_TABLEFILES_H
+
+#include <cstring>
+#include "Files.h"
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/TableFile.h"
+
+// Writing side of the table files (TableFile.h), readers map them with MappedTableFile.
+
+// Copies a name into a zero filled field keeping the last 0.
+static void CopyTableName(char* field, size_t size, const char* name) {
+	size_t length = strlen(name);
+	memcpy(field, name, length < size - 1 ? length : size - 1);
+}
+
+// Header of a new table, sections are placed in the order they are added.
+static TableFileHeader CreateTableHeader(const char* kind, const uint32_t* bins, const uint64_t* strides, int count) {
+	TableFileHeader h;
+	memset(&h, 0, sizeof(h));
+	h.Magic = TableFileHeader::MAGIC;
+	h.Version = TableFileHeader::VERSION;
+	CopyTableName(h.Kind, sizeof(h.Kind), kind);
+	for (int i = 0; i < count && i < TableFileHeader::MAX_BINS; i++) {
+		h.Bins[i] = bins[i];
+		h.Strides[i] = strides[i];
+	}
+	return h;
+}
+
+static uint64_t AlignTableOffset(uint64_t offset) {
+	return (offset + TableFileHeader::ALIGNMENT - 1) / TableFileHeader::ALIGNMENT * TableFileHeader::ALIGNMENT;
+}
+
+// Names bin dimension i of a new table and tells how its values map to the bins.
+static void SetTableAxis(TableFileHeader &h, int i, const char* name, TableAxisMapping mapping, float min, float max) {
+	CopyTableName(h.Axes[i].Name, sizeof(h.Axes[i].Name), name);
+	h.Axes[i].Mapping = mapping;
+	h.Axes[i].Min = min;
+	h.Axes[i].Max = max;
+}
+
+// Tables derived from another one (alias, guides, slices...) keep the generator of the source.
+static void CopyTableGenerator(TableFileHeader &h, const TableFileHeader &source) {
+	h.Seed = source.Seed;
+	h.Walks = source.Walks;
+}
+
+// Adds a section after the last one, returns it to set the checksum later.
+static TableSection& AddTableSection(TableFileHeader &h, const char* name, TableElementType type, uint64_t count) {
+	uint64_t end = sizeof(TableFileHeader);
+	if (h.SectionCount > 0)
+		end = h.Sections[h.SectionCount - 1].Offset + h.Sections[h.SectionCount - 1].Bytes();
+	TableSection &s = h.Sections[h.SectionCount++];
+	CopyTableName(s.Name, sizeof(s.Name), name);
+	s.ElementSize = TableElementSize(type);
+	s.Type = type;
+	s.Offset = AlignTableOffset(end);
+	s.Count = count;
+	return s;
+}
+
+static uint64_t TableFileSize(const TableFileHeader &h) {
+	const TableSection &last = h.Sections[h.SectionCount - 1];
+	return last.Offset + last.Bytes();
+}
+
+// Writes the header and extends the file to its size, gaps between sections read as zeros.
+static bool WriteTableHeader(FILE* f, const TableFileHeader &h) {
+	unsigned char zero = 0;
+	return SeekFile(f, TableFileSize(h) - 1) && fwrite(&zero, 1, 1, f) == 1 &&
+		SeekFile(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1;
+}
+
+static bool WriteTableSection(FILE* f, const TableSection &s, const void* data) {
+	if (!SeekFile(f, s.Offset))
+		return false;
+	// fwrite of more than 2GB at once fails on some runtimes
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (uint64_t done = 0; done < s.Bytes(); done += 1 << 28) {
+		size_t n = (size_t)(s.Bytes() - done < (1 << 28) ? s.Bytes() - done : 1 << 28);
+		if (fwrite(bytes + done, 1, n, f) != n)
+			return false;
+	}
+	return true;
+}
+
+// Computes the checksums of a table written in place (as the generator does) and updates its header.
+static bool SealTableFile(const char* path) {
+	TableFileHeader h;
+	{
+		MappedTableFile file;
+		if (!file.Open(path))
+			return false;
+		h = file.Header();
+		for (uint32_t i = 0; i < h.SectionCount; i++)
+			h.Sections[i].Checksum = TableChecksum(file.Section(h.Sections[i]), h.Sections[i].Bytes());
+	}
+	FILE* f = OpenFile(path, "r+b");
+	if (!f)
+		return false;
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	ok &= fclose(f) == 0;
+	return ok;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef OFFLINE_TILESCHEDULER_H
+#define OFFLINE_TILESCHEDULER_H
+
+#include <deque>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "Parallel.h"
+
+// How the tiles of a pass are given to the workers.
+enum class TileSchedule {
+	Shared,		// one queue in scanline order, as ParallelFor over the tiles
+	Stealing,	// a deque per worker with a contiguous band of tiles, idle workers steal
+	Cost		// a deque per worker with the tiles dealt by estimated cost, most expensive first
+};
+
+static const char* TileScheduleName(TileSchedule schedule) {
+	switch (schedule) {
+	case TileSchedule::Stealing: return "stealing";
+	case TileSchedule::Cost: return "cost";
+	default: return "shared";
+	}
+}
+
+static bool ParseTileSchedule(const std::string &name, TileSchedule &schedule) {
+	const TileSchedule all[] = { TileSchedule::Shared, TileSchedule::Stealing, TileSchedule::Cost };
+	for (TileSchedule s : all)
+		if (name == TileScheduleName(s)) {
+			schedule = s;
+			return true;
+		}
+	return false;
+}
+
+// Pixels [X0, X1) x [Y0, Y1) of the image and the cost estimated for them.
+struct Tile {
+	int X0, Y0, X1, Y1;
+	double Cost;
+};
+
+// Work of a worker during the last Run. Stolen counts the tiles taken from other deques.
+struct TileWorkerStatistics {
+	int Tiles = 0;
+	int Stolen = 0;
+	double Cost = 0;
+	double BusySeconds = 0;
+};
+
+// Splits an image in square tiles and runs them over the threads of a pool. Every worker owns a
+// deque: it takes its tiles from the front and, once empty, steals from the back of the others,
+// so the cheapest tiles left are the ones that fill the end of a pass. Costs come from a per pixel
+// buffer of the previous passes (the Complexity of RenderTarget) or are the pixel counts.
+class TileScheduler {
+	struct Queue {
+		std::mutex mutex;
+		std::deque<int> tiles;
+	};
+
+	std::vector<Tile> tiles;
+	std::unique_ptr<Queue[]> queues;
+	int queueCount = 0;
+	std::vector<TileWorkerStatistics> statistics;
+	double seconds = 0;
+
+	bool PopOwn(int queue, int &tile) {
+		Queue &q = queues[queue];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.tiles.empty())
+			return false;
+		tile = q.tiles.front();
+		q.tiles.pop_front();
+		return true;
+	}
+
+	bool Steal(int queue, int &tile) {
+		for (int i = 1; i < queueCount; i++) {
+			Queue &q = queues[(queue + i) % queueCount];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.tiles.empty()) {
+				tile = q.tiles.back();
+				q.tiles.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Distribute(int workers, TileSchedule schedule) {
+		queueCount = schedule == TileSchedule::Shared ? 1 : workers;
+		queues.reset(new Queue[queueCount]);
+		const int count = (int)tiles.size();
+		if (schedule != TileSchedule::Cost) {
+			for (int q = 0; q < queueCount; q++)
+				for (int t = (int)((long long)count * q / queueCount); t < (int)((long long)count * (q + 1) / queueCount); t++)
+					queues[q].tiles.push_back(t);
+			return;
+		}
+		// Longest processing time first: the next most expensive tile goes to the least loaded deque.
+		std::vector<int> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return tiles[a].Cost > tiles[b].Cost; });
+		std::vector<double> load(queueCount, 0.0);
+		for (int t : order) {
+			int q = (int)(std::min_element(load.begin(), load.end()) - load.begin());
+			load[q] += tiles[t].Cost;
+			queues[q].tiles.push_back(t);
+		}
+	}
+
+public:
+	// Tiles of size x size pixels in scanline order. cost (width x height, optional) is summed per
+	// tile, divided by passes (per pixel, optional). active (per tile, optional) skips the tiles at 0.
+	void Split(int width, int height, int size, const uint32_t* cost = nullptr, const uint32_t* passes = nullptr, const uint8_t* active = nullptr) {
+		if (size < 1)
+			size = 1;
+		tiles.clear();
+		int index = 0;
+		for (int y0 = 0; y0 < height; y0 += size)
+			for (int x0 = 0; x0 < width; x0 += size, index++) {
+				if (active && !active[index])
+					continue;
+				Tile tile = { x0, y0, std::min(x0 + size, width), std::min(y0 + size, height), 0 };
+				for (int y = tile.Y0; y < tile.Y1; y++)
+					for (int x = tile.X0; x < tile.X1; x++) {
+						int pixel = y * width + x;
+						tile.Cost += !cost ? 1 : passes ? cost[pixel] / (double)std::max(1u, passes[pixel]) : cost[pixel];
+					}
+				tiles.push_back(tile);
+			}
+	}
+
+	static int TileCount(int width, int height, int size) {
+		if (size < 1)
+			size = 1;
+		return ((width + size - 1) / size) * ((height + size - 1) / size);
+	}
+
+	const std::vector<Tile>& Tiles() const { return tiles; }
+
+	// body(tile, threadIndex) for every tile, returns when all of them were processed.
+	void Run(ThreadPool &pool, TileSchedule schedule, const std::function<void(const Tile&, int)> &body) {
+		const int workers = pool.ThreadCount();
+		statistics.assign(workers, TileWorkerStatistics());
+		Distribute(workers, schedule);
+		Stopwatch watch;
+		// A chunk per worker, a thread running more than one chunk finds the deques already empty.
+		pool.ParallelFor(workers, 1, [&](int, int, int thread) {
+			TileWorkerStatistics &s = statistics[thread];
+			const int own = thread % queueCount;
+			int tile;
+			while (true) {
+				bool stolen = false;
+				if (!PopOwn(own, tile)) {
+					if (!Steal(own, tile))
+						return; // tiles are never added during a run
+					stolen = true;
+				}
+				Stopwatch busy;
+				body(tiles[tile], thread);
+				s.BusySeconds += busy.Seconds();
+				s.Tiles++;
+				s.Stolen += stolen;
+				s.Cost += tiles[tile].Cost;
+			}
+		});
+		seconds = watch.Seconds();
+	}
+
+	const std::vector<TileWorkerStatistics>& Statistics() const { return statistics; }
+
+	// Wall time of the last Run.
+	double Seconds() const { return seconds; }
+
+	// Busy time of a worker over the wall time of the last Run.
+	double Utilization(int worker) const {
+		return seconds > 0 ? statistics[worker].BusySeconds / seconds : 0;
+	}
+
+	double MinimumUtilization() const {
+		double u = 1;
+		for (int w = 0; w < (int)statistics.size(); w++)
+			u = std::min(u, Utilization(w));
+		return u;
+	}
+
+	double MeanUtilization() const {
+		double u = 0;
+		for (int w = 0; w < (int)statistics.size(); w++)
+			u += Utilization(w);
+		return statistics.empty() ? 0 : u / statistics.size();
+	}
+
+	int StolenTiles() const {
+		int stolen = 0;
+		for (const TileWorkerStatistics &s : statistics)
+			stolen += s.Stolen;
+		return stolen;
+	}
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef OFFLINE_CVAETRAININGDATA_H
+#define OFFLINE_CVAETRAININGDATA_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/Philox.h"
+#include "../Common/ColumnFile.h"
+#include "../Samplers/ExactSampler.h"
+
+// Training data of the CVAE scattering model: random walks inside the unit sphere with the
+// physics of ExactSampleCosXAndW. Every row is one walk entering at the center along +z.
+//	inputs: Density (er), G, Phi
+//	outputs: N (scatterings), Exited, X (exit position), W (exit direction)
+// Sample i always uses the Philox stream (seed, i) and the stratum i % strata, so the file only
+// depends on the settings, not on the number of threads or the chunk scheduling.
+struct CVAETrainingSettings {
+	uint64_t Seed = 1;
+	uint64_t Samples = 1 << 24;
+	int ChunkRows = 1 << 16;
+	// Density is stratified in log scale
+	float DensityMin = 1, DensityMax = 256;
+	// G is stratified linearly
+	float GMin = -0.99f, GMax = 0.99f;
+	// Phi is stratified linearly in log(1 / (1 - phi)) as the STF albedo bins
+	float PhiMin = 0, PhiMax = 0.999f;
+	int DensityStrata = 16, GStrata = 16, PhiStrata = 8;
+
+	std::string Metadata() const {
+		char text[512];
+		snprintf(text, sizeof(text),
+			"generator=cvae-training\nseed=%llu\nsamples=%llu\nchunk=%d\n"
+			"density=%g,%g,%d\ng=%g,%g,%d\nphi=%g,%g,%d\n",
+			(unsigned long long)Seed, (unsigned long long)Samples, ChunkRows,
+			DensityMin, DensityMax, DensityStrata, GMin, GMax, GStrata, PhiMin, PhiMax, PhiStrata);
+		return text;
+	}
+
+	// Medium parameters of sample i
+	void Medium(uint64_t i, PhiloxGenerator &rng, float &density, float &g, float &phi) const {
+		uint64_t stratum = i % (uint64_t)(DensityStrata * GStrata * PhiStrata);
+		int d = (int)(stratum % DensityStrata);
+		int s = (int)(stratum / DensityStrata % GStrata);
+		int p = (int)(stratum / (DensityStrata * GStrata));
+		float u = (d + rng.random()) / DensityStrata;
+		density = expf(logf(DensityMin) + (logf(DensityMax) - logf(DensityMin)) * u);
+		u = (s + rng.random()) / GStrata;
+		g = GMin + (GMax - GMin) * u;
+		u = (p + rng.random()) / PhiStrata;
+		float a = logf(1 / (1 - PhiMin)), b = logf(1 / (1 - PhiMax));
+		phi = 1 - expf(-(a + (b - a) * u));
+	}
+};
+
+// Columns of one chunk while it is generated.
+struct CVAETrainingChunk {
+	std::vector<float> Density, G, Phi;
+	std::vector<int32_t> N;
+	std::vector<uint8_t> Exited;
+	std::vector<float> X[3], W[3];
+	EncodedChunk Encoded;
+	long long Steps = 0;
+
+	static std::vector<ColumnFileColumn> Columns() {
+		return {
+			{ "Density", ColumnType::Float32 }, { "G", ColumnType::Float32 }, { "Phi", ColumnType::Float32 },
+			{ "N", ColumnType::Int32 }, { "Exited", ColumnType::UInt8 },
+			{ "X.x", ColumnType::Float32 }, { "X.y", ColumnType::Float32 }, { "X.z", ColumnType::Float32 },
+			{ "W.x", ColumnType::Float32 }, { "W.y", ColumnType::Float32 }, { "W.z", ColumnType::Float32 }
+		};
+	}
+
+	void Generate(const CVAETrainingSettings &settings, uint64_t first, int rows) {
+		Density.resize(rows); G.resize(rows); Phi.resize(rows);
+		N.resize(rows); Exited.resize(rows);
+		for (int c = 0; c < 3; c++) {
+			X[c].resize(rows);
+			W[c].resize(rows);
+		}
+		Steps = 0;
+		for (int r = 0; r < rows; r++)
+		{
+			PhiloxGenerator rng(settings.Seed, first + r);
+			settings.Medium(first + r, rng, Density[r], G[r], Phi[r]);
+			float3 x, w;
+			int n;
+			bool exited = ExactRandomWalk(rng, G[r], Phi[r], Density[r], x, w, n);
+			N[r] = n;
+			Exited[r] = exited;
+			const float xc[3] = { x.x, x.y, x.z }, wc[3] = { w.x, w.y, w.z };
+			for (int c = 0; c < 3; c++) {
+				X[c][r] = exited ? xc[c] : 0;
+				W[c][r] = exited ? wc[c] : 0;
+			}
+			Steps += n + 1;
+		}
+	}
+
+	void Encode(const ColumnFileWriter &writer) {
+		const void* data[11] = {
+			Density.data(), G.data(), Phi.data(), N.data(), Exited.data(),
+			X[0].data(), X[1].data(), X[2].data(), W[0].data(), W[1].data(), W[2].data()
+		};
+		writer.Encode(data, (uint32_t)Density.size(), Encoded);
+	}
+};
+
+// Generates the CVAE training set in a chunked columnar file (see ColumnFile.h).
+// Workers generate and encode whole chunks, the main thread writes them in order.
+//	out=cvae_training.bin samples=16777216 seed=1 chunk=65536 threads=0 compress=1
+//	density=1,256 g=-0.99,0.99 phi=0,0.999 strata=16,16,8
+static int CVAETrainingDataGenerator(const CommandLine &args) {
+	CVAETrainingSettings settings;
+	settings.Seed = (uint64_t)args.Int("seed", 1);
+	settings.Samples = (uint64_t)args.Int("samples", 1 << 24);
+	settings.ChunkRows = (int)args.Int("chunk", 1 << 16);
+	std::vector<float> range = args.Floats("density", "1,256");
+	if (range.size() == 2) { settings.DensityMin = range[0]; settings.DensityMax = range[1]; }
+	range = args.Floats("g", "-0.99,0.99");
+	if (range.size() == 2) { settings.GMin = range[0]; settings.GMax = range[1]; }
+	range = args.Floats("phi", "0,0.999");
+	if (range.size() == 2) { settings.PhiMin = range[0]; settings.PhiMax = range[1]; }
+	range = args.Floats("strata", "16,16,8");
+	if (range.size() == 3) {
+		settings.DensityStrata = (int)maxf(1.0f, range[0]);
+		settings.GStrata = (int)maxf(1.0f, range[1]);
+		settings.PhiStrata = (int)maxf(1.0f, range[2]);
+	}
+	if (settings.ChunkRows <= 0 || settings.DensityMin <= 0 || settings.PhiMax >= 1 || settings.PhiMin > settings.PhiMax) {
+		printf("Invalid settings\n");
+		return 1;
+	}
+	std::string path = args.String("out", "cvae_training.bin");
+	ColumnCodec codec = args.Int("compress", 1) ? ColumnCodec::ShuffleRLE : ColumnCodec::None;
+
+	ThreadPool pool((int)args.Int("threads", 0));
+	ColumnFileWriter writer;
+	if (!writer.Open(path.c_str(), CVAETrainingChunk::Columns(), codec, settings.Metadata())) {
+		printf("Can not create %s\n", path.c_str());
+		return 1;
+	}
+	printf("Generating %llu samples into %s with %d threads\n%s",
+		(unsigned long long)settings.Samples, path.c_str(), pool.ThreadCount(), settings.Metadata().c_str());
+
+	uint64_t chunks = (settings.Samples + settings.ChunkRows - 1) / settings.ChunkRows;
+	// a round gives a few chunks to every thread, then they are written in order
+	int roundChunks = pool.ThreadCount() * 2;
+	std::vector<CVAETrainingChunk> round(roundChunks);
+	uint64_t rawBytes = 0, storedBytes = 0;
+	long long steps = 0;
+	Stopwatch watch;
+	double lastReport = 0;
+
+	for (uint64_t first = 0; first < chunks; first += roundChunks)
+	{
+		int count = (int)(chunks - first < (uint64_t)roundChunks ? chunks - first : roundChunks);
+		pool.ParallelFor(count, 1, [&](int b, int e, int) {
+			for (int c = b; c < e; c++) {
+				uint64_t firstRow = (first + c) * settings.ChunkRows;
+				int rows = (int)(settings.Samples - firstRow < (uint64_t)settings.ChunkRows ? settings.Samples - firstRow : settings.ChunkRows);
+				round[c].Generate(settings, firstRow, rows);
+				round[c].Encode(writer);
+			}
+		});
+		for (int c = 0; c < count; c++) {
+			if (!writer.Write(round[c].Encoded)) {
+				printf("Error writing %s\n", path.c_str());
+				return 1;
+			}
+			for (auto &column : round[c].Encoded.Columns)
+				storedBytes += column.size();
+			rawBytes += round[c].Density.size() * (10 * sizeof(float) + 1);
+			steps += round[c].Steps;
+		}
+
+		double seconds = watch.Seconds();
+		uint64_t done = first + count == chunks ? settings.Samples : (first + count) * settings.ChunkRows;
+		if (seconds - lastReport > 2 || done == settings.Samples) {
+			lastReport = seconds;
+			double rate = done / seconds;
+			printf("%6.2f%% %llu samples, %.3f G samples/hour, %.1f steps/sample, ratio %.3f, eta %.0fs\n",
+				done * 100.0 / settings.Samples, (unsigned long long)done, rate * 3600 * 1e-9,
+				steps / (double)done, storedBytes / (double)rawBytes, (settings.Samples - done) / rate);
+		}
+	}
+	if (!writer.Close()) {
+		printf("Error writing %s\n", path.c_str());
+		return 1;
+	}
+	printf("Done in %.1fs\n", watch.Seconds());
+	return 0;
+}
+
+#endif
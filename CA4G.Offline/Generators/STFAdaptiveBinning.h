@@ -0,0 +1,246 @@
+#ifndef OFFLINE_STFADAPTIVEBINNING_H
+#define OFFLINE_STFADAPTIVEBINNING_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/TableFiles.h"
+#include "../Samplers/STFSampler.h"
+
+// Builds STF tables with adaptive g and phi bins (kind stf_adaptive, see TableBins.h) from the
+// uniform stf2.bin. The fine bins of an axis are grouped into coarse bins that take equal shares of
+// the table change along the axis, the coarse values are the means of their fine bins.
+// r keeps its powers of two (the samplers round stochastically between them) and theta its
+// uniform bins (it is the variable sampled inside a row).
+
+// Coarse bins of an axis as ranges of fine bins.
+struct AdaptiveAxis {
+	// first fine bin of every coarse bin, the fine count at the end
+	std::vector<int> First;
+	// coarse bin of every fine bin
+	std::vector<int> Coarse;
+
+	int Count() const { return (int)First.size() - 1; }
+
+	void Map() {
+		Coarse.resize(First.back());
+		for (int c = 0; c < Count(); c++)
+			for (int f = First[c]; f < First[c + 1]; f++)
+				Coarse[f] = c;
+	}
+
+	// Edges in [0, 1] of the first coarse bins, the fine bins of those are uniform in u.
+	void Edges(int coarse, int fine, float* edges) const {
+		for (int c = 0; c <= coarse; c++)
+			edges[c] = First[c] / (float)fine;
+	}
+};
+
+// Groups n fine bins into m. differences[k] is the change between the fine bins k and k + 1,
+// every fine bin weights floor / n plus 1 - floor times its share of the changes to its
+// neighbours, and coarse bins take equal parts of the total weight (floor = 1 is uniform).
+static AdaptiveAxis PlaceAdaptiveEdges(const std::vector<double> &differences, int n, int m, double floor) {
+	std::vector<double> weight(n);
+	double total = 0;
+	for (int k = 0; k < n; k++) {
+		weight[k] = ((k > 0 ? differences[k - 1] : 0) + (k < n - 1 ? differences[k] : 0)) * 0.5;
+		total += weight[k];
+	}
+	for (int k = 0; k < n; k++)
+		weight[k] = floor / n + (1 - floor) * (total > 0 ? weight[k] / total : 1.0 / n);
+	AdaptiveAxis axis;
+	axis.First.push_back(0);
+	double prefix = 0;
+	int k = 0;
+	for (int c = 1; c < m; c++) {
+		double target = c / (double)m;
+		// at least one fine bin per coarse bin, the nearest boundary to the target otherwise
+		int first = axis.First.back() + 1;
+		while (k < first)
+			prefix += weight[k++];
+		while (k < n - (m - c) && prefix + weight[k] * 0.5 < target)
+			prefix += weight[k++];
+		axis.First.push_back(k);
+	}
+	axis.First.push_back(n);
+	axis.Map();
+	return axis;
+}
+
+// Fills the TABLE_BIN_LOOKUP bins of u = i / TABLE_BIN_LOOKUP for count bins with edges.
+static void BuildBinLookup(const float* edges, int count, uint32_t* lookup) {
+	int bin = 0;
+	for (int i = 0; i < TABLE_BIN_LOOKUP; i++) {
+		float u = i / (float)TABLE_BIN_LOOKUP;
+		while (bin < count - 1 && u >= edges[bin + 1])
+			bin++;
+		lookup[i] = bin;
+	}
+}
+
+// Change between two (g, phi, r) entries of the uniform tables: albedos and the mean over theta
+// of the cumulative s^m rows.
+static double STFEntryDifference(const STFTables &t, size_t a, size_t b) {
+	double d = fabs((double)t.OneTimeSA[a] - t.OneTimeSA[b]) + fabs((double)t.MultiTimeSA[a] - t.MultiTimeSA[b]);
+	const float* ra = t.STF + a * STFTables::BINS_THETA;
+	const float* rb = t.STF + b * STFTables::BINS_THETA;
+	double rows = 0;
+	for (int i = 0; i < STFTables::BINS_THETA; i++)
+		rows += fabs((double)ra[i] - rb[i]);
+	return d + rows / STFTables::BINS_THETA;
+}
+
+// Coarse tables of the fine ones grouped by the axes: means of the albedos and the rows.
+struct STFCoarseTables {
+	int BinsG, BinsSA;
+	std::vector<float> OneTimeSA, MultiTimeSA, STF;
+
+	STFCoarseTables(const STFTables &fine, const AdaptiveAxis &g, const AdaptiveAxis &sa) : BinsG(g.Count()), BinsSA(sa.Count()) {
+		size_t entries = (size_t)BinsG * BinsSA * STFTables::BINS_R;
+		std::vector<double> one(entries, 0), multi(entries, 0), rows(entries * STFTables::BINS_THETA, 0);
+		for (int fg = 0; fg < STFTables::BINS_G; fg++)
+			for (int fs = 0; fs < STFTables::BINS_SA; fs++)
+				for (int r = 0; r < STFTables::BINS_R; r++)
+				{
+					size_t f = ((size_t)fg * STFTables::BINS_SA + fs) * STFTables::BINS_R + r;
+					size_t c = ((size_t)g.Coarse[fg] * BinsSA + sa.Coarse[fs]) * STFTables::BINS_R + r;
+					one[c] += fine.OneTimeSA[f];
+					multi[c] += fine.MultiTimeSA[f];
+					for (int t = 0; t < STFTables::BINS_THETA; t++)
+						rows[c * STFTables::BINS_THETA + t] += fine.STF[f * STFTables::BINS_THETA + t];
+				}
+		OneTimeSA.resize(entries);
+		MultiTimeSA.resize(entries);
+		STF.resize(rows.size());
+		for (int cg = 0; cg < BinsG; cg++)
+			for (int cs = 0; cs < BinsSA; cs++)
+			{
+				double count = (double)(g.First[cg + 1] - g.First[cg]) * (sa.First[cs + 1] - sa.First[cs]);
+				for (int r = 0; r < STFTables::BINS_R; r++) {
+					size_t c = ((size_t)cg * BinsSA + cs) * STFTables::BINS_R + r;
+					OneTimeSA[c] = (float)(one[c] / count);
+					MultiTimeSA[c] = (float)(multi[c] / count);
+					for (int t = 0; t < STFTables::BINS_THETA; t++)
+						STF[c * STFTables::BINS_THETA + t] = (float)(rows[c * STFTables::BINS_THETA + t] / count);
+				}
+			}
+	}
+
+	// Mean STFEntryDifference of the fine entries to the coarse entries that replace them.
+	double Error(const STFTables &fine, const AdaptiveAxis &g, const AdaptiveAxis &sa) const {
+		double error = 0;
+		for (int fg = 0; fg < STFTables::BINS_G; fg++)
+			for (int fs = 0; fs < STFTables::BINS_SA; fs++)
+				for (int r = 0; r < STFTables::BINS_R; r++)
+				{
+					size_t f = ((size_t)fg * STFTables::BINS_SA + fs) * STFTables::BINS_R + r;
+					size_t c = ((size_t)g.Coarse[fg] * BinsSA + sa.Coarse[fs]) * STFTables::BINS_R + r;
+					double d = fabs((double)fine.OneTimeSA[f] - OneTimeSA[c]) + fabs((double)fine.MultiTimeSA[f] - MultiTimeSA[c]);
+					double rows = 0;
+					for (int t = 0; t < STFTables::BINS_THETA; t++)
+						rows += fabs((double)fine.STF[f * STFTables::BINS_THETA + t] - STF[c * STFTables::BINS_THETA + t]);
+					error += d + rows / STFTables::BINS_THETA;
+				}
+		return error / ((double)STFTables::BINS_G * STFTables::BINS_SA * STFTables::BINS_R);
+	}
+};
+
+// Axes of g bins x sa bins for the fine tables, floor = 1 gives uniform coarse bins.
+// The last two phi bins (phi = 0.999 and above) stay as they are.
+static void PlaceSTFAxes(const STFTables &fine, int binsG, int binsSA, double floor, AdaptiveAxis &g, AdaptiveAxis &sa) {
+	const int regular = STFTables::BINS_SA - 2;
+	std::vector<double> dG(STFTables::BINS_G - 1, 0), dSA(regular - 1, 0);
+	for (int fg = 0; fg < STFTables::BINS_G; fg++)
+		for (int fs = 0; fs < STFTables::BINS_SA; fs++)
+			for (int r = 0; r < STFTables::BINS_R; r++)
+			{
+				size_t f = ((size_t)fg * STFTables::BINS_SA + fs) * STFTables::BINS_R + r;
+				if (fg + 1 < STFTables::BINS_G)
+					dG[fg] += STFEntryDifference(fine, f, f + (size_t)STFTables::BINS_SA * STFTables::BINS_R);
+				if (fs + 1 < regular)
+					dSA[fs] += STFEntryDifference(fine, f, f + STFTables::BINS_R);
+			}
+	g = PlaceAdaptiveEdges(dG, STFTables::BINS_G, binsG, floor);
+	sa = PlaceAdaptiveEdges(dSA, regular, binsSA - 2, floor);
+	sa.First.push_back(regular + 1);
+	sa.First.push_back(regular + 2);
+	sa.Map();
+}
+
+// Writes the adaptive tables of stf2.bin and reports their mean difference to the fine tables
+// next to the one of uniform bins of the same size. floor is the part of the bins spread
+// uniformly, the rest follows the change of the tables (1 gives uniform bins).
+//	in=stf2.bin out=stf_adaptive.bin g=64 sa=128 floor=0.25 alias=1
+static int STFAdaptiveBinning(const CommandLine &args) {
+	std::string in = args.String("in", "stf2.bin"), out = args.String("out", "stf_adaptive.bin");
+	int binsG = (int)args.Int("g", 64), binsSA = (int)args.Int("sa", 128);
+	double floor = args.Float("floor", 0.25f);
+	bool alias = args.Int("alias", 1) != 0;
+	if (binsG < 1 || binsG > STFTables::BINS_G || binsSA < 3 || binsSA > STFTables::BINS_SA || floor < 0 || floor > 1) {
+		printf("Invalid bins or floor\n");
+		return 1;
+	}
+	STFTables fine;
+	if (!fine.Load(in.c_str()) || !fine.Remap.empty() || fine.Binning.Edges) {
+		printf("%s is not a uniform STF table\n", in.c_str());
+		return 1;
+	}
+	Stopwatch watch;
+	AdaptiveAxis g, sa, uniformG, uniformSA;
+	PlaceSTFAxes(fine, binsG, binsSA, floor, g, sa);
+	PlaceSTFAxes(fine, binsG, binsSA, 1, uniformG, uniformSA);
+	STFCoarseTables adaptive(fine, g, sa), uniform(fine, uniformG, uniformSA);
+
+	TableFileHeader h = STFTables::CreateAdaptiveHeader(binsG, binsSA, alias);
+	CopyTableGenerator(h, fine.File.Header());
+	std::vector<float> edges(binsG + binsSA);
+	g.Edges(binsG, STFTables::BINS_G, edges.data());
+	sa.Edges(binsSA - 2, STFTables::BINS_SA - 2, edges.data() + binsG + 1);
+	std::vector<uint32_t> lookup(2 * TABLE_BIN_LOOKUP), aliasSTF(alias ? adaptive.STF.size() : 0);
+	BuildBinLookup(edges.data(), binsG, lookup.data());
+	BuildBinLookup(edges.data() + binsG + 1, binsSA - 2, lookup.data() + TABLE_BIN_LOOKUP);
+	for (size_t row = 0; row < aliasSTF.size(); row += STFTables::BINS_THETA)
+		BuildAliasTable(adaptive.STF.data() + row, STFTables::BINS_THETA, aliasSTF.data() + row);
+
+	const void* data[] = { adaptive.OneTimeSA.data(), adaptive.MultiTimeSA.data(), adaptive.STF.data(), aliasSTF.data() };
+	FILE* f = OpenFile(out.c_str(), "wb");
+	bool ok = f && WriteTableHeader(f, h);
+	for (uint32_t i = 0; ok && i < h.SectionCount; i++) {
+		TableSection &s = h.Sections[i];
+		const void* section = strcmp(s.Name, "Edges") == 0 ? (const void*)edges.data() :
+			strcmp(s.Name, "Lookup") == 0 ? (const void*)lookup.data() : data[i];
+		s.Checksum = TableChecksum(section, s.Bytes());
+		ok = WriteTableSection(f, s, section);
+	}
+	ok = ok && SeekFile(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1;
+	if (f)
+		ok &= fclose(f) == 0;
+	if (!ok) {
+		printf("Error writing %s\n", out.c_str());
+		return 1;
+	}
+
+	double fineBytes = (double)fine.File.Size();
+	printf("%s -> %s: %d x %d bins (%.1f MB, x%.0f smaller) in %.1fs\n", in.c_str(), out.c_str(), binsG, binsSA,
+		TableFileSize(h) / (double)(1 << 20), fineBytes / TableFileSize(h), watch.Seconds());
+	int narrowG = STFTables::BINS_G, wideG = 0, narrowSA = STFTables::BINS_SA, wideSA = 0;
+	for (int c = 0; c < binsG; c++) {
+		int w = g.First[c + 1] - g.First[c];
+		narrowG = w < narrowG ? w : narrowG;
+		wideG = w > wideG ? w : wideG;
+	}
+	for (int c = 0; c < binsSA - 2; c++) {
+		int w = sa.First[c + 1] - sa.First[c];
+		narrowSA = w < narrowSA ? w : narrowSA;
+		wideSA = w > wideSA ? w : wideSA;
+	}
+	printf("  fine bins per bin: g %d..%d, phi %d..%d (uniform %.1f, %.1f)\n", narrowG, wideG, narrowSA, wideSA,
+		STFTables::BINS_G / (double)binsG, (STFTables::BINS_SA - 2) / (double)(binsSA - 2));
+	printf("  mean difference to the fine tables: adaptive %.6f, uniform %.6f\n",
+		adaptive.Error(fine, g, sa), uniform.Error(fine, uniformG, uniformSA));
+	return 0;
+}
+
+#endif
@@ -0,0 +1,511 @@
+#ifndef OFFLINE_STFTABLEGENERATOR_H
+#define OFFLINE_STFTABLEGENERATOR_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/Philox.h"
+#include "../Common/TableFiles.h"
+#include "../Samplers/STFSampler.h"
+#include "../Samplers/STFXSampler.h"
+
+// Generates stf2.bin (STFTechnique) and stfx.bin (STFXTechnique) with the random walk of
+// ExactSampleCosXAndW. A cell is one (g, r) bin of the table, every walk of a cell runs without
+// absorption (phi = 1) and is weighted afterwards by phi^N, so one set of walks fills all the
+// albedo bins of STF and gives the scattering count STFX samples absorption with.
+// Walk i of cell c uses the Philox stream (seed, c * walks + i), g is jittered inside its bin.
+// Cells are written in place in the sections of the table file (TableFile.h), the checksums
+// of the header are computed once all cells are done.
+
+// Scratch histogram of a worker. Touched keeps the non zero entries to merge them cheaply.
+struct TableScratch {
+	std::vector<double> Values;
+	std::vector<int> Touched;
+	long long Steps = 0;
+
+	void Add(int index, double value) {
+		if (value == 0)
+			return;
+		if (Values[index] == 0)
+			Touched.push_back(index);
+		Values[index] += value;
+	}
+};
+
+// stf2.bin: sections OneTimeSA[g, phi, r], MultiTimeSA[g, phi, r], STF[g, phi, r, theta].
+// Cell histogram: s^1 per phi bin, s^m per phi bin and the s^m mass per (phi, theta) bin.
+// r of the bin k is 2^k (the sampler rounds stochastically between powers of two).
+// With slices only the g bins of the slices are walked and only the slices are written
+// (kind stf_slices, see TableSlices.h), the cells are the (column, r) of those g bins.
+struct STFTableLayout {
+	static const int BINS_G = STFTables::BINS_G;
+	static const int BINS_SA = STFTables::BINS_SA;
+	static const int BINS_R = STFTables::BINS_R;
+	static const int BINS_THETA = STFTables::BINS_THETA;
+
+	const char* Name() const { return "stf"; }
+	const char* DefaultPath() const { return slices ? "stf_slices.bin" : "stf2.bin"; }
+	int Cells() const { return (slices ? (int)columns.size() : BINS_G) * BINS_R; }
+	int HistogramSize() const { return 2 * BINS_SA + BINS_SA * BINS_THETA; }
+	TableFileHeader Header() const { return header; }
+	std::string Bins() const {
+		char text[128];
+		int length = snprintf(text, sizeof(text), "g=%d,sa=%d,r=%d,theta=%d", BINS_G, BINS_SA, BINS_R, BINS_THETA);
+		if (slices)
+			snprintf(text + length, sizeof(text) - length, ",slices=%d:%016llx", slices->Count(),
+				(unsigned long long)TableChecksum(slices->Keys.data(), slices->Keys.size() * sizeof(uint32_t)));
+		return text;
+	}
+
+	int Column(int cell) const { return slices ? columns[cell / BINS_R] : cell / BINS_R; }
+	float Radius(int cell) const { return powf(2.0f, (float)(cell % BINS_R)); }
+	float G(int cell, float u) const { return -1 + 2 * (Column(cell) + u) / BINS_G; }
+
+	// log(phi) at the two Gauss-Legendre nodes of every albedo bin
+	std::vector<double> LogPhi;
+
+	// The sampler bins phi linearly in L = log(1 / (1 - phi)) up to 0.999 (bins 0..SA-3),
+	// SA-2 only gets phi = 0.999 and SA-1 takes (0.999, 1].
+	// sections OneTimeSA, MultiTimeSA, STF and Alias_STF if alias (Slices, SA, STF, Alias_STF with slices)
+	TableFileHeader header;
+	bool alias;
+	// slices to write, null for the whole tables
+	const STFTableSlices* slices;
+	// g bins of the slices, ascending
+	std::vector<int> columns;
+	// file offsets of the s^1 and s^m albedos, STF and Alias_STF are the sections 2 and 3 in both kinds
+	uint64_t oneTimeOffset, multiTimeOffset;
+
+	STFTableLayout(bool alias, const STFTableSlices* slices = nullptr) : LogPhi(2 * (BINS_SA - 2)),
+		header(slices ? STFTables::CreateSlicesHeader(slices->Count(), alias) : STFTables::CreateHeader(alias)),
+		alias(alias), slices(slices) {
+		oneTimeOffset = header.Sections[slices ? 1 : 0].Offset;
+		multiTimeOffset = slices ? oneTimeOffset + (uint64_t)slices->Count() * BINS_R * sizeof(float) : header.Sections[1].Offset;
+		if (slices) {
+			std::vector<bool> used(BINS_G, false);
+			for (uint32_t key : slices->Keys)
+				used[key / BINS_SA] = true;
+			for (int g = 0; g < BINS_G; g++)
+				if (used[g])
+					columns.push_back(g);
+		}
+
+		const double dL = log(1000.0) / (BINS_SA - 2);
+		const double nodes[2] = { 0.5 - 0.5 / sqrt(3.0), 0.5 + 0.5 / sqrt(3.0) };
+		for (int b = 0; b < BINS_SA - 2; b++)
+			for (int k = 0; k < 2; k++)
+				LogPhi[2 * b + k] = log(1 - exp(-(b + nodes[k]) * dL));
+	}
+
+	// Weights are phi^n averaged over the bin, uniform in L for the first bins and in phi for the last.
+	void Walk(int cell, PhiloxGenerator &rng, TableScratch &scratch) const {
+		float3 x, w;
+		int n;
+		ExactRandomWalk(rng, G(cell, rng.random()), 1.0f, Radius(cell), x, w, n);
+		scratch.Steps += n + 1;
+		if (n == 0) // exp(-r) is analytic in the sampler
+			return;
+		int thetaBin = (int)((x.z + 1) * 0.5f * BINS_THETA);
+		thetaBin = thetaBin < 0 ? 0 : thetaBin >= BINS_THETA ? BINS_THETA - 1 : thetaBin;
+		int albedo = n == 1 ? 0 : BINS_SA;
+		int stf = 2 * BINS_SA + thetaBin;
+
+		double last[2] = { pow(0.999, n), (1 - pow(0.999, n + 1)) / ((n + 1) * 0.001) };
+		for (int b = BINS_SA - 2; b < BINS_SA; b++) {
+			scratch.Add(albedo + b, last[b - (BINS_SA - 2)]);
+			if (n > 1)
+				scratch.Add(stf + b * BINS_THETA, last[b - (BINS_SA - 2)]);
+		}
+		// phi^n decreases with the bin, lower bins are skipped once negligible
+		for (int b = BINS_SA - 3; b >= 0; b--) {
+			double weight = 0.5 * (exp(n * LogPhi[2 * b]) + exp(n * LogPhi[2 * b + 1]));
+			if (weight < 1e-30)
+				break;
+			scratch.Add(albedo + b, weight);
+			if (n > 1)
+				scratch.Add(stf + b * BINS_THETA, weight);
+		}
+	}
+
+	// Writes the keys of the slices once the file is created.
+	bool Prepare(FILE* f) const {
+		return !slices || WriteTableSection(f, header.Sections[0], slices->Keys.data());
+	}
+
+	// Albedos are probabilities over all the walks, STF rows the cumulative s^m mass (not
+	// normalized, the sampler searches it with a value in [0, s^m)).
+	bool Write(FILE* f, int cell, const double* histogram, int walks) const {
+		int g = Column(cell), r = cell % BINS_R;
+		double scale = 1.0 / walks;
+		for (int b = 0; b < BINS_SA; b++)
+		{
+			int slice = slices ? slices->Slice(g, b) : g * BINS_SA + b;
+			if (slice < 0)
+				continue;
+			uint64_t albedoIndex = (uint64_t)slice * BINS_R + r;
+			float one = (float)(histogram[b] * scale);
+			float multi = (float)(histogram[BINS_SA + b] * scale);
+			float row[BINS_THETA];
+			double cdf = 0;
+			for (int t = 0; t < BINS_THETA; t++) {
+				cdf += histogram[2 * BINS_SA + b * BINS_THETA + t];
+				row[t] = (float)(cdf * scale);
+			}
+			uint64_t stfIndex = (uint64_t)slice * STFTables::STRIDE_SA + (uint64_t)r * STFTables::STRIDE_R;
+			if (!SeekFile(f, oneTimeOffset + albedoIndex * sizeof(float)) || !WriteFloats(f, &one, 1) ||
+				!SeekFile(f, multiTimeOffset + albedoIndex * sizeof(float)) || !WriteFloats(f, &multi, 1) ||
+				!SeekFile(f, header.Sections[2].Offset + stfIndex * sizeof(float)) || !WriteFloats(f, row, BINS_THETA))
+				return false;
+			if (alias) {
+				uint32_t table[BINS_THETA];
+				BuildAliasTable(row, BINS_THETA, table);
+				if (!SeekFile(f, header.Sections[3].Offset + stfIndex * sizeof(uint32_t)) || fwrite(table, sizeof(uint32_t), BINS_THETA, f) != BINS_THETA)
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+// stfx.bin: sections CDF_LogN[g, r, logN] and CDF_XW[g, r, logN, xw] (both halves the technique splits).
+// Cell histogram: counts per logN bin and per (logN, xw) bin.
+// r of the bin k is 2^(k - 0.5), the sampler rounds log2(r) + 0.5 stochastically.
+struct STFXTableLayout {
+	static const int BINS_G = STFXTables::BINS_G;
+	static const int BINS_R = STFXTables::BINS_R;
+	static const int BINS_LOGN = STFXTables::BINS_LOGN;
+	static const int BINS_X = STFXTables::BINS_X;
+
+	const char* Name() const { return "stfx"; }
+	const char* DefaultPath() const { return "stfx.bin"; }
+	int Cells() const { return BINS_G * BINS_R; }
+	int HistogramSize() const { return BINS_LOGN + BINS_LOGN * BINS_X; }
+	TableFileHeader Header() const { return header; }
+	std::string Bins() const {
+		char text[128];
+		snprintf(text, sizeof(text), "g=%d,r=%d,logn=%d,theta=%d,beta=%d,alpha=%d", BINS_G, BINS_R, BINS_LOGN,
+			STFXTables::BINS_THETA, STFXTables::BINS_BETA, STFXTables::BINS_ALPHA);
+		return text;
+	}
+
+	// sections CDF_LogN, CDF_XW, Alias_LogN, Alias_XW if alias and Guide_XW if guide
+	TableFileHeader header;
+	bool alias, guide;
+
+	STFXTableLayout(bool alias, bool guide) : header(STFXTables::CreateHeader(alias, guide)), alias(alias), guide(guide) {}
+
+	bool Prepare(FILE*) const { return true; }
+
+	float Radius(int cell) const { return powf(2.0f, cell % BINS_R - 0.5f); }
+	float G(int cell, float u) const { return -1 + 2 * (cell / BINS_R + u) / BINS_G; }
+
+	static int Bin(float v, int bins) {
+		int b = (int)((v + 1) * 0.5f * bins);
+		return b < 0 ? 0 : b >= bins ? bins - 1 : b;
+	}
+
+	// The sampler draws logN = 8 * (bin + u) / BINS_LOGN and N = (int)exp(logN), the walks
+	// leaving without scattering go to the first bin with N = 1.
+	void Walk(int cell, PhiloxGenerator &rng, TableScratch &scratch) const {
+		float3 x, w;
+		int n;
+		ExactRandomWalk(rng, G(cell, rng.random()), 1.0f, Radius(cell), x, w, n);
+		scratch.Steps += n + 1;
+		ScatteringSample s = { 1, 0, 0, n, false };
+		CompactExitVariables(x, w, s);
+		int logNBin = n <= 1 ? 0 : (int)(logf((float)n) * BINS_LOGN / 8);
+		logNBin = logNBin < BINS_LOGN ? logNBin : BINS_LOGN - 1;
+		int xwBin = Bin(s.Theta, STFXTables::BINS_THETA) * (STFXTables::BINS_BETA * STFXTables::BINS_ALPHA) +
+			Bin(s.Beta, STFXTables::BINS_BETA) * STFXTables::BINS_ALPHA + Bin(s.Alpha, STFXTables::BINS_ALPHA);
+		scratch.Add(logNBin, 1);
+		scratch.Add(BINS_LOGN + logNBin * BINS_X + xwBin, 1);
+	}
+
+	// Normalized cdfs. A logN bin without walks (never selected) gets a uniform cdf.
+	bool Write(FILE* f, int cell, const double* histogram, int walks) const {
+		std::vector<float> cdf(BINS_LOGN * BINS_X);
+		float logN[BINS_LOGN];
+		double sum = 0;
+		for (int l = 0; l < BINS_LOGN; l++) {
+			sum += histogram[l];
+			logN[l] = (float)(sum / walks);
+		}
+		logN[BINS_LOGN - 1] = 1;
+		for (int l = 0; l < BINS_LOGN; l++) {
+			const double* h = histogram + BINS_LOGN + l * BINS_X;
+			float* c = cdf.data() + l * BINS_X;
+			double count = histogram[l];
+			sum = 0;
+			for (int x = 0; x < BINS_X; x++) {
+				sum += h[x];
+				c[x] = count > 0 ? (float)(sum / count) : (x + 1) / (float)BINS_X;
+			}
+			c[BINS_X - 1] = 1;
+		}
+		// cell = g * BINS_R + r as LOGN_G_STRIDE and LOGN_R_STRIDE index the tables
+		uint64_t logNOffset = (uint64_t)cell * BINS_LOGN;
+		if (!SeekFile(f, header.Sections[0].Offset + logNOffset * sizeof(float)) || !WriteFloats(f, logN, BINS_LOGN) ||
+			!SeekFile(f, header.Sections[1].Offset + logNOffset * BINS_X * sizeof(float)) || !WriteFloats(f, cdf.data(), cdf.size()))
+			return false;
+		if (guide) {
+			uint16_t xwGuide[BINS_LOGN * GUIDE_ENTRIES];
+			for (int l = 0; l < BINS_LOGN; l++)
+				BuildGuideTable(cdf.data() + l * BINS_X, BINS_X, xwGuide + l * GUIDE_ENTRIES);
+			if (!SeekFile(f, header.Sections[alias ? 4 : 2].Offset + logNOffset * GUIDE_ENTRIES * sizeof(uint16_t)) ||
+				fwrite(xwGuide, sizeof(uint16_t), BINS_LOGN * GUIDE_ENTRIES, f) != BINS_LOGN * GUIDE_ENTRIES)
+				return false;
+		}
+		if (!alias)
+			return true;
+		uint32_t logNAlias[BINS_LOGN];
+		BuildAliasTable(logN, BINS_LOGN, logNAlias);
+		std::vector<uint32_t> xwAlias(BINS_LOGN * BINS_X);
+		for (int l = 0; l < BINS_LOGN; l++)
+			BuildAliasTable(cdf.data() + l * BINS_X, BINS_X, xwAlias.data() + l * BINS_X);
+		return
+			SeekFile(f, header.Sections[2].Offset + logNOffset * sizeof(uint32_t)) && fwrite(logNAlias, sizeof(uint32_t), BINS_LOGN, f) == BINS_LOGN &&
+			SeekFile(f, header.Sections[3].Offset + logNOffset * BINS_X * sizeof(uint32_t)) && fwrite(xwAlias.data(), sizeof(uint32_t), xwAlias.size(), f) == xwAlias.size();
+	}
+};
+
+// Completed cells are appended to <out>.progress after their data is in the table, so a resumed
+// run (resume=1) only computes the missing ones. The first line must match the settings.
+class TableProgress {
+	FILE* file = nullptr;
+public:
+	~TableProgress() { if (file) fclose(file); }
+
+	// Returns false if the progress file exists for other settings or can not be written.
+	bool Open(const std::string &path, const std::string &signature, bool resume, std::vector<bool> &done) {
+		if (resume) {
+			FILE* f = OpenFile(path.c_str(), "r");
+			if (f) {
+				char line[512];
+				bool same = fgets(line, sizeof(line), f) && signature == line;
+				while (same && fgets(line, sizeof(line), f)) {
+					size_t length = strlen(line);
+					int cell = atoi(line);
+					// a line cut by a crash is ignored
+					if (length > 0 && line[length - 1] == '\n' && cell >= 0 && cell < (int)done.size())
+						done[cell] = true;
+				}
+				fclose(f);
+				if (!same) {
+					printf("%s was generated with other settings\n", path.c_str());
+					return false;
+				}
+				file = OpenFile(path.c_str(), "a");
+				return file != nullptr;
+			}
+		}
+		file = OpenFile(path.c_str(), "w");
+		return file && fputs(signature.c_str(), file) >= 0 && fflush(file) == 0;
+	}
+
+	bool Completed(int cell) {
+		return fprintf(file, "%d\n", cell) > 0 && fflush(file) == 0;
+	}
+};
+
+struct STFTableSettings {
+	uint64_t Seed = 1;
+	int Walks = 1 << 14;
+	int Batch = 1024;
+
+	template<typename TLayout>
+	std::string Signature(const TLayout &layout) const {
+		char text[512];
+		snprintf(text, sizeof(text), "table=%s format=%u alias=%d seed=%llu walks=%d %s\n", layout.Name(), TableFileHeader::VERSION,
+			(int)layout.alias, (unsigned long long)Seed, Walks, layout.Bins().c_str());
+		return text;
+	}
+};
+
+// Histogram of a cell shared by the tasks of its batches, allocated by the first one.
+// Batches merge their scratch with atomic adds, the last one to finish writes the cell.
+struct TableCell {
+	std::atomic<std::atomic<double>*> Histogram;
+	std::atomic<int> Remaining;
+};
+
+static void AtomicAdd(std::atomic<double> &target, double value) {
+	double current = target.load(std::memory_order_relaxed);
+	while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+		;
+}
+
+template<typename TLayout>
+static int GenerateTable(const TLayout &layout, const STFTableSettings &settings, const std::string &path, bool resume, ThreadPool &pool) {
+	int cells = layout.Cells();
+	std::vector<bool> done(cells, false);
+	TableProgress progress;
+	if (!progress.Open(path + ".progress", settings.Signature(layout), resume, done))
+		return 1;
+
+	FILE* table = nullptr;
+	if (resume && std::count(done.begin(), done.end(), true) > 0)
+		table = OpenFile(path.c_str(), "r+b");
+	else {
+		// sized up front, cells are written in place as they finish
+		TableFileHeader header = layout.Header();
+		header.Seed = settings.Seed;
+		header.Walks = (uint32_t)settings.Walks;
+		table = OpenFile(path.c_str(), "w+b");
+		if (table && (!WriteTableHeader(table, header) || !layout.Prepare(table))) {
+			fclose(table);
+			table = nullptr;
+		}
+	}
+	if (!table) {
+		printf("Can not open %s\n", path.c_str());
+		return 1;
+	}
+
+	// expensive cells (large radius, backward scattering) first so the last tasks are short
+	std::vector<int> order;
+	for (int c = 0; c < cells; c++)
+		if (!done[c])
+			order.push_back(c);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		float ra = layout.Radius(a), rb = layout.Radius(b);
+		return ra * ra * (1 - layout.G(a, 0.5f)) > rb * rb * (1 - layout.G(b, 0.5f));
+	});
+	int batches = (settings.Walks + settings.Batch - 1) / settings.Batch;
+	int size = layout.HistogramSize();
+
+	std::unique_ptr<TableCell[]> state(new TableCell[cells]);
+	for (int c = 0; c < cells; c++) {
+		state[c].Histogram = nullptr;
+		state[c].Remaining = batches;
+	}
+	std::vector<TableScratch> scratch(pool.ThreadCount());
+	for (auto &s : scratch)
+		s.Values.assign(size, 0.0);
+
+	std::mutex mutex; // allocation of cell histograms, file writes and reports
+	std::atomic<long long> steps(0);
+	std::atomic<bool> failed(false);
+	int pending = (int)order.size(), completed = 0;
+	Stopwatch watch;
+	double lastReport = 0;
+	printf("Generating %s: %d of %d cells left, %d walks per cell, %d threads\n%s",
+		path.c_str(), pending, cells, settings.Walks, pool.ThreadCount(), settings.Signature(layout).c_str());
+
+	pool.ParallelFor(pending * batches, 1, [&](int begin, int end, int thread) {
+		TableScratch &s = scratch[thread];
+		for (int task = begin; task < end && !failed; task++)
+		{
+			int cell = order[task / batches];
+			int batch = task % batches;
+			int first = batch * settings.Batch;
+			int count = settings.Walks - first < settings.Batch ? settings.Walks - first : settings.Batch;
+			s.Steps = 0;
+			for (int i = 0; i < count; i++) {
+				PhiloxGenerator rng(settings.Seed, (uint64_t)cell * settings.Walks + first + i);
+				layout.Walk(cell, rng, s);
+			}
+			steps += s.Steps;
+
+			std::atomic<double>* histogram = state[cell].Histogram.load(std::memory_order_acquire);
+			if (!histogram) {
+				std::lock_guard<std::mutex> lock(mutex);
+				histogram = state[cell].Histogram.load(std::memory_order_acquire);
+				if (!histogram) {
+					histogram = new std::atomic<double>[size];
+					for (int i = 0; i < size; i++)
+						histogram[i].store(0, std::memory_order_relaxed);
+					state[cell].Histogram.store(histogram, std::memory_order_release);
+				}
+			}
+			for (int i : s.Touched) {
+				AtomicAdd(histogram[i], s.Values[i]);
+				s.Values[i] = 0;
+			}
+			s.Touched.clear();
+
+			if (state[cell].Remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				continue;
+			// last batch of the cell
+			std::vector<double> values(size);
+			for (int i = 0; i < size; i++)
+				values[i] = histogram[i].load(std::memory_order_relaxed);
+			delete[] histogram;
+			state[cell].Histogram = nullptr;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!layout.Write(table, cell, values.data(), settings.Walks) || fflush(table) != 0 || !progress.Completed(cell)) {
+				failed = true;
+				continue;
+			}
+			completed++;
+			double seconds = watch.Seconds();
+			if (seconds - lastReport > 2 || completed == pending) {
+				lastReport = seconds;
+				printf("%6.2f%% %d cells, %.1f M steps/s, eta %.0fs\n", completed * 100.0 / pending, completed,
+					steps * 1e-6 / seconds, seconds * (pending - completed) / completed);
+				fflush(stdout);
+			}
+		}
+	});
+
+	bool ok = !failed && fclose(table) == 0;
+	if (!ok) {
+		printf("Error writing %s, run again with resume=1\n", path.c_str());
+		return 1;
+	}
+	if (!SealTableFile(path.c_str())) {
+		printf("Can not update the checksums of %s\n", path.c_str());
+		return 1;
+	}
+	printf("Done in %.1fs\n", watch.Seconds());
+	return 0;
+}
+
+// Generates the tables of the STF (table=stf) or STFX (table=stfx) techniques.
+// The eta assumes the remaining cells are cheaper, expensive cells go first.
+// alias=1 adds the alias tables of every cdf (see AliasTable.h), guide=1 the guide tables of the
+// STFX position-direction cdfs (see GuideTable.h).
+// gs and phis generate only the STF slices of those media (every g with every phi) and their
+// neighbour bins into stf_slices.bin, walking only their g bins (see TableSlices.h).
+//	table=stf|stfx out=stf2.bin|stfx.bin walks=16384 batch=1024 seed=1 threads=0 resume=0 alias=1 guide=1
+//	gs=0.875 phis=0.95,0.999 neighbours=1
+static int STFTableGenerator(const CommandLine &args) {
+	STFTableSettings settings;
+	settings.Seed = (uint64_t)args.Int("seed", 1);
+	settings.Walks = (int)args.Int("walks", 1 << 14);
+	settings.Batch = (int)args.Int("batch", 1024);
+	if (settings.Walks <= 0 || settings.Batch <= 0) {
+		printf("Invalid settings\n");
+		return 1;
+	}
+	bool resume = args.Int("resume", 0) != 0;
+	bool alias = args.Int("alias", 1) != 0;
+	ThreadPool pool((int)args.Int("threads", 0));
+	std::string type = args.String("table", "stf");
+	if (type == "stf") {
+		const uint32_t bins[] = { STFTables::BINS_G, STFTables::BINS_SA, STFTables::BINS_R, STFTables::BINS_THETA };
+		STFTableSlices slices(bins);
+		bool sliced = args.Has("gs") || args.Has("phis");
+		if (sliced) {
+			int neighbours = (int)args.Int("neighbours", 1);
+			for (float g : args.Floats("gs", "0"))
+				for (float phi : args.Floats("phis", "0.999"))
+					slices.AddMedium(g, phi, neighbours);
+		}
+		STFTableLayout layout(alias, sliced ? &slices : nullptr);
+		return GenerateTable(layout, settings, args.String("out", layout.DefaultPath()), resume, pool);
+	}
+	if (type == "stfx") {
+		STFXTableLayout layout(alias, args.Int("guide", 1) != 0);
+		return GenerateTable(layout, settings, args.String("out", layout.DefaultPath()), resume, pool);
+	}
+	printf("Unknown table %s (stf or stfx)\n", type.c_str());
+	return 1;
+}
+
+#endif
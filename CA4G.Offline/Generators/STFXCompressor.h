@@ -0,0 +1,35 @@
+#ifndef OFFLINE_STFXCOMPRESSOR_H
+#define OFFLINE_STFXCOMPRESSOR_H
+
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Samplers/STFXCompressedSampler.h"
+
+// Converts stfx.bin into the compressed tables STFXTechnique loads (see STFXCompressedSampler.h).
+//	in=stfx.bin out=stfx_compressed.bin
+static int STFXCompressor(const CommandLine &args) {
+	std::string in = args.String("in", "stfx.bin"), out = args.String("out", "stfx_compressed.bin");
+	STFXCompressedTables tables;
+	Stopwatch watch;
+	if (!tables.Compress(in.c_str())) {
+		printf("Can not read %s\n", in.c_str());
+		return 1;
+	}
+	if (!tables.Save(out.c_str())) {
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	int sparse = 0, empty = 0;
+	for (auto &c : tables.Cells) {
+		sparse += c.Sparse();
+		empty += c.Count() == 0;
+	}
+	double dense = (double)STFXTables::BINS_G * STFXTables::BINS_R * STFXTables::BINS_LOGN * (1 + STFXTables::BINS_X) * sizeof(float);
+	printf("%s: %.1f MB -> %s: %.1f MB (x%.1f) in %.1fs\n", in.c_str(), dense / (1 << 20), out.c_str(),
+		tables.Bytes() / (double)(1 << 20), dense / tables.Bytes(), watch.Seconds());
+	printf("cdfs: %d sparse, %d dense, %d never sampled\n", sparse, (int)tables.Cells.size() - sparse - empty, empty);
+	return 0;
+}
+
+#endif
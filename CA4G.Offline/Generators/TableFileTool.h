@@ -0,0 +1,386 @@
+#ifndef OFFLINE_TABLEFILETOOL_H
+#define OFFLINE_TABLEFILETOOL_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include "../Common/CommandLine.h"
+#include "../Common/Parallel.h"
+#include "../Common/TableFiles.h"
+#include "../Samplers/STFSampler.h"
+#include "../Samplers/STFXSampler.h"
+
+// Converts tables written without header (the floats of the sections one after the other,
+// as stf2.bin and stfx.bin were) into table files. Sections are copied in chunks.
+//	table=stf|stfx in=stf2_raw.bin out=stf2.bin
+static int TableConvert(const CommandLine &args) {
+	std::string type = args.String("table", "stf");
+	if (type != "stf" && type != "stfx") {
+		printf("Unknown table %s (stf or stfx)\n", type.c_str());
+		return 1;
+	}
+	TableFileHeader h = type == "stf" ? STFTables::CreateHeader() : STFXTables::CreateHeader(false);
+	std::string in = args.String("in", ""), out = args.String("out", type == "stf" ? "stf2.bin" : "stfx.bin");
+	FILE* src = OpenFile(in.c_str(), "rb");
+	if (!src) {
+		printf("Can not read %s\n", in.c_str());
+		return 1;
+	}
+	FILE* dst = OpenFile(out.c_str(), "wb");
+	if (!dst) {
+		fclose(src);
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	Stopwatch watch;
+	std::vector<float> chunk(1 << 24);
+	bool ok = WriteTableHeader(dst, h);
+	for (uint32_t i = 0; ok && i < h.SectionCount; i++) {
+		TableSection &s = h.Sections[i];
+		uint64_t hash = TableChecksum(nullptr, 0);
+		ok = SeekFile(dst, s.Offset);
+		for (uint64_t done = 0; ok && done < s.Count; done += chunk.size()) {
+			size_t n = (size_t)(s.Count - done < chunk.size() ? s.Count - done : chunk.size());
+			ok = ReadFloats(src, chunk.data(), n) && WriteFloats(dst, chunk.data(), n);
+			hash = TableChecksum(chunk.data(), n * sizeof(float), hash);
+		}
+		s.Checksum = hash;
+	}
+	if (ok) // the raw file must end with the last section
+		ok = fgetc(src) == EOF && SeekFile(dst, 0) && fwrite(&h, sizeof(h), 1, dst) == 1;
+	fclose(src);
+	ok &= fclose(dst) == 0;
+	if (!ok) {
+		printf("%s is not a %s table without header\n", in.c_str(), type.c_str());
+		return 1;
+	}
+	printf("%s -> %s (%.1f MB) in %.1fs\n", in.c_str(), out.c_str(), TableFileSize(h) / (double)(1 << 20), watch.Seconds());
+	return 0;
+}
+
+// Adds the alias tables (AliasTable.h) of every cdf to an STF or STFX table file, the
+// other sections are copied as they are.
+//	in=stfx.bin out=stfx_alias.bin
+static int TableAlias(const CommandLine &args) {
+	std::string in = args.String("in", "stfx.bin"), out = args.String("out", "");
+	MappedTableFile file;
+	if (!file.Open(in.c_str()) || out.empty()) {
+		printf("Can not read %s or missing out=\n", in.c_str());
+		return 1;
+	}
+	const TableFileHeader &source = file.Header();
+	bool stf = strcmp(source.Kind, "stf") == 0;
+	if (!stf && strcmp(source.Kind, "stfx") != 0) {
+		printf("%s is not an STF or STFX table\n", in.c_str());
+		return 1;
+	}
+	TableFileHeader h = stf ? STFTables::CreateHeader(true) : STFXTables::CreateHeader(true);
+	CopyTableGenerator(h, source);
+	// alias sections after the cdfs, built from the cdf section (index - aliased) in rows of n bins
+	int aliased = stf ? 1 : 2;
+	int rows[2] = { stf ? STFTables::BINS_THETA : STFXTables::BINS_LOGN, STFXTables::BINS_X };
+	int copied = h.SectionCount - aliased;
+	for (int i = 0; i < copied; i++)
+		if (!file.Section(h.Sections[i].Name, h.Sections[i].ElementSize, h.Sections[i].Count)) {
+			printf("%s has other bins or misses %s\n", in.c_str(), h.Sections[i].Name);
+			return 1;
+		}
+	FILE* f = OpenFile(out.c_str(), "wb");
+	if (!f) {
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	Stopwatch watch;
+	bool ok = WriteTableHeader(f, h);
+	for (int i = 0; ok && i < copied; i++) {
+		h.Sections[i].Checksum = source.Find(h.Sections[i].Name)->Checksum;
+		ok = WriteTableSection(f, h.Sections[i], file.Section(h.Sections[i].Name, h.Sections[i].ElementSize, h.Sections[i].Count));
+	}
+	std::vector<uint32_t> table;
+	for (int a = 0; ok && a < aliased; a++) {
+		TableSection &s = h.Sections[copied + a];
+		const float* cdfs = (const float*)file.Section(h.Sections[copied - aliased + a].Name, sizeof(float), s.Count);
+		int n = rows[a];
+		uint64_t rowsPerChunk = ((1 << 24) + n - 1) / n;
+		uint64_t hash = TableChecksum(nullptr, 0);
+		ok = SeekFile(f, s.Offset);
+		for (uint64_t row = 0; ok && row < s.Count / n; row += rowsPerChunk) {
+			uint64_t count = s.Count / n - row < rowsPerChunk ? s.Count / n - row : rowsPerChunk;
+			table.resize((size_t)(count * n));
+			for (uint64_t r = 0; r < count; r++)
+				BuildAliasTable(cdfs + (row + r) * n, n, table.data() + r * n);
+			ok = fwrite(table.data(), sizeof(uint32_t), table.size(), f) == table.size();
+			hash = TableChecksum(table.data(), table.size() * sizeof(uint32_t), hash);
+		}
+		s.Checksum = hash;
+	}
+	ok = ok && SeekFile(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1;
+	ok &= fclose(f) == 0;
+	if (!ok) {
+		printf("Error writing %s\n", out.c_str());
+		return 1;
+	}
+	printf("%s -> %s (%.1f MB) in %.1fs\n", in.c_str(), out.c_str(), TableFileSize(h) / (double)(1 << 20), watch.Seconds());
+	return 0;
+}
+
+// Adds the guide tables (GuideTable.h) of the position-direction cdfs to an STFX table file,
+// the other sections are copied as they are.
+//	in=stfx.bin out=stfx_guide.bin
+static int TableGuide(const CommandLine &args) {
+	std::string in = args.String("in", "stfx.bin"), out = args.String("out", "");
+	MappedTableFile file;
+	if (!file.Open(in.c_str()) || out.empty()) {
+		printf("Can not read %s or missing out=\n", in.c_str());
+		return 1;
+	}
+	const TableFileHeader &source = file.Header();
+	if (!STFXTables::Matches(source)) {
+		printf("%s is not an STFX table\n", in.c_str());
+		return 1;
+	}
+	TableFileHeader h = STFXTables::CreateHeader(source.Find("Alias_XW") != nullptr, true);
+	CopyTableGenerator(h, source);
+	int copied = h.SectionCount - 1;
+	for (int i = 0; i < copied; i++)
+		if (!file.Section(h.Sections[i].Name, h.Sections[i].ElementSize, h.Sections[i].Count)) {
+			printf("%s misses %s\n", in.c_str(), h.Sections[i].Name);
+			return 1;
+		}
+	FILE* f = OpenFile(out.c_str(), "wb");
+	if (!f) {
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	Stopwatch watch;
+	bool ok = WriteTableHeader(f, h);
+	for (int i = 0; ok && i < copied; i++) {
+		h.Sections[i].Checksum = source.Find(h.Sections[i].Name)->Checksum;
+		ok = WriteTableSection(f, h.Sections[i], file.Section(h.Sections[i].Name, h.Sections[i].ElementSize, h.Sections[i].Count));
+	}
+	TableSection &s = h.Sections[copied];
+	const float* cdfs = (const float*)file.Section("CDF_XW", sizeof(float), STFXTables::XW_COUNT);
+	std::vector<uint16_t> guides(s.Count);
+	for (int row = 0; row < STFXTables::LOGN_COUNT; row++)
+		BuildGuideTable(cdfs + (size_t)row * STFXTables::BINS_X, STFXTables::BINS_X, guides.data() + (size_t)row * GUIDE_ENTRIES);
+	s.Checksum = TableChecksum(guides.data(), s.Bytes());
+	ok = ok && WriteTableSection(f, s, guides.data());
+	ok = ok && SeekFile(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1;
+	ok &= fclose(f) == 0;
+	if (!ok) {
+		printf("Error writing %s\n", out.c_str());
+		return 1;
+	}
+	printf("%s -> %s (%.1f MB) in %.1fs\n", in.c_str(), out.c_str(), TableFileSize(h) / (double)(1 << 20), watch.Seconds());
+	return 0;
+}
+
+// Copies the STF slices of some media (every g with every phi, and the neighbour bins) from an
+// stf or stf_slices table into an stf_slices table (TableSlices.h), as STFTechnique loads them.
+//	in=stf2.bin out=stf_slices.bin gs=0.875 phis=0.95,0.999 neighbours=1
+static int TableSlice(const CommandLine &args) {
+	std::string in = args.String("in", "stf2.bin"), out = args.String("out", "stf_slices.bin");
+	const uint32_t bins[] = { STFTables::BINS_G, STFTables::BINS_SA, STFTables::BINS_R, STFTables::BINS_THETA };
+	STFTableSlices slices(bins);
+	int neighbours = (int)args.Int("neighbours", 1);
+	for (float g : args.Floats("gs", "0"))
+		for (float phi : args.Floats("phis", "0.999"))
+			slices.AddMedium(g, phi, neighbours);
+	MappedTableFile file;
+	if (!file.Open(in.c_str())) {
+		printf("Can not read %s\n", in.c_str());
+		return 1;
+	}
+	bool alias = file.Header().Find("Alias_STF") != nullptr;
+	TableFileHeader h = STFTables::CreateSlicesHeader(slices.Count(), alias);
+	CopyTableGenerator(h, file.Header());
+	std::vector<float> albedos(2 * (size_t)slices.Count() * STFTables::BINS_R);
+	float* multi = albedos.data() + (size_t)slices.Count() * STFTables::BINS_R;
+	std::vector<uint32_t> stf((size_t)slices.Count() * STFTables::STRIDE_SA), aliasSTF(alias ? stf.size() : 0);
+	if (!slices.Gather(file, "STF", 0, albedos.data(), multi, stf.data()) ||
+		(alias && !slices.Gather(file, "Alias_STF", 0, albedos.data(), multi, aliasSTF.data()))) {
+		printf("%s is not an STF table with those slices\n", in.c_str());
+		return 1;
+	}
+	const void* data[] = { slices.Keys.data(), albedos.data(), stf.data(), aliasSTF.data() };
+	FILE* f = OpenFile(out.c_str(), "wb");
+	bool ok = f && WriteTableHeader(f, h);
+	for (uint32_t i = 0; ok && i < h.SectionCount; i++) {
+		h.Sections[i].Checksum = TableChecksum(data[i], h.Sections[i].Bytes());
+		ok = WriteTableSection(f, h.Sections[i], data[i]);
+	}
+	ok = ok && SeekFile(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1;
+	if (f)
+		ok &= fclose(f) == 0;
+	if (!ok) {
+		printf("Error writing %s\n", out.c_str());
+		return 1;
+	}
+	printf("%s -> %s: %d slices (%.1f KB)\n", in.c_str(), out.c_str(), slices.Count(), TableFileSize(h) / 1024.0);
+	return 0;
+}
+
+// How the values of an axis map to its bins, as the comments of the generated defines say it.
+static std::string DescribeTableAxis(const TableAxis &axis) {
+	char text[128];
+	switch (axis.Mapping) {
+	case TABLE_AXIS_LINEAR:
+		snprintf(text, sizeof(text), "linear in [%g, %g]", axis.Min, axis.Max);
+		break;
+	case TABLE_AXIS_LOG2:
+		snprintf(text, sizeof(text), "powers of two from %g to %g", axis.Min, axis.Max);
+		break;
+	case TABLE_AXIS_ALBEDO:
+		snprintf(text, sizeof(text), "linear in log(1 / (1 - v)) in [%g, %g], two more bins for %g and above", axis.Min,
+			axis.Max, axis.Max);
+		break;
+	case TABLE_AXIS_EDGES:
+		snprintf(text, sizeof(text), "adaptive in [%g, %g], edges in the section Edges", axis.Min, axis.Max);
+		break;
+	default:
+		snprintf(text, sizeof(text), "mapping unknown");
+	}
+	return text;
+}
+
+// Tables of version 1 and 2 have no axes, they take the ones of the generator layout of their
+// kind if the bins match. False if there is none.
+static bool DefaultTableAxes(TableFileHeader &h) {
+	if (h.Axes[0].Name[0])
+		return true;
+	TableFileHeader layout;
+	if (strcmp(h.Kind, "stf") == 0 || strcmp(h.Kind, "stf_slices") == 0)
+		layout = STFTables::CreateHeader();
+	else if (strcmp(h.Kind, "stf_adaptive") == 0)
+		layout = STFTables::CreateAdaptiveHeader((int)h.Bins[0], (int)h.Bins[1]);
+	else if (strcmp(h.Kind, "stfx") == 0 || strcmp(h.Kind, "stfx_compressed") == 0)
+		layout = STFXTables::CreateHeader(false);
+	else
+		return false;
+	if (memcmp(layout.Bins, h.Bins, sizeof(h.Bins)) != 0)
+		return false;
+	memcpy(h.Axes, layout.Axes, sizeof(h.Axes));
+	return true;
+}
+
+// Prints the header of a table file, verify=1 reads the sections and checks their checksums.
+//	file=stfx.bin verify=0
+static int TableInfo(const CommandLine &args) {
+	std::string path = args.String("file", "stfx.bin");
+	MappedTableFile file;
+	if (!file.Open(path.c_str())) {
+		printf("%s\n", file.Error());
+		return 1;
+	}
+	TableFileHeader h = file.Header();
+	printf("%s: %s, version %u, %.1f MB, id %016llx\n", path.c_str(), h.Kind, h.Version, file.Size() / (double)(1 << 20),
+		(unsigned long long)h.Id());
+	if (h.Version < 3 && DefaultTableAxes(h))
+		printf("  axes of the %s layout (not in the file)\n", h.Kind);
+	if (h.Walks)
+		printf("  generated with seed %llu, %u walks per cell\n", (unsigned long long)h.Seed, h.Walks);
+	for (int i = 0; i < TableFileHeader::MAX_BINS && h.Bins[i]; i++)
+		printf("  axis %d %-6s %5u bins, stride %10llu, %s\n", i, h.Axes[i].Name[0] ? h.Axes[i].Name : "?", h.Bins[i],
+			(unsigned long long)h.Strides[i], DescribeTableAxis(h.Axes[i]).c_str());
+	bool verify = args.Int("verify", 0) != 0;
+	int failed = 0;
+	for (uint32_t i = 0; i < h.SectionCount; i++) {
+		const TableSection &s = h.Sections[i];
+		printf("  %-12s offset %12llu, %12llu x %-7s checksum %016llx", s.Name, (unsigned long long)s.Offset,
+			(unsigned long long)s.Count, s.Type ? TableElementName(s.Type) : (std::to_string(s.ElementSize) + "B").c_str(),
+			(unsigned long long)s.Checksum);
+		if (verify) {
+			bool valid = file.Verify(s);
+			failed += !valid;
+			printf(valid ? " ok" : " MISMATCH");
+		}
+		printf("\n");
+	}
+	return failed ? 1 : 0;
+}
+
+// Writes the bin defines of the shaders and techniques (BINS_<AXIS>) from the header of a table
+// file, or from the layout the generator writes (table=stf|stf_adaptive|stfx, g= and sa= bins of
+// the adaptive one). The output is only rewritten if it changes, so a pre-build step running it
+// does not recompile the shaders when the table is the same.
+//	file=stf2.bin out=STFTableDefines.h
+static int TableDefines(const CommandLine &args) {
+	std::string path = args.String("file", ""), table = args.String("table", ""), out = args.String("out", "");
+	MappedTableFile file;
+	TableFileHeader h;
+	std::string source;
+	if (!path.empty()) {
+		if (!file.Open(path.c_str())) {
+			printf("%s\n", file.Error());
+			return 1;
+		}
+		h = file.Header();
+		size_t slash = path.find_last_of("/\\");
+		source = path.substr(slash == std::string::npos ? 0 : slash + 1);
+	}
+	else if (table == "stf" || table == "stfx" || table == "stf_adaptive") {
+		h = table == "stf" ? STFTables::CreateHeader() : table == "stfx" ? STFXTables::CreateHeader(false) :
+			STFTables::CreateAdaptiveHeader((int)args.Int("g", 64), (int)args.Int("sa", 128));
+		source = "the " + table + " layout of CA4G.Offline";
+	}
+	if (h.Bins[0] == 0 || out.empty()) {
+		printf("Missing file= (or table=stf|stf_adaptive|stfx) or out=\n");
+		return 1;
+	}
+	if (!DefaultTableAxes(h)) {
+		printf("%s has no axes (version %u) and other bins than the %s layout\n", source.c_str(), h.Version, h.Kind);
+		return 1;
+	}
+
+	std::string guard, text = "// Generated by CA4G.Offline tabledefines from " + source + ", do not edit.\n";
+	for (const char* c = h.Kind; c < h.Kind + sizeof(h.Kind) && *c; c++)
+		guard += (char)toupper(*c);
+	guard += "_TABLE_DEFINES_H";
+	char line[256];
+	if (!path.empty()) {
+		snprintf(line, sizeof(line), "// %s table, version %u, id %016llx", h.Kind, h.Version, (unsigned long long)h.Id());
+		text += line;
+		if (h.Walks) {
+			snprintf(line, sizeof(line), ", seed %llu, %u walks per cell", (unsigned long long)h.Seed, h.Walks);
+			text += line;
+		}
+		text += "\n";
+	}
+	text += "#ifndef " + guard + "\n#define " + guard + "\n";
+	for (int i = 0; i < TableFileHeader::MAX_BINS && h.Bins[i]; i++) {
+		std::string name;
+		for (const char* c = h.Axes[i].Name; c < h.Axes[i].Name + sizeof(h.Axes[i].Name) && *c; c++)
+			name += (char)toupper(*c);
+		snprintf(line, sizeof(line), "\n// %s %s\n#define BINS_%s %u\n", h.Axes[i].Name, DescribeTableAxis(h.Axes[i]).c_str(),
+			name.c_str(), h.Bins[i]);
+		text += line;
+	}
+	text += "\n#endif\n";
+
+	std::string current;
+	if (FILE* f = OpenFile(out.c_str(), "rb")) {
+		char buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			current.append(buffer, n);
+		fclose(f);
+	}
+	if (current == text) {
+		printf("%s is up to date\n", out.c_str());
+		return 0;
+	}
+	FILE* f = OpenFile(out.c_str(), "wb");
+	bool ok = f && fwrite(text.data(), 1, text.size(), f) == text.size();
+	if (f)
+		ok &= fclose(f) == 0;
+	if (!ok) {
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	printf("%s -> %s\n", source.c_str(), out.c_str());
+	return 0;
+}
+
+#endif
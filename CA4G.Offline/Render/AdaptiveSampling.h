@@ -0,0 +1,98 @@
+#ifndef OFFLINE_ADAPTIVESAMPLING_H
+#define OFFLINE_ADAPTIVESAMPLING_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "CPUPathtracer.h"
+
+struct AdaptiveSettings {
+	// Relative standard error of the image (root mean square over the pixels) to stop at
+	float Threshold = 0.05f;
+	// Passes of every pixel before the first estimate and the most passes a pixel receives
+	int MinimumPasses = 12;
+	int MaximumPasses = 3072;
+	// Rounds go to the tiles above the threshold, or to all of them (uniform baseline)
+	bool Adaptive = true;
+	// Added to the value of a pixel before dividing its standard error by it (PixelRelativeError)
+	float Epsilon = RELATIVE_ERROR_EPSILON;
+	// Tiles around a tile whose pixels also count for its error, and estimates in a row a tile must
+	// stay below the threshold before it stops receiving rounds
+	int Neighbourhood = 1;
+	int RetireRounds = 2;
+};
+
+struct AdaptiveResult {
+	int Rounds = 0;
+	// Relative standard error of the image and of its noisiest tile when the render stopped
+	double Error = 0, WorstTile = 0;
+	bool Converged = false;
+	RenderStatistics Statistics;
+};
+
+// Renders until the per pixel relative standard errors of the target (RenderTarget::
+// RelativeStandardError, from Accumulation and SqrAccumulation) meet a threshold. After the minimum
+// passes every round traces 3 passes (one per channel) of the tiles that are still active and
+// stops once the error of the image (root mean square over the pixels) is below the threshold or
+// no tile is left. The error of a tile is the root mean square over the pixels of the tiles in its
+// neighbourhood, and a tile retires only after RetireRounds estimates in a row below the threshold
+// (or at the maximum passes), so a low variance estimate of a few pixels that did not sample the
+// bright paths yet does not stop a tile early.
+// On the scene of adaptivebench it is at parity with uniform passes or worse (efficiency 1 /
+// (RMSE^2 time) of x0.83 to x1.04 against a reference). The DemoApp has no counterpart, only a
+// stop on the error of the image (STOP_RELATIVE_ERROR).
+static AdaptiveResult RenderAdaptive(CPUPathtracer &tracer, ThreadPool &pool, RenderTarget &target, const AdaptiveSettings &settings) {
+	AdaptiveResult result;
+	const int width = target.Width, height = target.Height, size = std::max(1, tracer.settings.TileSize);
+	const int tilesX = (width + size - 1) / size, tilesY = (height + size - 1) / size;
+	const int tileCount = TileScheduler::TileCount(width, height, size);
+	const int minimumPasses = std::max(6, (settings.MinimumPasses + 2) / 3 * 3);
+	while (target.Passes < minimumPasses)
+		result.Statistics.Add(tracer.RenderPass(pool, target));
+	std::vector<double> tileSquares(tileCount);
+	std::vector<int> tilePixels(tileCount);
+	std::vector<uint32_t> tilePasses(tileCount);
+	std::vector<int> tileBelow(tileCount, 0);
+	std::vector<uint8_t> active(tileCount);
+	while (true) {
+		std::fill(tileSquares.begin(), tileSquares.end(), 0.0);
+		std::fill(tilePixels.begin(), tilePixels.end(), 0);
+		std::fill(tilePasses.begin(), tilePasses.end(), 0u);
+		double error = 0;
+		for (int py = 0; py < height; py++)
+			for (int px = 0; px < width; px++) {
+				int pixel = py * width + px, tile = (py / size) * tilesX + px / size;
+				double e = target.RelativeStandardError(pixel, settings.Epsilon);
+				error += e * e;
+				tileSquares[tile] += e * e;
+				tilePixels[tile]++;
+				tilePasses[tile] = std::max(tilePasses[tile], target.PixelPasses[pixel]);
+			}
+		result.Error = sqrt(error / ((double)width * height));
+		result.WorstTile = 0;
+		int activeTiles = 0;
+		for (int t = 0; t < tileCount; t++) {
+			const int tx = t % tilesX, ty = t / tilesX, r = std::max(0, settings.Neighbourhood);
+			double squares = 0;
+			int pixels = 0;
+			for (int ny = std::max(0, ty - r); ny <= std::min(tilesY - 1, ty + r); ny++)
+				for (int nx = std::max(0, tx - r); nx <= std::min(tilesX - 1, tx + r); nx++) {
+					squares += tileSquares[ny * tilesX + nx];
+					pixels += tilePixels[ny * tilesX + nx];
+				}
+			double tileError = sqrt(squares / std::max(1, pixels));
+			result.WorstTile = std::max(result.WorstTile, tileError);
+			tileBelow[t] = tileError <= settings.Threshold ? tileBelow[t] + 1 : 0;
+			active[t] = tilePasses[t] + 3 <= (uint32_t)settings.MaximumPasses && (!settings.Adaptive || tileBelow[t] < settings.RetireRounds);
+			activeTiles += active[t];
+		}
+		result.Converged = result.Error <= settings.Threshold;
+		if (result.Converged || activeTiles == 0)
+			return result;
+		for (int p = 0; p < 3; p++)
+			result.Statistics.Add(tracer.RenderPass(pool, target, &active));
+		result.Rounds++;
+	}
+}
+
+#endif
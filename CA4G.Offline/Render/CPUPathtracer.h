@@ -0,0 +1,446 @@
+#ifndef OFFLINE_CPUPATHTRACER_H
+#define OFFLINE_CPUPATHTRACER_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include "../Common/Parallel.h"
+#include "../Common/TileScheduler.h"
+#include "../Samplers/STFSampler.h"
+#include "../Samplers/STFXSampler.h"
+#include "../CVAE/CVAEWavefront.h"
+#include "RenderAccelerator.h"
+#include "Scattering.h"
+#include "SpectralPath.h"
+#include "../../CA4G.DemoApp/ImageStatistics.h"
+
+// Headless reference of the path tracers of CA4G.DemoApp (Pathtracing_RT, STFPathtracing_RT,
+// STFXPathtracing_RT and CVAEPathtracing_RT) for machines without DXR. ComputePath follows the
+// shaders step by step, one color channel per pass (NumberOfPasses % 3, all of them with spectral
+// MIS in Pathtracing) with the switches of Shaders/Tools/Parameters.h. Differences with the GPU:
+//	- MaximalRadius is the exact distance to the surface of the object, not its distance field.
+//	- Texture maps are not applied (RenderScene keeps no textures).
+//	- STFX reads the dense tables (stfx.bin), not the compressed ones.
+
+enum class RenderTechnique {
+	Pathtracing, // Pathtracing_RT, delta tracking inside the media
+	STF,
+	STFX,
+	CVAE
+};
+
+static const char* RenderTechniqueName(RenderTechnique technique) {
+	switch (technique) {
+	case RenderTechnique::STF: return "stf";
+	case RenderTechnique::STFX: return "stfx";
+	case RenderTechnique::CVAE: return "cvae";
+	default: return "pt";
+	}
+}
+
+static bool ParseRenderTechnique(const std::string &name, RenderTechnique &technique) {
+	const RenderTechnique all[] = { RenderTechnique::Pathtracing, RenderTechnique::STF, RenderTechnique::STFX, RenderTechnique::CVAE };
+	for (RenderTechnique t : all)
+		if (name == RenderTechniqueName(t)) {
+			technique = t;
+			return true;
+		}
+	return false;
+}
+
+// Accumulation, SqrAccumulation and Complexity of CommonPT.h, Passes is NumberOfPasses.
+// PixelPasses counts the passes every pixel received, all of them unless passes render some tiles
+// (adaptive sampling), a pixel traces the channel PixelPasses % 3 or, Spectral, the three (spectral
+// MIS or shared paths, a collapsed path is a sample of 0 for the other channels).
+struct RenderTarget {
+	int Width = 0, Height = 0;
+	int Passes = 0;
+	bool Spectral = false;
+	std::vector<float3> Accumulation;
+	std::vector<float3> SqrAccumulation;
+	std::vector<uint32_t> Complexity;
+	std::vector<uint32_t> PixelPasses;
+
+	RenderTarget(int width, int height) : Width(width), Height(height),
+		Accumulation((size_t)width * height, float3(0, 0, 0)), SqrAccumulation((size_t)width * height, float3(0, 0, 0)),
+		Complexity((size_t)width * height, 0), PixelPasses((size_t)width * height, 0) {
+	}
+
+	// Output of AccumulateOutput, the mean or the complexity colors (ShowComplexity).
+	float3 Output(int pixel, bool showComplexity) const {
+		int passes = PixelPasses[pixel] > 0 ? PixelPasses[pixel] : 1;
+		if (showComplexity)
+			return GetColor((int)roundf(Complexity[pixel] / (float)passes));
+		return Accumulation[pixel] * (1.0f / passes);
+	}
+
+	// Standard error of Output over its value (mean of the channels plus a perceptual epsilon, see
+	// PixelRelativeError) from the samples of each channel, infinite before every channel has two.
+	float RelativeStandardError(int pixel, double epsilon = RELATIVE_ERROR_EPSILON) const {
+		return (float)PixelRelativeError(&Accumulation[pixel].x, &SqrAccumulation[pixel].x, PixelPasses[pixel], Spectral ? 3 : 1, epsilon);
+	}
+
+	// Writes Output as a little endian PFM.
+	bool Save(const char* path, bool showComplexity) const {
+		FILE* f = fopen(path, "wb");
+		if (!f)
+			return false;
+		fprintf(f, "PF\n%d %d\n-1.0\n", Width, Height);
+		std::vector<float> row(Width * 3);
+		bool ok = true;
+		for (int y = Height - 1; y >= 0 && ok; y--) { // PFM rows go bottom to top
+			for (int x = 0; x < Width; x++) {
+				float3 c = Output(y * Width + x, showComplexity);
+				row[x * 3 + 0] = c.x;
+				row[x * 3 + 1] = c.y;
+				row[x * 3 + 2] = c.z;
+			}
+			ok = fwrite(row.data(), sizeof(float), row.size(), f) == row.size();
+		}
+		return fclose(f) == 0 && ok;
+	}
+};
+
+// Work of the passes, Rays are the closest hit queries (the complexity), RadiusQueries the
+// MaximalRadius ones and MediumEvents the scatterings and sphere steps inside media.
+struct RenderStatistics {
+	long long Paths = 0;
+	long long Rays = 0;
+	long long RadiusQueries = 0;
+	long long MediumEvents = 0;
+	// Russian roulette played after surface scattering and before medium steps, and the paths it ended
+	long long SurfaceRoulettes = 0, SurfaceTerminations = 0;
+	long long MediumRoulettes = 0, MediumTerminations = 0;
+	double Seconds = 0;
+
+	void Add(const RenderStatistics &o) {
+		Paths += o.Paths;
+		Rays += o.Rays;
+		RadiusQueries += o.RadiusQueries;
+		MediumEvents += o.MediumEvents;
+		SurfaceRoulettes += o.SurfaceRoulettes;
+		SurfaceTerminations += o.SurfaceTerminations;
+		MediumRoulettes += o.MediumRoulettes;
+		MediumTerminations += o.MediumTerminations;
+		Seconds += o.Seconds;
+	}
+};
+
+struct RenderSettings {
+	RenderTechnique Technique = RenderTechnique::STF;
+	// Ratio of columns (from the left) traced with delta tracking in the media as the GUI option
+	float PathtracingRatio = 0;
+	// Side of the square tiles the workers take
+	int TileSize = 16;
+	// Cost orders the tiles by the Complexity of the previous passes
+	TileSchedule Schedule = TileSchedule::Cost;
+	// Random numbers of the paths (RANDOM_SEQUENCE)
+	RandomSequence Randoms = (RandomSequence)RANDOM_SEQUENCE;
+	ActivationTier Tier = ActivationTier::Exact;
+	// Pathtracing traces the three channels in every pass (SPECTRAL_PATHTRACING)
+	bool Spectral = SPECTRAL_PATHTRACING != 0;
+	// CVAE paths share the three channels in gray media (SHARED_PATH_MEDIA)
+	bool SharedMedia = SHARED_PATH_MEDIA != 0;
+	// Importance below which paths play Russian roulette (ROULETTE_*_THRESHOLD), 0 turns it off.
+	float SurfaceRoulette = ROULETTE_SURFACE_THRESHOLD;
+	float MediumRoulette = ROULETTE_MEDIUM_THRESHOLD;
+	// Delta tracking absorbs non-analogly (NON_ANALOG_ABSORPTION, see DeltaStep)
+	bool NonAnalogAbsorption = NON_ANALOG_ABSORPTION != 0;
+};
+
+class CPUPathtracer {
+public:
+	// Per worker state, the CVAE events of a path are evaluated one by one.
+	struct Worker {
+		CVAEMediumQueue Queue;
+		RenderStatistics Statistics;
+	};
+
+private:
+	const RenderScene &scene;
+	const RenderAccelerator &accelerator;
+	const STFTables* stf;
+	const STFXTables* stfx;
+	std::vector<Worker> workers;
+	TileScheduler scheduler;
+
+	float MaximalRadius(const float3 &x, const RenderHit &object, RenderStatistics &statistics) const {
+		statistics.RadiusQueries++;
+		return accelerator.MaximalRadius(x, object.Instance, object.Slot);
+	}
+
+	// Exit of a sphere of er mean free paths (GenerateVariablesWithTable / WithModel), false if absorbed.
+	bool SampleSphere(RandomGenerator &rng, Worker &worker, const RenderVolumeMaterial &medium, int cmp, float er, float3 &x, float3 &w) const {
+		worker.Statistics.MediumEvents++;
+		float g = Channel(medium.G, cmp), phi = Channel(medium.ScatteringAlbedo, cmp);
+		if (settings.Technique == RenderTechnique::CVAE && er <= CVAE_MAX_RADIUS) {
+			worker.Queue.Clear();
+			CVAEMediumEvent e;
+			e.rng = &rng;
+			e.G = g;
+			e.Phi = phi;
+			e.Density = er;
+			e.Win = w;
+			worker.Queue.Push(e);
+			worker.Queue.Flush(nullptr);
+			const CVAEMediumResult &result = worker.Queue.Result(0);
+			if (result.Absorbed)
+				return false;
+			x = result.X;
+			w = result.W;
+			return true;
+		}
+		ScatteringSample s;
+		if (settings.Technique == RenderTechnique::STFX)
+			s = STFXSampleCosXAndW(*stfx, rng, g, phi, er, TABLE_ALIAS_SAMPLING && stfx->AliasXW,
+				TABLE_GUIDE_SAMPLING && stfx->GuideXW, TABLE_INTERPOLATED_SAMPLING);
+		else if (settings.Technique == RenderTechnique::STF)
+			s = STFSampleCosXAndW(*stf, rng, g, phi, er, TABLE_ALIAS_SAMPLING && stf->AliasSTF, TABLE_INTERPOLATED_SAMPLING);
+		else // CVAE beyond its training range
+			s = DiffusionSampleCosXAndW(rng, g, phi, er);
+		if (s.Absorbed)
+			return false;
+		float3 win = w;
+		SphereExitToWorld(rng, win, s, x, w);
+		return true;
+	}
+
+	// Free flight to t and a scattering or absorption event, false if absorbed. nonAnalog
+	// (NON_ANALOG_ABSORPTION, MediumAbsorption of the shaders) always scatters and the importance
+	// carries the albedo. With channels the other channels follow the hero cmp with spectral MIS
+	// or, shared, hero ratios.
+	static bool DeltaStep(RandomGenerator &rng, const RenderVolumeMaterial &medium, int cmp, float t, float3 &x, float3 &w,
+		float3 &importance, float3 &pdfs, bool channels, bool shared, bool nonAnalog) {
+		x = x + w * t; // free traverse in a medium
+		if (channels)
+			SpectralCollision(importance, pdfs, medium.Extinction, cmp, t, shared);
+		if (nonAnalog)
+			importance = importance * medium.ScatteringAlbedo;
+		else if (rng.random() < 1 - Channel(medium.ScatteringAlbedo, cmp)) // absorption instead
+			return false;
+		else if (channels)
+			SpectralSurvival(importance, pdfs, medium.ScatteringAlbedo, cmp, shared);
+		float3 win = w;
+		w = ImportanceSamplePhase(rng, Channel(medium.G, cmp), w); // scattering event...
+		if (channels)
+			SpectralPhase(importance, pdfs, medium.G, cmp, win, w, shared);
+		return true;
+	}
+
+	// Medium branch of ComputePath when the flight t ends before the surface, false if absorbed.
+	// Spectral (Pathtracing) or shared (CVAE) importance and pdfs follow the delta tracking steps,
+	// a shared path collapses to the hero before the sphere steps unless the medium is gray.
+	bool MediumEvent(RandomGenerator &rng, Worker &worker, const RenderVolumeMaterial &medium, int cmp, bool usePT,
+		const RenderHit &object, float t, float3 &x, float3 &w, float3 &importance, float3 &pdfs, bool spectral, bool &shared) const {
+		RenderStatistics &statistics = worker.Statistics;
+		const float sigma = Channel(medium.Extinction, cmp);
+		const bool channels = spectral || shared, nonAnalog = settings.NonAnalogAbsorption;
+		if (usePT || settings.Technique == RenderTechnique::Pathtracing) {
+			statistics.MediumEvents++;
+			return DeltaStep(rng, medium, cmp, t, x, w, importance, pdfs, channels, shared, nonAnalog);
+		}
+		float r = MaximalRadius(x, object, statistics);
+		float er = sigma * r;
+		if (er < 1) {
+			statistics.MediumEvents++;
+			return DeltaStep(rng, medium, cmp, t, x, w, importance, pdfs, channels, shared, nonAnalog);
+		}
+		if (shared && !IsGrayMedium(medium, (float)GRAY_MEDIA_TOLERANCE))
+			CollapseToHero(importance, shared, cmp); // BeginMediumEvent
+		switch (settings.Technique) {
+		case RenderTechnique::STFX: { // one step capped to the tables
+			er = minf(er, 64.0f);
+			float3 sx;
+			if (!SampleSphere(rng, worker, medium, cmp, er, sx, w))
+				return false;
+			x = x + sx * (er / sigma);
+			return true;
+		}
+		case RenderTechnique::CVAE: // flights inside the spheres and the model where they scatter
+			while (er >= 1) {
+				er = minf(er, (float)MAX_SPHERE_RADIUS);
+				float flight = -logf(1 - rng.random()) / sigma;
+				if (flight < r) { // Some scattering in sphere
+					x = x + w * flight; // move to scatter position
+					r = MaximalRadius(x, object, statistics);
+					er = minf(sigma * r, (float)MAX_SPHERE_RADIUS);
+					float3 sx;
+					if (!SampleSphere(rng, worker, medium, cmp, er, sx, w))
+						return false;
+					x = x + sx * (er / sigma);
+				}
+				else // free flight
+					x = x + w * r;
+				r = MaximalRadius(x, object, statistics);
+				er = sigma * r;
+			}
+			return true;
+		default: // STF, sphere steps until the path gets close to the surface
+			while (er >= 1) {
+				er = minf(er, (float)MAX_SPHERE_RADIUS);
+				float3 sx;
+				if (!SampleSphere(rng, worker, medium, cmp, er, sx, w))
+					return false;
+				x = x + sx * (er / sigma);
+				r = MaximalRadius(x, object, statistics);
+				er = sigma * r;
+			}
+			return true;
+		}
+	}
+
+public:
+	RenderSettings settings;
+
+	// Tables of the technique (STF or STFX) must stay loaded while rendering.
+	CPUPathtracer(const RenderScene &scene, const RenderAccelerator &accelerator, const RenderSettings &settings,
+		const STFTables* stf = nullptr, const STFXTables* stfx = nullptr) :
+		scene(scene), accelerator(accelerator), stf(stf), stfx(stfx), settings(settings) {
+	}
+
+	// Pathtracing_RT and NEEPathtracing_RT trace the three channels (Spectral), the other techniques one.
+	bool SpectralPaths() const {
+		return settings.Spectral && settings.Technique == RenderTechnique::Pathtracing;
+	}
+
+	// CVAEPathtracing_RT starts the paths shared by the three channels (SharedMedia).
+	bool SharedPaths() const {
+		return settings.SharedMedia && settings.Technique == RenderTechnique::CVAE;
+	}
+
+	// ComputePath of the shaders for the channel cmp, complexity counts the closest hit queries.
+	float3 ComputePath(RandomGenerator &rng, Worker &worker, int cmp, bool usePT, float3 x, float3 w, int &complexity) const {
+		const bool spectral = SpectralPaths();
+		bool shared = SharedPaths();
+		float3 pdfs;
+		float3 importance = StartSpectralImportance(cmp, spectral || shared, pdfs);
+		int bounces = 0;
+		bool isOutside = true;
+		while (true) {
+			complexity++;
+			rng.StartPathVertex(complexity);
+			RenderHit hit;
+			if (!accelerator.Intersect(x, w, 100.0f, hit))
+				return importance * (SampleSkybox(w) + SampleLight(scene.Light, w) * (bounces > 0 ? 1.0f : 0.0f));
+
+			// GetHitInfo, object space attributes moved by the instance transform
+			const RenderGeometry &geometry = scene.Geometries[hit.Geometry];
+			const int* index = &scene.Indices[geometry.StartIndex + hit.Triangle * 3];
+			const RenderVertex &v0 = scene.Vertices[geometry.StartVertex + index[0]];
+			const RenderVertex &v1 = scene.Vertices[geometry.StartVertex + index[1]];
+			const RenderVertex &v2 = scene.Vertices[geometry.StartVertex + index[2]];
+			const float4x4 &transform = scene.Instances[hit.Instance].Transform;
+			float b0 = 1 - hit.U - hit.V;
+			float3 localP = v0.P * b0 + v1.P * hit.U + v2.P * hit.V;
+			float3 localN = v0.N * b0 + v1.N * hit.U + v2.N * hit.V;
+			float4 worldP = mul(float4(localP.x, localP.y, localP.z, 1), transform);
+			float4 worldN = mul(float4(localN.x, localN.y, localN.z, 0), transform);
+			float3 P = float3(worldP.x, worldP.y, worldP.z);
+			float3 N = normalize(float3(worldN.x, worldN.y, worldN.z));
+			int materialIndex = geometry.MaterialIndex;
+			const RenderMaterial &material = scene.Materials[materialIndex];
+			const RenderVolumeMaterial &medium = scene.VolumeMaterials[materialIndex];
+			if (!isOutside && shared && !IsGrayMedium(medium, (float)SHARED_PATH_MAX_SPREAD))
+				CollapseToHero(importance, shared, cmp); // BeginMediumFlight
+
+			float d = length(P - x); // Distance to the hit position.
+			float sigma = Channel(medium.Extinction, cmp);
+			float t = isOutside || sigma == 0 ? 100000000 : -logf(maxf(0.000000000001f, 1 - rng.random())) / sigma;
+
+			if (t >= d) {
+				if (!isOutside && (spectral || shared))
+					SpectralTransmittance(importance, pdfs, medium.Extinction, cmp, d, shared);
+				bounces += isOutside;
+				if (bounces >= MAX_PATHTRACING_BOUNCES)
+					return float3(0, 0, 0);
+
+				// SurfelScattering
+				float3 V = -1 * w;
+				float3 fN;
+				float4 R, T;
+				ComputeImpulses(V, N, material, fN, R, T);
+				float3 ratio, direction;
+				RandomScatterRay(rng, V, fN, R, T, material, ratio, direction);
+				importance = importance * maxf(ratio, float3(0, 0, 0));
+				if (direction.x == 0 && direction.y == 0 && direction.z == 0)
+					return float3(0, 0, 0); // nothing selected, the importance is 0
+				if (!RussianRoulette(rng, importance, settings.SurfaceRoulette, worker.Statistics.SurfaceRoulettes)) {
+					worker.Statistics.SurfaceTerminations++;
+					return float3(0, 0, 0);
+				}
+				w = direction;
+				x = P + fN * (dot(direction, fN) >= 0 ? 0.001f : -0.001f);
+
+				if ((material.Specular.x != 0 || material.Specular.y != 0 || material.Specular.z != 0) && material.Roulette.w > 0)
+					isOutside = dot(N, w) >= 0;
+			}
+			else {
+				if (!RussianRoulette(rng, importance, settings.MediumRoulette, worker.Statistics.MediumRoulettes)) {
+					worker.Statistics.MediumTerminations++;
+					return float3(0, 0, 0);
+				}
+				if (!MediumEvent(rng, worker, medium, cmp, usePT, hit, t, x, w, importance, pdfs, spectral, shared))
+					return float3(0, 0, 0);
+			}
+		}
+	}
+
+	// Tiles and worker utilization of the last pass.
+	const TileScheduler& Scheduler() const { return scheduler; }
+
+	// One pass (frame) of RayGen over all the pixels in tiles, accumulated into target.
+	// activeTiles (one per tile in scanline order, optional) selects the tiles traced.
+	RenderStatistics RenderPass(ThreadPool &pool, RenderTarget &target, const std::vector<uint8_t>* activeTiles = nullptr) {
+		workers.resize(pool.ThreadCount());
+		for (Worker &worker : workers) {
+			worker.Queue.Tier = settings.Tier;
+			worker.Statistics = RenderStatistics();
+		}
+		const int width = target.Width, height = target.Height;
+		const float4x4 projectionToWorld = scene.Camera.ProjectionToWorld(width, height);
+		target.Spectral = SpectralPaths() || SharedPaths();
+		Stopwatch watch;
+		scheduler.Split(width, height, settings.TileSize, target.Passes > 0 ? target.Complexity.data() : nullptr, target.PixelPasses.data(),
+			activeTiles ? activeTiles->data() : nullptr);
+		scheduler.Run(pool, settings.Schedule, [&](const Tile &tile, int thread) {
+			Worker &worker = workers[thread];
+			for (int py = tile.Y0; py < tile.Y1; py++)
+				for (int px = tile.X0; px < tile.X1; px++) {
+					// NumberOfPasses of the pixel
+					const int pass = (int)target.PixelPasses[py * width + px];
+					const int cmp = pass % 3;
+					// StartRandomSeedForRay(dimensions, 1, index, 0, NumberOfPasses), a Sobol point per pass
+					// when the pass traces the three channels
+					RandomGenerator rng = RandomGenerator::ForRay(width, height, 1, px, py, 0, pass, settings.Randoms, target.Spectral ? 1 : 3);
+					float cx = (px + rng.random()) / width, cy = (py + rng.random()) / height;
+					float3 O, D;
+					RenderCamera::PrimaryRay(projectionToWorld, cx, cy, O, D);
+
+					int complexity = 0;
+					bool usePT = px < width * settings.PathtracingRatio;
+					float3 color = ComputePath(rng, worker, cmp, usePT, O, D, complexity);
+					if (color.x != color.x || color.y != color.y || color.z != color.z)
+						color = float3(0, 0, 0);
+
+					// AccumulateOutput
+					int pixel = py * width + px;
+					target.Accumulation[pixel] = target.Accumulation[pixel] + color;
+					target.SqrAccumulation[pixel] = target.SqrAccumulation[pixel] + color * color;
+					target.Complexity[pixel] += complexity;
+					target.PixelPasses[pixel]++;
+					worker.Statistics.Paths++;
+					worker.Statistics.Rays += complexity;
+				}
+		});
+		target.Passes++;
+		RenderStatistics total;
+		for (const Worker &worker : workers)
+			total.Add(worker.Statistics);
+		total.Seconds = watch.Seconds();
+		return total;
+	}
+};
+
+#endif
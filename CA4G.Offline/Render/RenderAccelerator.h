@@ -0,0 +1,475 @@
+#ifndef OFFLINE_RENDERACCELERATOR_H
+#define OFFLINE_RENDERACCELERATOR_H
+
+#include <vector>
+#include "../Common/Parallel.h"
+#include "RenderScene.h"
+#include "RenderBVH.h"
+#include "RenderWideBVH.h"
+
+// Ray queries of the CPU path tracer, the structure CreateRTXScene hands to DXR: a bottom level
+// (BLAS) per instance over the triangles of its geometries in object space and a top level (TLAS)
+// over the instances with their transforms. Every geometry of a BLAS keeps its own binary tree so
+// the distance to the nearest surface of one object (MaximalRadius, the distance fields of the
+// shaders) can be queried alone, and the collapsed wide form of it for the rays.
+
+struct RenderHit {
+	int Instance = -1;
+	int Slot = -1; // geometry of the instance, the object of MaximalRadius
+	int Geometry = -1; // scene geometry
+	int Triangle = -1; // of the geometry
+	float T = 0;
+	float U = 0, V = 0; // barycentrics of the second and third vertices
+};
+
+// Rays traced together, coherent ones (a block of pixels) share most of the traversal.
+struct RenderRayPacket {
+	static const int SIZE = RenderWideBVH::PACKET;
+	float3 O[SIZE], D[SIZE];
+	float TMax[SIZE];
+	int Active = (1 << SIZE) - 1;
+};
+
+// Triangles of the geometries of an instance (a DXR geometry collection) in object space.
+class RenderBLAS {
+	static const int STACK_SIZE = 64;
+
+	struct Primitive {
+		int Slot;
+		int Triangle;
+	};
+
+	const RenderScene* scene = nullptr;
+	std::vector<int> geometries; // scene geometry of every slot
+	std::vector<int> roots; // root node of every slot
+	std::vector<RenderBVHNode> nodes;
+	std::vector<Primitive> primitives;
+	RenderWideBVH wide;
+	std::vector<int> wideRoots; // -1 for geometries without triangles
+	std::vector<int> wideStarts, packStarts; // first wide node and pack of every slot
+	std::vector<double> costs, builtCosts; // SAH cost of every slot, now and when it was built
+	RenderBuildStatistics statistics;
+
+	// Ranges of a slot in the node arrays, its trees are appended after the ones of the previous slot.
+	int NodeEnd(int slot) const { return slot + 1 < (int)roots.size() ? roots[slot + 1] : (int)nodes.size(); }
+	int WideEnd(int slot) const { return slot + 1 < (int)wideStarts.size() ? wideStarts[slot + 1] : wide.NodeCount(); }
+	int PackEnd(int slot) const { return slot + 1 < (int)packStarts.size() ? packStarts[slot + 1] : wide.PackCount(); }
+
+	void Triangle(const Primitive &p, float3 &a, float3 &b, float3 &c) const {
+		const RenderGeometry &g = scene->Geometries[geometries[p.Slot]];
+		const int* index = &scene->Indices[g.StartIndex + p.Triangle * 3];
+		a = scene->Vertices[g.StartVertex + index[0]].P;
+		b = scene->Vertices[g.StartVertex + index[1]].P;
+		c = scene->Vertices[g.StartVertex + index[2]].P;
+	}
+
+	void SetHit(const RenderPrimitiveHit &closest, RenderHit &hit) const {
+		const Primitive &p = primitives[closest.Primitive];
+		hit.T = closest.T;
+		hit.U = closest.U;
+		hit.V = closest.V;
+		hit.Slot = p.Slot;
+		hit.Geometry = geometries[p.Slot];
+		hit.Triangle = p.Triangle;
+	}
+
+public:
+	void Build(const RenderScene &scene, const RenderInstance &instance, ThreadPool* pool) {
+		statistics = RenderBuildStatistics();
+		this->scene = &scene;
+		geometries = instance.Geometries;
+		roots.clear();
+		nodes.clear();
+		primitives.clear();
+		wide.Clear();
+		wideRoots.clear();
+		wideStarts.clear();
+		packStarts.clear();
+		costs.clear();
+		builtCosts.clear();
+		std::vector<RenderBuildReference> references;
+		for (int slot = 0; slot < (int)geometries.size(); slot++) {
+			const RenderGeometry &g = scene.Geometries[geometries[slot]];
+			int count = g.IndexCount / 3;
+			references.resize(count);
+			auto bound = [&](int b, int e, int) {
+				for (int t = b; t < e; t++) {
+					const int* index = &scene.Indices[g.StartIndex + t * 3];
+					float3 p0 = scene.Vertices[g.StartVertex + index[0]].P;
+					float3 p1 = scene.Vertices[g.StartVertex + index[1]].P;
+					float3 p2 = scene.Vertices[g.StartVertex + index[2]].P;
+					references[t] = { minf(p0, minf(p1, p2)), t, maxf(p0, maxf(p1, p2)), 0 };
+				}
+			};
+			if (pool != nullptr)
+				pool->ParallelFor(count, 65536, bound);
+			else
+				bound(0, count, 0);
+			int root = RenderBVHBuilder(references, pool).Build(nodes, (int)primitives.size());
+			roots.push_back(root);
+			for (const RenderBuildReference &r : references)
+				primitives.push_back({ slot, r.Index });
+			wideStarts.push_back(wide.NodeCount());
+			packStarts.push_back(wide.PackCount());
+			wideRoots.push_back(count == 0 ? -1 : wide.Collapse(nodes, root, [&](int reference, float3 &a, float3 &b, float3 &c) {
+				Triangle(primitives[reference], a, b, c);
+			}));
+			costs.push_back(SAHCost(nodes, root));
+			builtCosts.push_back(costs.back());
+			statistics.SAHCost += costs.back();
+		}
+		statistics.Nodes = (int)nodes.size();
+		statistics.References = (int)primitives.size();
+		statistics.WideNodes = wide.NodeCount();
+		statistics.Packs = wide.PackCount();
+	}
+
+	const RenderBuildStatistics &Statistics() const { return statistics; }
+
+	bool Uses(const std::vector<bool> &updatedGeometries) const {
+		for (int g : geometries)
+			if (updatedGeometries[g])
+				return true;
+		return false;
+	}
+
+	// Refits the trees of the geometries whose vertices were updated, the triangles keep their
+	// leaves. Returns false when the SAH cost of a tree grew past rebuildRatio times the cost it was
+	// built with, the BLAS should be built again.
+	bool Refit(const std::vector<bool> &updatedGeometries, float rebuildRatio, ThreadPool* pool) {
+		bool keep = true;
+		for (int slot = 0; slot < (int)geometries.size(); slot++) {
+			if (!updatedGeometries[geometries[slot]] || wideRoots[slot] < 0)
+				continue;
+			int begin = roots[slot], end = NodeEnd(slot);
+			auto refitLeaves = [&](int b, int e, int) {
+				for (int n = begin + b; n < begin + e; n++) {
+					RenderBVHNode &node = nodes[n];
+					if (node.Count == 0)
+						continue;
+					node.Min = float3(1e30f, 1e30f, 1e30f);
+					node.Max = float3(-1e30f, -1e30f, -1e30f);
+					for (int i = node.Start; i < node.Start + node.Count; i++) {
+						float3 v0, v1, v2;
+						Triangle(primitives[i], v0, v1, v2);
+						node.Min = minf(node.Min, minf(v0, minf(v1, v2)));
+						node.Max = maxf(node.Max, maxf(v0, maxf(v1, v2)));
+					}
+				}
+			};
+			if (pool != nullptr)
+				pool->ParallelFor(end - begin, 4096, refitLeaves);
+			else
+				refitLeaves(0, end - begin, 0);
+			// children follow their parent in the array
+			for (int n = end - 1; n >= begin; n--) {
+				RenderBVHNode &node = nodes[n];
+				if (node.Count == 0) {
+					node.Min = minf(nodes[node.Start].Min, nodes[node.Start + 1].Min);
+					node.Max = maxf(nodes[node.Start].Max, nodes[node.Start + 1].Max);
+				}
+			}
+			wide.Refit(nodes, wideStarts[slot], WideEnd(slot), packStarts[slot], PackEnd(slot), [&](int reference, float3 &a, float3 &b, float3 &c) {
+				Triangle(primitives[reference], a, b, c);
+			}, pool);
+			double cost = SAHCost(nodes, roots[slot]);
+			statistics.SAHCost += cost - costs[slot];
+			costs[slot] = cost;
+			keep &= cost <= builtCosts[slot] * rebuildRatio;
+		}
+		return keep;
+	}
+
+	// Bounds of all the geometries in object space.
+	void Bounds(float3 &minimum, float3 &maximum) const {
+		minimum = float3(1e30f, 1e30f, 1e30f);
+		maximum = float3(-1e30f, -1e30f, -1e30f);
+		for (int root : roots) {
+			minimum = minf(minimum, nodes[root].Min);
+			maximum = maxf(maximum, nodes[root].Max);
+		}
+	}
+
+	void Bounds(int slot, float3 &minimum, float3 &maximum) const {
+		minimum = nodes[roots[slot]].Min;
+		maximum = nodes[roots[slot]].Max;
+	}
+
+	// Closest hit in (0, hit.T) of a ray in object space. hit keeps the previous closest hit
+	// otherwise.
+	bool Intersect(const RenderWideRay &ray, RenderHit &hit) const {
+		RenderPrimitiveHit closest;
+		closest.T = hit.T;
+		for (int root : wideRoots)
+			if (root >= 0)
+				wide.Intersect(ray, root, closest);
+		if (closest.Primitive < 0)
+			return false;
+		SetHit(closest, hit);
+		return true;
+	}
+
+	// Intersect for the active rays of a packet, returns the rays with a new closest hit.
+	int Intersect(const RenderWideRay* rays, int active, RenderHit* hits) const {
+		RenderPrimitiveHit closest[RenderWideBVH::PACKET];
+		for (int r = 0; r < RenderWideBVH::PACKET; r++)
+			closest[r].T = hits[r].T;
+		int found = 0;
+		for (int root : wideRoots)
+			if (root >= 0)
+				found |= wide.Intersect(rays, active, root, closest);
+		for (int r = 0; r < RenderWideBVH::PACKET; r++)
+			if (found & (1 << r))
+				SetHit(closest[r], hits[r]);
+		return found;
+	}
+
+	// Distance from x to the closest triangle of the geometry in slot, in object space.
+	float Nearest(const float3 &x, int slot) const {
+		float best = 1e30f;
+		int stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = roots[slot];
+		while (top > 0) {
+			const RenderBVHNode &node = nodes[stack[--top]];
+			if (SqrDistanceToBox(x, node.Min, node.Max) >= best)
+				continue;
+			if (node.Count == 0) {
+				int left = node.Start, right = node.Start + 1;
+				float dl = SqrDistanceToBox(x, nodes[left].Min, nodes[left].Max);
+				float dr = SqrDistanceToBox(x, nodes[right].Min, nodes[right].Max);
+				// the closer child is visited first
+				stack[top++] = dl < dr ? right : left;
+				stack[top++] = dl < dr ? left : right;
+				continue;
+			}
+			for (int i = node.Start; i < node.Start + node.Count; i++) {
+				float3 v0, v1, v2;
+				Triangle(primitives[i], v0, v1, v2);
+				float3 d = ClosestPointOnTriangle(x, v0, v1 - v0, v2 - v0) - x;
+				best = minf(best, dot(d, d));
+			}
+		}
+		return sqrtf(best);
+	}
+};
+
+// Work of the last RenderAccelerator::Update.
+struct RenderUpdateStatistics {
+	double Seconds = 0;
+	bool Built = false; // everything was built again
+	int Refitted = 0, Rebuilt = 0; // BLAS
+	bool TLAS = false; // the TLAS was built again
+};
+
+// Bottom levels of the instances and the top level over them.
+class RenderAccelerator {
+	static const int STACK_SIZE = 64;
+
+	std::vector<RenderBLAS> blas;
+	std::vector<float4x4> worldToObject;
+	std::vector<float> objectToWorldScale; // shortest axis of the instance transform
+	std::vector<RenderBVHNode> tlas;
+	std::vector<int> tlasInstances;
+	RenderBuildStatistics blasStatistics, tlasStatistics;
+	RenderSceneVersion version; // of the scene the structure reflects
+	RenderUpdateStatistics updateStatistics;
+
+	void SumBLASStatistics(double seconds) {
+		blasStatistics = RenderBuildStatistics();
+		for (const RenderBLAS &b : blas) {
+			blasStatistics.SAHCost += b.Statistics().SAHCost;
+			blasStatistics.Nodes += b.Statistics().Nodes;
+			blasStatistics.References += b.Statistics().References;
+			blasStatistics.WideNodes += b.Statistics().WideNodes;
+			blasStatistics.Packs += b.Statistics().Packs;
+		}
+		blasStatistics.Seconds = seconds;
+	}
+
+	// Over the instance boxes, whose BLAS may have changed.
+	void BuildTLAS(const RenderScene &scene) {
+		Stopwatch watch;
+		tlasStatistics = RenderBuildStatistics();
+		worldToObject.resize(blas.size());
+		objectToWorldScale.resize(blas.size());
+		std::vector<RenderBuildReference> references(blas.size());
+		for (size_t i = 0; i < blas.size(); i++) {
+			const float4x4 &transform = scene.Instances[i].Transform;
+			worldToObject[i] = inverse(transform);
+			objectToWorldScale[i] = minf(length(float3(transform._m00, transform._m01, transform._m02)),
+				minf(length(float3(transform._m10, transform._m11, transform._m12)), length(float3(transform._m20, transform._m21, transform._m22))));
+			float3 minimum, maximum;
+			blas[i].Bounds(minimum, maximum);
+			references[i].Index = (int)i;
+			TransformBox(minimum, maximum, transform, references[i].Min, references[i].Max);
+		}
+		tlas.clear();
+		int root = RenderBVHBuilder(references, nullptr).Build(tlas);
+		tlasInstances.clear();
+		for (const RenderBuildReference &r : references)
+			tlasInstances.push_back(r.Index);
+		tlasStatistics.SAHCost = SAHCost(tlas, root);
+		tlasStatistics.Nodes = (int)tlas.size();
+		tlasStatistics.References = (int)tlasInstances.size();
+		tlasStatistics.Seconds = watch.Seconds();
+	}
+
+	RenderWideRay ToObject(const float3 &O, const float3 &D, int instance) const {
+		float4 o = mul(float4(O.x, O.y, O.z, 1), worldToObject[instance]);
+		float4 d = mul(float4(D.x, D.y, D.z, 0), worldToObject[instance]);
+		return RenderWideRay(float3(o.x, o.y, o.z), float3(d.x, d.y, d.z));
+	}
+
+public:
+	// pool spreads the builds of large geometries, it can be null.
+	void Build(const RenderScene &scene, ThreadPool* pool = nullptr) {
+		Stopwatch watch;
+		std::vector<bool> updatedGeometries;
+		scene.Updated(version, updatedGeometries);
+		blas.resize(scene.Instances.size());
+		for (size_t i = 0; i < blas.size(); i++)
+			blas[i].Build(scene, scene.Instances[i], pool);
+		SumBLASStatistics(watch.Seconds());
+		BuildTLAS(scene);
+	}
+
+	// Follows the changes of the scene since the last Build or Update as UpdateRTXScene does with
+	// the dirty bits of SceneVersion. New geometries, indices or instances build everything again.
+	// Updated vertices refit the BLAS of the instances that use them, or build it again when its
+	// SAH cost grew past rebuildRatio times the cost it was built with. Updated vertices or
+	// instance transforms then build the TLAS again, the other BLAS are left alone. Returns the
+	// elements updated.
+	RenderSceneElement Update(const RenderScene &scene, ThreadPool* pool = nullptr, float rebuildRatio = 1.5f) {
+		Stopwatch watch;
+		updateStatistics = RenderUpdateStatistics();
+		std::vector<bool> updatedGeometries;
+		RenderSceneElement updated = scene.Updated(version, updatedGeometries);
+		if (+(updated & (RenderSceneElement::Indices | RenderSceneElement::Geometries | RenderSceneElement::Instances))) {
+			Build(scene, pool);
+			updateStatistics.Built = true;
+		}
+		else {
+			if (+(updated & RenderSceneElement::Vertices)) {
+				for (size_t i = 0; i < blas.size(); i++) {
+					if (!blas[i].Uses(updatedGeometries))
+						continue;
+					if (blas[i].Refit(updatedGeometries, rebuildRatio, pool))
+						updateStatistics.Refitted++;
+					else {
+						blas[i].Build(scene, scene.Instances[i], pool);
+						updateStatistics.Rebuilt++;
+					}
+				}
+				SumBLASStatistics(watch.Seconds());
+			}
+			if (+(updated & (RenderSceneElement::Vertices | RenderSceneElement::InstanceTransforms))) {
+				BuildTLAS(scene);
+				updateStatistics.TLAS = true;
+			}
+		}
+		updateStatistics.Seconds = watch.Seconds();
+		return updated;
+	}
+
+	const RenderBuildStatistics &BLASStatistics() const { return blasStatistics; }
+	const RenderBuildStatistics &TLASStatistics() const { return tlasStatistics; }
+	const RenderUpdateStatistics &UpdateStatistics() const { return updateStatistics; }
+
+	int NodeCount() const { return blasStatistics.Nodes + tlasStatistics.Nodes; }
+
+	// Closest hit along D from O up to tMax (TMin = 0 as the shaders). Rays enter the instances
+	// transformed without normalizing, so the distances stay in world space.
+	bool Intersect(const float3 &O, const float3 &D, float tMax, RenderHit &hit) const {
+		hit = RenderHit();
+		hit.T = tMax;
+		if (tlas.empty())
+			return false;
+		float3 invD = float3(1 / D.x, 1 / D.y, 1 / D.z);
+		int stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const RenderBVHNode &node = tlas[stack[--top]];
+			if (IntersectBox(O, invD, hit.T, node.Min, node.Max) < 0)
+				continue;
+			if (node.Count == 0) {
+				stack[top++] = node.Start + 1;
+				stack[top++] = node.Start;
+				continue;
+			}
+			for (int i = node.Start; i < node.Start + node.Count; i++) {
+				int instance = tlasInstances[i];
+				if (blas[instance].Intersect(ToObject(O, D, instance), hit))
+					hit.Instance = instance;
+			}
+		}
+		return hit.Triangle >= 0;
+	}
+
+	// Intersect for the active rays of a packet, the instances are entered by all the rays that
+	// reach their boxes at once. Returns the rays that hit.
+	int Intersect(const RenderRayPacket &packet, RenderHit* hits) const {
+		const int SIZE = RenderRayPacket::SIZE;
+		float3 invD[SIZE];
+		for (int r = 0; r < SIZE; r++) {
+			hits[r] = RenderHit();
+			hits[r].T = packet.TMax[r];
+			invD[r] = float3(1 / packet.D[r].x, 1 / packet.D[r].y, 1 / packet.D[r].z);
+		}
+		if (tlas.empty())
+			return 0;
+		struct Entry {
+			int Node;
+			int Mask;
+		};
+		Entry stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { 0, packet.Active };
+		RenderWideRay local[SIZE];
+		while (top > 0) {
+			Entry entry = stack[--top];
+			const RenderBVHNode &node = tlas[entry.Node];
+			int mask = 0;
+			for (int r = 0; r < SIZE; r++)
+				if ((entry.Mask & (1 << r)) && IntersectBox(packet.O[r], invD[r], hits[r].T, node.Min, node.Max) >= 0)
+					mask |= 1 << r;
+			if (mask == 0)
+				continue;
+			if (node.Count == 0) {
+				stack[top++] = { node.Start + 1, mask };
+				stack[top++] = { node.Start, mask };
+				continue;
+			}
+			for (int i = node.Start; i < node.Start + node.Count; i++) {
+				int instance = tlasInstances[i];
+				for (int r = 0; r < SIZE; r++)
+					local[r] = ToObject(packet.O[r], packet.D[r], instance);
+				int found = blas[instance].Intersect(local, mask, hits);
+				for (int r = 0; r < SIZE; r++)
+					if (found & (1 << r))
+						hits[r].Instance = instance;
+			}
+		}
+		int hitMask = 0;
+		for (int r = 0; r < SIZE; r++)
+			if (hits[r].Triangle >= 0)
+				hitMask |= 1 << r;
+		return hitMask;
+	}
+
+	// Radius of the largest empty sphere around x in a geometry (slot) of an instance, the distance
+	// to its surface. As the distance fields of the shaders, that cover the box of the object only,
+	// it is 0 outside of it.
+	float MaximalRadius(const float3 &x, int instance, int slot) const {
+		float4 p = mul(float4(x.x, x.y, x.z, 1), worldToObject[instance]);
+		float3 local = float3(p.x, p.y, p.z);
+		float3 minimum, maximum;
+		blas[instance].Bounds(slot, minimum, maximum);
+		if (SqrDistanceToBox(local, minimum, maximum) > 0)
+			return 0;
+		return blas[instance].Nearest(local, slot) * objectToWorldScale[instance];
+	}
+};
+
+#endif
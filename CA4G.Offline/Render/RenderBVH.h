@@ -0,0 +1,514 @@
+#ifndef OFFLINE_RENDERBVH_H
+#define OFFLINE_RENDERBVH_H
+
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+#include "../Common/Parallel.h"
+#include "RenderScene.h"
+
+// Binary bounding volume hierarchies of the CPU path tracer (RenderAccelerator.h), binned SAH trees
+// built from references to the scene arrays, and the box and triangle helpers of their queries.
+
+struct RenderBVHNode {
+	float3 Min;
+	int Start; // first reference of a leaf, left child of an inner node (the right one follows it)
+	float3 Max;
+	int Count; // references of a leaf, 0 for inner nodes
+};
+
+// Bounds of a primitive being built, Index is the triangle of the geometry or the instance.
+struct RenderBuildReference {
+	float3 Min;
+	int Index;
+	float3 Max;
+	int Padding; // 32 bytes, the builder loads both bounds as SSE vectors
+};
+
+// Build report, SAHCost is the expected cost of a random ray (traversal steps plus triangle
+// tests weighted by the surface areas relative to the roots).
+struct RenderBuildStatistics {
+	double Seconds = 0;
+	double SAHCost = 0;
+	int Nodes = 0;
+	int References = 0;
+	int WideNodes = 0; // of the collapsed hierarchy the rays traverse
+	int Packs = 0; // triangle packs of its leaves
+};
+
+// Closest point to p of the triangle (a, a + e1, a + e2), Real-Time Collision Detection 5.1.5.
+static float3 ClosestPointOnTriangle(const float3 &p, const float3 &a, const float3 &e1, const float3 &e2) {
+	float3 ap = p - a;
+	float d1 = dot(e1, ap), d2 = dot(e2, ap);
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+	float3 bp = ap - e1;
+	float d3 = dot(e1, bp), d4 = dot(e2, bp);
+	if (d3 >= 0 && d4 <= d3)
+		return a + e1;
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + e1 * (d1 / (d1 - d3));
+	float3 cp = ap - e2;
+	float d5 = dot(e1, cp), d6 = dot(e2, cp);
+	if (d6 >= 0 && d5 <= d6)
+		return a + e2;
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + e2 * (d2 / (d2 - d6));
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return a + e1 + (e2 - e1) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	float denominator = 1 / (va + vb + vc);
+	return a + e1 * (vb * denominator) + e2 * (vc * denominator);
+}
+
+static float SqrDistanceToBox(const float3 &p, const float3 &minimum, const float3 &maximum) {
+	float3 d = maxf(maxf(minimum - p, p - maximum), float3(0, 0, 0));
+	return dot(d, d);
+}
+
+// Slab test, the entry distance or a negative value if the box is missed before tMax.
+static float IntersectBox(const float3 &O, const float3 &invD, float tMax, const float3 &minimum, const float3 &maximum) {
+	float3 t0 = (minimum - O) * invD, t1 = (maximum - O) * invD;
+	float3 tNear = minf(t0, t1), tFar = maxf(t0, t1);
+	float enter = maxf(0.0f, maxf(tNear.x, maxf(tNear.y, tNear.z)));
+	float exit = minf(tMax, minf(tFar.x, minf(tFar.y, tFar.z)));
+	return enter <= exit ? enter : -1;
+}
+
+static float HalfArea(const float3 &minimum, const float3 &maximum) {
+	float3 d = maxf(maximum - minimum, float3(0, 0, 0));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// Bounds of the eight corners of a box moved by transform.
+static void TransformBox(const float3 &minimum, const float3 &maximum, const float4x4 &transform, float3 &outMin, float3 &outMax) {
+	outMin = float3(1e30f, 1e30f, 1e30f);
+	outMax = float3(-1e30f, -1e30f, -1e30f);
+	for (int c = 0; c < 8; c++) {
+		float4 p = mul(float4(c & 1 ? maximum.x : minimum.x, c & 2 ? maximum.y : minimum.y, c & 4 ? maximum.z : minimum.z, 1), transform);
+		outMin = minf(outMin, float3(p.x, p.y, p.z));
+		outMax = maxf(outMax, float3(p.x, p.y, p.z));
+	}
+}
+
+// Binned SAH builder (SSE bounds and bins). Nodes with many references are split first with
+// their binning spread over the pool, then the subtrees left are built as independent tasks and
+// appended.
+class RenderBVHBuilder {
+	static const int BINS = 16;
+	static const int PARALLEL_CHUNK = 16384;
+
+	// Bounds are handled as SSE vectors, the fourth lane is ignored.
+	static __m128 LoadMin(const RenderBuildReference &r) {
+		return _mm_and_ps(_mm_loadu_ps(&r.Min.x), _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1))); // drops Index
+	}
+	static __m128 LoadMax(const RenderBuildReference &r) { return _mm_loadu_ps(&r.Max.x); }
+
+	static float3 ToFloat3(__m128 v) {
+		alignas(16) float f[4];
+		_mm_store_ps(f, v);
+		return float3(f[0], f[1], f[2]);
+	}
+
+	static float Area(__m128 minimum, __m128 maximum) {
+		alignas(16) float d[4];
+		_mm_store_ps(d, _mm_max_ps(_mm_sub_ps(maximum, minimum), _mm_setzero_ps()));
+		return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+	}
+
+	struct Bins {
+		__m128 Min[3][BINS], Max[3][BINS];
+		int Count[3][BINS];
+
+		void Clear(int count) {
+			for (int a = 0; a < 3; a++)
+				for (int b = 0; b < count; b++) {
+					Min[a][b] = _mm_set1_ps(1e30f);
+					Max[a][b] = _mm_set1_ps(-1e30f);
+					Count[a][b] = 0;
+				}
+		}
+
+		void Add(const Bins &o, int count) {
+			for (int a = 0; a < 3; a++)
+				for (int b = 0; b < count; b++) {
+					Min[a][b] = _mm_min_ps(Min[a][b], o.Min[a][b]);
+					Max[a][b] = _mm_max_ps(Max[a][b], o.Max[a][b]);
+					Count[a][b] += o.Count[a][b];
+				}
+		}
+	};
+
+	// Bounds of the references and of their centroids (doubled, the sum of the bounds).
+	struct Extent {
+		__m128 Min, Max, CentroidMin, CentroidMax;
+		__m128 BinScale; // bins per unit of doubled centroid, 0 on flat axes
+		int BinCount = BINS; // fewer for small nodes
+
+		Extent() {
+			Min = CentroidMin = _mm_set1_ps(1e30f);
+			Max = CentroidMax = _mm_set1_ps(-1e30f);
+			BinScale = _mm_setzero_ps();
+		}
+
+		void Add(__m128 minimum, __m128 maximum) {
+			Min = _mm_min_ps(Min, minimum);
+			Max = _mm_max_ps(Max, maximum);
+			__m128 c = _mm_add_ps(minimum, maximum);
+			CentroidMin = _mm_min_ps(CentroidMin, c);
+			CentroidMax = _mm_max_ps(CentroidMax, c);
+		}
+
+		void Add(const Extent &o) {
+			Min = _mm_min_ps(Min, o.Min);
+			Max = _mm_max_ps(Max, o.Max);
+			CentroidMin = _mm_min_ps(CentroidMin, o.CentroidMin);
+			CentroidMax = _mm_max_ps(CentroidMax, o.CentroidMax);
+		}
+
+		void PrepareBins(int references) {
+			BinCount = references < BINS ? (references < 4 ? 4 : references) : BINS;
+			__m128 size = _mm_sub_ps(CentroidMax, CentroidMin);
+			__m128 scale = _mm_div_ps(_mm_set1_ps(BinCount * 0.9999f), size);
+			BinScale = _mm_and_ps(scale, _mm_cmpgt_ps(size, _mm_setzero_ps()));
+		}
+
+		bool Flat(int axis) const {
+			alignas(16) float s[4];
+			_mm_store_ps(s, BinScale);
+			return s[axis] == 0;
+		}
+	};
+
+	struct Split {
+		int Axis = -1;
+		int Bin = 0; // references in bins [0, Bin] go left
+		float Cost = 1e30f;
+	};
+
+	struct Task {
+		int Node, Begin, End, Depth;
+		Extent Bounds;
+	};
+
+	std::vector<RenderBuildReference> &references;
+	std::vector<RenderBuildReference> scratch;
+	ThreadPool* pool;
+
+	// Bins of the centroid on the three axes.
+	static __m128i BinsOf(__m128 minimum, __m128 maximum, const Extent &e) {
+		__m128 f = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(minimum, maximum), e.CentroidMin), e.BinScale);
+		f = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(f, _mm_set1_ps((float)(e.BinCount - 1))));
+		return _mm_cvttps_epi32(f);
+	}
+
+	static void AddToBins(Bins &bins, const RenderBuildReference &r, const Extent &e) {
+		__m128 minimum = LoadMin(r), maximum = LoadMax(r);
+		alignas(16) int b[4];
+		_mm_store_si128((__m128i*)b, BinsOf(minimum, maximum, e));
+		for (int a = 0; a < 3; a++) {
+			bins.Min[a][b[a]] = _mm_min_ps(bins.Min[a][b[a]], minimum);
+			bins.Max[a][b[a]] = _mm_max_ps(bins.Max[a][b[a]], maximum);
+			bins.Count[a][b[a]]++;
+		}
+	}
+
+	bool Parallel(int count) const { return pool != nullptr && pool->ThreadCount() > 1 && count > 2 * PARALLEL_CHUNK; }
+
+	Extent ComputeExtent(int begin, int end) {
+		Extent extent;
+		if (!Parallel(end - begin)) {
+			for (int i = begin; i < end; i++)
+				extent.Add(LoadMin(references[i]), LoadMax(references[i]));
+			return extent;
+		}
+		std::vector<Extent> partial(pool->ThreadCount());
+		pool->ParallelFor(end - begin, PARALLEL_CHUNK, [&](int b, int e, int thread) {
+			for (int i = begin + b; i < begin + e; i++)
+				partial[thread].Add(LoadMin(references[i]), LoadMax(references[i]));
+		});
+		for (const Extent &p : partial)
+			extent.Add(p);
+		return extent;
+	}
+
+	void Bin(int begin, int end, const Extent &extent, Bins &bins) {
+		bins.Clear(extent.BinCount);
+		if (!Parallel(end - begin)) {
+			for (int i = begin; i < end; i++)
+				AddToBins(bins, references[i], extent);
+			return;
+		}
+		std::vector<Bins> partial(pool->ThreadCount());
+		for (Bins &p : partial)
+			p.Clear(extent.BinCount);
+		pool->ParallelFor(end - begin, PARALLEL_CHUNK, [&](int b, int e, int thread) {
+			for (int i = begin + b; i < begin + e; i++)
+				AddToBins(partial[thread], references[i], extent);
+		});
+		for (const Bins &p : partial)
+			bins.Add(p, extent.BinCount);
+	}
+
+	// Sweeps the bins of every axis from both sides, the cost of a plane is the half area times
+	// the count of both sides.
+	static Split BestSplit(const Bins &bins, const Extent &extent) {
+		Split best;
+		const int n = extent.BinCount;
+		for (int a = 0; a < 3; a++) {
+			if (extent.Flat(a))
+				continue;
+			float leftArea[BINS], rightArea[BINS];
+			int leftCount[BINS], rightCount[BINS];
+			__m128 lMin = _mm_set1_ps(1e30f), lMax = _mm_set1_ps(-1e30f), rMin = lMin, rMax = lMax;
+			int lCount = 0, rCount = 0;
+			for (int b = 0; b < n; b++) {
+				lMin = _mm_min_ps(lMin, bins.Min[a][b]);
+				lMax = _mm_max_ps(lMax, bins.Max[a][b]);
+				lCount += bins.Count[a][b];
+				leftArea[b] = Area(lMin, lMax);
+				leftCount[b] = lCount;
+				int r = n - 1 - b;
+				rMin = _mm_min_ps(rMin, bins.Min[a][r]);
+				rMax = _mm_max_ps(rMax, bins.Max[a][r]);
+				rCount += bins.Count[a][r];
+				rightArea[r] = Area(rMin, rMax);
+				rightCount[r] = rCount;
+			}
+			for (int b = 0; b < n - 1; b++) {
+				if (leftCount[b] == 0 || rightCount[b + 1] == 0)
+					continue;
+				float cost = leftArea[b] * leftCount[b] + rightArea[b + 1] * rightCount[b + 1];
+				if (cost < best.Cost) {
+					best.Axis = a;
+					best.Bin = b;
+					best.Cost = cost;
+				}
+			}
+		}
+		return best;
+	}
+
+	static bool GoesLeft(__m128 minimum, __m128 maximum, const Extent &extent, const Split &split) {
+		alignas(16) int b[4];
+		_mm_store_si128((__m128i*)b, BinsOf(minimum, maximum, extent));
+		return b[split.Axis] <= split.Bin;
+	}
+
+	// Stable partition in chunks: every chunk counts its sides, then scatters its references to
+	// their offsets in a scratch copy.
+	int ParallelPartition(int begin, int end, const Extent &extent, const Split &split, Extent &left, Extent &right) {
+		int count = end - begin;
+		int chunks = (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+		std::vector<int> leftCounts(chunks);
+		std::vector<Extent> leftExtents(chunks), rightExtents(chunks);
+		pool->ParallelFor(chunks, 1, [&](int b, int e, int) {
+			for (int c = b; c < e; c++)
+				for (int i = begin + c * PARALLEL_CHUNK; i < std::min(end, begin + (c + 1) * PARALLEL_CHUNK); i++) {
+					__m128 minimum = LoadMin(references[i]), maximum = LoadMax(references[i]);
+					if (GoesLeft(minimum, maximum, extent, split)) {
+						leftCounts[c]++;
+						leftExtents[c].Add(minimum, maximum);
+					}
+					else
+						rightExtents[c].Add(minimum, maximum);
+				}
+		});
+		std::vector<int> leftOffsets(chunks), rightOffsets(chunks);
+		int totalLeft = 0;
+		for (int c = 0; c < chunks; c++) {
+			leftOffsets[c] = totalLeft;
+			totalLeft += leftCounts[c];
+		}
+		for (int c = 0, right = totalLeft; c < chunks; c++) {
+			rightOffsets[c] = right;
+			right += std::min(PARALLEL_CHUNK, count - c * PARALLEL_CHUNK) - leftCounts[c];
+		}
+		scratch.resize(count);
+		pool->ParallelFor(chunks, 1, [&](int b, int e, int) {
+			for (int c = b; c < e; c++) {
+				int l = leftOffsets[c], r = rightOffsets[c];
+				for (int i = begin + c * PARALLEL_CHUNK; i < std::min(end, begin + (c + 1) * PARALLEL_CHUNK); i++)
+					scratch[GoesLeft(LoadMin(references[i]), LoadMax(references[i]), extent, split) ? l++ : r++] = references[i];
+			}
+		});
+		pool->ParallelFor(count, PARALLEL_CHUNK, [&](int b, int e, int) {
+			std::copy(scratch.begin() + b, scratch.begin() + e, references.begin() + begin + b);
+		});
+		left = right = Extent();
+		for (int c = 0; c < chunks; c++) {
+			left.Add(leftExtents[c]);
+			right.Add(rightExtents[c]);
+		}
+		return begin + totalLeft;
+	}
+
+	// Bounds the node with its extent and partitions its references, false for a leaf. mid is the
+	// first reference of the right child, the extents of both children are gathered on the way.
+	bool SplitNode(RenderBVHNode &node, int begin, int end, int depth, Extent extent, int &mid, Extent &left, Extent &right) {
+		int count = end - begin;
+		node.Min = ToFloat3(extent.Min);
+		node.Max = ToFloat3(extent.Max);
+		if (count == 1 || depth >= MAX_DEPTH)
+			return false;
+		extent.PrepareBins(count);
+		Bins bins;
+		Bin(begin, end, extent, bins);
+		Split split = BestSplit(bins, extent);
+		if (split.Axis < 0) { // all centroids together, halves in order when they do not fit a leaf
+			if (count <= MAX_LEAF_SIZE)
+				return false;
+			mid = begin + count / 2;
+			left = ComputeExtent(begin, mid);
+			right = ComputeExtent(mid, end);
+			return true;
+		}
+		float splitCost = TRAVERSAL_COST + INTERSECTION_COST * split.Cost / maxf(Area(extent.Min, extent.Max), 1e-30f);
+		if (count <= MAX_LEAF_SIZE && count * INTERSECTION_COST <= splitCost)
+			return false;
+		if (Parallel(count)) {
+			mid = ParallelPartition(begin, end, extent, split, left, right);
+			return true;
+		}
+		left = right = Extent();
+		int i = begin, j = end - 1;
+		while (i <= j) {
+			__m128 minimum = LoadMin(references[i]), maximum = LoadMax(references[i]);
+			if (GoesLeft(minimum, maximum, extent, split)) {
+				left.Add(minimum, maximum);
+				i++;
+			}
+			else {
+				right.Add(minimum, maximum);
+				std::swap(references[i], references[j--]);
+			}
+		}
+		mid = i;
+		return true;
+	}
+
+	void BuildRecursive(std::vector<RenderBVHNode> &nodes, int index, int begin, int end, int depth, const Extent &extent) {
+		int mid;
+		Extent left, right;
+		if (!SplitNode(nodes[index], begin, end, depth, extent, mid, left, right)) {
+			nodes[index].Start = begin;
+			nodes[index].Count = end - begin;
+			return;
+		}
+		int first = (int)nodes.size();
+		nodes.push_back(RenderBVHNode());
+		nodes.push_back(RenderBVHNode());
+		nodes[index].Start = first;
+		nodes[index].Count = 0;
+		BuildRecursive(nodes, first, begin, mid, depth + 1, left);
+		BuildRecursive(nodes, first + 1, mid, end, depth + 1, right);
+	}
+
+public:
+	static const int MAX_LEAF_SIZE = 8;
+	static const int MAX_DEPTH = 60; // the traversals keep stacks of 64 nodes
+	static constexpr float TRAVERSAL_COST = 1.0f;
+	static constexpr float INTERSECTION_COST = 1.0f;
+
+	// references are reordered as the leaves refer to them, pool can be null.
+	RenderBVHBuilder(std::vector<RenderBuildReference> &references, ThreadPool* pool) : references(references), pool(pool) {
+	}
+
+	// Appends the hierarchy to nodes and returns its root, leaves count references from referenceOffset.
+	int Build(std::vector<RenderBVHNode> &nodes, int referenceOffset = 0) {
+		int n = (int)references.size();
+		int root = (int)nodes.size();
+		nodes.push_back(RenderBVHNode());
+		if (n == 0) {
+			nodes[root].Min = float3(1e30f, 1e30f, 1e30f);
+			nodes[root].Max = float3(-1e30f, -1e30f, -1e30f);
+			nodes[root].Start = referenceOffset;
+			nodes[root].Count = 0;
+			return root;
+		}
+		// top levels until there are enough subtrees to keep the workers busy
+		int threads = pool != nullptr ? pool->ThreadCount() : 1;
+		int taskSize = threads > 1 ? std::max(4096, n / (threads * 8)) : n;
+		std::vector<Task> pending = { { root, 0, n, 0, ComputeExtent(0, n) } }, tasks;
+		while (!pending.empty()) {
+			Task t = pending.back();
+			pending.pop_back();
+			int mid;
+			Extent leftExtent, rightExtent;
+			if (t.End - t.Begin <= taskSize)
+				tasks.push_back(t);
+			else if (!SplitNode(nodes[t.Node], t.Begin, t.End, t.Depth, t.Bounds, mid, leftExtent, rightExtent)) {
+				nodes[t.Node].Start = t.Begin;
+				nodes[t.Node].Count = t.End - t.Begin;
+			}
+			else {
+				int left = (int)nodes.size();
+				nodes.push_back(RenderBVHNode());
+				nodes.push_back(RenderBVHNode());
+				nodes[t.Node].Start = left;
+				nodes[t.Node].Count = 0;
+				pending.push_back({ left, t.Begin, mid, t.Depth + 1, leftExtent });
+				pending.push_back({ left + 1, mid, t.End, t.Depth + 1, rightExtent });
+			}
+		}
+		// subtrees over disjoint ranges of the references, largest first
+		std::sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) { return a.End - a.Begin > b.End - b.Begin; });
+		std::vector<std::vector<RenderBVHNode>> subtrees(tasks.size());
+		ThreadPool* outer = pool;
+		pool = nullptr; // busy with the tasks, they bin serially
+		auto build = [&](int b, int e, int) {
+			for (int i = b; i < e; i++) {
+				subtrees[i].push_back(RenderBVHNode());
+				BuildRecursive(subtrees[i], 0, tasks[i].Begin, tasks[i].End, tasks[i].Depth, tasks[i].Bounds);
+			}
+		};
+		if (outer != nullptr)
+			outer->ParallelFor((int)tasks.size(), 1, build);
+		else
+			build(0, (int)tasks.size(), 0);
+		pool = outer;
+		// the root of a subtree takes the node reserved for it, the rest is appended
+		for (size_t i = 0; i < tasks.size(); i++) {
+			int base = (int)nodes.size() - 1;
+			for (size_t k = 0; k < subtrees[i].size(); k++) {
+				RenderBVHNode node = subtrees[i][k];
+				if (node.Count == 0)
+					node.Start += base;
+				if (k == 0)
+					nodes[tasks[i].Node] = node;
+				else
+					nodes.push_back(node);
+			}
+		}
+		for (int i = root; i < (int)nodes.size(); i++)
+			if (nodes[i].Count > 0)
+				nodes[i].Start += referenceOffset;
+		return root;
+	}
+};
+
+// SAH cost of the hierarchy at root relative to the area of the root.
+static double SAHCost(const std::vector<RenderBVHNode> &nodes, int root) {
+	double rootArea = HalfArea(nodes[root].Min, nodes[root].Max);
+	if (rootArea <= 0)
+		return 0;
+	double cost = 0;
+	std::vector<int> stack = { root };
+	while (!stack.empty()) {
+		const RenderBVHNode &node = nodes[stack.back()];
+		stack.pop_back();
+		double area = HalfArea(node.Min, node.Max) / rootArea;
+		if (node.Count == 0) {
+			cost += area * RenderBVHBuilder::TRAVERSAL_COST;
+			stack.push_back(node.Start);
+			stack.push_back(node.Start + 1);
+		}
+		else
+			cost += area * node.Count * RenderBVHBuilder::INTERSECTION_COST;
+	}
+	return cost;
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef OFFLINE_RENDERCOMMAND_H
+#define OFFLINE_RENDERCOMMAND_H
+
+#include <memory>
+#include <string>
+#include <cstdio>
+#include "../Common/CommandLine.h"
+#include "CPUPathtracer.h"
+#include "AdaptiveSampling.h"
+#ifdef _WIN32
+#include "SceneImport.h"
+#include "../../CA4G.DemoApp/main_scene.h"
+#endif
+
+// Scene of the render commands, scene=lucydrago (models=a.obj,b.obj replaces its spheres of
+// slices=96) or scene=demo, the main_scene of CA4G.DemoApp imported through its SceneManager
+// (Windows only, without textures, see SceneImport.h).
+static bool BuildRenderScene(const CommandLine &args, RenderScene &scene, std::string &error) {
+	std::string name = args.String("scene", "lucydrago");
+	if (name == "lucydrago")
+		return BuildLucyAndDragoScene(scene, args.Strings("models", ""), (int)args.Int("slices", 96), error);
+#ifdef _WIN32
+	if (name == "demo") {
+		gObj<SceneManager> manager = new main_scene();
+		manager->SetupScene();
+		int textured = ImportScene(manager, scene);
+		if (textured > 0)
+			printf("Warning: the textures of %d materials are ignored, the CPU path tracer has no texture support\n", textured);
+		return true;
+	}
+#endif
+	error = "unknown scene " + name;
+	return false;
+}
+
+// Tables a technique samples, loaded from stf= (stf2.bin) and stfx= (stfx.bin) when needed.
+struct RenderTables {
+	std::unique_ptr<STFTables> STF;
+	std::unique_ptr<STFXTables> STFX;
+
+	bool Load(const CommandLine &args, RenderTechnique technique, std::string &error) {
+		if (technique == RenderTechnique::STF && !STF) {
+			std::string path = args.String("stf", "stf2.bin");
+			STF.reset(new STFTables());
+			if (!STF->Load(path.c_str())) {
+				error = path + " is not an STF table (" + (STF->File.Error()[0] ? STF->File.Error() : "other kind or bins") + ")";
+				STF.reset();
+				return false;
+			}
+		}
+		if (technique == RenderTechnique::STFX && !STFX) {
+			std::string path = args.String("stfx", "stfx.bin");
+			STFX.reset(new STFXTables());
+			if (!STFX->Load(path.c_str())) {
+				error = path + " is not an STFX table (" + (STFX->File.Error()[0] ? STFX->File.Error() : "other kind or bins") + ")";
+				STFX.reset();
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+static void PrintBuildStatistics(const RenderScene &scene, const RenderAccelerator &accelerator) {
+	const RenderBuildStatistics &blas = accelerator.BLASStatistics(), &tlas = accelerator.TLASStatistics();
+	printf("Scene: %d triangles, %d geometries, %d instances\n", scene.TriangleCount(), (int)scene.Geometries.size(), (int)scene.Instances.size());
+	printf("  BLAS %8.2f ms %9d nodes, SAH cost %.2f\n", blas.Seconds * 1000, blas.Nodes, blas.SAHCost);
+	printf("  TLAS %8.3f ms %9d nodes, SAH cost %.2f\n", tlas.Seconds * 1000, tlas.Nodes, tlas.SAHCost);
+	printf("  BVH%d %9d nodes, %d triangle packs (%.2f triangles per pack)\n", RenderWideBVH::WIDTH, blas.WideNodes, blas.Packs,
+		blas.References / (double)(blas.Packs > 0 ? blas.Packs : 1));
+}
+
+// Renders passes of a technique with the CPU path tracer and saves the mean (or the complexity)
+// as a PFM, reporting the throughput of the passes. adaptive=<relative error> renders tiles until
+// the error of the image reaches it (RenderAdaptive), passes is then the most a pixel receives.
+//	technique=pt|stf|stfx|cvae width=640 height=360 passes=16 ptratio=0 tile=16 schedule=shared|stealing|cost threads=0
+//	tier=exact|polynomial|linear randoms=hybridtaus|philox|sobol adaptive=0 minpasses=12 out=render.pfm complexity=0
+//	rrsurface=0 rrmedium=0 (ROULETTE_*_THRESHOLD) nonanalog=0 (NON_ANALOG_ABSORPTION) spectral=0 (SPECTRAL_PATHTRACING, pt only)
+//	shared=0 (SHARED_PATH_MEDIA, cvae only)
+//	scene=lucydrago|demo models= slices=96 stf=stf2.bin stfx=stfx.bin
+static int RenderCommand(const CommandLine &args) {
+	RenderSettings settings;
+	std::string techniqueName = args.String("technique", "stf");
+	if (!ParseRenderTechnique(techniqueName, settings.Technique)) {
+		printf("Unknown technique %s (pt, stf, stfx or cvae)\n", techniqueName.c_str());
+		return 1;
+	}
+	settings.PathtracingRatio = args.Float("ptratio", 0);
+	settings.TileSize = (int)args.Int("tile", 16);
+	std::string scheduleName = args.String("schedule", "cost");
+	if (!ParseTileSchedule(scheduleName, settings.Schedule)) {
+		printf("Unknown schedule %s (shared, stealing or cost)\n", scheduleName.c_str());
+		return 1;
+	}
+	settings.Tier = ParseActivationTier(args.String("tier", "exact"));
+	std::string randomsName = args.String("randoms", RandomSequenceName(settings.Randoms));
+	if (!ParseRandomSequence(randomsName, settings.Randoms)) {
+		printf("Unknown random sequence %s (hybridtaus, philox or sobol)\n", randomsName.c_str());
+		return 1;
+	}
+	settings.SurfaceRoulette = args.Float("rrsurface", settings.SurfaceRoulette);
+	settings.MediumRoulette = args.Float("rrmedium", settings.MediumRoulette);
+	settings.NonAnalogAbsorption = args.Int("nonanalog", settings.NonAnalogAbsorption) != 0;
+	settings.Spectral = args.Int("spectral", settings.Spectral) != 0;
+	settings.SharedMedia = args.Int("shared", settings.SharedMedia) != 0;
+	int width = (int)args.Int("width", 640), height = (int)args.Int("height", 360);
+	int passes = (int)args.Int("passes", 16);
+	AdaptiveSettings adaptive;
+	adaptive.Threshold = args.Float("adaptive", 0);
+	adaptive.MinimumPasses = (int)args.Int("minpasses", adaptive.MinimumPasses);
+	adaptive.MaximumPasses = passes;
+	std::string out = args.String("out", "render.pfm");
+	bool showComplexity = args.Int("complexity", 0) != 0;
+	ThreadPool pool((int)args.Int("threads", 0));
+
+	RenderScene scene;
+	RenderTables tables;
+	std::string error;
+	if (!BuildRenderScene(args, scene, error) || !tables.Load(args, settings.Technique, error)) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	RenderAccelerator accelerator;
+	accelerator.Build(scene, &pool);
+	PrintBuildStatistics(scene, accelerator);
+
+	CPUPathtracer tracer(scene, accelerator, settings, tables.STF.get(), tables.STFX.get());
+	RenderTarget target(width, height);
+	RenderStatistics total;
+	double utilization = 0;
+	int stolen = 0;
+	if (adaptive.Threshold > 0) {
+		AdaptiveResult result = RenderAdaptive(tracer, pool, target, adaptive);
+		total = result.Statistics;
+		passes = target.Passes;
+		long long pixelPasses = 0;
+		uint32_t fewest = ~0u, most = 0;
+		for (uint32_t p : target.PixelPasses) {
+			pixelPasses += p;
+			fewest = std::min(fewest, p);
+			most = std::max(most, p);
+		}
+		double uniform = (double)most * width * height;
+		printf("Adaptive: %s relative error %.4f (worst tile %.4f, threshold %.4f) after %d rounds\n",
+			result.Converged ? "converged to" : "stopped at", result.Error, result.WorstTile, adaptive.Threshold, result.Rounds);
+		printf("  passes per pixel %u min %.1f mean %u max, %.1f%% of the pixel passes of %u uniform passes\n", fewest,
+			pixelPasses / (double)(width * height), most, 100 * pixelPasses / (uniform > 0 ? uniform : 1), most);
+	}
+	else
+		for (int p = 0; p < passes; p++) {
+			total.Add(tracer.RenderPass(pool, target));
+			utilization += tracer.Scheduler().MeanUtilization();
+			stolen += tracer.Scheduler().StolenTiles();
+		}
+
+	double paths = (double)(total.Paths > 0 ? total.Paths : 1);
+	printf("%s %dx%d, %d passes, %d threads: %.1f ms/pass\n", RenderTechniqueName(settings.Technique), width, height,
+		passes, pool.ThreadCount(), total.Seconds * 1000 / (passes > 0 ? passes : 1));
+	printf("  %.3f Mpaths/s %.3f Mrays/s, per path: %.2f rays %.2f radius queries %.2f medium events\n",
+		total.Paths / total.Seconds * 1e-6, total.Rays / total.Seconds * 1e-6,
+		total.Rays / paths, total.RadiusQueries / paths, total.MediumEvents / paths);
+	printf("  russian roulette per 1000 paths: surface %.2f played %.2f ended, medium %.2f played %.2f ended\n",
+		1000 * total.SurfaceRoulettes / paths, 1000 * total.SurfaceTerminations / paths,
+		1000 * total.MediumRoulettes / paths, 1000 * total.MediumTerminations / paths);
+	if (adaptive.Threshold <= 0)
+		printf("  %s schedule, %d tiles: %.1f%% worker utilization, %.1f stolen tiles per pass\n", TileScheduleName(settings.Schedule),
+			(int)tracer.Scheduler().Tiles().size(), 100 * utilization / (passes > 0 ? passes : 1), stolen / (double)(passes > 0 ? passes : 1));
+	if (!target.Save(out.c_str(), showComplexity)) {
+		printf("Can not write %s\n", out.c_str());
+		return 1;
+	}
+	printf("Saved %s\n", out.c_str());
+	return 0;
+}
+
+#endif
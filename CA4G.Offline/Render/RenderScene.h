@@ -0,0 +1,372 @@
+#ifndef OFFLINE_RENDERSCENE_H
+#define OFFLINE_RENDERSCENE_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include "ca4g_gmath.h"
+
+using namespace CA4G;
+
+// Scene of the CPU path tracer (CPUPathtracer.h) laid out as IScene: geometries are ranges of
+// the vertex and index buffers (indices relative to the first vertex) and instances place a
+// collection of geometries with a transform. Geometry transforms, fixed in the DemoApp scenes,
+// are applied to the vertices when appended. Render nodes without DirectX build it from OBJ
+// files or the built-in scenes, SceneImport.h copies a SceneManager of CA4G.DemoApp into it.
+
+// Material of Shaders/Tools/Definitions.h (SceneMaterial) without the texture maps.
+struct RenderMaterial {
+	float3 Diffuse = float3(1, 1, 1);
+	float RefractionIndex = 1;
+	float3 Specular = float3(0, 0, 0);
+	float SpecularSharpness = 1;
+	float4 Roulette = float4(1, 0, 0, 0); // X - Diffuse ammount, Y - Specular, Z - Mirror scattering, W - Fresnell scattering
+	float3 Emissive = float3(0, 0, 0);
+};
+
+struct RenderVolumeMaterial {
+	float3 Extinction = float3(0, 0, 0);
+	float3 ScatteringAlbedo = float3(1, 1, 1);
+	float3 G = float3(0, 0, 0);
+};
+
+struct RenderVertex {
+	float3 P;
+	float3 N;
+
+	RenderVertex Transformed(const float4x4 &transform) const {
+		float4 p = mul(float4(P.x, P.y, P.z, 1), transform);
+		float4 n = mul(float4(N.x, N.y, N.z, 0), transform);
+		return { float3(p.x, p.y, p.z), normalize(float3(n.x, n.y, n.z)) };
+	}
+};
+
+// Triangle list of the vertices [StartVertex, StartVertex + VertexCount), with an instance it
+// is the object whose empty spheres MaximalRadius measures (a distance field in the shaders).
+struct RenderGeometry {
+	int StartVertex;
+	int VertexCount;
+	int StartIndex;
+	int IndexCount;
+	int MaterialIndex;
+};
+
+struct RenderInstance {
+	std::vector<int> Geometries;
+	float4x4 Transform;
+};
+
+// Camera and main light of SceneInfo.
+struct RenderCamera {
+	float3 Position = float3(0, 0, 2);
+	float3 Target = float3(0, 0, 0);
+	float3 Up = float3(0, 1, 0);
+	float FoV = PI / 4;
+	float NearPlane = 0.1f;
+	float FarPlane = 1000.0f;
+
+	// FromProjectionToWorld of the techniques (Camera::GetMatrices)
+	float4x4 ProjectionToWorld(int width, int height) const {
+		float4x4 view = Transforms::LookAtRH(Position, Target, Up);
+		float4x4 projection = Transforms::PerspectiveFovRH(FoV, height / (float)width, NearPlane, FarPlane);
+		return mul(inverse(projection), inverse(view));
+	}
+
+	// Ray of RayGen through (cx, cy) in [0, 1] of the image, from the near plane.
+	static void PrimaryRay(const float4x4 &projectionToWorld, float cx, float cy, float3 &O, float3 &D) {
+		float4 ndcP = float4(2 * cx - 1, -(2 * cy - 1), 0, 1);
+		float4 ndcT = float4(ndcP.x, ndcP.y, 1, 1);
+		float4 viewP = mul(ndcP, projectionToWorld);
+		float4 viewT = mul(ndcT, projectionToWorld);
+		O = float3(viewP.x, viewP.y, viewP.z) * (1 / viewP.w);
+		float3 T = float3(viewT.x, viewT.y, viewT.z) * (1 / viewT.w);
+		D = normalize(T - O);
+	}
+};
+
+struct RenderLight {
+	float3 Position = float3(0, 0, 0);
+	float3 Direction = float3(0, 0, 0);
+	float3 Intensity = float3(0, 0, 0);
+};
+
+// Parts of a RenderScene the ray queries depend on, with the bits of SceneElement (ca4g_scene.h).
+enum class RenderSceneElement {
+	None = 0,
+	Vertices = 4,
+	Indices = 8,
+	Geometries = 16,
+	Instances = 32,
+	InstanceTransforms = 128,
+	All = Vertices | Indices | Geometries | Instances | InstanceTransforms
+};
+
+static RenderSceneElement operator&(const RenderSceneElement &a, const RenderSceneElement &b) {
+	return (RenderSceneElement)(((int)a) & ((int)b));
+}
+
+static RenderSceneElement operator|(const RenderSceneElement &a, const RenderSceneElement &b) {
+	return (RenderSceneElement)(((int)a) | ((int)b));
+}
+
+static bool operator +(const RenderSceneElement &a) {
+	return a != RenderSceneElement::None;
+}
+
+// Versions of the parts of a RenderScene a consumer has seen (SceneVersion). Vertices are also
+// versioned per geometry so the untouched ones can be left alone.
+struct RenderSceneVersion {
+	long Elements[8] = {};
+	std::vector<long> Vertices;
+};
+
+class RenderScene {
+	RenderSceneVersion currentVersion;
+
+public:
+	std::vector<RenderVertex> Vertices; // object space
+	std::vector<int> Indices; // relative to the first vertex of the geometry, 3 per triangle
+	std::vector<RenderGeometry> Geometries;
+	std::vector<RenderInstance> Instances;
+	std::vector<RenderMaterial> Materials;
+	std::vector<RenderVolumeMaterial> VolumeMaterials; // one per material
+	RenderCamera Camera;
+	RenderLight Light;
+
+	int TriangleCount() const { return (int)Indices.size() / 3; }
+
+	// Marks parts of the scene as changed (SceneInfo::OnUpdated), after writing Vertices or the
+	// Transform of Instances directly. geometry restricts a change of vertices to one geometry.
+	void OnUpdated(RenderSceneElement elements, int geometry = -1) {
+		for (int i = 0; i < 8; i++)
+			if ((int)elements & (1 << i))
+				currentVersion.Elements[i]++;
+		if (+(elements & RenderSceneElement::Vertices))
+			for (int g = 0; g < (int)currentVersion.Vertices.size(); g++)
+				if (geometry == -1 || geometry == g)
+					currentVersion.Vertices[g]++;
+	}
+
+	// Parts updated since version, which is brought up to date (SceneInfo::Updated).
+	// updatedGeometries flags the geometries whose vertices changed.
+	RenderSceneElement Updated(RenderSceneVersion &version, std::vector<bool> &updatedGeometries) const {
+		RenderSceneElement update = RenderSceneElement::None;
+		for (int i = 0; i < 8; i++)
+			if (currentVersion.Elements[i] != version.Elements[i]) {
+				version.Elements[i] = currentVersion.Elements[i];
+				update = update | (RenderSceneElement)(1 << i);
+			}
+		updatedGeometries.assign(currentVersion.Vertices.size(), false);
+		version.Vertices.resize(currentVersion.Vertices.size(), -1);
+		for (size_t g = 0; g < currentVersion.Vertices.size(); g++)
+			if (currentVersion.Vertices[g] != version.Vertices[g]) {
+				version.Vertices[g] = currentVersion.Vertices[g];
+				updatedGeometries[g] = true;
+			}
+		return update;
+	}
+
+	// Removes everything, consumers see all the elements updated.
+	void Clear() {
+		Vertices.clear();
+		Indices.clear();
+		Geometries.clear();
+		Instances.clear();
+		Materials.clear();
+		VolumeMaterials.clear();
+		currentVersion.Vertices.clear();
+		OnUpdated(RenderSceneElement::All);
+	}
+
+	int AppendMaterial(const RenderMaterial &material, const RenderVolumeMaterial &volume = RenderVolumeMaterial()) {
+		Materials.push_back(material);
+		VolumeMaterials.push_back(volume);
+		return (int)Materials.size() - 1;
+	}
+
+	// Appends a mesh (indices relative to its vertices) moved by the geometry transform.
+	int AppendGeometry(const std::vector<RenderVertex> &vertices, const std::vector<int> &indices, int materialIndex,
+		const float4x4 &transform = Transforms::Translate(0, 0, 0)) {
+		RenderGeometry geometry = { (int)Vertices.size(), (int)vertices.size(), (int)Indices.size(), (int)indices.size(), materialIndex };
+		for (const RenderVertex &v : vertices)
+			Vertices.push_back(v.Transformed(transform));
+		Indices.insert(Indices.end(), indices.begin(), indices.end());
+		Geometries.push_back(geometry);
+		currentVersion.Vertices.push_back(0);
+		OnUpdated(RenderSceneElement::Vertices | RenderSceneElement::Indices | RenderSceneElement::Geometries, (int)Geometries.size() - 1);
+		return (int)Geometries.size() - 1;
+	}
+
+	int AppendInstance(const std::vector<int> &geometries, const float4x4 &transform = Transforms::Translate(0, 0, 0)) {
+		Instances.push_back({ geometries, transform });
+		OnUpdated(RenderSceneElement::Instances | RenderSceneElement::InstanceTransforms);
+		return (int)Instances.size() - 1;
+	}
+
+	// As SceneManager::setGlassMaterial and setMirrorMaterial.
+	void SetGlassMaterial(int index, float alpha, float refractionIndex) {
+		RenderMaterial &material = Materials[index];
+		material.RefractionIndex = refractionIndex;
+		material.Specular = lerp(material.Specular, float3(1, 1, 1), float3(alpha));
+		material.Roulette = lerp(material.Roulette, float4(0, 0, 0, 1), float4(alpha));
+	}
+
+	void SetMirrorMaterial(int index, float alpha) {
+		RenderMaterial &material = Materials[index];
+		material.Specular = lerp(material.Specular, float3(1, 1, 1), float3(alpha));
+		material.Roulette = lerp(material.Roulette, float4(0, 0, 1, 0), float4(alpha));
+	}
+};
+
+// Scales a mesh to a unit largest side, centered in x and z and resting on y = 0
+// (SceneNormalization::Scale | Maximum | MinY | Center of the DemoApp scenes).
+static void NormalizeMesh(std::vector<RenderVertex> &vertices) {
+	if (vertices.empty())
+		return;
+	float3 minimum = vertices[0].P, maximum = vertices[0].P;
+	for (const RenderVertex &v : vertices) {
+		minimum = minf(minimum, v.P);
+		maximum = maxf(maximum, v.P);
+	}
+	float3 size = maximum - minimum;
+	float scale = 1.0f / maxf(0.0000001f, maxf(size.x, maxf(size.y, size.z)));
+	float3 translate = float3(-0.5f * (maximum.x + minimum.x), -minimum.y, -0.5f * (maximum.z + minimum.z));
+	for (RenderVertex &v : vertices)
+		v.P = (v.P + translate) * scale;
+}
+
+// Positions, normals and faces (polygons as fans) of an OBJ file as one mesh, missing normals
+// are the face normals. Materials and texture coordinates are ignored.
+static bool LoadOBJMesh(const char* path, std::vector<RenderVertex> &vertices, std::vector<int> &indices) {
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return false;
+	std::vector<float3> positions, normals;
+	std::vector<int> face;
+	char line[1024];
+	while (fgets(line, sizeof(line), f)) {
+		float x, y, z;
+		if (line[0] == 'v' && line[1] == ' ' && sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3)
+			positions.push_back(float3(x, y, z));
+		else if (line[0] == 'v' && line[1] == 'n' && sscanf(line + 3, "%f %f %f", &x, &y, &z) == 3)
+			normals.push_back(float3(x, y, z));
+		else if (line[0] == 'f' && line[1] == ' ') {
+			face.clear();
+			char* p = line + 2;
+			while (true) {
+				while (*p == ' ' || *p == '\t')
+					p++;
+				if (*p == '\0' || *p == '\n' || *p == '\r')
+					break;
+				int vi = (int)strtol(p, &p, 10), ni = 0;
+				if (*p == '/') {
+					p++;
+					if (*p != '/')
+						strtol(p, &p, 10); // texture coordinate
+					if (*p == '/') {
+						p++;
+						ni = (int)strtol(p, &p, 10);
+					}
+				}
+				while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+					p++;
+				vi = vi < 0 ? (int)positions.size() + vi : vi - 1;
+				ni = ni < 0 ? (int)normals.size() + ni : ni - 1;
+				if (vi < 0 || vi >= (int)positions.size()) {
+					fclose(f);
+					return false;
+				}
+				face.push_back((int)vertices.size());
+				vertices.push_back({ positions[vi], ni >= 0 && ni < (int)normals.size() ? normals[ni] : float3(0, 0, 0) });
+			}
+			for (size_t k = 2; k < face.size(); k++) {
+				indices.push_back(face[0]);
+				indices.push_back(face[k - 1]);
+				indices.push_back(face[k]);
+			}
+		}
+	}
+	fclose(f);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		RenderVertex &a = vertices[indices[t]], &b = vertices[indices[t + 1]], &c = vertices[indices[t + 2]];
+		float3 n = cross(b.P - a.P, c.P - a.P);
+		if (length(n) > 0)
+			n = normalize(n);
+		if (length(a.N) == 0) a.N = n;
+		if (length(b.N) == 0) b.N = n;
+		if (length(c.N) == 0) c.N = n;
+	}
+	return !indices.empty();
+}
+
+// Sphere of the given subdivisions resting on y = 0, unit diameter (a normalized mesh).
+static void CreateSphereMesh(int slices, int stacks, std::vector<RenderVertex> &vertices, std::vector<int> &indices) {
+	for (int j = 0; j <= stacks; j++)
+		for (int i = 0; i <= slices; i++) {
+			float theta = PI * j / stacks, phi = 2 * PI * (i % slices) / slices; // closed seam
+			float3 n = float3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			vertices.push_back({ n * 0.5f + float3(0, 0.5f, 0), n });
+		}
+	for (int j = 0; j < stacks; j++)
+		for (int i = 0; i < slices; i++) {
+			int a = j * (slices + 1) + i, b = a + slices + 1;
+			if (j > 0) {
+				indices.push_back(a); indices.push_back(a + 1); indices.push_back(b);
+			}
+			if (j < stacks - 1) {
+				indices.push_back(a + 1); indices.push_back(b + 1); indices.push_back(b);
+			}
+		}
+}
+
+// Square of side size on y = 0 facing +y.
+static void CreatePlateMesh(float size, std::vector<RenderVertex> &vertices, std::vector<int> &indices) {
+	float h = size * 0.5f;
+	vertices = {
+		{ float3(-h, 0, -h), float3(0, 1, 0) }, { float3(h, 0, -h), float3(0, 1, 0) },
+		{ float3(h, 0, h), float3(0, 1, 0) }, { float3(-h, 0, h), float3(0, 1, 0) } };
+	indices = { 0, 2, 1, 0, 3, 2 };
+}
+
+// LucyAndDrago2 of CA4G.DemoApp (main_scene.h): two glass objects filled with media on a
+// reflective plate, lit by the skybox and the main light. models replaces the two spheres by OBJ
+// files (newLucy.obj,newDragon.obj in the DemoApp), normalized as the DemoApp does. The spheres
+// have slices x slices / 2 quads.
+static bool BuildLucyAndDragoScene(RenderScene &scene, const std::vector<std::string> &models, int slices, std::string &error) {
+	scene.Camera.Position = float3(0, 0.5f, 1.7f);
+	scene.Camera.Target = float3(0, 0.4f, 0);
+	scene.Light.Direction = normalize(float3(1, 1, -1));
+	scene.Light.Intensity = float3(10, 10, 10);
+
+	const float offsets[2] = { 0.4f, -0.3f };
+	for (int m = 0; m < 2; m++) {
+		std::vector<RenderVertex> vertices;
+		std::vector<int> indices;
+		if (m < (int)models.size()) {
+			if (!LoadOBJMesh(models[m].c_str(), vertices, indices)) {
+				error = "can not read the mesh of " + models[m];
+				return false;
+			}
+			NormalizeMesh(vertices);
+		}
+		else
+			CreateSphereMesh(slices, slices / 2, vertices, indices);
+		int geometry = scene.AppendGeometry(vertices, indices, scene.AppendMaterial(RenderMaterial()));
+		scene.AppendInstance({ geometry }, Transforms::Translate(offsets[m], 0, 0));
+	}
+	std::vector<RenderVertex> plate;
+	std::vector<int> plateIndices;
+	CreatePlateMesh(4, plate, plateIndices);
+	scene.AppendInstance({ scene.AppendGeometry(plate, plateIndices, scene.AppendMaterial(RenderMaterial())) });
+
+	scene.SetGlassMaterial(0, 1, 1 / 1.5f); // glass lucy
+	scene.SetGlassMaterial(1, 1, 1 / 1.5f); // glass drago
+	scene.SetMirrorMaterial(2, 0.3f); // reflective plate
+
+	scene.VolumeMaterials[0] = { float3(400, 600, 800), float3(0.999f, 0.999f, 0.995f), float3(0.6f, 0.6f, 0.6f) };
+	scene.VolumeMaterials[1] = { float3(500, 500, 500), float3(0.995f, 1, 0.999f), float3(0.9f, 0.9f, 0.9f) };
+	return true;
+}
+
+#endif
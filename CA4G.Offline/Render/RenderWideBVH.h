@@ -0,0 +1,513 @@
+#ifndef OFFLINE_RENDERWIDEBVH_H
+#define OFFLINE_RENDERWIDEBVH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "RenderBVH.h"
+
+// Form of the binary hierarchies the ray queries traverse. The binary tree is collapsed into
+// nodes of WIDTH children (8 with AVX2, the Release configuration, 4 with SSE otherwise) whose
+// boxes are quantized to bytes relative to the node box, and the triangles of the leaves are
+// copied into packs of four tested at once with the watertight intersection of Woop, Benthin and
+// Wald (2013). A single ray tests all the children of a node in one slab test, a packet of 8 rays
+// tests every child against all of its rays.
+
+// SIMD lanes of the slab tests.
+struct RenderLanes4 {
+	typedef __m128 Float;
+	static const int WIDTH = 4;
+
+	static Float Set(float v) { return _mm_set1_ps(v); }
+	static Float Load(const float* p) { return _mm_loadu_ps(p); }
+	static void Store(float* p, Float v) { _mm_storeu_ps(p, v); }
+	// 4 bytes converted to floats (SSE2)
+	static Float LoadBytes(const uint8_t* p) {
+		int bytes;
+		memcpy(&bytes, p, 4);
+		__m128i zero = _mm_setzero_si128();
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+	}
+	static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	static Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+	static int LessEqual(Float a, Float b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+};
+
+#ifdef __AVX2__
+struct RenderLanes8 {
+	typedef __m256 Float;
+	static const int WIDTH = 8;
+
+	static Float Set(float v) { return _mm256_set1_ps(v); }
+	static Float Load(const float* p) { return _mm256_loadu_ps(p); }
+	static void Store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+	static Float LoadBytes(const uint8_t* p) {
+		return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+	}
+	static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float MulAdd(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+	static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+	static int LessEqual(Float a, Float b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+};
+typedef RenderLanes8 RenderNodeLanes;
+#else
+typedef RenderLanes4 RenderNodeLanes;
+#endif
+
+struct RenderWideNode {
+	static const int WIDTH = RenderNodeLanes::WIDTH;
+	float Origin[3];
+	float Scale[3]; // a child box is Origin + Bounds * Scale
+	uint8_t Bounds[6][WIDTH]; // minimum x, y, z and maximum x, y, z of every child
+	int Child[WIDTH]; // inner node, ~first pack of a leaf or EMPTY
+};
+
+// Four triangles of a leaf, empty lanes have Primitive -1.
+struct RenderTrianglePack {
+	float V0[3][4], V1[3][4], V2[3][4];
+	int Primitive[4]; // reference of the binary leaves
+	int Last; // the leaf ends with this pack
+};
+
+// A ray prepared for the traversal: inverse direction (finite for axis parallel rays), byte rows
+// of the near and far planes of every axis and the shear to ray space of the watertight test.
+struct RenderWideRay {
+	float Origin[3];
+	float Inverse[3];
+	int Near[3], Far[3];
+	int K[3]; // kx, ky, kz: kz is the major axis of the direction
+	float S[3]; // Sx, Sy, Sz
+
+	RenderWideRay() {}
+
+	RenderWideRay(const float3 &O, const float3 &D) {
+		float d[3] = { D.x, D.y, D.z };
+		Origin[0] = O.x;
+		Origin[1] = O.y;
+		Origin[2] = O.z;
+		for (int a = 0; a < 3; a++) {
+			Inverse[a] = 1 / (fabsf(d[a]) > 1e-20f ? d[a] : copysignf(1e-20f, d[a]));
+			Near[a] = Inverse[a] >= 0 ? a : a + 3;
+			Far[a] = Inverse[a] >= 0 ? a + 3 : a;
+		}
+		int kz = fabsf(d[0]) > fabsf(d[1]) ? (fabsf(d[0]) > fabsf(d[2]) ? 0 : 2) : (fabsf(d[1]) > fabsf(d[2]) ? 1 : 2);
+		int kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+		if (d[kz] < 0) // keeps the winding
+			std::swap(kx, ky);
+		K[0] = kx;
+		K[1] = ky;
+		K[2] = kz;
+		S[0] = d[kx] / d[kz];
+		S[1] = d[ky] / d[kz];
+		S[2] = 1 / d[kz];
+	}
+};
+
+// Closest hit of a primitive (a reference of the binary leaves), U and V weight the second and
+// third vertices.
+struct RenderPrimitiveHit {
+	float T;
+	float U = 0, V = 0;
+	int Primitive = -1;
+};
+
+static inline int LowestBit(int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, (unsigned long)mask);
+	return (int)index;
+#else
+	return __builtin_ctz((unsigned)mask);
+#endif
+}
+
+class RenderWideBVH {
+public:
+	static const int WIDTH = RenderWideNode::WIDTH;
+	static const int PACKET = 8;
+	static const int EMPTY = INT_MIN;
+
+private:
+	static const int STACK_SIZE = 64 * WIDTH;
+	static const int PACK_SIZE = 4;
+	static constexpr float ROUNDING = 1.0000004f; // widens the far distances of the slab tests
+
+	std::vector<RenderWideNode> nodes;
+	std::vector<RenderTrianglePack> packs;
+	std::vector<int> sources; // binary node of every child, WIDTH per node, for the refits
+
+	static int CountReferences(const std::vector<RenderBVHNode> &binary, int index, std::vector<int> &counts) {
+		const RenderBVHNode &node = binary[index];
+		counts[index] = node.Count > 0 ? node.Count :
+			CountReferences(binary, node.Start, counts) + CountReferences(binary, node.Start + 1, counts);
+		return counts[index];
+	}
+
+	static void GatherReferences(const std::vector<RenderBVHNode> &binary, int index, std::vector<int> &references) {
+		const RenderBVHNode &node = binary[index];
+		if (node.Count == 0) {
+			GatherReferences(binary, node.Start, references);
+			GatherReferences(binary, node.Start + 1, references);
+			return;
+		}
+		for (int i = node.Start; i < node.Start + node.Count; i++)
+			references.push_back(i);
+	}
+
+	// Packs the references under a binary node, returns the first pack.
+	template<class TriangleOf>
+	int Leaf(const std::vector<RenderBVHNode> &binary, int index, TriangleOf &triangle) {
+		std::vector<int> references;
+		GatherReferences(binary, index, references);
+		int first = (int)packs.size();
+		for (int i = 0; i < (int)references.size(); i += PACK_SIZE) {
+			RenderTrianglePack pack = {};
+			for (int lane = 0; lane < PACK_SIZE; lane++) {
+				pack.Primitive[lane] = -1;
+				if (i + lane >= (int)references.size())
+					continue;
+				pack.Primitive[lane] = references[i + lane];
+				LoadLane(pack, lane, triangle);
+			}
+			pack.Last = i + PACK_SIZE >= (int)references.size();
+			packs.push_back(pack);
+		}
+		return first;
+	}
+
+	template<class TriangleOf>
+	static void LoadLane(RenderTrianglePack &pack, int lane, TriangleOf &triangle) {
+		float3 v[3];
+		triangle(pack.Primitive[lane], v[0], v[1], v[2]);
+		float(*target[3])[4] = { pack.V0, pack.V1, pack.V2 };
+		for (int k = 0; k < 3; k++) {
+			target[k][0][lane] = v[k].x;
+			target[k][1][lane] = v[k].y;
+			target[k][2][lane] = v[k].z;
+		}
+	}
+
+	// Conservative byte bounds of the children relative to the box of all of them.
+	static void Quantize(RenderWideNode &node, const float3* minimum, const float3* maximum, int count) {
+		float3 lo = float3(1e30f, 1e30f, 1e30f), hi = float3(-1e30f, -1e30f, -1e30f);
+		for (int c = 0; c < count; c++) {
+			lo = minf(lo, minimum[c]);
+			hi = maxf(hi, maximum[c]);
+		}
+		float nodeMin[3] = { lo.x, lo.y, lo.z }, nodeMax[3] = { hi.x, hi.y, hi.z };
+		for (int a = 0; a < 3; a++) {
+			float origin = nodeMin[a], scale = (nodeMax[a] - nodeMin[a]) / 255;
+			while (origin + 255 * scale < nodeMax[a])
+				scale = nextafterf(scale, INFINITY);
+			node.Origin[a] = origin;
+			node.Scale[a] = scale;
+			for (int c = 0; c < WIDTH; c++) {
+				if (c >= count) { // never hit, the traversal skips them too
+					node.Bounds[a][c] = 255;
+					node.Bounds[a + 3][c] = 0;
+					continue;
+				}
+				float childMin[3] = { minimum[c].x, minimum[c].y, minimum[c].z }, childMax[3] = { maximum[c].x, maximum[c].y, maximum[c].z };
+				int qMin = scale > 0 ? std::max(0, std::min(255, (int)floorf((childMin[a] - origin) / scale))) : 0;
+				while (qMin > 0 && origin + qMin * scale > childMin[a])
+					qMin--;
+				int qMax = scale > 0 ? std::max(0, std::min(255, (int)ceilf((childMax[a] - origin) / scale))) : 0;
+				while (qMax < 255 && origin + qMax * scale < childMax[a])
+					qMax++;
+				node.Bounds[a][c] = (uint8_t)qMin;
+				node.Bounds[a + 3][c] = (uint8_t)qMax;
+			}
+		}
+	}
+
+	// Opens the child of largest area until the node has WIDTH children. Subtrees of a pack or less
+	// become a single leaf.
+	template<class TriangleOf>
+	int CollapseNode(const std::vector<RenderBVHNode> &binary, const std::vector<int> &counts, int index, TriangleOf &triangle) {
+		auto isInner = [&](int n) { return binary[n].Count == 0 && counts[n] > PACK_SIZE; };
+		int children[WIDTH];
+		int count = 1;
+		children[0] = index;
+		while (count < WIDTH) {
+			int best = -1;
+			float bestArea = -1;
+			for (int c = 0; c < count; c++)
+				if (isInner(children[c])) {
+					float area = HalfArea(binary[children[c]].Min, binary[children[c]].Max);
+					if (area > bestArea) {
+						bestArea = area;
+						best = c;
+					}
+				}
+			if (best < 0)
+				break;
+			int opened = children[best];
+			children[best] = binary[opened].Start;
+			children[count++] = binary[opened].Start + 1;
+		}
+
+		int wide = (int)nodes.size();
+		nodes.push_back(RenderWideNode());
+		sources.resize(nodes.size() * WIDTH, -1);
+		for (int c = 0; c < count; c++)
+			sources[wide * WIDTH + c] = children[c];
+		RenderWideNode node;
+		float3 minimum[WIDTH], maximum[WIDTH];
+		for (int c = 0; c < count; c++) {
+			minimum[c] = binary[children[c]].Min;
+			maximum[c] = binary[children[c]].Max;
+		}
+		Quantize(node, minimum, maximum, count);
+		for (int c = 0; c < WIDTH; c++)
+			node.Child[c] = c >= count ? EMPTY :
+				isInner(children[c]) ? CollapseNode(binary, counts, children[c], triangle) : ~Leaf(binary, children[c], triangle);
+		nodes[wide] = node;
+		return wide;
+	}
+
+	// Watertight test of the triangles of a leaf, in ray space sheared along the major axis.
+	bool IntersectLeaf(const RenderWideRay &ray, int pack, RenderPrimitiveHit &hit) const {
+		const int kx = ray.K[0], ky = ray.K[1], kz = ray.K[2];
+		const __m128 ox = _mm_set1_ps(ray.Origin[kx]), oy = _mm_set1_ps(ray.Origin[ky]), oz = _mm_set1_ps(ray.Origin[kz]);
+		const __m128 sx = _mm_set1_ps(ray.S[0]), sy = _mm_set1_ps(ray.S[1]), sz = _mm_set1_ps(ray.S[2]);
+		const __m128 zero = _mm_setzero_ps(), signBit = _mm_set1_ps(-0.0f);
+		bool found = false;
+		while (true) {
+			const RenderTrianglePack &p = packs[pack];
+			__m128 az = _mm_sub_ps(_mm_loadu_ps(p.V0[kz]), oz);
+			__m128 bz = _mm_sub_ps(_mm_loadu_ps(p.V1[kz]), oz);
+			__m128 cz = _mm_sub_ps(_mm_loadu_ps(p.V2[kz]), oz);
+			__m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V0[kx]), ox), _mm_mul_ps(sx, az));
+			__m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V0[ky]), oy), _mm_mul_ps(sy, az));
+			__m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V1[kx]), ox), _mm_mul_ps(sx, bz));
+			__m128 by = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V1[ky]), oy), _mm_mul_ps(sy, bz));
+			__m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V2[kx]), ox), _mm_mul_ps(sx, cz));
+			__m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(p.V2[ky]), oy), _mm_mul_ps(sy, cz));
+			// scaled barycentrics, the edge functions of the 2D triangle
+			__m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			__m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			__m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+			__m128 negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+			__m128 positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+			__m128 det = _mm_add_ps(_mm_add_ps(u, v), w);
+			__m128 t = _mm_mul_ps(sz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, az), _mm_mul_ps(v, bz)), _mm_mul_ps(w, cz)));
+			// 0 < t / det < hit.T without the division
+			__m128 sign = _mm_and_ps(det, signBit);
+			__m128 signedT = _mm_xor_ps(t, sign), absDet = _mm_xor_ps(det, sign);
+			__m128 inRange = _mm_and_ps(_mm_cmpgt_ps(signedT, zero), _mm_cmplt_ps(signedT, _mm_mul_ps(_mm_set1_ps(hit.T), absDet)));
+			int mask = _mm_movemask_ps(_mm_andnot_ps(_mm_and_ps(negative, positive), inRange));
+			if (mask != 0) {
+				alignas(16) float T[4], D[4], V[4], W[4];
+				_mm_store_ps(T, t);
+				_mm_store_ps(D, det);
+				_mm_store_ps(V, v);
+				_mm_store_ps(W, w);
+				for (int lane = 0; lane < PACK_SIZE; lane++)
+					if ((mask & (1 << lane)) && p.Primitive[lane] >= 0) {
+						float inverseDet = 1 / D[lane];
+						float distance = T[lane] * inverseDet;
+						if (distance < hit.T) {
+							hit.T = distance;
+							hit.U = V[lane] * inverseDet;
+							hit.V = W[lane] * inverseDet;
+							hit.Primitive = p.Primitive[lane];
+							found = true;
+						}
+					}
+			}
+			if (p.Last)
+				break;
+			pack++;
+		}
+		return found;
+	}
+
+public:
+	void Clear() {
+		nodes.clear();
+		packs.clear();
+		sources.clear();
+	}
+
+	// Collapses the binary tree under root (RenderBVHBuilder::Build) and returns the wide root.
+	// triangle(reference, a, b, c) gives the vertices of a reference of the binary leaves.
+	template<class TriangleOf>
+	int Collapse(const std::vector<RenderBVHNode> &binary, int root, TriangleOf triangle) {
+		std::vector<int> counts(binary.size());
+		CountReferences(binary, root, counts);
+		return CollapseNode(binary, counts, root, triangle);
+	}
+
+	// Requantizes the nodes [nodeBegin, nodeEnd) against the boxes of the binary tree they were
+	// collapsed from, refitted before, and reloads the triangles of the packs [packBegin, packEnd).
+	// pool can be null.
+	template<class TriangleOf>
+	void Refit(const std::vector<RenderBVHNode> &binary, int nodeBegin, int nodeEnd, int packBegin, int packEnd,
+		TriangleOf triangle, ThreadPool* pool) {
+		auto refitNodes = [&](int b, int e, int) {
+			for (int n = nodeBegin + b; n < nodeBegin + e; n++) {
+				float3 minimum[WIDTH], maximum[WIDTH];
+				int count = 0;
+				for (; count < WIDTH && nodes[n].Child[count] != EMPTY; count++) {
+					minimum[count] = binary[sources[n * WIDTH + count]].Min;
+					maximum[count] = binary[sources[n * WIDTH + count]].Max;
+				}
+				Quantize(nodes[n], minimum, maximum, count);
+			}
+		};
+		auto refitPacks = [&](int b, int e, int) {
+			for (int p = packBegin + b; p < packBegin + e; p++)
+				for (int lane = 0; lane < PACK_SIZE; lane++)
+					if (packs[p].Primitive[lane] >= 0)
+						LoadLane(packs[p], lane, triangle);
+		};
+		if (pool != nullptr) {
+			pool->ParallelFor(nodeEnd - nodeBegin, 1024, refitNodes);
+			pool->ParallelFor(packEnd - packBegin, 4096, refitPacks);
+		}
+		else {
+			refitNodes(0, nodeEnd - nodeBegin, 0);
+			refitPacks(0, packEnd - packBegin, 0);
+		}
+	}
+
+	int NodeCount() const { return (int)nodes.size(); }
+	int PackCount() const { return (int)packs.size(); }
+
+	// Closest hit in (0, hit.T) of a ray under root, hit keeps the previous closest hit otherwise.
+	bool Intersect(const RenderWideRay &ray, int root, RenderPrimitiveHit &hit) const {
+		typedef RenderNodeLanes L;
+		struct Entry {
+			int Node;
+			float T;
+		};
+		Entry stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { root, 0 };
+		bool found = false;
+		while (top > 0) {
+			Entry entry = stack[--top];
+			if (entry.T > hit.T)
+				continue;
+			if (entry.Node < 0) {
+				found |= IntersectLeaf(ray, ~entry.Node, hit);
+				continue;
+			}
+			const RenderWideNode &node = nodes[entry.Node];
+			L::Float tNear = L::Set(0), tFar = L::Set(hit.T);
+			for (int a = 0; a < 3; a++) {
+				L::Float scale = L::Set(node.Scale[a] * ray.Inverse[a]);
+				L::Float offset = L::Set((node.Origin[a] - ray.Origin[a]) * ray.Inverse[a]);
+				tNear = L::Max(tNear, L::MulAdd(L::LoadBytes(node.Bounds[ray.Near[a]]), scale, offset));
+				tFar = L::Min(tFar, L::MulAdd(L::LoadBytes(node.Bounds[ray.Far[a]]), scale, offset));
+			}
+			int mask = L::LessEqual(tNear, L::Mul(tFar, L::Set(ROUNDING)));
+			if (mask == 0)
+				continue;
+			alignas(32) float distances[WIDTH];
+			L::Store(distances, tNear);
+			// sorted on the stack, the closest child ends on top
+			int first = top;
+			for (; mask != 0; mask &= mask - 1) {
+				int c = LowestBit(mask);
+				if (node.Child[c] == EMPTY)
+					continue;
+				Entry child = { node.Child[c], distances[c] };
+				int j = top++;
+				for (; j > first && stack[j - 1].T < child.T; j--)
+					stack[j] = stack[j - 1];
+				stack[j] = child;
+			}
+		}
+		return found;
+	}
+
+	// Closest hits of the active rays of a packet under root, the slab tests of a child run over all
+	// the rays at once. Returns the rays with a new closest hit.
+	int Intersect(const RenderWideRay* rays, int active, int root, RenderPrimitiveHit* hits) const {
+		typedef RenderNodeLanes L;
+		const int CHUNKS = PACKET / L::WIDTH;
+		struct Entry {
+			int Node;
+			int Mask;
+		};
+		alignas(32) float origin[3][PACKET], inverse[3][PACKET], tMax[PACKET], tNearest[PACKET];
+		for (int r = 0; r < PACKET; r++)
+			for (int a = 0; a < 3; a++) {
+				origin[a][r] = rays[r].Origin[a];
+				inverse[a][r] = rays[r].Inverse[a];
+			}
+		Entry stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { root, active };
+		int found = 0;
+		while (top > 0) {
+			Entry entry = stack[--top];
+			if (entry.Node < 0) {
+				for (int r = 0; r < PACKET; r++)
+					if ((entry.Mask & (1 << r)) && IntersectLeaf(rays[r], ~entry.Node, hits[r]))
+						found |= 1 << r;
+				continue;
+			}
+			const RenderWideNode &node = nodes[entry.Node];
+			for (int r = 0; r < PACKET; r++)
+				tMax[r] = hits[r].T;
+			Entry children[WIDTH];
+			float order[WIDTH];
+			int count = 0;
+			for (int c = 0; c < WIDTH && node.Child[c] != EMPTY; c++) {
+				float lo[3], hi[3];
+				for (int a = 0; a < 3; a++) {
+					lo[a] = node.Origin[a] + node.Bounds[a][c] * node.Scale[a];
+					hi[a] = node.Origin[a] + node.Bounds[a + 3][c] * node.Scale[a];
+				}
+				int mask = 0;
+				for (int k = 0; k < CHUNKS; k++) {
+					L::Float tNear = L::Set(0), tFar = L::Load(tMax + k * L::WIDTH);
+					for (int a = 0; a < 3; a++) {
+						L::Float o = L::Load(origin[a] + k * L::WIDTH), inv = L::Load(inverse[a] + k * L::WIDTH);
+						L::Float t0 = L::Mul(L::Sub(L::Set(lo[a]), o), inv), t1 = L::Mul(L::Sub(L::Set(hi[a]), o), inv);
+						tNear = L::Max(tNear, L::Min(t0, t1));
+						tFar = L::Min(tFar, L::Max(t0, t1));
+					}
+					mask |= L::LessEqual(tNear, L::Mul(tFar, L::Set(ROUNDING))) << (k * L::WIDTH);
+					L::Store(tNearest + k * L::WIDTH, tNear);
+				}
+				mask &= entry.Mask;
+				if (mask == 0)
+					continue;
+				// the entry of the closest ray orders the children
+				float nearest = 1e30f;
+				for (int r = 0; r < PACKET; r++)
+					if (mask & (1 << r))
+						nearest = minf(nearest, tNearest[r]);
+				int j = count++;
+				for (; j > 0 && order[j - 1] < nearest; j--) {
+					children[j] = children[j - 1];
+					order[j] = order[j - 1];
+				}
+				children[j] = { node.Child[c], mask };
+				order[j] = nearest;
+			}
+			for (int c = 0; c < count; c++)
+				stack[top++] = children[c];
+		}
+		return found;
+	}
+};
+
+#endif
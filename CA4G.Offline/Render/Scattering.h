@@ -0,0 +1,154 @@
+#ifndef OFFLINE_RENDER_SCATTERING_H
+#define OFFLINE_RENDER_SCATTERING_H
+
+#include "../Common/Randoms.h"
+#include "../../CA4G.DemoApp/Shaders/Tools/Parameters.h"
+#include "RenderScene.h"
+
+// CPU counterparts of Shaders/Tools/Scattering.h (surfaces), CommonEnvironment.h (skybox and
+// main light) and CommonComplexity.h, same formulas and random numbers as the shaders.
+
+// float3::operator[] is avoided, its out of range fallback is not defined in the library
+static float Channel(const float3 &v, int c) {
+	return c == 0 ? v.x : c == 1 ? v.y : v.z;
+}
+
+static float3 randomHSDirection(RandomGenerator &rng, const float3 &N, float &NdotD) {
+	float r1 = rng.random();
+	float r2 = rng.random() * 2 - 1;
+	float sqrt_of_one_minus_sqrR2 = sqrtf(maxf(0.0f, 1.0f - r2 * r2));
+	float3 d = float3(cosf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, sinf(2 * PI * r1) * sqrt_of_one_minus_sqrR2, r2);
+	NdotD = dot(N, d);
+	d = d * (NdotD < 0 ? -1.0f : 1.0f);
+	NdotD = fabsf(NdotD);
+	return d;
+}
+
+static float ComputeFresnel(float NdotL, float ratio) {
+	float divOneMinusByOnePlus = (1 - ratio) / (1 + ratio);
+	float f = divOneMinusByOnePlus * divOneMinusByOnePlus;
+	return f + (1.0f - f) * powf(1.0f - NdotL, 5);
+}
+
+// Faced normal and the fresnel impulses (xyz direction, w probability) of a surfel.
+static void ComputeImpulses(const float3 &V, const float3 &N, const RenderMaterial &material, float3 &fN, float4 &R, float4 &T) {
+	float NdotV = dot(V, N);
+	bool invertNormal = NdotV < 0;
+	NdotV = fabsf(NdotV);
+	// Ratio between refraction indices depending of exiting or entering to the medium (assuming vaccum medium 1)
+	float eta = !invertNormal ? material.RefractionIndex : 1 / material.RefractionIndex;
+	fN = invertNormal ? -1 * N : N;
+	float3 reflected = reflect(V, fN);
+	float fresnel = ComputeFresnel(NdotV, eta);
+	float3 refracted = refract(V, fN, eta);
+	R = float4(reflected.x, reflected.y, reflected.z, fresnel);
+	T = float4(refracted.x, refracted.y, refracted.z, 1 - fresnel);
+	if (refracted.x == 0 && refracted.y == 0 && refracted.z == 0) {
+		R.w = 1;
+		T.w = 0; // total internal reflection
+	}
+	// Mix reflection impulse with mirror materials
+	R.w = material.Roulette.z + R.w * material.Roulette.w;
+	T.w *= material.Roulette.w;
+}
+
+// Picks lambert, blinn, mirror or fresnel with the roulette of the material, ratio already
+// carries the inverse of the pdf. A roulette adding up less than one can select nothing (ratio 0).
+static void RandomScatterRay(RandomGenerator &rng, const float3 &V, const float3 &fN, const float4 &R, const float4 &T,
+	const RenderMaterial &material, float3 &ratio, float3 &direction) {
+	float NdotD;
+	float3 D = randomHSDirection(rng, fN, NdotD);
+
+	const float roulette[4] = { material.Roulette.x, material.Roulette.y, R.w, T.w };
+	float selection = rng.random();
+	float lower = 0;
+	int selected = -1;
+	for (int i = 0; i < 4 && selected < 0; i++) {
+		if (lower <= selection && selection < lower + roulette[i])
+			selected = i;
+		lower += roulette[i];
+	}
+	ratio = float3(0, 0, 0);
+	direction = float3(0, 0, 0);
+	switch (selected) {
+	case 0: // Diffuse
+		ratio = material.Diffuse * 2 * NdotD;
+		direction = D;
+		break;
+	case 1: { // Specular (Glossy)
+		float3 H = normalize(V + D);
+		float HdotN = maxf(0.0001f, dot(H, fN));
+		ratio = material.Specular * (powf(HdotN, material.SpecularSharpness) * (2 + material.SpecularSharpness) * NdotD);
+		direction = D;
+		break;
+	}
+	case 2: // Mirror
+		ratio = material.Specular;
+		direction = float3(R.x, R.y, R.z);
+		break;
+	case 3: // Fresnel
+		ratio = material.Specular;
+		direction = float3(T.x, T.y, T.z);
+		break;
+	}
+}
+
+// RussianRoulette of Scattering.h, games counts the paths that played it (below threshold).
+static bool RussianRoulette(RandomGenerator &rng, float3 &importance, float threshold, long long &games) {
+	float throughput = (importance.x + importance.y + importance.z) / 3;
+	if (throughput >= threshold)
+		return true;
+	games++;
+	float survival = throughput / threshold;
+	if (rng.random() >= survival)
+		return false;
+	importance = importance * (1 / survival);
+	return true;
+}
+
+static float3 SampleSkybox(const float3 &L) {
+#ifdef USE_SKYBOX
+	static const float3 BG_COLORS[5] = {
+		float3(0.1f, 0.05f, 0.01f), // GROUND DARKER BLUE
+		float3(0.01f, 0.05f, 0.2f), // HORIZON GROUND DARK BLUE
+		float3(0.8f, 0.9f, 1.0f), // HORIZON SKY WHITE
+		float3(0.1f, 0.3f, 1.0f),  // SKY LIGHT BLUE
+		float3(0.01f, 0.1f, 0.7f)  // SKY BLUE
+	};
+	static const float BG_DISTS[5] = { -1.0f, -0.1f, 0.0f, 0.4f, 1.0f };
+	float3 col = BG_COLORS[0];
+	for (int i = 1; i < 5; i++)
+		col = lerp(col, BG_COLORS[i], float3(smoothstep(BG_DISTS[i - 1], BG_DISTS[i], L.y)));
+	return col;
+#else
+	return float3(0, 0, 0);
+#endif
+}
+
+static float3 SampleLight(const RenderLight &light, const float3 &L) {
+#ifdef USE_NARROW_LIGHTSOURCE
+	int N = 80;
+#else
+	int N = 10;
+#endif
+	float phongNorm = (N + 2) / (4 * 3.14159f);
+	return light.Intensity * (powf(maxf(0.0f, dot(L, light.Direction)), (float)N) * phongNorm);
+}
+
+// Color of the complexity images (ShowComplexity).
+static float3 GetColor(int complexity) {
+	if (complexity == 0)
+		return float3(0, 0, 0);
+	static const float3 stopPoints[13] = {
+		float3(0, 0, 128), float3(49, 54, 149), float3(69, 117, 180), float3(116, 173, 209),
+		float3(171, 217, 233), float3(224, 243, 248), float3(255, 255, 191), float3(254, 224, 144),
+		float3(253, 174, 97), float3(244, 109, 67), float3(215, 48, 39), float3(165, 0, 38),
+		float3(200, 0, 175)
+	};
+	float level = log2f((float)complexity);
+	if (level >= 12)
+		return stopPoints[12] * (1 / 255.0f);
+	return lerp(stopPoints[(int)level], stopPoints[(int)level + 1], float3(fmodf(level, 1.0f))) * (1 / 255.0f);
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef OFFLINE_SCENEIMPORT_H
+#define OFFLINE_SCENEIMPORT_H
+
+#include "ca4g_scene.h"
+#include "RenderScene.h"
+
+// Copies the scene of a SceneManager (after SetupScene) into a RenderScene, the geometries with
+// their transforms applied and the instances as CreateRTXScene loads them. Needs the CA4G library
+// (DirectX) and main_scene.h (Windows shell folders), the render commands only include it on
+// Windows, elsewhere only the built-in scenes render. The CPU path tracer has no textures, so
+// the import keeps positions, normals, the constant material values and the main light (the only
+// one the techniques use), and drops:
+//	- the diffuse, specular, bump and mask maps of the materials (CommonRT.h samples them)
+//	- texture coordinates, tangents and binormals of the vertices
+// ImportScene returns how many materials referenced a map.
+
+static float4x4 ImportedGeometryTransform(gObj<IScene> desc, const GeometryDescription &geometry) {
+	return geometry.TransformIndex == -1 ?
+		float4x4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1) :
+		Transforms::FromAffine(desc->getTransformsBuffer().Data[geometry.TransformIndex]);
+}
+
+static int ImportScene(gObj<SceneManager> manager, RenderScene &scene) {
+	gObj<IScene> desc = manager->getScene();
+	SceneData<SceneVertex> vertices = desc->Vertices();
+	SceneData<int> indices = desc->Indices();
+
+	int texturedMaterials = 0;
+	for (int m = 0; m < desc->Materials().Count; m++) {
+		const SceneMaterial &source = desc->Materials().Data[m];
+		if (source.DiffuseMap >= 0 || source.SpecularMap >= 0 || source.BumpMap >= 0 || source.MaskMap >= 0)
+			texturedMaterials++;
+		RenderMaterial material;
+		material.Diffuse = source.Diffuse;
+		material.RefractionIndex = source.RefractionIndex;
+		material.Specular = source.Specular;
+		material.SpecularSharpness = source.SpecularPower;
+		material.Roulette = source.Roulette;
+		material.Emissive = source.Emissive;
+		const VolumeMaterial &volume = desc->VolumeMaterials().Data[m];
+		scene.AppendMaterial(material, RenderVolumeMaterial{ volume.Extinction, volume.ScatteringAlbedo, volume.G });
+	}
+
+	for (int g = 0; g < desc->Geometries().Count; g++) {
+		const GeometryDescription &geometry = desc->Geometries().Data[g];
+		float4x4 geometryTransform = ImportedGeometryTransform(desc, geometry);
+		std::vector<RenderVertex> meshVertices(geometry.VertexCount);
+		for (int v = 0; v < geometry.VertexCount; v++) {
+			const SceneVertex &source = vertices.Data[geometry.StartVertex + v];
+			meshVertices[v] = { source.Position, source.Normal };
+		}
+		// a geometry without indices is a triangle list
+		std::vector<int> meshIndices;
+		if (geometry.IndexCount > 0)
+			meshIndices.assign(indices.Data + geometry.StartIndex, indices.Data + geometry.StartIndex + geometry.IndexCount);
+		else
+			for (int v = 0; v < geometry.VertexCount; v++)
+				meshIndices.push_back(v);
+		scene.AppendGeometry(meshVertices, meshIndices, geometry.MaterialIndex, geometryTransform);
+	}
+
+	for (int i = 0; i < desc->Instances().Count; i++) {
+		const InstanceDescription &instance = desc->Instances().Data[i];
+		scene.AppendInstance(std::vector<int>(instance.GeometryIndices, instance.GeometryIndices + instance.Count), instance.Transform);
+	}
+
+	const Camera &camera = manager->getCamera();
+	scene.Camera.Position = camera.Position;
+	scene.Camera.Target = camera.Target;
+	scene.Camera.Up = camera.Up;
+	scene.Camera.FoV = camera.FoV;
+	scene.Camera.NearPlane = camera.NearPlane;
+	scene.Camera.FarPlane = camera.FarPlane;
+
+	const LightSource &light = manager->getMainLight();
+	scene.Light.Position = light.Position;
+	scene.Light.Direction = light.Direction;
+	scene.Light.Intensity = light.Intensity;
+	return texturedMaterials;
+}
+
+// Brings a RenderScene imported from manager up to the elements updated since version (after
+// Animate), as UpdateRTXScene does, marking the same elements so RenderAccelerator::Update follows
+// them. New geometries, indices or instances import the scene again.
+static void UpdateImportedScene(gObj<SceneManager> manager, SceneVersion &version, RenderScene &scene) {
+	SceneElement updated = manager->Updated(version, SceneElement::Vertices | SceneElement::Indices | SceneElement::Geometries |
+		SceneElement::Instances | SceneElement::GeometryTransforms | SceneElement::InstanceTransforms);
+	gObj<IScene> desc = manager->getScene();
+	if (+(updated & (SceneElement::Indices | SceneElement::Geometries | SceneElement::Instances))) {
+		scene.Clear();
+		ImportScene(manager, scene);
+		return;
+	}
+	if (+(updated & (SceneElement::Vertices | SceneElement::GeometryTransforms))) {
+		SceneData<SceneVertex> vertices = desc->Vertices();
+		for (int g = 0; g < desc->Geometries().Count; g++) {
+			const GeometryDescription &geometry = desc->Geometries().Data[g];
+			float4x4 geometryTransform = ImportedGeometryTransform(desc, geometry);
+			for (int v = 0; v < geometry.VertexCount; v++) {
+				const SceneVertex &source = vertices.Data[geometry.StartVertex + v];
+				scene.Vertices[scene.Geometries[g].StartVertex + v] = RenderVertex{ source.Position, source.Normal }.Transformed(geometryTransform);
+			}
+		}
+		scene.OnUpdated(RenderSceneElement::Vertices);
+	}
+	if (+(updated & SceneElement::InstanceTransforms)) {
+		for (int i = 0; i < desc->Instances().Count; i++)
+			scene.Instances[i].Transform = desc->Instances().Data[i].Transform;
+		scene.OnUpdated(RenderSceneElement::InstanceTransforms);
+	}
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef OFFLINE_RENDER_SPECTRALPATH_H
+#define OFFLINE_RENDER_SPECTRALPATH_H
+
+#include "../Common/HGPhaseFunction.h"
+#include "Scattering.h"
+
+// CPU counterpart of Shaders/Tools/SpectralPath.h, spectral is SPECTRAL_PATHTRACING.
+// importance carries f_c / p_hero and pdfs p_k / p_hero, both divided by the mean of pdfs, so
+// importance is the balance heuristic estimate over the three hero channels.
+// shared applies the hero ratios of SharedPath.h (SHARED_PATH_MEDIA) instead: importance carries
+// f_c / p_hero alone and the path collapses to the hero where a medium is not gray enough.
+
+static float3 StartSpectralImportance(int hero, bool spectral, float3 &pdfs) {
+	pdfs = float3(1, 1, 1);
+	if (spectral)
+		return float3(1, 1, 1);
+	return float3(hero == 0 ? 3.0f : 0.0f, hero == 1 ? 3.0f : 0.0f, hero == 2 ? 3.0f : 0.0f);
+}
+
+static void SpectralEvent(float3 &importance, float3 &pdfs, const float3 &ratio, bool shared = false) {
+	if (shared) {
+		importance = importance * ratio;
+		return;
+	}
+	float3 next = pdfs * ratio;
+	float mean = (next.x + next.y + next.z) / 3;
+	importance = importance * ratio * (1 / mean);
+	pdfs = next * (1 / mean);
+}
+
+static void SpectralTransmittance(float3 &importance, float3 &pdfs, const float3 &sigma, int hero, float d, bool shared = false) {
+	float h = Channel(sigma, hero);
+	SpectralEvent(importance, pdfs, float3(expf(-(sigma.x - h) * d), expf(-(sigma.y - h) * d), expf(-(sigma.z - h) * d)), shared);
+}
+
+static void SpectralCollision(float3 &importance, float3 &pdfs, const float3 &sigma, int hero, float t, bool shared = false) {
+	float h = Channel(sigma, hero);
+	SpectralEvent(importance, pdfs, float3(sigma.x / h * expf(-(sigma.x - h) * t), sigma.y / h * expf(-(sigma.y - h) * t),
+		sigma.z / h * expf(-(sigma.z - h) * t)), shared);
+}
+
+static void SpectralSurvival(float3 &importance, float3 &pdfs, const float3 &albedo, int hero, bool shared = false) {
+	SpectralEvent(importance, pdfs, albedo * (1 / Channel(albedo, hero)), shared);
+}
+
+static void SpectralPhase(float3 &importance, float3 &pdfs, const float3 &G, int hero, const float3 &D, const float3 &L, bool shared = false) {
+	float3 phases = float3(EvalPhase(G.x, D, L), EvalPhase(G.y, D, L), EvalPhase(G.z, D, L));
+	SpectralEvent(importance, pdfs, phases * (1 / Channel(phases, hero)), shared);
+}
+
+// IsGrayMedium of SharedPath.h, the same for every hero.
+static bool IsGrayMedium(const RenderVolumeMaterial &m, float tolerance) {
+	auto highest = [](const float3 &v) { return maxf(v.x, maxf(v.y, v.z)); };
+	auto spread = [&](const float3 &v) { return highest(v) - minf(v.x, minf(v.y, v.z)); };
+	return spread(m.Extinction) <= tolerance * highest(m.Extinction) &&
+		spread(m.ScatteringAlbedo) <= tolerance * highest(m.ScatteringAlbedo) && spread(m.G) <= tolerance;
+}
+
+// CollapseToHero of SharedPath.h, the path goes on as the single channel estimator.
+static void CollapseToHero(float3 &importance, bool &shared, int hero) {
+	if (!shared)
+		return;
+	float h = Channel(importance, hero) * 3;
+	importance = float3(hero == 0 ? h : 0.0f, hero == 1 ? h : 0.0f, hero == 2 ? h : 0.0f);
+	shared = false;
+}
+
+#endif
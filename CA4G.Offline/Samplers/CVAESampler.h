@@ -0,0 +1,41 @@
+#ifndef OFFLINE_CVAESAMPLER_H
+#define OFFLINE_CVAESAMPLER_H
+
+#include "../CVAE/CVAEWavefront.h"
+#include "ExactSampler.h"
+
+// Samples the CVAE model (GenerateVariablesWithModel) for a fixed medium in batches.
+// Events enter at the sphere bottom along +z so results are comparable with the exact walk.
+// All events of a batch share one random stream, evaluation is single threaded.
+class CVAESampler {
+	CVAEMediumQueue queue;
+public:
+	CVAESampler(ActivationTier tier) {
+		queue.Tier = tier;
+	}
+
+	void Sample(RandomGenerator &rng, float g, float phi, float r, ScatteringSample* samples, int count) {
+		queue.Clear();
+		for (int i = 0; i < count; i++) {
+			CVAEMediumEvent e;
+			e.rng = &rng;
+			e.G = g;
+			e.Phi = phi;
+			e.Density = r;
+			e.Win = float3(0, 0, 1);
+			queue.Push(e);
+		}
+		queue.Flush(nullptr);
+		for (int i = 0; i < count; i++) {
+			const CVAEMediumResult &result = queue.Result(i);
+			ScatteringSample &s = samples[i];
+			s.N = (int)result.Scatterings;
+			s.Absorbed = result.Absorbed;
+			s.Theta = s.Beta = s.Alpha = 0;
+			if (!s.Absorbed)
+				CompactExitVariables(result.X, result.W, s);
+		}
+	}
+};
+
+#endif
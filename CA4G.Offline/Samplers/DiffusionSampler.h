@@ -0,0 +1,63 @@
+#ifndef OFFLINE_DIFFUSIONSAMPLER_H
+#define OFFLINE_DIFFUSIONSAMPLER_H
+
+#include "ExactSampler.h"
+
+// CPU counterpart of Shaders/Tools/DiffusionSphere.h
+// Exit of a sphere far larger than the transport mean free path (beyond the STF tables and the
+// range the CVAE model was trained on) in the diffusion limit. Entering at the center along +z the
+// walk forgets its direction after a transport mean free path 1 / (1 - g phi), it is taken as an
+// isotropic source at that depth. Without absorption the exit position follows the harmonic
+// measure of the source (Poisson kernel of the ball), the direction is cosine weighted around the
+// normal as the multiple scattering of the tables. The walk survives with the first passage
+// probability of the diffusion with absorption, (R / a) sinh(ka) / sinh(kR), R the radius
+// extended by the extrapolation distance and k = sqrt(3 (1 - phi)(1 - g phi)).
+// Bounds of its error against the exact walk for spheres of 256 to 1024 mean free paths, g up to
+// 0.875 and albedos from 0.999 to 1 (CA4G.Offline diffusionerror): absorption rate and KS
+// distances of the exit marginals. Measured up to 0.014 and 0.036 (theta), 0.052 (beta, alpha)
+// with 4096 samples, mostly the noise of the samples (KS of 1024 exits is about 0.06).
+static const double DIFFUSION_ABSORPTION_BOUND = 0.025;
+static const double DIFFUSION_KS_THETA_BOUND = 0.06;
+static const double DIFFUSION_KS_DIRECTION_BOUND = 0.075;
+
+// (1 - exp(-x)) / x without the cancellation near 0
+static float DiffusionShrink(float x)
+{
+	return x < 1e-3f ? 1 - 0.5f * x : (1 - expf(-x)) / x;
+}
+
+// Probability of leaving a sphere of r mean free paths entering at its center.
+static float DiffusionSurvival(float g, float phi, float r)
+{
+	float sigmaTr = 1 - g * phi;
+	float a = minf(1 / sigmaTr, 0.5f * r);
+	float R = r + 1.42f / sigmaTr;
+	float k = sqrtf(3 * (1 - phi) * sigmaTr);
+	return expf(k * (a - R)) * DiffusionShrink(2 * k * a) / DiffusionShrink(2 * k * R);
+}
+
+static ScatteringSample DiffusionSampleCosXAndW(RandomGenerator &rng, float g, float phi, float r)
+{
+	ScatteringSample s = { 1, 0, 0, -1, false };
+	if (rng.random() >= DiffusionSurvival(g, phi, r)) {
+		s.Absorbed = true;
+		return s;
+	}
+	// harmonic measure of a source at rho of the radius, inverted in closed form
+	float sigmaTr = 1 - g * phi;
+	float rho = minf(1 / sigmaTr, 0.5f * r) / (r + 1.42f / sigmaTr);
+	float u = rng.random();
+	if (rho < 1e-4f)
+		s.Theta = 2 * u - 1;
+	else {
+		float q = u * (1 / (1 - rho) - 1 / (1 + rho)) + 1 / (1 + rho);
+		s.Theta = clamp((1 + rho * rho - 1 / (q * q)) / (2 * rho), -1.0f, 1.0f);
+	}
+	float angle = rng.random() * 2 * 3.141596f;
+	float rad = sqrtf(rng.random());
+	s.Alpha = rad * sinf(angle);
+	s.Beta = rad * cosf(angle);
+	return s;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef OFFLINE_EXACTSAMPLER_H
+#define OFFLINE_EXACTSAMPLER_H
+
+#include "../Common/Randoms.h"
+#include "../Common/HGPhaseFunction.h"
+
+// Outcome of a walk inside the unit sphere entering at (0,0,0) along +z, in the
+// compact variables the techniques use (see GenerateVariablesWithTable).
+struct ScatteringSample {
+	float Theta; // cosine of the exit position angle to +z
+	float Beta;  // exit direction along the tangent
+	float Alpha; // exit direction along the binormal
+	int N;       // scattering events inside, -1 if the sampler does not know it
+	bool Absorbed;
+};
+
+static float DistanceToSphereBoundary(const float3 &x, const float3 &w)
+{
+	float b = 2 * dot(x, w);
+	float c = dot(x, x) - 1;
+
+	float Disc = b * b - 4 * c;
+
+	if (Disc <= 0)
+		return 0;
+
+	// Assuming x is inside the sphere, only the positive root is needed (intersection forward w).
+	return maxf(0.0f, (-b + sqrtf(Disc)) / 2);
+}
+
+// Exit position x and direction w (entering along +z) in the compact variables theta, beta, alpha.
+// The result does not depend on a rotation of x and w around z.
+static void CompactExitVariables(const float3 &x, const float3 &w, ScatteringSample &s)
+{
+	float3 zAxis = float3(0, 0, 1);
+	float3 xAxis = fabsf(x.z) > 0.999f ? float3(1, 0, 0) : normalize(cross(x, float3(0, 0, 1)));
+	float3 yAxis = cross(zAxis, xAxis);
+
+	float3x3 normR = transpose(float3x3(xAxis, yAxis, zAxis));
+	float3 normx = mul(x, normR);
+	float3 normw = mul(w, normR);
+	float3 B = float3(1, 0, 0);
+	float3 T = cross(normx, B);
+	s.Theta = normx.z;
+	s.Beta = dot(normw, T);
+	s.Alpha = dot(normw, B);
+}
+
+// Inverse of CompactExitVariables for a walk entering along win (GenerateVariablesWithTable),
+// exit position x in radii and direction w around the entry point.
+static void SphereExitToWorld(RandomGenerator &rng, const float3 &win, const ScatteringSample &s, float3 &x, float3 &w)
+{
+	float3 temp = fabsf(win.x) >= 0.9999f ? float3(0, 0, 1) : float3(1, 0, 0);
+	float3 winY = normalize(cross(temp, win));
+	float3 winX = cross(win, winY);
+	float rAlpha = rng.random() * 2 * PI;
+	float3x3 R = mul(float3x3(
+		cosf(rAlpha), -sinf(rAlpha), 0,
+		sinf(rAlpha), cosf(rAlpha), 0,
+		0, 0, 1), float3x3(winX, winY, win));
+	float3 ex = float3(0, sqrtf(maxf(0.0f, 1 - s.Theta * s.Theta)), s.Theta);
+	float3 T = cross(ex, float3(1, 0, 0));
+	float3 ew = normalize(ex * sqrtf(maxf(0.0f, 1 - s.Beta * s.Beta - s.Alpha * s.Alpha)) + T * s.Beta + float3(1, 0, 0) * s.Alpha);
+	x = mul(ex, R);
+	w = mul(ew, R);
+}
+
+// Random walk of ExactSampleCosXAndW (STFPathtracing_RT.hlsl) inside the unit sphere, entering at
+// the center along +z. r is the sphere radius in mean free paths.
+// Returns false if absorbed, otherwise x and w are the exit position and direction.
+// n gets the number of scattering events (including the absorbing one).
+template<typename TRandom>
+static bool ExactRandomWalk(TRandom &rng, float g, float phi, float r, float3 &x, float3 &w, int &n)
+{
+	x = float3(0, 0, 0);
+	w = float3(0, 0, 1);
+	n = 0;
+
+	float t = -logf(1 - rng.random()) / r;
+	if (t >= 1) // leaves without scattering
+	{
+		x = w;
+		return true;
+	}
+
+	x = x + w * t; // first flight
+
+	while (true) {
+		n++;
+		if (rng.random() < 1 - phi) // Absorption
+			return false;
+
+		w = ImportanceSamplePhase(rng, g, w); // scattering event...
+
+		float d = DistanceToSphereBoundary(x, w);
+
+		t = -logf(maxf(0.000000001f, 1 - rng.random())) / r;
+
+		if (t >= d)
+		{
+			x = x + w * d;
+			return true;
+		}
+
+		x = x + w * t;
+	}
+}
+
+// CPU port of ExactSampleCosXAndW (STFPathtracing_RT.hlsl), the ground-truth random walk.
+template<typename TRandom>
+static ScatteringSample ExactSampleCosXAndW(TRandom &rng, float g, float phi, float r)
+{
+	ScatteringSample s = { 1, 0, 0, 0, false };
+	float3 x, w;
+	s.Absorbed = !ExactRandomWalk(rng, g, phi, r, x, w, s.N);
+	if (s.Absorbed)
+		s.Theta = 0;
+	else if (s.N > 0)
+		CompactExitVariables(x, w, s);
+	return s;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef OFFLINE_STFSAMPLER_H
+#define OFFLINE_STFSAMPLER_H
+
+#include <vector>
+#include "../Common/TableFiles.h"
+#include "../Common/AliasTable.h"
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/TableSlices.h"
+#include "ExactSampler.h"
+#include "DiffusionSampler.h"
+
+// Tables of STFPathtracing_RT.hlsl (stf2.bin, the sections STFTechnique streams to the device),
+// some of their (g, phi) slices (kind stf_slices, see TableSlices.h) or tables with adaptive g and
+// phi bins (kind stf_adaptive, see TableBins.h).
+struct STFTables {
+	// HG factor [-1,1] linear
+	static const int BINS_G = 200;
+	// Scattering albedo [0, 0.999] linear in log(1 / (1 - alpha))
+	static const int BINS_SA = 1000;
+	// Radius [1, 256] linear in log(r)
+	static const int BINS_R = 9;
+	// Theta [0,pi] linear in cos(theta)
+	static const int BINS_THETA = 45;
+
+	static const int STRIDE_G = BINS_SA * BINS_R * BINS_THETA;
+	static const int STRIDE_SA = BINS_R * BINS_THETA;
+	static const int STRIDE_R = BINS_THETA;
+
+	static const int ALBEDO_COUNT = BINS_G * BINS_SA * BINS_R;
+	static const size_t STF_COUNT = (size_t)BINS_G * BINS_SA * BINS_R * BINS_THETA;
+
+	// Views of the mapped file, pages are read as the sampler touches them.
+	// Indexed by slice, the slice of (g, phi) is g * Binning.BinsSA + phi unless the file has slices.
+	MappedTableFile File;
+	// [slice, r] -> s^1
+	const float* OneTimeSA = nullptr;
+	// [slice, r] -> s^m
+	const float* MultiTimeSA = nullptr;
+	// [slice, r, theta] -> cdf(theta)
+	const float* STF = nullptr;
+	// [slice, r, theta] -> alias table of the theta row, null if the file has none
+	const uint32_t* AliasSTF = nullptr;
+	// [g, phi] -> slice (-1 if missing) of stf_slices files, empty for the whole tables
+	std::vector<int> Remap;
+	// g and phi bins, the BINS_G x BINS_SA uniform ones unless the file is adaptive
+	STFBinning Binning = STFBinning(BINS_G, BINS_SA);
+
+	int Slice(int g, int phi) const {
+		return Remap.empty() ? g * Binning.BinsSA + phi : Remap[g * BINS_SA + phi];
+	}
+
+	// Axes of the bins above, g and phi follow the section Edges in adaptive tables
+	static void SetAxes(TableFileHeader &h, bool adaptive) {
+		SetTableAxis(h, 0, "g", adaptive ? TABLE_AXIS_EDGES : TABLE_AXIS_LINEAR, -1, 1);
+		SetTableAxis(h, 1, "sa", adaptive ? TABLE_AXIS_EDGES : TABLE_AXIS_ALBEDO, 0, 0.999f);
+		SetTableAxis(h, 2, "r", TABLE_AXIS_LOG2, 1, 256);
+		SetTableAxis(h, 3, "theta", TABLE_AXIS_LINEAR, -1, 1);
+	}
+
+	// alias adds the section Alias_STF
+	static TableFileHeader CreateHeader(bool alias = false) {
+		const uint32_t bins[] = { BINS_G, BINS_SA, BINS_R, BINS_THETA };
+		const uint64_t strides[] = { STRIDE_G, STRIDE_SA, STRIDE_R, 1 };
+		TableFileHeader h = CreateTableHeader("stf", bins, strides, 4);
+		SetAxes(h, false);
+		AddTableSection(h, "OneTimeSA", TABLE_F32, ALBEDO_COUNT);
+		AddTableSection(h, "MultiTimeSA", TABLE_F32, ALBEDO_COUNT);
+		AddTableSection(h, "STF", TABLE_F32, STF_COUNT);
+		if (alias)
+			AddTableSection(h, "Alias_STF", TABLE_U32, STF_COUNT);
+		return h;
+	}
+
+	// Sections of count slices with their keys (g * BINS_SA + phi) in the section Slices.
+	static TableFileHeader CreateSlicesHeader(int count, bool alias = false) {
+		const uint32_t bins[] = { BINS_G, BINS_SA, BINS_R, BINS_THETA };
+		const uint64_t strides[] = { 0, STRIDE_SA, STRIDE_R, 1 };
+		TableFileHeader h = CreateTableHeader("stf_slices", bins, strides, 4);
+		SetAxes(h, false);
+		AddTableSection(h, "Slices", TABLE_U32, count);
+		AddTableSection(h, "SA", TABLE_F32, 2 * (uint64_t)count * BINS_R);
+		AddTableSection(h, "STF", TABLE_F32, (uint64_t)count * STRIDE_SA);
+		if (alias)
+			AddTableSection(h, "Alias_STF", TABLE_U32, (uint64_t)count * STRIDE_SA);
+		return h;
+	}
+
+	// Tables of binsG x binsSA adaptive bins, Edges and Lookup go after the uniform sections.
+	static TableFileHeader CreateAdaptiveHeader(int binsG, int binsSA, bool alias = false) {
+		const uint32_t bins[] = { (uint32_t)binsG, (uint32_t)binsSA, BINS_R, BINS_THETA };
+		const uint64_t strides[] = { (uint64_t)binsSA * STRIDE_SA, STRIDE_SA, STRIDE_R, 1 };
+		TableFileHeader h = CreateTableHeader("stf_adaptive", bins, strides, 4);
+		SetAxes(h, true);
+		uint64_t albedos = (uint64_t)binsG * binsSA * BINS_R;
+		AddTableSection(h, "OneTimeSA", TABLE_F32, albedos);
+		AddTableSection(h, "MultiTimeSA", TABLE_F32, albedos);
+		AddTableSection(h, "STF", TABLE_F32, albedos * BINS_THETA);
+		if (alias)
+			AddTableSection(h, "Alias_STF", TABLE_U32, albedos * BINS_THETA);
+		AddTableSection(h, "Edges", TABLE_F32, (uint64_t)binsG + binsSA);
+		AddTableSection(h, "Lookup", TABLE_U32, 2 * TABLE_BIN_LOOKUP);
+		return h;
+	}
+
+	bool Load(const char* path) {
+		const uint32_t bins[] = { BINS_G, BINS_SA, BINS_R, BINS_THETA };
+		Remap.clear();
+		Binning = STFBinning(BINS_G, BINS_SA);
+		// tables written before the header are raw sections (MappedTableFile::OpenHeaderless)
+		if (!File.Open(path) && !File.OpenHeaderless(path, "stf", bins, 4))
+			return false;
+		const TableFileHeader &h = File.Header();
+		if (h.Matches("stf_slices", bins, 4))
+			return LoadSlices();
+		if (!h.Matches("stf", bins, 4)) {
+			const uint32_t adaptive[] = { h.Bins[0], h.Bins[1], BINS_R, BINS_THETA };
+			if (!h.Matches("stf_adaptive", adaptive, 4))
+				return false;
+			Binning = STFBinning((int)h.Bins[0], (int)h.Bins[1]);
+			if (!Binning.Use(File))
+				return false;
+		}
+		uint64_t albedos = (uint64_t)Binning.BinsG * Binning.BinsSA * BINS_R;
+		OneTimeSA = (const float*)File.Section("OneTimeSA", sizeof(float), albedos);
+		MultiTimeSA = (const float*)File.Section("MultiTimeSA", sizeof(float), albedos);
+		STF = (const float*)File.Section("STF", sizeof(float), albedos * BINS_THETA);
+		AliasSTF = (const uint32_t*)File.Section("Alias_STF", sizeof(uint32_t), albedos * BINS_THETA);
+		return OneTimeSA && MultiTimeSA && STF;
+	}
+
+	bool LoadSlices() {
+		const TableSection* keys = File.Header().Find("Slices");
+		uint64_t count = keys ? keys->Count : 0;
+		const uint32_t* slices = (const uint32_t*)File.Section("Slices", sizeof(uint32_t), count);
+		OneTimeSA = (const float*)File.Section("SA", sizeof(float), 2 * count * BINS_R);
+		MultiTimeSA = OneTimeSA ? OneTimeSA + count * BINS_R : nullptr;
+		STF = (const float*)File.Section("STF", sizeof(float), count * STRIDE_SA);
+		AliasSTF = (const uint32_t*)File.Section("Alias_STF", sizeof(uint32_t), count * STRIDE_SA);
+		if (!slices || !OneTimeSA || !STF)
+			return false;
+		Remap.assign((size_t)BINS_G * BINS_SA, -1);
+		for (uint64_t s = 0; s < count; s++)
+			if (slices[s] < Remap.size())
+				Remap[slices[s]] = (int)s;
+		return true;
+	}
+};
+
+// CPU port of SampleCosXAndW in STFPathtracing_RT.hlsl.
+// N is 0 or 1 for the analytic cases and -1 for the tabulated multiple scattering. Spheres
+// larger than the last radius of the tables are sampled in the diffusion limit.
+// alias draws theta from Alias_STF as the shader does with TABLE_ALIAS_SAMPLING.
+// interpolate picks the g and phi bins around the medium with their interpolation weights
+// (TABLE_INTERPOLATED_SAMPLING) instead of the bins the medium falls in, drawing the randoms as
+// STFPickPhiBin and STFPickGBin do (phi first, only where there is a neighbour bin).
+static ScatteringSample STFSampleCosXAndW(const STFTables &tables, RandomGenerator &rng, float g, float phi, float r, bool alias = false,
+	bool interpolate = false)
+{
+	if (r > (1 << (STFTables::BINS_R - 1))) // beyond the last radius of the tables
+		return DiffusionSampleCosXAndW(rng, g, phi, r);
+
+	ScatteringSample s = { 1, 0, 0, 0, false };
+
+	float logR = maxf(0.0f, log2f(r));
+
+	int rBin = (int)logR;
+	rBin += (rng.random() < fmodf(logR, 1.0f)); // better than interpolate beteen logR and logR+1
+	r = powf(2.0f, (float)rBin);
+
+	int phiBin, gBin;
+	if (interpolate) {
+		float wPhi, wG;
+		if (tables.Binning.PhiBins(phi, phiBin, wPhi))
+			phiBin += rng.random() < wPhi;
+		if (tables.Binning.GBins(g, gBin, wG))
+			gBin += rng.random() < wG;
+	}
+	else {
+		phiBin = tables.Binning.PhiBin(phi);
+		gBin = tables.Binning.GBin(g);
+	}
+	int slice = tables.Slice(gBin, phiBin);
+	if (slice < 0) { // medium without slice in the file, absorbed as the shader does
+		s.Absorbed = true;
+		s.N = -1;
+		return s;
+	}
+	size_t offsetInSTFTable = (size_t)rBin * STFTables::STRIDE_R + (size_t)slice * STFTables::STRIDE_SA;
+
+	float selectingCase = rng.random();
+	float prob0Scat = expf(-r);
+	float prob1Scat = tables.OneTimeSA[slice * STFTables::BINS_R + rBin];
+	float probmScat = tables.MultiTimeSA[slice * STFTables::BINS_R + rBin];
+
+	if (selectingCase < prob0Scat) // no scattering
+		return s;
+
+	selectingCase -= prob0Scat;
+	if (selectingCase < prob1Scat) {
+		// Mueller proposal for a single scattering (see the shader about its bias)
+		float t = -logf(1 - rng.random() * (1 - prob0Scat)) / r;
+		float3 w = ImportanceSamplePhase(rng, g, float3(0, 0, 1)); // scattering event...
+		float d = DistanceToSphereBoundary(float3(0, 0, t), w);
+		float3 x = float3(0, 0, t) + w * d;
+		float cosBeta = dot(x, w);
+		s.Beta = sqrtf(maxf(0.0f, 1 - cosBeta * cosBeta));
+		s.Alpha = 0;
+		s.Theta = x.z;
+		s.N = 1;
+		return s;
+	}
+	selectingCase -= prob1Scat;
+	if (selectingCase < probmScat) {
+		// Mueller assumes separability of p(x,w) = p(x)p(w)
+		// alpha and beta are choosen uniformly in plane disc,
+		// therefore they represent a cosine weighted outgoing direction
+		float angle = rng.random() * 2 * 3.141596f;
+		float rad = sqrtf(rng.random());
+		s.Alpha = rad * sinf(angle);
+		s.Beta = rad * cosf(angle);
+
+		size_t minTheta = offsetInSTFTable;
+		size_t maxTheta = offsetInSTFTable + STFTables::BINS_THETA - 1;
+		if (alias) {
+			float u0 = rng.random();
+			minTheta += SampleAlias(tables.AliasSTF + offsetInSTFTable, STFTables::BINS_THETA, u0, rng.random());
+		}
+		else
+			while (minTheta < maxTheta) {
+				size_t med = (minTheta + maxTheta) / 2;
+				if (selectingCase < tables.STF[med])
+					maxTheta = med;
+				else
+					minTheta = med + 1;
+			}
+		s.Theta = 2 * ((minTheta - offsetInSTFTable) + rng.random()) / STFTables::BINS_THETA - 1;
+		s.N = -1;
+		return s;
+	}
+	s.Alpha = s.Beta = s.Theta = 0;
+	s.N = -1;
+	s.Absorbed = true;
+	return s;
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef OFFLINE_STFXCOMPRESSEDSAMPLER_H
+#define OFFLINE_STFXCOMPRESSEDSAMPLER_H
+
+#include <vector>
+#include "STFXSampler.h"
+
+// Compressed STFX tables (stfx_compressed.bin), CPU counterpart of Shaders/Tools/CompressedCDF.h.
+// Every cdf(x, w | g, r, logN) of BINS_X bins is quantized to 16 bits (65535 is 1) and stored as
+//	sparse: (cdf, bin) pairs of the bins where the cdf grows, or
+//	dense: the cdf of the bins from the first to the last non empty one.
+// whichever is smaller. Zero probability bins are never sampled, so leaving them out is exact.
+// Cdfs of logN bins that CDF_LogN never selects are empty.
+//
+// Table file of kind stfx_compressed (TableFile.h) with sections
+//	CDF_LogN float[BINS_G * BINS_R * BINS_LOGN] (as in stfx.bin)
+//	Cells STFXCompressedCell[BINS_G * BINS_R * BINS_LOGN] (same order as the cdfs of CDF_XW)
+//	Data uint16[] (even count, sparse blocks start at even positions)
+//	Alias_LogN uint[BINS_G * BINS_R * BINS_LOGN] (alias tables of CDF_LogN, see AliasTable.h)
+
+// Offset in 16-bit units and Info = first bin | count << 13 | sparse << 31
+// Count is 0 for cdfs that are never sampled.
+struct STFXCompressedCell {
+	uint32_t Offset;
+	uint32_t Info;
+
+	int First() const { return Info & 0x1FFF; }
+	int Count() const { return (Info >> 13) & 0x3FFF; }
+	bool Sparse() const { return (Info >> 31) != 0; }
+};
+
+// Returns the bin of the quantized cdf where value (in [0,1)) falls.
+static int SearchCompressedCDF(const uint16_t* data, const STFXCompressedCell &cell, float value) {
+	float v = value * 65535;
+	int beg = 0, end = cell.Count() - 1;
+	if (end < 0)
+		return 0;
+	const uint16_t* block = data + cell.Offset;
+	if (cell.Sparse()) {
+		// pairs (cdf, bin), one 32-bit read each in the shader
+		while (beg < end) {
+			int med = (beg + end) / 2;
+			if (v < block[2 * med])
+				end = med;
+			else
+				beg = med + 1;
+		}
+		return block[2 * beg + 1];
+	}
+	while (beg < end) {
+		int med = (beg + end) / 2;
+		if (v < block[med])
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return cell.First() + beg;
+}
+
+struct STFXCompressedTables {
+	std::vector<float> CDF_LogN;
+	std::vector<STFXCompressedCell> Cells;
+	std::vector<uint16_t> Data;
+	std::vector<uint32_t> AliasLogN;
+
+	TableFileHeader CreateHeader() const {
+		TableFileHeader h = STFXTables::CreateBinsHeader("stfx_compressed");
+		AddTableSection(h, "CDF_LogN", TABLE_F32, CDF_LogN.size());
+		AddTableSection(h, "Cells", TABLE_U32X2, Cells.size());
+		AddTableSection(h, "Data", TABLE_U16, Data.size());
+		AddTableSection(h, "Alias_LogN", TABLE_U32, AliasLogN.size());
+		return h;
+	}
+
+	size_t Bytes() const { return (size_t)TableFileSize(CreateHeader()); }
+
+	// Appends the cdf of one (g, r, logN) cell. selected is false if CDF_LogN never picks it.
+	void Encode(const float* cdf, bool selected) {
+		const int X = STFXTables::BINS_X;
+		STFXCompressedCell cell = { (uint32_t)Data.size(), 0 };
+		if (!selected) {
+			Cells.push_back(cell);
+			return;
+		}
+		uint16_t q[X];
+		int first = -1, last = 0, steps = 0;
+		uint16_t previous = 0;
+		for (int x = 0; x < X; x++) {
+			float c = cdf[x] < 0 ? 0 : cdf[x] > 1 ? 1 : cdf[x];
+			int v = (int)(c * 65535 + 0.5f);
+			q[x] = (uint16_t)(v < previous ? previous : v);
+			if (q[x] > previous) {
+				if (first < 0)
+					first = x;
+				last = x;
+				steps++;
+			}
+			previous = q[x];
+		}
+		if (first < 0) { // degenerated, everything in the last bin
+			first = last = X - 1;
+			steps = 1;
+		}
+		q[last] = 65535;
+		int denseCount = last - first + 1;
+		if (2 * steps < denseCount) {
+			cell.Info = (uint32_t)first | (uint32_t)steps << 13 | 1u << 31;
+			uint16_t below = 0;
+			for (int x = first; x <= last; x++)
+				if (q[x] > below) {
+					Data.push_back(q[x]);
+					Data.push_back((uint16_t)x);
+					below = q[x];
+				}
+		}
+		else {
+			cell.Info = (uint32_t)first | (uint32_t)denseCount << 13;
+			Data.insert(Data.end(), q + first, q + last + 1);
+			if (Data.size() % 2)
+				Data.push_back(65535);
+		}
+		Cells.push_back(cell);
+	}
+
+	// Compresses stfx.bin one cdf at a time from its mapping.
+	bool Compress(const char* densePath) {
+		STFXTables dense;
+		if (!dense.Load(densePath))
+			return false;
+		CDF_LogN.assign(dense.CDF_LogN, dense.CDF_LogN + STFXTables::LOGN_COUNT);
+		AliasLogN.resize(STFXTables::LOGN_COUNT);
+		for (int i = 0; i < STFXTables::LOGN_COUNT; i += STFXTables::BINS_LOGN)
+			BuildAliasTable(CDF_LogN.data() + i, STFXTables::BINS_LOGN, AliasLogN.data() + i);
+		Cells.clear();
+		Data.clear();
+		for (int i = 0; i < STFXTables::LOGN_COUNT; i++) {
+			int logNBin = i % STFXTables::BINS_LOGN;
+			float below = logNBin == 0 ? 0 : CDF_LogN[i - 1];
+			Encode(dense.CDF_XW + (size_t)i * STFXTables::BINS_X, CDF_LogN[i] > below);
+		}
+		return true;
+	}
+
+	bool Save(const char* path) const {
+		TableFileHeader h = CreateHeader();
+		const void* sections[] = { CDF_LogN.data(), Cells.data(), Data.data(), AliasLogN.data() };
+		for (int i = 0; i < 4; i++)
+			h.Sections[i].Checksum = TableChecksum(sections[i], h.Sections[i].Bytes());
+		FILE* f = OpenFile(path, "wb");
+		if (!f)
+			return false;
+		bool ok = WriteTableHeader(f, h);
+		for (int i = 0; ok && i < 4; i++)
+			ok = WriteTableSection(f, h.Sections[i], sections[i]);
+		ok &= fclose(f) == 0;
+		return ok;
+	}
+
+	// The compressed tables are small, they are copied out of the mapping.
+	bool Load(const char* path) {
+		MappedTableFile file;
+		if (!file.Open(path) || !STFXTables::Matches(file.Header(), "stfx_compressed"))
+			return false;
+		const TableSection* data = file.Header().Find("Data");
+		const float* logN = (const float*)file.Section("CDF_LogN", sizeof(float), STFXTables::LOGN_COUNT);
+		const STFXCompressedCell* cells = (const STFXCompressedCell*)file.Section("Cells", sizeof(STFXCompressedCell), STFXTables::LOGN_COUNT);
+		const uint32_t* alias = (const uint32_t*)file.Section("Alias_LogN", sizeof(uint32_t), STFXTables::LOGN_COUNT);
+		if (!data || data->ElementSize != sizeof(uint16_t) || !logN || !cells || !alias)
+			return false;
+		const uint16_t* values = (const uint16_t*)file.Section(*data);
+		CDF_LogN.assign(logN, logN + STFXTables::LOGN_COUNT);
+		Cells.assign(cells, cells + STFXTables::LOGN_COUNT);
+		AliasLogN.assign(alias, alias + STFXTables::LOGN_COUNT);
+		Data.assign(values, values + data->Count);
+		return true;
+	}
+};
+
+// STFXSampleCosXAndW with the position and direction bin drawn from the compressed cdfs.
+// alias draws the logN bin from Alias_LogN as the shader does with TABLE_ALIAS_SAMPLING.
+static ScatteringSample STFXCompressedSampleCosXAndW(const STFXCompressedTables &tables, RandomGenerator &rng, float g, float phi, float r, bool alias = false)
+{
+	ScatteringSample s = { 1, 0, 0, 0, false };
+
+	int rBin = 0;
+	if (r < 1) {
+		rBin = rng.random() < r;
+	}
+	else
+	{
+		float logR = log2f(r) - 0.5f + 1;
+		rBin = (int)logR;
+		rBin += rng.random() < fmodf(logR, 1.0f);
+	}
+	rBin = rBin < STFXTables::BINS_R - 1 ? rBin : STFXTables::BINS_R - 1;
+	int gBin = (int)minf((g * 0.5f + 0.5f) * STFXTables::BINS_G, STFXTables::BINS_G - 1.0f);
+
+	size_t startPoslogNPos = (size_t)gBin * STFXTables::LOGN_G_STRIDE + (size_t)rBin * STFXTables::LOGN_R_STRIDE;
+	int selectedLogNBin;
+	if (alias) {
+		float u0 = rng.random();
+		selectedLogNBin = SampleAlias(tables.AliasLogN.data() + startPoslogNPos, STFXTables::BINS_LOGN, u0, rng.random());
+	}
+	else
+		selectedLogNBin = (int)(STFXSearchBin(tables.CDF_LogN.data(), startPoslogNPos, startPoslogNPos + STFXTables::BINS_LOGN - 1, rng.random()) - startPoslogNPos);
+	float logN = 8.0f * (selectedLogNBin + rng.random()) / STFXTables::BINS_LOGN;
+
+	s.N = (int)expf(logN);
+
+	if (rng.random() >= powf(phi, (float)s.N))
+	{
+		s.Theta = 0;
+		s.Absorbed = true;
+		return s;
+	}
+
+	int xwBin = SearchCompressedCDF(tables.Data.data(), tables.Cells[startPoslogNPos + selectedLogNBin], rng.random());
+
+	int thetaBin = xwBin / (STFXTables::BINS_BETA * STFXTables::BINS_ALPHA);
+	int betaBin = (xwBin % (STFXTables::BINS_BETA * STFXTables::BINS_ALPHA)) / STFXTables::BINS_ALPHA;
+	int alphaBin = xwBin % STFXTables::BINS_ALPHA;
+
+	s.Theta = (thetaBin + rng.random()) * 2.0f / STFXTables::BINS_THETA - 1.0f;
+	s.Beta = s.N > 1 ? (betaBin + rng.random()) * 2.0f / STFXTables::BINS_BETA - 1.0f : 0.0f;
+	s.Alpha = s.N > 2 ? (alphaBin + rng.random()) * 2.0f / STFXTables::BINS_ALPHA - 1.0f : 0.0f;
+	return s;
+}
+
+#endif
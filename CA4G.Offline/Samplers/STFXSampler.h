@@ -0,0 +1,173 @@
+#ifndef OFFLINE_STFXSAMPLER_H
+#define OFFLINE_STFXSAMPLER_H
+
+#include <vector>
+#include "../Common/TableFiles.h"
+#include "../Common/AliasTable.h"
+#include "../Common/GuideTable.h"
+#include "../../CA4G.DemoApp/Shaders/CVAEVolumePathtracing/TableBins.h"
+#include "ExactSampler.h"
+
+// Tables of STFXPathtracing_RT.hlsl (stfx.bin, the sections STFXTechnique streams to the device).
+// The shader splits CDF_XW in two buffers, here both halves are contiguous.
+struct STFXTables {
+	// HG factor [-1,1] linear
+	static const int BINS_G = 100;
+	// Log of the number of Scatters between 0..8
+	static const int BINS_LOGN = 100;
+	// Radius [0, 127] linear in log(r)
+	static const int BINS_R = 8;
+	// Theta [0,pi] linear in cos(theta) beta[-1,1] alpha[-1,1]
+	static const int BINS_THETA = 40;
+	static const int BINS_BETA = 20;
+	static const int BINS_ALPHA = 10;
+	static const int BINS_X = BINS_THETA * BINS_BETA * BINS_ALPHA;
+
+	static const int LOGN_G_STRIDE = BINS_R * BINS_LOGN;
+	static const int LOGN_R_STRIDE = BINS_LOGN;
+
+	static const int LOGN_COUNT = BINS_G * BINS_R * BINS_LOGN;
+	static const size_t XW_COUNT = (size_t)BINS_G * BINS_R * BINS_LOGN * BINS_X;
+	static const size_t GUIDE_COUNT = (size_t)LOGN_COUNT * GUIDE_ENTRIES;
+
+	// Views of the mapped file, pages are read as the sampler touches them
+	MappedTableFile File;
+	// cdf(logN | g, r)
+	const float* CDF_LogN = nullptr;
+	// cdf(x, w | g, r, logN)
+	const float* CDF_XW = nullptr;
+	// alias tables of the same cdfs, null if the file has none
+	const uint32_t* AliasLogN = nullptr;
+	const uint32_t* AliasXW = nullptr;
+	// [g, r, logN] -> guide table of cdf(x, w), null if the file has none
+	const uint16_t* GuideXW = nullptr;
+
+	// Header without sections, also of the compressed tables
+	static TableFileHeader CreateBinsHeader(const char* kind) {
+		const uint32_t bins[] = { BINS_G, BINS_R, BINS_LOGN, BINS_THETA, BINS_BETA, BINS_ALPHA };
+		const uint64_t strides[] = { (uint64_t)LOGN_G_STRIDE * BINS_X, (uint64_t)LOGN_R_STRIDE * BINS_X, BINS_X,
+			BINS_BETA * BINS_ALPHA, BINS_ALPHA, 1 };
+		TableFileHeader h = CreateTableHeader(kind, bins, strides, 6);
+		SetTableAxis(h, 0, "g", TABLE_AXIS_LINEAR, -1, 1);
+		SetTableAxis(h, 1, "r", TABLE_AXIS_LOG2, 0.70710678f, 90.509668f);
+		SetTableAxis(h, 2, "logn", TABLE_AXIS_LINEAR, 0, 8);
+		SetTableAxis(h, 3, "theta", TABLE_AXIS_LINEAR, -1, 1);
+		SetTableAxis(h, 4, "beta", TABLE_AXIS_LINEAR, -1, 1);
+		SetTableAxis(h, 5, "alpha", TABLE_AXIS_LINEAR, -1, 1);
+		return h;
+	}
+
+	// alias adds the sections Alias_LogN and Alias_XW, guide the section Guide_XW after them
+	static TableFileHeader CreateHeader(bool alias, bool guide = false) {
+		TableFileHeader h = CreateBinsHeader("stfx");
+		AddTableSection(h, "CDF_LogN", TABLE_F32, LOGN_COUNT);
+		AddTableSection(h, "CDF_XW", TABLE_F32, XW_COUNT);
+		if (alias) {
+			AddTableSection(h, "Alias_LogN", TABLE_U32, LOGN_COUNT);
+			AddTableSection(h, "Alias_XW", TABLE_U32, XW_COUNT);
+		}
+		if (guide)
+			AddTableSection(h, "Guide_XW", TABLE_U16, GUIDE_COUNT);
+		return h;
+	}
+
+	static bool Matches(const TableFileHeader &h, const char* kind = "stfx") {
+		const uint32_t bins[] = { BINS_G, BINS_R, BINS_LOGN, BINS_THETA, BINS_BETA, BINS_ALPHA };
+		return h.Matches(kind, bins, 6);
+	}
+
+	bool Load(const char* path) {
+		const uint32_t bins[] = { BINS_G, BINS_R, BINS_LOGN, BINS_THETA, BINS_BETA, BINS_ALPHA };
+		if (!File.Open(path, "stfx", bins, 6) && !File.OpenHeaderless(path, "stfx", bins, 6))
+			return false;
+		CDF_LogN = (const float*)File.Section("CDF_LogN", sizeof(float), LOGN_COUNT);
+		CDF_XW = (const float*)File.Section("CDF_XW", sizeof(float), XW_COUNT);
+		AliasLogN = (const uint32_t*)File.Section("Alias_LogN", sizeof(uint32_t), LOGN_COUNT);
+		AliasXW = (const uint32_t*)File.Section("Alias_XW", sizeof(uint32_t), XW_COUNT);
+		GuideXW = (const uint16_t*)File.Section("Guide_XW", sizeof(uint16_t), GUIDE_COUNT);
+		return CDF_LogN && CDF_XW;
+	}
+};
+
+static size_t STFXSearchBin(const float* cdf, size_t beg, size_t end, float value) {
+	while (beg < end) {
+		size_t med = (beg + end) / 2;
+		if (value < cdf[med])
+			end = med;
+		else
+			beg = med + 1;
+	}
+	return beg;
+}
+
+// CPU port of SampleCosXAndW in STFXPathtracing_RT.hlsl.
+// The radius bin is clamped to the table, the shader relies on out of range reads returning 0.
+// alias draws the bins from the alias tables as the shader does with TABLE_ALIAS_SAMPLING,
+// guided searches CDF_XW from its guide tables as with TABLE_GUIDE_SAMPLING (before alias).
+// interpolate picks the g bin around the medium with its interpolation weights as STFXPickGBin
+// does with TABLE_INTERPOLATED_SAMPLING (a random only where there is a neighbour bin).
+static ScatteringSample STFXSampleCosXAndW(const STFXTables &tables, RandomGenerator &rng, float g, float phi, float r, bool alias = false,
+	bool guided = false, bool interpolate = false)
+{
+	ScatteringSample s = { 1, 0, 0, 0, false };
+
+	int rBin = 0;
+	if (r < 1) {
+		rBin = rng.random() < r; // 0 or 1 depending on linerly on r (0,1].
+	}
+	else
+	{
+		float logR = log2f(r) - 0.5f + 1;
+		rBin = (int)logR;
+		rBin += rng.random() < fmodf(logR, 1.0f);
+	}
+	rBin = rBin < STFXTables::BINS_R - 1 ? rBin : STFXTables::BINS_R - 1;
+	int gBin = (int)minf((g * 0.5f + 0.5f) * STFXTables::BINS_G, STFXTables::BINS_G - 1.0f);
+	float wG;
+	if (interpolate && InterpolateTableBin(nullptr, STFXTables::BINS_G, STFXTables::BINS_G - 1, gBin, g * 0.5f + 0.5f, wG))
+		gBin += rng.random() < wG;
+
+	// Get the logN from the table
+	size_t startPoslogNPos = (size_t)gBin * STFXTables::LOGN_G_STRIDE + (size_t)rBin * STFXTables::LOGN_R_STRIDE;
+	int selectedLogNBin;
+	if (alias) {
+		float u0 = rng.random();
+		selectedLogNBin = SampleAlias(tables.AliasLogN + startPoslogNPos, STFXTables::BINS_LOGN, u0, rng.random());
+	}
+	else
+		selectedLogNBin = (int)(STFXSearchBin(tables.CDF_LogN, startPoslogNPos, startPoslogNPos + STFXTables::BINS_LOGN - 1, rng.random()) - startPoslogNPos);
+	float logN = 8.0f * (selectedLogNBin + rng.random()) / STFXTables::BINS_LOGN;
+
+	s.N = (int)expf(logN);
+
+	if (rng.random() >= powf(phi, (float)s.N)) // Absorption given N
+	{
+		s.Theta = 0;
+		s.Absorbed = true;
+		return s;
+	}
+
+	size_t startxwPos = (startPoslogNPos + selectedLogNBin) * STFXTables::BINS_X;
+	int xwBin;
+	if (guided)
+		xwBin = SearchGuided(tables.CDF_XW, startxwPos, STFXTables::BINS_X,
+			tables.GuideXW + (startPoslogNPos + selectedLogNBin) * GUIDE_ENTRIES, rng.random());
+	else if (alias) {
+		float u0 = rng.random();
+		xwBin = SampleAlias(tables.AliasXW + startxwPos, STFXTables::BINS_X, u0, rng.random());
+	}
+	else
+		xwBin = (int)(STFXSearchBin(tables.CDF_XW, startxwPos, startxwPos + STFXTables::BINS_X - 1, rng.random()) - startxwPos);
+
+	// Convert xwBin into theta, beta, alpha bins...
+	int thetaBin = xwBin / (STFXTables::BINS_BETA * STFXTables::BINS_ALPHA);
+	int betaBin = (xwBin % (STFXTables::BINS_BETA * STFXTables::BINS_ALPHA)) / STFXTables::BINS_ALPHA;
+	int alphaBin = xwBin % STFXTables::BINS_ALPHA;
+
+	s.Theta = (thetaBin + rng.random()) * 2.0f / STFXTables::BINS_THETA - 1.0f;
+	s.Beta = s.N > 1 ? (betaBin + rng.random()) * 2.0f / STFXTables::BINS_BETA - 1.0f : 0.0f;
+	s.Alpha = s.N > 2 ? (alphaBin + rng.random()) * 2.0f / STFXTables::BINS_ALPHA - 1.0f : 0.0f;
+	return s;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Offline tools and CPU benchmarks for the volume path tracing techniques of CA4G.DemoApp.
+// Usage: CA4G.Offline <command> [key=value ...]
+
+#include <cstdio>
+#include <cstring>
+
+#include "Benchmarks/WavefrontBenchmark.h"
+#include "Benchmarks/ActivationBenchmark.h"
+#include "Benchmarks/SamplerBenchmark.h"
+#include "Benchmarks/SharedPathBenchmark.h"
+#include "Benchmarks/STFXCompressionBenchmark.h"
+#include "Benchmarks/TableLoadBenchmark.h"
+#include "Benchmarks/AliasSamplingBenchmark.h"
+#include "Benchmarks/GuideSamplingBenchmark.h"
+#include "Benchmarks/SphereStepsBenchmark.h"
+#include "Benchmarks/DiffusionErrorBenchmark.h"
+#include "Benchmarks/RenderBenchmark.h"
+#include "Benchmarks/RayBenchmark.h"
+#include "Benchmarks/AnimationBenchmark.h"
+#include "Benchmarks/TileScalingBenchmark.h"
+#include "Benchmarks/RandomBenchmark.h"
+#include "Benchmarks/ConvergenceBenchmark.h"
+#include "Benchmarks/AdaptiveBenchmark.h"
+#include "Benchmarks/RouletteBenchmark.h"
+#include "Generators/CVAETrainingData.h"
+#include "Generators/STFTableGenerator.h"
+#include "Generators/STFXCompressor.h"
+#include "Generators/TableFileTool.h"
+#include "Generators/STFAdaptiveBinning.h"
+#include "Render/RenderCommand.h"
+
+struct OfflineCommand {
+	const char* Name;
+	const char* Description;
+	int(*Run)(const CommandLine &args);
+};
+
+static const OfflineCommand Commands[] = {
+	{ "wavefront", "CVAE medium events evaluated one by one vs batched in wavefronts", WavefrontBenchmark },
+	{ "activations", "Error report and throughput of the softplus accuracy tiers", ActivationBenchmark },
+	{ "samplers", "Exact walk, STF, STFX and CVAE samplers: throughput and distances to the exact walk", SamplerBenchmark },
+	{ "sharedpath", "Per channel tracing vs shared paths for the three color channels in RGB media", SharedPathBenchmark },
+	{ "cvaedata", "Generates training data of the CVAE scattering model (exact random walks)", CVAETrainingDataGenerator },
+	{ "stftable", "Generates the STF (stf2.bin) or STFX (stfx.bin) tables with exact random walks", STFTableGenerator },
+	{ "stfxcompress", "Converts stfx.bin into the compressed STFX tables (16-bit sparse cdfs)", STFXCompressor },
+	{ "aliassampling", "Binary search over the STF/STFX cdfs vs alias tables: lookups and samplers", AliasSamplingBenchmark },
+	{ "spheresteps", "Medium steps per path in a thick sphere capping the step spheres at 2^8 to 2^14", SphereStepsBenchmark },
+	{ "diffusionerror", "Absorption and exit distances of the diffusion limit against the exact walk beyond the tables", DiffusionErrorBenchmark },
+	{ "guidesampling", "Binary search over the STFX position-direction cdfs vs guide tables: speed and coherence", GuideSamplingBenchmark },
+	{ "stfxformat", "Size, speed and error of the compressed STFX tables against the dense ones", STFXCompressionBenchmark },
+	{ "tableconvert", "Converts STF/STFX tables without header into table files", TableConvert },
+	{ "tableinfo", "Prints the header of a table file and verifies its checksums", TableInfo },
+	{ "tabledefines", "Writes the bin defines of the shaders from the header of a table file", TableDefines },
+	{ "tablealias", "Adds the alias tables of every cdf to an STF or STFX table file", TableAlias },
+	{ "tableguide", "Adds the guide tables of the position-direction cdfs to an STFX table file", TableGuide },
+	{ "tableslice", "Copies the STF slices of some media into a table of slices", TableSlice },
+	{ "stfadaptive", "Builds STF tables with adaptive g and phi bins from the uniform ones", STFAdaptiveBinning },
+	{ "render", "Renders a DemoApp scene with the CPU path tracer (pt, stf, stfx or cvae) into a PFM", RenderCommand },
+	{ "renderbench", "Passes of the CPU path tracer per technique: paths/s, Mrays/s and work per path", RenderBenchmark },
+	{ "raybench", "Closest hit Mrays/s of the wide BVH for single rays and packets, coherent vs incoherent", RayBenchmark },
+	{ "animbench", "Per frame cost of RenderAccelerator::Update (TLAS rebuild, BLAS refit) vs building it again", AnimationBenchmark },
+	{ "tilebench", "Scaling of the CPU path tracer passes from 1 to N threads per tile schedule, with worker utilization", TileScalingBenchmark },
+	{ "randoms", "Philox ray streams vs HybridTaus with warm-up: known answers, statistical tests and throughput", RandomBenchmark },
+	{ "converge", "Noise of the CPU path tracer against the passes per random sequence (philox vs Owen-scrambled Sobol)", ConvergenceBenchmark },
+	{ "adaptivebench", "Adaptive sampling against uniform passes to the same relative error estimate", AdaptiveBenchmark },
+	{ "roulette", "Russian roulette thresholds of the CPU path tracer: steps per event type, noise and efficiency", RouletteBenchmark },
+	{ "tableload", "Load time and peak memory of the tables mapped vs read into memory", TableLoadBenchmark },
+};
+
+int main(int argc, char** argv)
+{
+	if (argc >= 2)
+		for (auto &c : Commands)
+			if (strcmp(c.Name, argv[1]) == 0)
+				return c.Run(CommandLine(argc - 2, argv + 2));
+
+	printf("Usage: CA4G.Offline <command> [key=value ...]\n");
+	for (auto &c : Commands)
+		printf("  %-16s %s\n", c.Name, c.Description);
+	return 1;
+}
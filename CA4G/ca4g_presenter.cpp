@@ -591,6 +591,17 @@ namespace CA4G {
 			singleSubresource->__InternalViewWrapper, region);
 	}
 
+	void CopyManager::Loading::BufferRegionToGPU(gObj<Buffer> dst, long long dstOffset, gObj<Buffer> staging, long long bytes)
+	{
+		DX_ResourceWrapper* dstWrapper = dst->__InternalDXWrapper;
+		DX_ResourceWrapper* stagingWrapper = staging->__InternalDXWrapper;
+		stagingWrapper->__ResolveUploading();
+		dstWrapper->AddBarrier(wrapper->__InternalDXCmdWrapper->cmdList, D3D12_RESOURCE_STATE_COPY_DEST);
+		wrapper->__InternalDXCmdWrapper->cmdList->CopyBufferRegion(
+			dstWrapper->resource, dst->__InternalViewWrapper->arrayStart * dstWrapper->elementStride + dstOffset,
+			stagingWrapper->uploading, staging->__InternalViewWrapper->arrayStart * stagingWrapper->elementStride, bytes);
+	}
+
 	void CopyManager::Copying::Resource(gObj<Texture2D> dst, gObj<Texture2D> src) {
 		auto cmdWrapper = this->manager->__InternalDXCmdWrapper;
 		dst->__InternalDXWrapper->AddBarrier(cmdWrapper->cmdList,
@@ -138,6 +138,10 @@ namespace CA4G {
 			
 			// Updates a region of a single subresource from the gpu to mapped memory
 			void RegionFromGPU(gObj<ResourceView> singleSubresource, const D3D12_BOX &region);
+
+			// Updates bytes of a buffer starting at dstOffset with the beginning of the mapped memory of other buffer.
+			// Allows to stream big buffers through a small staging buffer instead of mapping them entirely.
+			void BufferRegionToGPU(gObj<Buffer> dst, long long dstOffset, gObj<Buffer> staging, long long bytes);
 		}
 		* const load;
 